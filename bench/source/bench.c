@@ -0,0 +1,462 @@
+#define TWSFWPHYSX_IMPLEMENTATION
+
+// for clock_gettime(CLOCK_MONOTONIC)
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 199309L
+#endif
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+#include "twsfwphysx/twsfwphysx.h"
+
+enum distribution { UNIFORM = 0, CLUSTERED = 1 };
+
+static const char *const DISTRIBUTIONS[] = { "uniform", "clustered" };
+
+struct scenario {
+    const char *curve;
+    enum distribution distribution;
+    int32_t n_agents;
+    int32_t n_missiles;
+    int32_t n_steps;
+    float agent_radius;
+};
+
+struct options {
+    uint64_t seed;
+    uint64_t max_buffer_bytes;
+    uint64_t min_time_ns;
+    double budget_ns;
+    int smoke;
+    const char *output;
+};
+
+struct result {
+    int skipped;
+    uint64_t n_calls;
+    double ns_per_call;
+    double ns_per_agent_step;
+    struct twsfwphysx_stats stats;
+};
+
+// Each curve varies one parameter while all others are kept fixed.
+static const struct scenario SCENARIOS[] = {
+    { "agents", UNIFORM, 10, 0, 10, .01F },
+    { "agents", UNIFORM, 100, 0, 10, .01F },
+    { "agents", UNIFORM, 1000, 0, 10, .01F },
+    { "agents", UNIFORM, 10000, 0, 10, .01F },
+    { "agents", UNIFORM, 100000, 0, 10, .01F },
+    { "agents", CLUSTERED, 10, 0, 10, .01F },
+    { "agents", CLUSTERED, 100, 0, 10, .01F },
+    { "agents", CLUSTERED, 1000, 0, 10, .01F },
+    { "agents", CLUSTERED, 10000, 0, 10, .01F },
+    { "agents", CLUSTERED, 100000, 0, 10, .01F },
+    { "missiles", UNIFORM, 1000, 0, 10, .01F },
+    { "missiles", UNIFORM, 1000, 500, 10, .01F },
+    { "missiles", UNIFORM, 1000, 5000, 10, .01F },
+    { "missiles", UNIFORM, 1000, 50000, 10, .01F },
+    { "steps", UNIFORM, 1000, 1000, 1, .01F },
+    { "steps", UNIFORM, 1000, 1000, 10, .01F },
+    { "steps", UNIFORM, 1000, 1000, 100, .01F },
+    { "radius", CLUSTERED, 1000, 1000, 10, .001F },
+    { "radius", CLUSTERED, 1000, 1000, 10, .01F },
+    { "radius", CLUSTERED, 1000, 1000, 10, .1F },
+};
+
+static const struct scenario SMOKE_SCENARIOS[] = {
+    { "agents", UNIFORM, 10, 0, 10, .01F },
+    { "agents", UNIFORM, 1000, 0, 10, .01F },
+    { "agents", CLUSTERED, 1000, 0, 10, .01F },
+    { "missiles", UNIFORM, 1000, 1000, 10, .01F },
+};
+
+static uint64_t now_ns(void)
+{
+#ifdef _WIN32
+    LARGE_INTEGER counter;
+    LARGE_INTEGER frequency;
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&frequency);
+
+    const uint64_t ticks = (uint64_t)counter.QuadPart;
+    const uint64_t hz = (uint64_t)frequency.QuadPart;
+    return ticks / hz * 1000000000ULL + ticks % hz * 1000000000ULL / hz;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+// splitmix64
+static uint64_t random_u64(uint64_t *state)
+{
+    uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30U)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27U)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31U);
+}
+
+// uniform in [0, 1)
+static float random_float(uint64_t *state)
+{
+    return (float)(random_u64(state) >> 40U) / 16777216.F;
+}
+
+static struct twsfwphysx_vec normalized(const struct twsfwphysx_vec v)
+{
+    const float norm = sqrtf(v.x * v.x + v.y * v.y + v.z * v.z);
+    const struct twsfwphysx_vec w = { v.x / norm, v.y / norm, v.z / norm };
+    return w;
+}
+
+static struct twsfwphysx_vec random_position(uint64_t *state)
+{
+    const float z = 2.F * random_float(state) - 1.F;
+    const float phi = 6.2831853F * random_float(state);
+    const float s = sqrtf(fmaxf(0.F, 1.F - z * z));
+    const struct twsfwphysx_vec r = { s * cosf(phi), s * sinf(phi), z };
+    return r;
+}
+
+// random direction of movement, i.e., random rotation axis perpendicular to r
+static struct twsfwphysx_vec random_axis(uint64_t *state,
+                                         const struct twsfwphysx_vec r)
+{
+    for (;;) {
+        const struct twsfwphysx_vec t = random_position(state);
+        const struct twsfwphysx_vec u = { r.y * t.z - r.z * t.y,
+                                          r.z * t.x - r.x * t.z,
+                                          r.x * t.y - r.y * t.x };
+        if (u.x * u.x + u.y * u.y + u.z * u.z > 1e-6F) {
+            return normalized(u);
+        }
+    }
+}
+
+// approximately normal distributed with a standard deviation of .5
+static float random_normal(uint64_t *state)
+{
+    return random_float(state) + random_float(state) + random_float(state) -
+           1.5F;
+}
+
+static void make_world_state(const struct scenario *scenario,
+                             uint64_t *state,
+                             struct twsfwphysx_agents *agents,
+                             struct twsfwphysx_missiles *missiles)
+{
+    struct twsfwphysx_vec centers[8];
+    for (int32_t i = 0; i < 8; i++) {
+        centers[i] = random_position(state);
+    }
+
+    for (int32_t i = 0; i < agents->size; i++) {
+        struct twsfwphysx_vec r = random_position(state);
+        if (scenario->distribution == CLUSTERED) {
+            const struct twsfwphysx_vec c = centers[random_u64(state) % 8U];
+            const float dx = .1F * random_normal(state);
+            const float dy = .1F * random_normal(state);
+            const float dz = .1F * random_normal(state);
+            const struct twsfwphysx_vec v = { c.x + dx, c.y + dy, c.z + dz };
+            r = normalized(v);
+        }
+
+        // agents must not die, such that all calls do the same work
+        const struct twsfwphysx_agent agent = { r,
+                                                random_axis(state, r),
+                                                random_float(state),
+                                                random_float(state),
+                                                1e9F };
+        twsfwphysx_set_agent(agents, agent, i);
+    }
+
+    for (int32_t i = 0; i < scenario->n_missiles; i++) {
+        const struct twsfwphysx_vec r = random_position(state);
+        const struct twsfwphysx_missile missile = { r,
+                                                    random_axis(state, r),
+                                                    1.F,
+                                                    i };
+        twsfwphysx_add_missile(missiles, missile);
+    }
+}
+
+static uint64_t estimate_buffer_bytes(const int32_t n_agents)
+{
+    const uint64_t n = (uint64_t)n_agents;
+    return n * sizeof(struct twsfwphysx_agent) + n * (n - 1) * sizeof(float);
+}
+
+static struct result run(const struct scenario *scenario,
+                         const uint64_t seed,
+                         const struct options *options)
+{
+    struct result result;
+    memset(&result, 0, sizeof(struct result));
+
+    if (estimate_buffer_bytes(scenario->n_agents) > options->max_buffer_bytes) {
+        result.skipped = 1;
+        return result;
+    }
+
+    const struct twsfwphysx_world world = { .restitution = .9F,
+                                            .agent_radius =
+                                                scenario->agent_radius,
+                                            .missile_acceleration = 1.F };
+
+    uint64_t state = seed;
+    struct twsfwphysx_agents initial_agents =
+        twsfwphysx_create_agents(scenario->n_agents);
+    struct twsfwphysx_missiles initial_missiles =
+        twsfwphysx_new_missile_batch();
+    make_world_state(scenario, &state, &initial_agents, &initial_missiles);
+
+    struct twsfwphysx_agents agents =
+        twsfwphysx_create_agents(scenario->n_agents);
+    struct twsfwphysx_missiles missiles = twsfwphysx_new_missile_batch();
+    for (int32_t i = 0; i < initial_missiles.size; i++) {
+        twsfwphysx_add_missile(&missiles, initial_missiles.missiles[i]);
+    }
+
+    struct twsfwphysx_simulation_buffer *buffer =
+        twsfwphysx_create_simulation_buffer();
+    twsfwphysx_set_stats(buffer, &result.stats);
+
+    // The first call (which allocates the buffer) is not measured. All calls
+    // start from the same world state.
+    uint64_t ns = 0;
+    for (int32_t call = -1; call < 1 || ns < options->min_time_ns; call++) {
+        memcpy(agents.agents,
+               initial_agents.agents,
+               (size_t)agents.size * sizeof(struct twsfwphysx_agent));
+        if (initial_missiles.size > 0) {
+            memcpy(missiles.missiles,
+                   initial_missiles.missiles,
+                   (size_t)initial_missiles.size *
+                       sizeof(struct twsfwphysx_missile));
+        }
+        missiles.size = initial_missiles.size;
+
+        if (call == 0) {
+            const uint64_t buffer_bytes = result.stats.buffer_bytes;
+            twsfwphysx_reset_stats(&result.stats);
+            result.stats.buffer_bytes = buffer_bytes;
+        }
+
+        const uint64_t begin = now_ns();
+        twsfwphysx_simulate(
+            &agents, &missiles, &world, .1F, scenario->n_steps, buffer);
+        if (call >= 0) {
+            ns += now_ns() - begin;
+        }
+    }
+
+    result.n_calls = result.stats.n_calls;
+    result.ns_per_call = (double)ns / (double)result.n_calls;
+    result.ns_per_agent_step =
+        result.ns_per_call /
+        ((double)scenario->n_agents * (double)scenario->n_steps);
+
+    twsfwphysx_delete_simulation_buffer(buffer);
+    twsfwphysx_delete_missile_batch(&missiles);
+    twsfwphysx_delete_agents(&agents);
+    twsfwphysx_delete_missile_batch(&initial_missiles);
+    twsfwphysx_delete_agents(&initial_agents);
+
+    return result;
+}
+
+static void write_result(FILE *file,
+                         const struct scenario *scenario,
+                         const struct result *result)
+{
+    fprintf(file,
+            "    {\"curve\": \"%s\", \"distribution\": \"%s\", "
+            "\"n_agents\": %d, \"n_missiles\": %d, \"n_steps\": %d, "
+            "\"agent_radius\": %g, ",
+            scenario->curve,
+            DISTRIBUTIONS[scenario->distribution],
+            scenario->n_agents,
+            scenario->n_missiles,
+            scenario->n_steps,
+            (double)scenario->agent_radius);
+
+    if (result->skipped) {
+        fprintf(file, "\"skipped\": true}");
+        return;
+    }
+
+    const struct twsfwphysx_stats *stats = &result->stats;
+    const double n_calls = (double)result->n_calls;
+    fprintf(file,
+            "\"skipped\": false, \"n_calls\": %llu, \"ns_per_call\": %.1f, "
+            "\"ns_per_agent_step\": %.3f, \"ns_missiles\": %.1f, "
+            "\"ns_distances\": %.1f, \"ns_agents\": %.1f, "
+            "\"ns_collisions\": %.1f, \"n_collisions\": %.1f, "
+            "\"n_hits\": %.1f, \"buffer_bytes\": %llu}",
+            (unsigned long long)result->n_calls,
+            result->ns_per_call,
+            result->ns_per_agent_step,
+            (double)stats->ns_missiles / n_calls,
+            (double)stats->ns_distances / n_calls,
+            (double)stats->ns_agents / n_calls,
+            (double)stats->ns_collisions / n_calls,
+            (double)stats->n_collisions / n_calls,
+            (double)stats->n_hits / n_calls,
+            (unsigned long long)stats->buffer_bytes);
+}
+
+static void print_result(const struct scenario *scenario,
+                         const struct result *result)
+{
+    fprintf(stderr,
+            "%-9s %-9s %7d %6d %4d %6.3f ",
+            scenario->curve,
+            DISTRIBUTIONS[scenario->distribution],
+            scenario->n_agents,
+            scenario->n_missiles,
+            scenario->n_steps,
+            (double)scenario->agent_radius);
+
+    if (result->skipped) {
+        fprintf(stderr, "%14s\n", "skipped");
+    } else {
+        fprintf(stderr,
+                "%14.3f %10.1f\n",
+                result->ns_per_agent_step,
+                (double)result->stats.buffer_bytes / 1048576.);
+    }
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr,
+            "usage: %s [--smoke] [--seed N] [--max-buffer-mb N] "
+            "[--min-time-ms N] [--budget-ns N] [--output FILE]\n"
+            "\n"
+            "  --smoke          run a few small scenarios once and fail if\n"
+            "                   any exceeds the budget\n"
+            "  --seed           seed of the random world states (42)\n"
+            "  --max-buffer-mb  skip scenarios whose simulation buffer would\n"
+            "                   exceed this size (2048)\n"
+            "  --min-time-ms    minimal measuring time per scenario (500)\n"
+            "  --budget-ns      maximal ns per agent and simulation step\n"
+            "                   (1e6 with --smoke, unlimited otherwise)\n"
+            "  --output         write JSON to FILE instead of stdout\n",
+            name);
+}
+
+static int parse_options(const int argc,
+                         const char *argv[],
+                         struct options *options)
+{
+    options->seed = 42;
+    options->max_buffer_bytes = 2048ULL * 1048576ULL;
+    options->min_time_ns = 500ULL * 1000000ULL;
+    options->budget_ns = -1.;
+    options->smoke = 0;
+    options->output = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        const int has_value = i + 1 < argc;
+        if (strcmp(argv[i], "--smoke") == 0) {
+            options->smoke = 1;
+        } else if (strcmp(argv[i], "--seed") == 0 && has_value) {
+            options->seed = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--max-buffer-mb") == 0 && has_value) {
+            options->max_buffer_bytes = strtoull(argv[++i], NULL, 10) *
+                                        1048576ULL;
+        } else if (strcmp(argv[i], "--min-time-ms") == 0 && has_value) {
+            options->min_time_ns = strtoull(argv[++i], NULL, 10) * 1000000ULL;
+        } else if (strcmp(argv[i], "--budget-ns") == 0 && has_value) {
+            options->budget_ns = strtod(argv[++i], NULL);
+        } else if (strcmp(argv[i], "--output") == 0 && has_value) {
+            options->output = argv[++i];
+        } else {
+            usage(argv[0]);
+            return 0;
+        }
+    }
+
+    if (options->smoke) {
+        options->min_time_ns = 0;
+        if (options->budget_ns < 0.) {
+            options->budget_ns = 1e6;
+        }
+    }
+
+    return 1;
+}
+
+int main(const int argc, const char *argv[])
+{
+    struct options options;
+    if (!parse_options(argc, argv, &options)) {
+        return 2;
+    }
+
+    const struct scenario *scenarios = options.smoke ? SMOKE_SCENARIOS :
+                                                       SCENARIOS;
+    const size_t n_scenarios =
+        options.smoke ? sizeof(SMOKE_SCENARIOS) / sizeof(struct scenario) :
+                        sizeof(SCENARIOS) / sizeof(struct scenario);
+
+    FILE *file = stdout;
+    if (options.output != NULL) {
+        file = fopen(options.output, "w");
+        if (file == NULL) {
+            fprintf(stderr, "cannot open %s\n", options.output);
+            return 2;
+        }
+    }
+
+    fprintf(stderr,
+            "%-9s %-9s %7s %6s %4s %6s %14s %10s\n",
+            "curve",
+            "dist",
+            "n",
+            "misl",
+            "stps",
+            "radius",
+            "ns/agent-step",
+            "buffer MiB");
+    fprintf(file,
+            "{\n  \"version\": \"%s\",\n  \"seed\": %llu,\n  \"results\": [\n",
+            twsfwphysx_version(),
+            (unsigned long long)options.seed);
+
+    int n_over_budget = 0;
+    for (size_t i = 0; i < n_scenarios; i++) {
+        // independent world states for all scenarios
+        const uint64_t seed = options.seed + 0x9e3779b97f4a7c15ULL * i;
+        const struct result result = run(&scenarios[i], seed, &options);
+
+        print_result(&scenarios[i], &result);
+        write_result(file, &scenarios[i], &result);
+        fprintf(file, i + 1 < n_scenarios ? ",\n" : "\n");
+
+        if (!result.skipped && options.budget_ns >= 0. &&
+            result.ns_per_agent_step > options.budget_ns) {
+            fprintf(stderr,
+                    "^ exceeds budget of %g ns per agent and step\n",
+                    options.budget_ns);
+            n_over_budget += 1;
+        }
+    }
+
+    fprintf(file, "  ]\n}\n");
+    if (file != stdout) {
+        fclose(file);
+    }
+
+    return n_over_budget > 0 ? 1 : 0;
+}
@@ -5,6 +5,8 @@ if (BUILD_TESTING)
     add_subdirectory(test)
 endif ()
 
+add_subdirectory(bench)
+
 option(ENABLE_COVERAGE "Enable coverage support separate from CTest's" OFF)
 if (ENABLE_COVERAGE)
     include(cmake/coverage.cmake)
@@ -12,6 +12,7 @@ default(
         source/*.c source/*.h
         include/*.h
         test/*.c test/*.h
+        bench/*.c bench/*.h
 )
 default(FIX NO)
 
@@ -15,6 +15,42 @@
   Darwin systems, ensure that this library is available during
   compilation/linking.
 
+  Results of `sinf`, `cosf`, `expf` and `atan2f` differ slightly between
+  implementations of `math.h` and compilers may fuse multiplications and
+  additions. Define `TWSFWPHYSX_DETERMINISTIC` next to
+  `TWSFWPHYSX_IMPLEMENTATION` to replace those functions by the engine's own
+  implementations and to disable floating point contractions.
+  \ref twsfwphysx_simulate then yields bitwise identical results on all
+  platforms with IEEE 754 floats (e.g., x86-64, ARM64 and WASM), such that
+  peers of a lockstep simulation only need to exchange their inputs. Never
+  combine this mode with `-ffast-math`.
+
+  Define `TWSFWPHYSX_SIMD` (next to `TWSFWPHYSX_DETERMINISTIC`) to propagate
+  agents and missiles, to compute distances and to search for hits with four
+  lanes at once. Results stay bitwise identical. The kernels use WebAssembly
+  SIMD128 (compile with `-msimd128`) or, on other targets, the vector
+  extensions of GCC and Clang.
+
+  Define `TWSFWPHYSX_ASYNC` to enable \ref twsfwphysx_pipeline, which
+  simulates on a worker thread while the previous tick is still readable, and
+  \ref twsfwphysx_thread_pool, which shares the work of each simulation step
+  among several threads. This requires POSIX threads (link with `-pthread`)
+  or the Win32 API on Windows.
+
+  Define `TWSFWPHYSX_TRACE` to record a timeline of \ref twsfwphysx_simulate
+  (see \ref twsfwphysx_write_trace) that can be opened in `chrome://tracing`
+  or Perfetto.
+
+  Define `TWSFWPHYSX_MMAP` to enable replay files (see
+  \ref twsfwphysx_recorder and \ref twsfwphysx_replay) and world files (see
+  \ref twsfwphysx_world_file) which are read via memory mapping as well as
+  \ref twsfwphysx_publisher which shares world states with other processes.
+  This requires POSIX `mmap` or the Win32 API on Windows.
+
+  C++17 users may include \ref twsfwphysx.hpp instead, which adds RAII
+  containers and selects specialised simulation kernels at compile time (see
+  \ref twsfwphysx_simulate_kernel).
+
   Find more information about installing and on how to contribute on our
   <a href="https://github.com/Tondorf/twsfwphysx">GitHub page</a>.
 
@@ -92,17 +128,73 @@
  * changes between **all** `0.*.*` releases and an __almost__ stable ABI for
  * between versions within the same major release `>= 1`.
  *
+ * For rollback netcode, \ref twsfwphysx_snapshots keeps a ring of saved world
+ * states that can be restored with \ref twsfwphysx_restore.
+ *
+ * Cap and k-nearest neighbour queries as well as ray casts for aiming
+ * (\ref twsfwphysx_cast_rays) are answered by a
+ * \ref twsfwphysx_spatial_index that is rebuilt once per tick.
+ * \ref twsfwphysx_predict_missile_impacts and
+ * \ref twsfwphysx_predict_collisions look ahead without simulating.
+ *
  * HAVE FUN!
  */
 
 #pragma once
 
+// Intervals are measured with clock_gettime(CLOCK_MONOTONIC), which strict ISO
+// C modes hide unless POSIX is requested before the first system header.
+#if defined(TWSFWPHYSX_IMPLEMENTATION) && !defined(_WIN32) && \
+    !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 199309L
+#endif
+
 #include <stdint.h>
 
+#ifdef TWSFWPHYSX_TRACE
+#include <stdio.h>
+#endif
+
 #ifdef TWSFWPHYSX_IMPLEMENTATION
 #include <assert.h>
+#include <float.h>
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+#ifdef TWSFWPHYSX_ASYNC
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+#endif
+
+#ifdef TWSFWPHYSX_TRACE
+#include <stdatomic.h>
+#endif
+
+#if defined(TWSFWPHYSX_SIMD) && defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#endif
+
+#ifdef TWSFWPHYSX_MMAP
+#include <stddef.h>
+#include <stdio.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#endif
 #endif
 
 #ifdef __cplusplus
@@ -396,6 +488,299 @@ struct twsfwphysx_simulation_buffer *twsfwphysx_create_simulation_buffer(void);
 void twsfwphysx_delete_simulation_buffer(
     struct twsfwphysx_simulation_buffer *buffer);
 
+/**
+ * @brief Number of regions of \ref twsfwphysx_digest.
+ */
+#define TWSFWPHYSX_DIGEST_REGIONS 8
+
+/**
+ * @brief Order-independent digest of the state of agents and missiles.
+ *
+ * Every agent (including its index) and every missile is hashed bitwise and
+ * the hashes are summed up. Hence, the digest does not depend on the order of
+ * missiles which changes whenever missiles detonate. Peers of a lockstep
+ * simulation can compare digests to detect desynchronizations.
+ *
+ * Additionally, hashes are summed up per region, i.e., per octant of the
+ * sphere: The region of an object at position \f$\vec{r}\f$ is
+ * `(r.x < 0) | (r.y < 0) << 1 | (r.z < 0) << 2`. Comparing `regions` helps to
+ * narrow down where a divergence started without diffing the full state. Note
+ * that the sum of all `regions` equals `agents + missiles` (modulo
+ * \f$2^{64}\f$).
+ *
+ * Attach a digest to a \ref twsfwphysx_simulation_buffer via
+ * \ref twsfwphysx_set_digest to let \ref twsfwphysx_simulate keep it up to
+ * date or compute it directly with \ref twsfwphysx_compute_digest.
+ */
+struct twsfwphysx_digest {
+    uint64_t agents; ///< Digest of all agents
+    uint64_t missiles; ///< Digest of all missiles
+    uint64_t regions[TWSFWPHYSX_DIGEST_REGIONS];
+    ///< Digests of agents and missiles per octant of the sphere
+};
+
+/**
+ * @brief Attaches a digest to the simulation buffer.
+ *
+ * Once attached, \ref twsfwphysx_simulate updates `digest` incrementally while
+ * propagating, colliding and detonating objects during its last simulation
+ * step. Afterward, `digest` describes the returned state of agents and missiles
+ * and reading it is free. Set `digest` to `NULL` to detach it again. If no
+ * digest is attached, no additional work is done during simulation.
+ *
+ * Note that changes to agents or missiles between calls to
+ * \ref twsfwphysx_simulate (e.g., via \ref twsfwphysx_turn_agent) are not
+ * reflected until the next simulation.
+ *
+ * @param buffer The simulation buffer
+ * @param digest The digest (or `NULL`)
+ */
+void twsfwphysx_set_digest(struct twsfwphysx_simulation_buffer *buffer,
+                           struct twsfwphysx_digest *digest);
+
+/**
+ * @brief Computes the digest of agents and missiles.
+ *
+ * Computes the same digest that \ref twsfwphysx_simulate maintains (see
+ * \ref twsfwphysx_set_digest) from scratch.
+ *
+ * @param agents Agents
+ * @param missiles Missiles
+ * @param digest The digest
+ */
+void twsfwphysx_compute_digest(const struct twsfwphysx_agents *agents,
+                               const struct twsfwphysx_missiles *missiles,
+                               struct twsfwphysx_digest *digest);
+
+/**
+ * @brief Types of \ref twsfwphysx_event.
+ */
+enum twsfwphysx_event_type {
+    TWSFWPHYSX_EVENT_COLLISION = 0,
+    ///< Two agents collided: `a` and `b` are the indices of the agents and
+    ///< `value` is the magnitude of the impulse.
+
+    TWSFWPHYSX_EVENT_HIT_HEAD_ON = 1,
+    ///< A missile hit an agent head-on: `a` is the index of the agent, `b` the
+    ///< payload of the missile and `value` the damage (`< 2`).
+
+    TWSFWPHYSX_EVENT_HIT_REAR = 2
+    ///< A missile hit an agent from behind: `a` is the index of the agent, `b`
+    ///< the payload of the missile and `value` the damage (`>= 2`).
+};
+
+/**
+ * @brief Compact record of something that happened during simulation.
+ *
+ * See \ref twsfwphysx_event_type for the meaning of `a`, `b` and `value`.
+ */
+struct twsfwphysx_event {
+    int32_t type; ///< One of \ref twsfwphysx_event_type
+    int32_t step; ///< Index of the simulation step (`0 <= step < n_steps`)
+    int32_t a; ///< Index of the (first) agent
+    int32_t b; ///< Index of the second agent or payload of the missile
+    float value; ///< Impulse or damage
+};
+
+/**
+ * @brief Ring buffer of events recorded by \ref twsfwphysx_simulate.
+ *
+ * The storage of the ring is provided by the caller (see
+ * \ref twsfwphysx_make_events) and the ring can be attached to a simulation
+ * buffer via \ref twsfwphysx_set_events. If the ring is full, the oldest
+ * event is overridden and `n_dropped` is increased.
+ *
+ * **Example**
+ * \code{.c}
+ * struct twsfwphysx_event storage[1024];
+ * struct twsfwphysx_events events = twsfwphysx_make_events(storage, 1024);
+ * twsfwphysx_set_events(buffer, &events);
+ *
+ * twsfwphysx_simulate(&agents, &missiles, &world, t, n_steps, buffer);
+ * for (int32_t i = 0; i < events.size; i++) {
+ *     const struct twsfwphysx_event *event = twsfwphysx_get_event(&events, i);
+ *     // ...
+ * }
+ * twsfwphysx_clear_events(&events);
+ * \endcode
+ */
+struct twsfwphysx_events {
+    struct twsfwphysx_event *events; ///< Storage provided by the caller
+    int32_t capacity; ///< Number of events that fit into `events`
+    int32_t begin; ///< Position of the oldest event in `events`
+    int32_t size; ///< Number of events in the ring
+    int32_t n_dropped; ///< Number of overridden events
+};
+
+/**
+ * @brief Creates an empty ring of events.
+ *
+ * @param storage Array of at least `capacity` events
+ * @param capacity Capacity of the ring (`capacity > 0`)
+ * @return The empty ring
+ */
+struct twsfwphysx_events
+twsfwphysx_make_events(struct twsfwphysx_event *storage, int32_t capacity);
+
+/**
+ * @brief Removes all events from the ring.
+ *
+ * Also resets \ref twsfwphysx_events.n_dropped.
+ *
+ * @param events The ring of events
+ */
+void twsfwphysx_clear_events(struct twsfwphysx_events *events);
+
+/**
+ * @brief Returns an event from the ring.
+ *
+ * @param events The ring of events
+ * @param i Index of the event, starting with the oldest event
+ *          (`0 <= i < events->size`)
+ * @return The event
+ */
+const struct twsfwphysx_event *
+twsfwphysx_get_event(const struct twsfwphysx_events *events, int32_t i);
+
+/**
+ * @brief Attaches a ring of events to the simulation buffer.
+ *
+ * Once attached, \ref twsfwphysx_simulate appends an event for every
+ * collision between agents and for every detonated missile. Set `events` to
+ * `NULL` to detach the ring again. If no ring is attached, no events are
+ * recorded and no additional work is done.
+ *
+ * @param buffer The simulation buffer
+ * @param events The ring of events (or `NULL`)
+ */
+void twsfwphysx_set_events(struct twsfwphysx_simulation_buffer *buffer,
+                           struct twsfwphysx_events *events);
+
+/**
+ * @brief Performance counters of \ref twsfwphysx_simulate.
+ *
+ * Attach the counters to a simulation buffer via \ref twsfwphysx_set_stats.
+ * \ref twsfwphysx_simulate then accumulates the (wall-clock) time spent in
+ * each phase of a simulation step and counts what happened. Read the fields
+ * directly and use \ref twsfwphysx_reset_stats to start over.
+ *
+ * The simulation step consists of the following phases:
+ * - missiles: searching the nearest agent for each missile, detonating or
+ *   propagating it,
+ * - distances: filling the pairwise distance buffers before and after the
+ *   propagation of agents,
+ * - agents: propagating agents,
+ * - collisions: testing all pairs of agents and resolving collisions.
+ */
+struct twsfwphysx_stats {
+    uint64_t n_calls; ///< Number of calls to \ref twsfwphysx_simulate
+    uint64_t n_steps; ///< Number of simulation steps
+    uint64_t ns_total; ///< Nanoseconds spent in \ref twsfwphysx_simulate
+    uint64_t ns_missiles; ///< Nanoseconds spent in the missile phase
+    uint64_t ns_distances; ///< Nanoseconds spent in the distance phase
+    uint64_t ns_agents; ///< Nanoseconds spent in the agent phase
+    uint64_t ns_collisions; ///< Nanoseconds spent in the collision phase
+    uint64_t n_pairs_tested; ///< Number of tested pairs of agents
+    uint64_t n_pairs_close; ///< Number of pairs within collision distance
+    uint64_t n_collisions; ///< Number of resolved collisions
+    uint64_t n_missiles_propagated; ///< Number of propagated missiles
+    uint64_t n_hits; ///< Number of detonated missiles
+    uint64_t n_reallocations; ///< Number of grown simulation buffers
+    uint64_t buffer_bytes; ///< Current (i.e., peak) size of the buffer
+};
+
+/**
+ * @brief Resets all performance counters to zero.
+ *
+ * @param stats The performance counters
+ */
+void twsfwphysx_reset_stats(struct twsfwphysx_stats *stats);
+
+/**
+ * @brief Attaches performance counters to the simulation buffer.
+ *
+ * Once attached, \ref twsfwphysx_simulate accumulates timings and counts in
+ * `stats` (without resetting it first). Set `stats` to `NULL` to detach the
+ * counters again. If no counters are attached, no clocks are read.
+ *
+ * @param buffer The simulation buffer
+ * @param stats The performance counters (or `NULL`)
+ */
+void twsfwphysx_set_stats(struct twsfwphysx_simulation_buffer *buffer,
+                          struct twsfwphysx_stats *stats);
+
+/**
+ * @brief View of a caller-provided (strided) array.
+ *
+ * The layout follows the conventions of NumPy: Element `[i][j][k]` is located
+ * at `(char *)data + i * strides[0] + j * strides[1] + k * strides[2]`, i.e.,
+ * all strides are given in bytes. Unused trailing strides are ignored.
+ */
+struct twsfwphysx_strided_array {
+    void *data; ///< Address of element `[0][0][0]` (or `NULL` to skip)
+    int64_t strides[3]; ///< Strides in bytes
+};
+
+/**
+ * @brief Trajectories of agents and missiles recorded during simulation.
+ *
+ * Attach a trajectory to a simulation buffer via
+ * \ref twsfwphysx_set_trajectory. \ref twsfwphysx_simulate then writes a
+ * _frame_ after every `every`-th simulation step, starting at frame 0 for each
+ * call, until `capacity` frames have been written. Every array with
+ * `data != NULL` receives the state of all objects at this step:
+ * - `agent_r`: `float[capacity][n_agents][3]`,
+ * - `agent_v`: `float[capacity][n_agents]`,
+ * - `agent_hp`: `float[capacity][n_agents]`,
+ * - `missile_r`: `float[capacity][n_missiles][3]`,
+ * - `missile_payload`: `int32_t[capacity][n_missiles]` and
+ * - `n_missiles`: `int32_t[capacity]`,
+ *
+ * where `n_agents` is \ref twsfwphysx_agents.size and `n_missiles` is
+ * \ref twsfwphysx_missiles.size at the beginning of the simulation. Since
+ * missiles detonate and the remaining ones are reordered (see
+ * \ref twsfwphysx_simulate), only the first `n_missiles[frame]` entries of
+ * the missile arrays are written in each frame; use `missile_payload` to
+ * identify missiles.
+ *
+ * **Example**
+ * \code{.c}
+ * float r[10][N_AGENTS][3];
+ * struct twsfwphysx_trajectory trajectory = {
+ *     .every = 10,
+ *     .capacity = 10,
+ *     .agent_r = { r, { sizeof(r[0]), sizeof(r[0][0]), sizeof(float) } }
+ * };
+ * twsfwphysx_set_trajectory(buffer, &trajectory);
+ *
+ * // r[i] holds the positions after 10 * (i + 1) steps
+ * twsfwphysx_simulate(&agents, &missiles, &world, t, 100, buffer);
+ * \endcode
+ */
+struct twsfwphysx_trajectory {
+    int32_t every; ///< Record every `every`-th simulation step (`every > 0`)
+    int32_t capacity; ///< Maximal number of frames
+    int32_t size; ///< Number of frames written by the last simulation
+    struct twsfwphysx_strided_array agent_r; ///< Positions of agents
+    struct twsfwphysx_strided_array agent_v; ///< Velocities of agents
+    struct twsfwphysx_strided_array agent_hp; ///< HPs of agents
+    struct twsfwphysx_strided_array missile_r; ///< Positions of missiles
+    struct twsfwphysx_strided_array missile_payload; ///< Payloads of missiles
+    struct twsfwphysx_strided_array n_missiles; ///< Numbers of missiles
+};
+
+/**
+ * @brief Attaches a trajectory to the simulation buffer.
+ *
+ * See \ref twsfwphysx_trajectory. Set `trajectory` to `NULL` to detach it
+ * again. If no trajectory is attached, no additional work is done.
+ *
+ * @param buffer The simulation buffer
+ * @param trajectory The trajectory (or `NULL`)
+ */
+void twsfwphysx_set_trajectory(struct twsfwphysx_simulation_buffer *buffer,
+                               struct twsfwphysx_trajectory *trajectory);
+
 /**
  * @brief Simulates the movements and interactions of agents and missiles.
  *
@@ -422,6 +807,9 @@ void twsfwphysx_delete_simulation_buffer(
  * remaining missiles is reordered. Note that \ref twsfwphysx_missile.payload
  * still stays persistent and thus can help to identify missiles.
  *
+ * Agents are updated in place, i.e., \ref twsfwphysx_agents.agents is never
+ * replaced or reallocated.
+ *
  * @param agents Agents
  * @param missiles Missiles
  * @param world World invariants
@@ -436,6 +824,81 @@ void twsfwphysx_simulate(struct twsfwphysx_agents *agents,
                          int32_t n_steps,
                          struct twsfwphysx_simulation_buffer *buffer);
 
+/**
+ * @brief Assumptions that select a specialised simulation kernel.
+ *
+ * Combine the flags with `|` and pass them to
+ * \ref twsfwphysx_simulate_kernel.
+ */
+enum twsfwphysx_kernel {
+    TWSFWPHYSX_KERNEL_GENERIC = 0,
+    ///< No assumptions (same as \ref twsfwphysx_simulate)
+
+    TWSFWPHYSX_KERNEL_NO_MISSILES = 1,
+    ///< There are no missiles.
+
+    TWSFWPHYSX_KERNEL_ELASTIC = 2,
+    ///< \ref twsfwphysx_world.restitution is 1.
+
+    TWSFWPHYSX_KERNEL_ALL_ALIVE = 4
+    ///< All agents have positive HPs. (Requires
+    ///< \ref TWSFWPHYSX_KERNEL_NO_MISSILES, because missiles can kill agents.)
+};
+
+/**
+ * @brief Simulates with a kernel that is specialised for some assumptions.
+ *
+ * Same as \ref twsfwphysx_simulate, but the hot loops are compiled for the
+ * given combination of \ref twsfwphysx_kernel flags, such that they carry no
+ * branches for missiles, restitution or HPs. Results are bitwise identical
+ * to \ref twsfwphysx_simulate as long as the assumptions hold (which is
+ * checked by assertions). If events, digests, statistics or trajectories are
+ * attached to `buffer`, this falls back to \ref twsfwphysx_simulate.
+ *
+ * The C++ wrapper `twsfwphysx.hpp` selects kernels at compile time via
+ * `twsfwphysx::simulate<Options>()`.
+ *
+ * @param agents Agents
+ * @param missiles Missiles
+ * @param world World invariants
+ * @param t Simulation time
+ * @param n_steps Number of simulation steps.
+ * @param buffer Simulation buffer (Set to `NULL` if not needed.)
+ * @param kernel Combination of \ref twsfwphysx_kernel flags
+ */
+void twsfwphysx_simulate_kernel(struct twsfwphysx_agents *agents,
+                                struct twsfwphysx_missiles *missiles,
+                                const struct twsfwphysx_world *world,
+                                float t,
+                                int32_t n_steps,
+                                struct twsfwphysx_simulation_buffer *buffer,
+                                uint32_t kernel);
+
+/**
+ * @brief Signature of \ref twsfwphysx_simulate and its specialised kernels.
+ */
+typedef void (*twsfwphysx_simulate_function)(
+    struct twsfwphysx_agents *agents,
+    struct twsfwphysx_missiles *missiles,
+    const struct twsfwphysx_world *world,
+    float t,
+    int32_t n_steps,
+    struct twsfwphysx_simulation_buffer *buffer);
+
+/**
+ * @brief Returns the kernel that is specialised for some assumptions.
+ *
+ * Every supported combination of \ref twsfwphysx_kernel flags has its own
+ * compiled function (see \ref twsfwphysx_simulate_kernel). Combinations
+ * without a specialised kernel return \ref twsfwphysx_simulate. Select the
+ * kernel once and call it repeatedly to skip the dispatch of
+ * \ref twsfwphysx_simulate_kernel.
+ *
+ * @param kernel Combination of \ref twsfwphysx_kernel flags
+ * @return The specialised kernel
+ */
+twsfwphysx_simulate_function twsfwphysx_select_kernel(uint32_t kernel);
+
 /**
  * @brief Changes orientation of agent.
  *
@@ -448,392 +911,5397 @@ void twsfwphysx_simulate(struct twsfwphysx_agents *agents,
  */
 void twsfwphysx_turn_agent(struct twsfwphysx_agent *agent, float angle);
 
-#ifdef TWSFWPHYSX_IMPLEMENTATION
-
-const char *twsfwphysx_version(void)
-{
-    return "0.9.0";
-}
+/**
+ * @struct twsfwphysx_snapshots
+ * @brief Opaque ring of preallocated world-state snapshots.
+ *
+ * A snapshot stores the complete state of agents and missiles that
+ * \ref twsfwphysx_simulate needs to continue a simulation. (The
+ * \ref twsfwphysx_simulation_buffer only holds intermediary results and does
+ * not need to be saved.) Each slot of the ring is a single contiguous block of
+ * memory that is reused for later snapshots, i.e., taking a snapshot does not
+ * allocate memory as long as the number of agents and missiles fits into the
+ * capacity given to \ref twsfwphysx_create_snapshots.
+ *
+ * This is intended for rollback netcode that keeps a short history of frames:
+ * \code{.c}
+ * struct twsfwphysx_snapshots *history =
+ *     twsfwphysx_create_snapshots(8, agents.size, 64);
+ *
+ * for (int32_t tick = 0;; tick++) {
+ *     twsfwphysx_snapshot(history, tick, &agents, &missiles);
+ *     twsfwphysx_simulate(&agents, &missiles, &world, t, n_steps, buffer);
+ *
+ *     if (late_input_arrived) {
+ *         twsfwphysx_restore(history, late_input_tick, &agents, &missiles);
+ *         // apply late input and re-simulate up to `tick`
+ *     }
+ * }
+ * \endcode
+ *
+ * Use \ref twsfwphysx_create_snapshots to create such a ring and
+ * \ref twsfwphysx_delete_snapshots to delete it if no longer needed.
+ */
+struct twsfwphysx_snapshots;
 
-struct twsfwphysx_agents twsfwphysx_create_agents(const int32_t size)
-{
-    struct twsfwphysx_agents agents = { NULL, 0 };
-    if (size < 1) {
-        return agents;
-    }
+/**
+ * @brief Creates a new ring of snapshots.
+ *
+ * Creates a ring of `n_slots` snapshots whose slots are preallocated for
+ * `n_agents` agents and `n_missiles` missiles. Snapshots of larger worlds are
+ * still possible but (re)allocate the affected slot.
+ *
+ * @param n_slots Number of snapshots kept in the ring (`n_slots > 0`)
+ * @param n_agents Number of agents to preallocate per slot
+ * @param n_missiles Number of missiles to preallocate per slot
+ * @return A new ring of snapshots
+ */
+struct twsfwphysx_snapshots *twsfwphysx_create_snapshots(int32_t n_slots,
+                                                         int32_t n_agents,
+                                                         int32_t n_missiles);
 
-    agents.agents = (struct twsfwphysx_agent *)malloc(
-        (uint64_t)size * sizeof(struct twsfwphysx_agent));
-    agents.size = size;
+/**
+ * @brief Deletes a ring of snapshots.
+ *
+ * Deletes the ring that was previously created using
+ * \ref twsfwphysx_create_snapshots.
+ *
+ * @param snapshots Ring of snapshots
+ */
+void twsfwphysx_delete_snapshots(struct twsfwphysx_snapshots *snapshots);
 
-    return agents;
-}
+/**
+ * @brief Saves the state of agents and missiles.
+ *
+ * Copies agents and missiles into the slot `tick % n_slots` of the ring and
+ * thereby overrides the oldest snapshot if the ring is full.
+ *
+ * @param snapshots Ring of snapshots
+ * @param tick Non-negative identifier of the snapshot, e.g., a frame number
+ * @param agents Agents
+ * @param missiles Missiles
+ */
+void twsfwphysx_snapshot(struct twsfwphysx_snapshots *snapshots,
+                         int32_t tick,
+                         const struct twsfwphysx_agents *agents,
+                         const struct twsfwphysx_missiles *missiles);
 
-void twsfwphysx_delete_agents(struct twsfwphysx_agents *agents)
-{
-    free(agents->agents);
-    agents->agents = NULL;
-    agents->size = 0;
-}
+/**
+ * @brief Restores the state of agents and missiles.
+ *
+ * Overrides `agents` and `missiles` with the snapshot that was taken for
+ * `tick`. Afterward, \ref twsfwphysx_simulate continues bit-identically to
+ * the simulation that followed the original call to
+ * \ref twsfwphysx_snapshot. If the number of agents differs from the
+ * snapshot, `agents` is resized. Missiles are (re)allocated as needed, just
+ * like in \ref twsfwphysx_add_missile.
+ *
+ * @param snapshots Ring of snapshots
+ * @param tick Identifier of the snapshot
+ * @param agents Agents (previously created by \ref twsfwphysx_create_agents)
+ * @param missiles Missiles
+ * @return `1` if the snapshot was restored, `0` if no snapshot for `tick` is
+ *         (still) present in the ring
+ */
+int twsfwphysx_restore(const struct twsfwphysx_snapshots *snapshots,
+                       int32_t tick,
+                       struct twsfwphysx_agents *agents,
+                       struct twsfwphysx_missiles *missiles);
 
-void twsfwphysx_set_agent(const struct twsfwphysx_agents *batch,
-                          const struct twsfwphysx_agent agent,
-                          const int32_t index)
-{
-    assert(index >= 0 && index < batch->size);
-    assert(batch->agents != NULL);
-    batch->agents[index] = agent;
-}
+/**
+ * @struct twsfwphysx_spatial_index
+ * @brief Opaque uniform grid over the positions of agents or missiles.
+ *
+ * Answers cap queries ("all agents within an angle of X") and k-nearest
+ * neighbour queries on the sphere without scanning all objects. The unit
+ * sphere is embedded into a uniform grid of cubic cells whose resolution
+ * depends on the number of indexed objects. Objects are sorted by cell and
+ * stored in a compressed sparse row layout, i.e., the objects of a cell (and
+ * of a column of cells) are contiguous in memory.
+ *
+ * An index is a snapshot of positions. Rebuild it (in linear time) after
+ * every call to \ref twsfwphysx_simulate, e.g.:
+ * \code{.c}
+ * struct twsfwphysx_spatial_index *index =
+ *     twsfwphysx_create_spatial_index();
+ *
+ * for (;;) {
+ *     twsfwphysx_simulate(&agents, &missiles, &world, t, n_steps, buffer);
+ *     twsfwphysx_index_agents(index, &agents);
+ *
+ *     int32_t nearest[4];
+ *     float cosines[4];
+ *     const int32_t n = twsfwphysx_query_nearest(
+ *         index, agents.agents[0].r, 4, nearest, cosines);
+ *     // nearest[0] == 0 is the agent itself
+ * }
+ * \endcode
+ *
+ * Use \ref twsfwphysx_create_spatial_index to create an index and
+ * \ref twsfwphysx_delete_spatial_index to delete it if no longer needed.
+ */
+struct twsfwphysx_spatial_index;
 
-struct twsfwphysx_missiles twsfwphysx_new_missile_batch(void)
-{
-    const struct twsfwphysx_missiles missiles = { NULL, 0, 0 };
-    return missiles;
-}
+/**
+ * @brief Creates a new (empty) spatial index.
+ *
+ * @return A new spatial index
+ */
+struct twsfwphysx_spatial_index *twsfwphysx_create_spatial_index(void);
 
-void twsfwphysx_clear_missile_batch(struct twsfwphysx_missiles *missiles)
-{
-    assert(missiles != NULL);
-    missiles->size = 0;
-}
+/**
+ * @brief Deletes the spatial index.
+ *
+ * @param index The spatial index
+ */
+void twsfwphysx_delete_spatial_index(struct twsfwphysx_spatial_index *index);
 
-void twsfwphysx_delete_missile_batch(struct twsfwphysx_missiles *missiles)
-{
-    free(missiles->missiles);
-    missiles->missiles = NULL;
-    missiles->size = 0;
-    missiles->capacity = 0;
-}
+/**
+ * @brief Indexes the positions of all agents with positive HPs.
+ *
+ * Replaces the previous content of the index. Memory is only (re)allocated
+ * if the number of objects grows. Queries return indices into
+ * \ref twsfwphysx_agents.agents.
+ *
+ * @param index The spatial index
+ * @param agents Agents
+ */
+void twsfwphysx_index_agents(struct twsfwphysx_spatial_index *index,
+                             const struct twsfwphysx_agents *agents);
+
+/**
+ * @brief Indexes the positions of all missiles.
+ *
+ * Replaces the previous content of the index. Queries return indices into
+ * \ref twsfwphysx_missiles.missiles.
+ *
+ * @param index The spatial index
+ * @param missiles Missiles
+ */
+void twsfwphysx_index_missiles(struct twsfwphysx_spatial_index *index,
+                               const struct twsfwphysx_missiles *missiles);
+
+/**
+ * @brief Finds all objects within a cap.
+ *
+ * Finds all objects whose angular distance to `r` is at most `angle`. The
+ * order of the results is unspecified.
+ *
+ * @param index The spatial index
+ * @param r Center of the cap (a unit vector)
+ * @param angle Opening angle of the cap (in radians, `angle >= 0`)
+ * @param ids Output array of (at least) `capacity` indices
+ * @param capacity Size of `ids`
+ * @return The number of objects within the cap. If this exceeds `capacity`,
+ *         only the first `capacity` indices are written.
+ */
+int32_t twsfwphysx_query_cap(const struct twsfwphysx_spatial_index *index,
+                             struct twsfwphysx_vec r,
+                             float angle,
+                             int32_t *ids,
+                             int32_t capacity);
+
+/**
+ * @brief Answers many cap queries at once.
+ *
+ * Results are written in a compressed sparse row layout: The objects of
+ * query `i` are `ids[offsets[i]]` to `ids[offsets[i + 1] - 1]`.
+ *
+ * @param index The spatial index
+ * @param r Array of `n` centers
+ * @param angles Array of `n` opening angles
+ * @param n Number of queries
+ * @param offsets Output array of `n + 1` offsets
+ * @param ids Output array of (at least) `capacity` indices
+ * @param capacity Size of `ids`
+ * @return `offsets[n]`, i.e., the total number of results. If this exceeds
+ *         `capacity`, `ids` is incomplete and the queries have to be repeated
+ *         with a larger array.
+ */
+int32_t
+twsfwphysx_query_cap_batch(const struct twsfwphysx_spatial_index *index,
+                           const struct twsfwphysx_vec *r,
+                           const float *angles,
+                           int32_t n,
+                           int32_t *offsets,
+                           int32_t *ids,
+                           int32_t capacity);
+
+/**
+ * @brief Finds the k nearest objects.
+ *
+ * @param index The spatial index
+ * @param r Query position (a unit vector)
+ * @param k Number of objects to find
+ * @param ids Output array of `k` indices sorted by distance
+ * @param cosines Output array of `k` cosines of the angular distances
+ * @return The number of found objects which is only smaller than `k` if the
+ *         index holds less than `k` objects
+ */
+int32_t twsfwphysx_query_nearest(const struct twsfwphysx_spatial_index *index,
+                                 struct twsfwphysx_vec r,
+                                 int32_t k,
+                                 int32_t *ids,
+                                 float *cosines);
+
+/**
+ * @brief Answers many k-nearest neighbour queries at once.
+ *
+ * The results of query `i` are written to `ids[i * k]` to
+ * `ids[i * k + k - 1]` (and `cosines`, respectively). Missing results (if the
+ * index holds less than `k` objects) are set to `-1` (and `-2`).
+ *
+ * @param index The spatial index
+ * @param r Array of `n` query positions
+ * @param n Number of queries
+ * @param k Number of objects to find per query
+ * @param ids Output array of `n * k` indices
+ * @param cosines Output array of `n * k` cosines of the angular distances
+ */
+void twsfwphysx_query_nearest_batch(
+    const struct twsfwphysx_spatial_index *index,
+    const struct twsfwphysx_vec *r,
+    int32_t n,
+    int32_t k,
+    int32_t *ids,
+    float *cosines);
+
+/**
+ * @brief Arc along a great circle, e.g., the path of a missile.
+ *
+ * A ray uses the same parametrisation as \ref twsfwphysx_agent: It starts at
+ * `r` and rotates around the axis `u` (which is perpendicular to `r`) for
+ * `length` radians.
+ */
+struct twsfwphysx_ray {
+    struct twsfwphysx_vec r; ///< Origin (a unit vector)
+    struct twsfwphysx_vec u; ///< Axis of rotation (a unit vector)
+    float length; ///< Maximum arc length in radians
+    int32_t ignore; ///< Index of an agent that is ignored (or `-1`)
+};
+
+/**
+ * @brief First agent on a \ref twsfwphysx_ray.
+ */
+struct twsfwphysx_ray_hit {
+    int32_t agent; ///< Index of the agent or `-1` if nothing was hit
+    float angle; ///< Arc length to the first contact (or `length`)
+};
+
+/**
+ * @brief Casts many rays against the agents in a spatial index.
+ *
+ * Finds the first agent whose cap of radius
+ * \ref twsfwphysx_world.agent_radius intersects each ray, i.e., the agent a
+ * missile launched along the ray would hit first if all agents stood still.
+ * The index has to be filled by \ref twsfwphysx_index_agents, such that dead
+ * agents are never hit. Rays that start inside of a cap hit the agent at an
+ * angle of `0`, hence, set `ignore` to the index of the shooter, e.g.:
+ * \code{.c}
+ * const struct twsfwphysx_agent *agent = &agents.agents[i];
+ * const struct twsfwphysx_ray ray = { agent->r, agent->u, 3.14159265F, i };
+ * \endcode
+ *
+ * Each ray only visits the grid cells along its arc and the exact contact is
+ * computed in closed form, which makes casting thousands of rays per tick
+ * cheap compared to simulating missiles.
+ *
+ * @param index Spatial index of the agents
+ * @param world World invariants
+ * @param rays Array of `n` rays
+ * @param n Number of rays
+ * @param hits Output array of `n` hits
+ * @return The number of rays that hit an agent
+ */
+int32_t twsfwphysx_cast_rays(const struct twsfwphysx_spatial_index *index,
+                             const struct twsfwphysx_world *world,
+                             const struct twsfwphysx_ray *rays,
+                             int32_t n,
+                             struct twsfwphysx_ray_hit *hits);
+
+/**
+ * @brief Predicted contact of a missile or agent with an agent.
+ */
+struct twsfwphysx_impact {
+    int32_t target; ///< Index of the hit agent or `-1` if there is none
+    float t; ///< Time until the contact (or the horizon)
+};
+
+/**
+ * @brief Predicts which agent each missile will hit and when.
+ *
+ * Assumes that all agents and missiles keep their current headings, i.e.,
+ * ignores collisions between agents and missiles that detonate earlier. The
+ * motion of agents and missiles is known in closed form (see
+ * \ref twsfwphysx_simulate), which allows to compute the time of the first
+ * contact by conservative advancement instead of forward simulation. The
+ * horizon is split into slabs in which the agents are indexed by `index`,
+ * such that each missile is only tested against nearby agents.
+ *
+ * @param agents Agents (agents with non-positive HPs are never hit)
+ * @param missiles Missiles
+ * @param world World invariants
+ * @param horizon Maximum time to look ahead
+ * @param index Spatial index used as scratch space (its content is replaced)
+ * @param impacts Output array of `missiles->size` impacts
+ * @return The number of missiles that hit an agent within the horizon
+ */
+int32_t
+twsfwphysx_predict_missile_impacts(const struct twsfwphysx_agents *agents,
+                                   const struct twsfwphysx_missiles *missiles,
+                                   const struct twsfwphysx_world *world,
+                                   float horizon,
+                                   struct twsfwphysx_spatial_index *index,
+                                   struct twsfwphysx_impact *impacts);
+
+/**
+ * @brief Predicts the first collision of each agent.
+ *
+ * Works like \ref twsfwphysx_predict_missile_impacts for pairs of agents,
+ * i.e., `impacts[i]` is the first agent that agent `i` collides with (if
+ * nobody changes their heading). Agents with non-positive HPs never collide.
+ *
+ * @param agents Agents
+ * @param world World invariants
+ * @param horizon Maximum time to look ahead
+ * @param index Spatial index used as scratch space (its content is replaced)
+ * @param impacts Output array of `agents->size` impacts
+ * @return The number of agents that collide within the horizon
+ */
+int32_t twsfwphysx_predict_collisions(const struct twsfwphysx_agents *agents,
+                                      const struct twsfwphysx_world *world,
+                                      float horizon,
+                                      struct twsfwphysx_spatial_index *index,
+                                      struct twsfwphysx_impact *impacts);
+
+#ifdef TWSFWPHYSX_ASYNC
+
+/**
+ * @struct twsfwphysx_pipeline
+ * @brief Opaque double-buffered simulation running on a worker thread.
+ *
+ * **Only available if `TWSFWPHYSX_ASYNC` is defined**, in which case the
+ * implementation depends on POSIX threads (or the Win32 API on Windows).
+ *
+ * A pipeline owns three world states: The _front_ state holds the result of
+ * the last simulated tick `N` and stays readable while the worker simulates
+ * tick `N+1` into the _back_ state. Inputs for tick `N+1` (e.g., turning
+ * agents, launching missiles or changing accelerations) are written into the
+ * _staging_ state which is a copy of the front state after each tick. This
+ * allows overlapping the simulation with, e.g., serializing, broadcasting and
+ * rendering the previous tick:
+ * \code{.c}
+ * struct twsfwphysx_pipeline *pipeline =
+ *     twsfwphysx_create_pipeline(&agents, &missiles, &world);
+ *
+ * for (;;) {
+ *     struct twsfwphysx_pipeline_state *inputs =
+ *         twsfwphysx_pipeline_staging(pipeline);
+ *     twsfwphysx_turn_agent(&inputs->agents.agents[0], .1F);
+ *
+ *     twsfwphysx_simulate_begin(pipeline, t, n_steps);
+ *     broadcast(twsfwphysx_pipeline_front(pipeline));  // tick N
+ *     twsfwphysx_simulate_end(pipeline);  // tick N+1 is the front now
+ * }
+ * \endcode
+ *
+ * Use \ref twsfwphysx_create_pipeline to create a pipeline and
+ * \ref twsfwphysx_delete_pipeline to delete it if no longer needed.
+ */
+struct twsfwphysx_pipeline;
+
+/**
+ * @brief World state of a \ref twsfwphysx_pipeline.
+ *
+ * Both containers are owned by the pipeline. Modify them only via the usual
+ * functions, e.g., \ref twsfwphysx_add_missile.
+ */
+struct twsfwphysx_pipeline_state {
+    struct twsfwphysx_agents agents; ///< Agents
+    struct twsfwphysx_missiles missiles; ///< Missiles
+};
+
+/**
+ * @brief Creates a new pipeline.
+ *
+ * Copies `agents` and `missiles` into the front and the staging state and
+ * starts the worker thread.
+ *
+ * @param agents Initial agents
+ * @param missiles Initial missiles
+ * @param world World invariants (copied)
+ * @return A new pipeline
+ */
+struct twsfwphysx_pipeline *
+twsfwphysx_create_pipeline(const struct twsfwphysx_agents *agents,
+                           const struct twsfwphysx_missiles *missiles,
+                           const struct twsfwphysx_world *world);
+
+/**
+ * @brief Deletes the pipeline.
+ *
+ * Waits for a running simulation, stops the worker thread and releases all
+ * states of the pipeline.
+ *
+ * @param pipeline The pipeline
+ */
+void twsfwphysx_delete_pipeline(struct twsfwphysx_pipeline *pipeline);
+
+/**
+ * @brief Returns the front state, i.e., the result of the last tick.
+ *
+ * The front state must not be modified but can be read at any time, in
+ * particular while the next tick is simulated. It is replaced by
+ * \ref twsfwphysx_simulate_end.
+ *
+ * @param pipeline The pipeline
+ * @return The front state
+ */
+const struct twsfwphysx_pipeline_state *
+twsfwphysx_pipeline_front(const struct twsfwphysx_pipeline *pipeline);
+
+/**
+ * @brief Returns the staging state, i.e., the input of the next tick.
+ *
+ * After \ref twsfwphysx_create_pipeline and after each call to
+ * \ref twsfwphysx_simulate_end, the staging state is a copy of the front
+ * state. Apply inputs to this state before calling
+ * \ref twsfwphysx_simulate_begin. Do not access the staging state while a
+ * simulation is running.
+ *
+ * @param pipeline The pipeline
+ * @return The staging state
+ */
+struct twsfwphysx_pipeline_state *
+twsfwphysx_pipeline_staging(struct twsfwphysx_pipeline *pipeline);
+
+/**
+ * @brief Returns the simulation buffer used by the worker thread.
+ *
+ * Use this buffer to, e.g., attach a \ref twsfwphysx_digest. Do not access
+ * the buffer while a simulation is running.
+ *
+ * @param pipeline The pipeline
+ * @return The simulation buffer
+ */
+struct twsfwphysx_simulation_buffer *
+twsfwphysx_pipeline_simulation_buffer(struct twsfwphysx_pipeline *pipeline);
+
+/**
+ * @brief Starts simulating the next tick asynchronously.
+ *
+ * Hands the staging state over to the worker thread which then calls
+ * \ref twsfwphysx_simulate (see there for `t` and `n_steps`) and returns
+ * immediately. Every call has to be followed by
+ * \ref twsfwphysx_simulate_end before the next call.
+ *
+ * @param pipeline The pipeline
+ * @param t Simulation time
+ * @param n_steps Number of simulation steps.
+ */
+void twsfwphysx_simulate_begin(struct twsfwphysx_pipeline *pipeline,
+                               float t,
+                               int32_t n_steps);
+
+/**
+ * @brief Waits for the simulation of the next tick to finish.
+ *
+ * Waits for the simulation that was started by
+ * \ref twsfwphysx_simulate_begin, makes its result the new front state and
+ * copies it into the staging state.
+ *
+ * @param pipeline The pipeline
+ */
+void twsfwphysx_simulate_end(struct twsfwphysx_pipeline *pipeline);
+
+/**
+ * @struct twsfwphysx_thread_pool
+ * @brief Opaque pool of worker threads that share the work of a simulation.
+ *
+ * **Only available if `TWSFWPHYSX_ASYNC` is defined.**
+ *
+ * Once attached to a simulation buffer (see \ref twsfwphysx_set_thread_pool),
+ * \ref twsfwphysx_simulate distributes the distances between agents and the
+ * propagation of agents and missiles of each step among the threads of the
+ * pool. Missile hits and collisions are still resolved by the calling thread
+ * since their order matters. Results are bitwise identical to simulations
+ * without pool. Worlds with less than 256 agents (or missiles) are not worth
+ * the synchronization and are simulated by the calling thread only.
+ *
+ * Use \ref twsfwphysx_create_thread_pool to create a pool and
+ * \ref twsfwphysx_delete_thread_pool to delete it if no longer needed. A pool
+ * must not be used by several simulations at the same time.
+ */
+struct twsfwphysx_thread_pool;
+
+/**
+ * @brief Creates a new thread pool.
+ *
+ * The calling thread of a simulation takes part in the work, hence
+ * `n_threads - 1` worker threads are started.
+ *
+ * @param n_threads Number of threads sharing the work (`n_threads > 0`)
+ * @return A new thread pool
+ */
+struct twsfwphysx_thread_pool *
+twsfwphysx_create_thread_pool(int32_t n_threads);
+
+/**
+ * @brief Deletes the thread pool.
+ *
+ * Stops all worker threads. The pool must not be attached to a simulation
+ * buffer anymore.
+ *
+ * @param pool The thread pool
+ */
+void twsfwphysx_delete_thread_pool(struct twsfwphysx_thread_pool *pool);
+
+/**
+ * @brief Attaches a thread pool to the simulation buffer.
+ *
+ * See \ref twsfwphysx_thread_pool. Set `pool` to `NULL` to detach it again.
+ *
+ * @param buffer The simulation buffer
+ * @param pool The thread pool (or `NULL`)
+ */
+void twsfwphysx_set_thread_pool(struct twsfwphysx_simulation_buffer *buffer,
+                                struct twsfwphysx_thread_pool *pool);
+
+#endif
+
+#ifdef TWSFWPHYSX_TRACE
+
+#ifndef TWSFWPHYSX_TRACE_CAPACITY
+/**
+ * @brief Number of trace events kept per thread (see
+ * \ref twsfwphysx_write_trace).
+ */
+#define TWSFWPHYSX_TRACE_CAPACITY 65536
+#endif
+
+/**
+ * @brief Writes the recorded timeline as Chrome trace JSON.
+ *
+ * **Only available if `TWSFWPHYSX_TRACE` is defined**, in which case the
+ * implementation depends on C11 atomics and thread-local storage.
+ *
+ * In this mode, \ref twsfwphysx_simulate records begin and end events for
+ * each call, each simulation step and each phase of a step (missiles,
+ * distances, agents and collisions; see \ref twsfwphysx_stats). Every thread
+ * writes into its own ring of the latest \ref TWSFWPHYSX_TRACE_CAPACITY events
+ * without any locking, such that tracing can stay enabled in production:
+ * \code{.c}
+ * if (tick_took_too_long) {
+ *     FILE *file = fopen("tick.json", "w");
+ *     twsfwphysx_write_trace(file);
+ *     fclose(file);
+ * }
+ * \endcode
+ *
+ * The output can be opened in `chrome://tracing` or https://ui.perfetto.dev.
+ * Call this function only while no thread is simulating; otherwise, events
+ * written at the same time may be garbled.
+ *
+ * @param file The output file
+ * @return The number of written events
+ */
+int32_t twsfwphysx_write_trace(FILE *file);
+
+/**
+ * @brief Removes all recorded events of all threads.
+ *
+ * Call this function only while no thread is simulating.
+ */
+void twsfwphysx_clear_trace(void);
+
+#endif
+
+#ifdef TWSFWPHYSX_MMAP
+
+/**
+ * @struct twsfwphysx_recorder
+ * @brief Opaque streaming writer of replay files.
+ *
+ * **Only available if `TWSFWPHYSX_MMAP` is defined**, in which case the
+ * implementation depends on POSIX `mmap` (or the Win32 API on Windows).
+ *
+ * A recorder wraps \ref twsfwphysx_simulate and appends every tick to a
+ * replay file: a keyframe with the full state of agents and missiles every
+ * `keyframe_interval` ticks and, in between, a compact delta that only holds
+ * the inputs of the tick, i.e., `t`, `n_steps` and the changes that were
+ * applied to agents and missiles since the previous tick (turned agents, new
+ * missiles, etc.). Deleting the recorder appends an index of all keyframes.
+ * \code{.c}
+ * struct twsfwphysx_recorder *recorder = twsfwphysx_create_recorder(
+ *     "match.replay", &world, 64, &agents, &missiles);
+ *
+ * for (;;) {
+ *     twsfwphysx_turn_agent(&agents.agents[0], .1F);
+ *     twsfwphysx_record_simulate(
+ *         recorder, &agents, &missiles, t, n_steps, buffer);
+ * }
+ *
+ * twsfwphysx_delete_recorder(recorder);
+ * \endcode
+ *
+ * Read replay files with \ref twsfwphysx_replay.
+ */
+struct twsfwphysx_recorder;
+
+/**
+ * @brief Creates a new recorder.
+ *
+ * Creates (or truncates) the file at `path` and records `agents` and
+ * `missiles` as the keyframe of tick 0.
+ *
+ * @param path Path of the replay file
+ * @param world World invariants (copied)
+ * @param keyframe_interval Number of ticks between two keyframes
+ *        (`keyframe_interval > 0`)
+ * @param agents Initial agents
+ * @param missiles Initial missiles
+ * @return A new recorder or `NULL` if the file cannot be opened
+ */
+struct twsfwphysx_recorder *
+twsfwphysx_create_recorder(const char *path,
+                           const struct twsfwphysx_world *world,
+                           int32_t keyframe_interval,
+                           const struct twsfwphysx_agents *agents,
+                           const struct twsfwphysx_missiles *missiles);
+
+/**
+ * @brief Deletes the recorder.
+ *
+ * Appends the index of keyframes and closes the replay file.
+ *
+ * @param recorder The recorder
+ * @return `1` if the replay file has been written successfully, `0` if any
+ *         write failed
+ */
+int twsfwphysx_delete_recorder(struct twsfwphysx_recorder *recorder);
+
+/**
+ * @brief Simulates and records the next tick.
+ *
+ * Records the differences between `agents` and `missiles` and the result of
+ * the previous tick and calls \ref twsfwphysx_simulate (see there for all
+ * parameters). Afterward, the result is recorded as a keyframe if the tick is
+ * a multiple of the keyframe interval.
+ *
+ * @param recorder The recorder
+ * @param agents Agents
+ * @param missiles Missiles
+ * @param t Time
+ * @param n_steps Number of simulation steps
+ * @param buffer Simulation buffer
+ */
+void twsfwphysx_record_simulate(struct twsfwphysx_recorder *recorder,
+                                struct twsfwphysx_agents *agents,
+                                struct twsfwphysx_missiles *missiles,
+                                float t,
+                                int32_t n_steps,
+                                struct twsfwphysx_simulation_buffer *buffer);
+
+/**
+ * @struct twsfwphysx_replay
+ * @brief Opaque memory-mapped reader of replay files.
+ *
+ * **Only available if `TWSFWPHYSX_MMAP` is defined.**
+ *
+ * Opens replay files written by \ref twsfwphysx_recorder. Nothing is parsed
+ * upfront: \ref twsfwphysx_replay_seek looks up the nearest keyframe in the
+ * index and replays the following ticks via \ref twsfwphysx_simulate, i.e.,
+ * at most `keyframe_interval - 1` ticks are simulated per seek.
+ *
+ * Replaying reproduces the recorded match bit-identically if the replay is
+ * read by the same build that recorded it. Define `TWSFWPHYSX_DETERMINISTIC`
+ * to read replays that were recorded on other platforms. Replay files are
+ * written in the native byte order.
+ */
+struct twsfwphysx_replay;
+
+/**
+ * @brief Opens a replay file.
+ *
+ * @param path Path of the replay file
+ * @return The replay or `NULL` if the file cannot be mapped or is not a
+ *         (complete) replay file
+ */
+struct twsfwphysx_replay *twsfwphysx_open_replay(const char *path);
+
+/**
+ * @brief Closes the replay file.
+ *
+ * @param replay The replay
+ */
+void twsfwphysx_close_replay(struct twsfwphysx_replay *replay);
+
+/**
+ * @brief Returns the number of recorded ticks.
+ *
+ * Includes tick 0, i.e., the initial state given to
+ * \ref twsfwphysx_create_recorder.
+ *
+ * @param replay The replay
+ * @return The number of ticks
+ */
+int32_t twsfwphysx_replay_n_ticks(const struct twsfwphysx_replay *replay);
+
+/**
+ * @brief Returns the world invariants of the replay.
+ *
+ * @param replay The replay
+ * @return The world invariants
+ */
+struct twsfwphysx_world
+twsfwphysx_replay_world(const struct twsfwphysx_replay *replay);
+
+/**
+ * @brief Reconstructs the state of agents and missiles after a tick.
+ *
+ * Overrides `agents` and `missiles` with the state after `tick` calls to
+ * \ref twsfwphysx_record_simulate. `agents` and `missiles` are (re)allocated
+ * as in \ref twsfwphysx_restore.
+ *
+ * @param replay The replay
+ * @param tick The tick (`0 <= tick < twsfwphysx_replay_n_ticks(replay)`)
+ * @param agents Agents (previously created by \ref twsfwphysx_create_agents)
+ * @param missiles Missiles
+ * @param buffer Simulation buffer (see \ref twsfwphysx_simulate)
+ * @return `1` if the state has been reconstructed, `0` if the replay file is
+ *         corrupted
+ */
+int twsfwphysx_replay_seek(const struct twsfwphysx_replay *replay,
+                           int32_t tick,
+                           struct twsfwphysx_agents *agents,
+                           struct twsfwphysx_missiles *missiles,
+                           struct twsfwphysx_simulation_buffer *buffer);
+
+/**
+ * @struct twsfwphysx_world_file
+ * @brief Opaque memory mapping of a world file.
+ *
+ * **Only available if `TWSFWPHYSX_MMAP` is defined.**
+ *
+ * A world file holds the world invariants, agents and missiles in the memory
+ * layout of \ref twsfwphysx_agent and \ref twsfwphysx_missile: A header of 64
+ * bytes (magic `TWSFWWLD`, version, byte order, sizes of both structs, number
+ * of agents and missiles, world invariants and the offsets of both sections)
+ * is followed by the agents and the missiles, each aligned to 64 bytes.
+ *
+ * Mapping a world file neither parses nor copies agents and missiles: Both
+ * containers point directly into the mapping which is private to the process
+ * (copy-on-write), i.e., the operating system only loads pages that are
+ * actually accessed and modifications never reach the file. This allows
+ * starting huge scenarios instantly:
+ * \code{.c}
+ * struct twsfwphysx_world world;
+ * struct twsfwphysx_agents agents;
+ * struct twsfwphysx_missiles missiles;
+ * struct twsfwphysx_world_file *file = twsfwphysx_map_world_file(
+ *     "stress.world", &world, &agents, &missiles);
+ *
+ * twsfwphysx_simulate(&agents, &missiles, &world, t, n_steps, buffer);
+ *
+ * twsfwphysx_delete_missile_batch(&missiles);
+ * twsfwphysx_unmap_world_file(file);
+ * \endcode
+ *
+ * Write world files with \ref twsfwphysx_save_world_file.
+ */
+struct twsfwphysx_world_file;
+
+/**
+ * @brief Writes a world file.
+ *
+ * @param path Path of the world file
+ * @param world World invariants
+ * @param agents Agents
+ * @param missiles Missiles
+ * @return `1` if the file has been written successfully, `0` otherwise
+ */
+int twsfwphysx_save_world_file(const char *path,
+                               const struct twsfwphysx_world *world,
+                               const struct twsfwphysx_agents *agents,
+                               const struct twsfwphysx_missiles *missiles);
+
+/**
+ * @brief Maps a world file into memory.
+ *
+ * Sets `world` and lets `agents` and `missiles` point into the mapped file.
+ * Mapped agents can be modified and simulated but must neither be resized nor
+ * deleted. Missiles can be added as usual and are moved to the heap once they
+ * outgrow the mapping. Delete them with
+ * \ref twsfwphysx_delete_missile_batch which never frees mapped memory.
+ *
+ * @param path Path of the world file
+ * @param world World invariants
+ * @param agents Agents
+ * @param missiles Missiles
+ * @return The mapping or `NULL` if the file cannot be mapped or is not a world
+ *         file that has been written on a compatible platform
+ */
+struct twsfwphysx_world_file *
+twsfwphysx_map_world_file(const char *path,
+                          struct twsfwphysx_world *world,
+                          struct twsfwphysx_agents *agents,
+                          struct twsfwphysx_missiles *missiles);
+
+/**
+ * @brief Unmaps a world file.
+ *
+ * Agents and missiles that still point into the mapping must not be used
+ * afterward.
+ *
+ * @param file The mapping
+ */
+void twsfwphysx_unmap_world_file(struct twsfwphysx_world_file *file);
+
+/**
+ * @struct twsfwphysx_publisher
+ * @brief Opaque writer of world states into a shared memory region.
+ *
+ * **Only available if `TWSFWPHYSX_MMAP` is defined.**
+ *
+ * A publisher maps a file as shared memory (preferably on a RAM-backed file
+ * system, e.g., `/dev/shm` on Linux) that other processes, e.g., renderers or
+ * spectator relays, map via \ref twsfwphysx_subscriber. After each tick, the
+ * simulation copies agents and missiles into the region without ever waiting
+ * for readers:
+ * \code{.c}
+ * struct twsfwphysx_publisher *publisher =
+ *     twsfwphysx_create_publisher("/dev/shm/twsfw", 1024, 4096);
+ *
+ * for (int64_t tick = 0;; tick++) {
+ *     twsfwphysx_simulate(&agents, &missiles, &world, t, n_steps, buffer);
+ *     twsfwphysx_publish(publisher, tick, &agents, &missiles);
+ * }
+ * \endcode
+ *
+ * The region consists of a header of 64 bytes that is followed by three
+ * slots. Each publication is written into the slot after the latest one and
+ * is guarded by a sequence number of the slot (a seqlock) which is odd while
+ * the slot is written. Hence, readers access the latest slot in place while
+ * the next two publications go into the other slots. The header holds (in
+ * this order and in the native byte order) the magic `TWSFWSHM`, the layout
+ * version, a byte-order mark (`0x01020304`), the sizes of
+ * \ref twsfwphysx_agent and \ref twsfwphysx_missile, the maximal number of
+ * agents and missiles (all 32 bits), the size of a slot, the offset of
+ * missiles within a slot, the number of publications and the latest tick
+ * (all 64 bits). Each slot starts with its sequence number, the tick (both 64
+ * bits), the number of agents and missiles (both 32 bits) and holds its agents
+ * at offset 64.
+ */
+struct twsfwphysx_publisher;
+
+/**
+ * @brief Creates a new publisher.
+ *
+ * Creates (or truncates) the file at `path` and maps it as shared memory.
+ *
+ * @param path Path of the shared file
+ * @param max_agents Maximal number of published agents
+ * @param max_missiles Maximal number of published missiles
+ * @return A new publisher or `NULL` if the file cannot be mapped
+ */
+struct twsfwphysx_publisher *twsfwphysx_create_publisher(const char *path,
+                                                         int32_t max_agents,
+                                                         int32_t max_missiles);
+
+/**
+ * @brief Deletes the publisher.
+ *
+ * Unmaps the shared memory but keeps the file such that subscribers can still
+ * read the latest publication. Remove the file if no longer needed.
+ *
+ * @param publisher The publisher
+ */
+void twsfwphysx_delete_publisher(struct twsfwphysx_publisher *publisher);
+
+/**
+ * @brief Publishes agents and missiles.
+ *
+ * Never blocks and never allocates memory.
+ *
+ * @param publisher The publisher
+ * @param tick Identifier of the published state, e.g., a frame number
+ * @param agents Agents
+ * @param missiles Missiles
+ * @return `1` if the state has been published, `0` if it exceeds the maximal
+ *         number of agents or missiles
+ */
+int twsfwphysx_publish(struct twsfwphysx_publisher *publisher,
+                       int64_t tick,
+                       const struct twsfwphysx_agents *agents,
+                       const struct twsfwphysx_missiles *missiles);
+
+/**
+ * @struct twsfwphysx_subscriber
+ * @brief Opaque read-only mapping of a shared region of a
+ * \ref twsfwphysx_publisher.
+ *
+ * **Only available if `TWSFWPHYSX_MMAP` is defined.**
+ *
+ * Subscribers read the latest publication in place and check afterward
+ * whether it has been overwritten in the meantime:
+ * \code{.c}
+ * struct twsfwphysx_shared_state state;
+ * if (twsfwphysx_read_shared(subscriber, &state)) {
+ *     render(&state.agents, &state.missiles);
+ *     if (!twsfwphysx_validate_shared(&state)) {
+ *         // the publisher was faster than us; discard the frame
+ *     }
+ * }
+ * \endcode
+ *
+ * A publication is only overwritten by the third publication after it, i.e.,
+ * readers that need less than two ticks do not have to retry. Readers never
+ * block the publisher.
+ */
+struct twsfwphysx_subscriber;
+
+/**
+ * @brief State of a \ref twsfwphysx_subscriber.
+ *
+ * Agents and missiles point into the shared region and must not be modified.
+ */
+struct twsfwphysx_shared_state {
+    int64_t tick; ///< Tick given to \ref twsfwphysx_publish
+    struct twsfwphysx_agents agents; ///< Agents (read-only)
+    struct twsfwphysx_missiles missiles; ///< Missiles (read-only)
+    const void *slot; ///< **Only for internal usage.**
+    uint64_t sequence; ///< **Only for internal usage.**
+};
+
+/**
+ * @brief Opens the shared region of a publisher.
+ *
+ * @param path Path of the shared file (see \ref twsfwphysx_create_publisher)
+ * @return A new subscriber or `NULL` if the file cannot be mapped or has not
+ *         been created by a compatible publisher
+ */
+struct twsfwphysx_subscriber *twsfwphysx_open_subscriber(const char *path);
+
+/**
+ * @brief Closes the shared region.
+ *
+ * @param subscriber The subscriber
+ */
+void twsfwphysx_close_subscriber(struct twsfwphysx_subscriber *subscriber);
+
+/**
+ * @brief Reads the latest publication without copying it.
+ *
+ * Fields of `state` may be inconsistent if the publication is overwritten
+ * while reading. Call \ref twsfwphysx_validate_shared after reading.
+ *
+ * @param subscriber The subscriber
+ * @param state The latest publication
+ * @return `1` if `state` has been set, `0` if nothing has been published yet
+ *         or the latest publication is being overwritten (retry later)
+ */
+int twsfwphysx_read_shared(const struct twsfwphysx_subscriber *subscriber,
+                           struct twsfwphysx_shared_state *state);
+
+/**
+ * @brief Checks whether a publication is still intact.
+ *
+ * @param state State returned by \ref twsfwphysx_read_shared
+ * @return `1` if the publication has not been overwritten since
+ *         \ref twsfwphysx_read_shared, `0` if everything that has been read
+ *         since then has to be discarded
+ */
+int twsfwphysx_validate_shared(const struct twsfwphysx_shared_state *state);
+
+#endif
+
+#ifdef TWSFWPHYSX_IMPLEMENTATION
+
+const char *twsfwphysx_version(void)
+{
+    return "0.9.0";
+}
+
+struct twsfwphysx_agents twsfwphysx_create_agents(const int32_t size)
+{
+    struct twsfwphysx_agents agents = { NULL, 0 };
+    if (size < 1) {
+        return agents;
+    }
+
+    agents.agents = (struct twsfwphysx_agent *)malloc(
+        (uint64_t)size * sizeof(struct twsfwphysx_agent));
+    agents.size = size;
+
+    return agents;
+}
+
+void twsfwphysx_delete_agents(struct twsfwphysx_agents *agents)
+{
+    free(agents->agents);
+    agents->agents = NULL;
+    agents->size = 0;
+}
+
+void twsfwphysx_set_agent(const struct twsfwphysx_agents *batch,
+                          const struct twsfwphysx_agent agent,
+                          const int32_t index)
+{
+    assert(index >= 0 && index < batch->size);
+    assert(batch->agents != NULL);
+    batch->agents[index] = agent;
+}
+
+struct twsfwphysx_missiles twsfwphysx_new_missile_batch(void)
+{
+    const struct twsfwphysx_missiles missiles = { NULL, 0, 0 };
+    return missiles;
+}
+
+void twsfwphysx_clear_missile_batch(struct twsfwphysx_missiles *missiles)
+{
+    assert(missiles != NULL);
+    missiles->size = 0;
+}
+
+void twsfwphysx_delete_missile_batch(struct twsfwphysx_missiles *missiles)
+{
+    if (missiles->capacity >= 0) {
+        free(missiles->missiles);
+    }
+    missiles->missiles = NULL;
+    missiles->size = 0;
+    missiles->capacity = 0;
+}
+
+// A negative capacity indicates that the missiles are borrowed from memory that
+// is not owned by twsfwphysx (e.g., a mapped world file). Borrowed missiles are
+// moved to the heap as soon as they have to grow and are never freed.
+static void reserve_missiles(struct twsfwphysx_missiles *missiles,
+                             const int32_t capacity)
+{
+    if (missiles->capacity < 0) {
+        struct twsfwphysx_missile *borrowed = missiles->missiles;
+        missiles->missiles = (struct twsfwphysx_missile *)malloc(
+            (uint64_t)capacity * sizeof(struct twsfwphysx_missile));
+        assert(missiles->missiles != NULL);
+
+        if (missiles->size > 0) {
+            memcpy(missiles->missiles,
+                   borrowed,
+                   (uint64_t)missiles->size *
+                       sizeof(struct twsfwphysx_missile));
+        }
+    } else {
+        // NOLINTNEXTLINE(bugprone-suspicious-realloc-usage)
+        missiles->missiles = (struct twsfwphysx_missile *)realloc(
+            missiles->missiles,
+            (uint64_t)capacity * sizeof(struct twsfwphysx_missile));
+        assert(missiles->missiles != NULL);
+    }
+
+    missiles->capacity = capacity;
+}
+
+static int32_t missile_capacity(const struct twsfwphysx_missiles *missiles)
+{
+    return missiles->capacity < 0 ? -missiles->capacity : missiles->capacity;
+}
 
 void twsfwphysx_add_missile(struct twsfwphysx_missiles *missiles,
                             const struct twsfwphysx_missile missile)
 {
-    if (missiles->size >= missiles->capacity) {
-        missiles->capacity = missiles->capacity > 0 ? 2 * missiles->capacity :
-                                                      1;
+    const int32_t capacity = missile_capacity(missiles);
+    if (missiles->size >= capacity) {
+        reserve_missiles(missiles, capacity > 0 ? 2 * capacity : 1);
+    }
+
+    missiles->missiles[missiles->size++] = missile;
+}
+
+#ifdef TWSFWPHYSX_DETERMINISTIC
+
+// Operations on floats must not be evaluated with excess precision. (Values
+// 16 and 32 are defined in ISO/IEC TS 18661-3 and keep floats as floats.)
+#if FLT_EVAL_METHOD != 0 && FLT_EVAL_METHOD != 16 && FLT_EVAL_METHOD != 32
+#error "TWSFWPHYSX_DETERMINISTIC requires FLT_EVAL_METHOD == 0 (e.g., SSE2)."
+#endif
+
+#ifdef __FAST_MATH__
+#error "TWSFWPHYSX_DETERMINISTIC cannot be used with -ffast-math."
+#endif
+
+// Fused multiply-adds round differently than separate operations. Hence,
+// contractions have to be disabled for the remaining implementation.
+#if defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC optimize("fp-contract=off")
+#elif defined(_MSC_VER)
+#pragma fp_contract(off)
+#endif
+
+// The following functions replace `sinf`, `cosf`, `expf` and `expm1f` from
+// `math.h` whose results differ between implementations of libm. They only use
+// basic arithmetic operations, `floorf` and `ldexpf` which are exact (or
+// correctly rounded) according to IEEE 754 and thus yield identical results on
+// all platforms.
+
+static void sincos_f(const float x, float *sin_x, float *cos_x)
+{
+    // Cody-Waite reduction to [-pi/4, pi/4] using pi/2 = DP1 + DP2 + DP3
+    const float k = floorf((x * 0.636619772F) + .5F);
+    float y = x - (k * 1.5703125F);
+    y = y - (k * 4.837512969970703e-4F);
+    y = y - (k * 7.549789954891882e-8F);
+    const float z = y * y;
+
+    float s = -1.9515295891e-4F;
+    s = (s * z) + 8.3321608736e-3F;
+    s = (s * z) - 1.6666654611e-1F;
+    s = (s * z * y) + y;
+
+    float c = 2.443315711809948e-5F;
+    c = (c * z) - 1.388731625493765e-3F;
+    c = (c * z) + 4.166664568298827e-2F;
+    c = (c * z * z) - (.5F * z) + 1.F;
+
+    switch ((int32_t)fmodf(k, 4.F) & 3) {
+    case 0:
+        *sin_x = s;
+        *cos_x = c;
+        break;
+    case 1:
+        *sin_x = c;
+        *cos_x = -s;
+        break;
+    case 2:
+        *sin_x = -s;
+        *cos_x = -c;
+        break;
+    default:
+        *sin_x = -c;
+        *cos_x = s;
+        break;
+    }
+}
+
+static float cos_f(const float x)
+{
+    float sin_x;
+    float cos_x;
+    sincos_f(x, &sin_x, &cos_x);
+    return cos_x;
+}
+
+static float exp_f(const float x)
+{
+    if (x > 88.72283F) {
+        return HUGE_VALF;
+    }
+    if (x < -103.97208F) {
+        return 0.F;
+    }
+
+    // Cody-Waite reduction to [-ln(2)/2, ln(2)/2] using ln(2) = C1 + C2
+    const float n = floorf((x * 1.44269504088896341F) + .5F);
+    float y = x - (n * 0.693359375F);
+    y = y - (n * -2.12194440e-4F);
+    const float z = y * y;
+
+    float p = 1.9875691500e-4F;
+    p = (p * y) + 1.3981999507e-3F;
+    p = (p * y) + 8.3334519073e-3F;
+    p = (p * y) + 4.1665795894e-2F;
+    p = (p * y) + 1.6666665459e-1F;
+    p = (p * y) + 5.0000001201e-1F;
+    p = (p * z) + y + 1.F;
+
+    return ldexpf(p, (int)n);
+}
+
+static float expm1_f(const float x)
+{
+    if (fabsf(x) >= .34657359F) {
+        return exp_f(x) - 1.F;
+    }
+
+    // Taylor series; the remainder is below the precision of floats
+    float p = 1.F / 5040.F;
+    p = (p * x) + (1.F / 720.F);
+    p = (p * x) + (1.F / 120.F);
+    p = (p * x) + (1.F / 24.F);
+    p = (p * x) + (1.F / 6.F);
+    p = (p * x) + .5F;
+
+    return (p * x * x) + x;
+}
+
+static float atan2_f(const float y, const float x)
+{
+    // reduction to t = tan(a) in [0, 1] and then to [-tan(pi/8), tan(pi/8)]
+    const float ax = fabsf(x);
+    const float ay = fabsf(y);
+    const int swapped = ax < ay;
+    float t = swapped ? ax / ay : (ax > 0.F ? ay / ax : 0.F);
+    float offset = 0.F;
+    if (t > .41421356237F) {
+        offset = .78539816340F;
+        t = (t - 1.F) / (t + 1.F);
+    }
+    const float z = t * t;
+
+    float p = 8.05374449538e-2F;
+    p = (p * z) - 1.38776856032e-1F;
+    p = (p * z) + 1.99777106478e-1F;
+    p = (p * z) - 3.33329491539e-1F;
+    float a = offset + (p * z * t) + t;
+
+    if (swapped) {
+        a = 1.57079632679F - a;
+    }
+    if (x < 0.F) {
+        a = 3.14159265359F - a;
+    }
+    return y < 0.F ? -a : a;
+}
+
+static float acos_f(const float x)
+{
+    return atan2_f(sqrtf((1.F - x) * (1.F + x)), x);
+}
+
+#else
+
+static void sincos_f(const float x, float *sin_x, float *cos_x)
+{
+    *sin_x = sinf(x);
+    *cos_x = cosf(x);
+}
+
+static float cos_f(const float x)
+{
+    return cosf(x);
+}
+
+static float exp_f(const float x)
+{
+    return expf(x);
+}
+
+static float expm1_f(const float x)
+{
+    return expm1f(x);
+}
+
+static float atan2_f(const float y, const float x)
+{
+    return atan2f(y, x);
+}
+
+static float acos_f(const float x)
+{
+    return acosf(x);
+}
+
+#endif
+
+static float vec_length(const struct twsfwphysx_vec v)
+{
+    return sqrtf((v.x * v.x) + (v.y * v.y) + (v.z * v.z));
+}
+
+static struct twsfwphysx_vec normalize(struct twsfwphysx_vec v)
+{
+    const float length = vec_length(v);
+    v.x /= length;
+    v.y /= length;
+    v.z /= length;
+
+    return v;
+}
+
+static float dot(const struct twsfwphysx_vec v, const struct twsfwphysx_vec w)
+{
+    return v.x * w.x + v.y * w.y + v.z * w.z;
+}
+
+static struct twsfwphysx_vec cross(const struct twsfwphysx_vec v,
+                                   const struct twsfwphysx_vec w)
+{
+    const struct twsfwphysx_vec res = { v.y * w.z - v.z * w.y,
+                                        v.z * w.x - v.x * w.z,
+                                        v.x * w.y - v.y * w.x };
+    return res;
+}
+
+static void
+rotate(struct twsfwphysx_vec *r, struct twsfwphysx_vec u, float angle)
+{
+    float sin_angle;
+    float cos_angle;
+    sincos_f(angle, &sin_angle, &cos_angle);
+
+    const struct twsfwphysx_vec w = cross(u, *r);
+    r->x = cos_angle * r->x + sin_angle * w.x;
+    r->y = cos_angle * r->y + sin_angle * w.y;
+    r->z = cos_angle * r->z + sin_angle * w.z;
+}
+
+static void
+propagate(struct twsfwphysx_vec *r,
+          const struct twsfwphysx_vec u,
+          float *v,
+          const float a, // NOLINT(bugprone-easily-swappable-parameters)
+          const float dt) // NOLINT(bugprone-easily-swappable-parameters)
+{
+    const float theta = (a * dt) - ((*v - a) * expm1_f(-dt));
+    rotate(r, u, theta);
+
+    *v = a - ((a - *v) * exp_f(-dt));
+}
+
+#ifdef TWSFWPHYSX_SIMD
+
+#ifndef TWSFWPHYSX_DETERMINISTIC
+#error "TWSFWPHYSX_SIMD requires TWSFWPHYSX_DETERMINISTIC."
+#endif
+
+// Four lanes of floats and of 32-bit integers (or masks). The SIMD kernels
+// perform the same operations in the same order as their scalar counterparts
+// and thus yield bitwise identical results. On targets other than WASM, the
+// vector extensions of GCC and Clang stand in for SIMD128 (e.g., for tests).
+#if defined(__wasm_simd128__)
+
+typedef v128_t f32x4;
+typedef v128_t i32x4;
+
+static f32x4 f32x4_make(const float a,
+                        const float b,
+                        const float c,
+                        const float d)
+{
+    return wasm_f32x4_make(a, b, c, d);
+}
+
+static f32x4 f32x4_splat(const float x)
+{
+    return wasm_f32x4_splat(x);
+}
+
+static f32x4 f32x4_add(const f32x4 a, const f32x4 b)
+{
+    return wasm_f32x4_add(a, b);
+}
+
+static f32x4 f32x4_sub(const f32x4 a, const f32x4 b)
+{
+    return wasm_f32x4_sub(a, b);
+}
+
+static f32x4 f32x4_mul(const f32x4 a, const f32x4 b)
+{
+    return wasm_f32x4_mul(a, b);
+}
+
+static f32x4 f32x4_neg(const f32x4 a)
+{
+    return wasm_f32x4_neg(a);
+}
+
+static f32x4 f32x4_floor(const f32x4 a)
+{
+    return wasm_f32x4_floor(a);
+}
+
+static i32x4 f32x4_gt(const f32x4 a, const f32x4 b)
+{
+    return wasm_f32x4_gt(a, b);
+}
+
+static i32x4 f32x4_trunc(const f32x4 a)
+{
+    return wasm_i32x4_trunc_sat_f32x4(a);
+}
+
+static f32x4 f32x4_select(const i32x4 mask, const f32x4 a, const f32x4 b)
+{
+    return wasm_v128_bitselect(a, b, mask);
+}
+
+static void f32x4_store(float *dst, const f32x4 a)
+{
+    wasm_v128_store(dst, a);
+}
+
+static i32x4 i32x4_make(const int32_t a,
+                        const int32_t b,
+                        const int32_t c,
+                        const int32_t d)
+{
+    return wasm_i32x4_make(a, b, c, d);
+}
+
+static i32x4 i32x4_splat(const int32_t x)
+{
+    return wasm_i32x4_splat(x);
+}
+
+static i32x4 i32x4_add(const i32x4 a, const i32x4 b)
+{
+    return wasm_i32x4_add(a, b);
+}
+
+static i32x4 i32x4_and(const i32x4 a, const i32x4 b)
+{
+    return wasm_v128_and(a, b);
+}
+
+static i32x4 i32x4_eq(const i32x4 a, const i32x4 b)
+{
+    return wasm_i32x4_eq(a, b);
+}
+
+static i32x4 i32x4_select(const i32x4 mask, const i32x4 a, const i32x4 b)
+{
+    return wasm_v128_bitselect(a, b, mask);
+}
+
+static void i32x4_store(int32_t *dst, const i32x4 a)
+{
+    wasm_v128_store(dst, a);
+}
+
+#elif defined(__GNUC__)
+
+typedef float f32x4 __attribute__((vector_size(16)));
+typedef int32_t i32x4 __attribute__((vector_size(16)));
+
+static f32x4 f32x4_make(const float a,
+                        const float b,
+                        const float c,
+                        const float d)
+{
+    const f32x4 res = { a, b, c, d };
+    return res;
+}
+
+static f32x4 f32x4_splat(const float x)
+{
+    return f32x4_make(x, x, x, x);
+}
+
+static f32x4 f32x4_add(const f32x4 a, const f32x4 b)
+{
+    return a + b;
+}
+
+static f32x4 f32x4_sub(const f32x4 a, const f32x4 b)
+{
+    return a - b;
+}
+
+static f32x4 f32x4_mul(const f32x4 a, const f32x4 b)
+{
+    return a * b;
+}
+
+static f32x4 f32x4_neg(const f32x4 a)
+{
+    return -a;
+}
+
+static f32x4 f32x4_floor(const f32x4 a)
+{
+    return f32x4_make(floorf(a[0]), floorf(a[1]), floorf(a[2]), floorf(a[3]));
+}
+
+static i32x4 f32x4_gt(const f32x4 a, const f32x4 b)
+{
+    return a > b;
+}
+
+static i32x4 f32x4_trunc(const f32x4 a)
+{
+    return __builtin_convertvector(a, i32x4);
+}
+
+static f32x4 f32x4_select(const i32x4 mask, const f32x4 a, const f32x4 b)
+{
+    return (f32x4)((mask & (i32x4)a) | (~mask & (i32x4)b));
+}
+
+static void f32x4_store(float *dst, const f32x4 a)
+{
+    memcpy(dst, &a, sizeof(f32x4));
+}
+
+static i32x4 i32x4_make(const int32_t a,
+                        const int32_t b,
+                        const int32_t c,
+                        const int32_t d)
+{
+    const i32x4 res = { a, b, c, d };
+    return res;
+}
+
+static i32x4 i32x4_splat(const int32_t x)
+{
+    return i32x4_make(x, x, x, x);
+}
+
+static i32x4 i32x4_add(const i32x4 a, const i32x4 b)
+{
+    return a + b;
+}
+
+static i32x4 i32x4_and(const i32x4 a, const i32x4 b)
+{
+    return a & b;
+}
+
+static i32x4 i32x4_eq(const i32x4 a, const i32x4 b)
+{
+    return a == b;
+}
+
+static i32x4 i32x4_select(const i32x4 mask, const i32x4 a, const i32x4 b)
+{
+    return (mask & a) | (~mask & b);
+}
+
+static void i32x4_store(int32_t *dst, const i32x4 a)
+{
+    memcpy(dst, &a, sizeof(i32x4));
+}
+
+#else
+#error "TWSFWPHYSX_SIMD requires WebAssembly SIMD128 or GCC/Clang."
+#endif
+
+// components of four vectors
+struct vec_x4 {
+    f32x4 x;
+    f32x4 y;
+    f32x4 z;
+};
+
+static struct vec_x4 load_vec_x4(const struct twsfwphysx_vec *v0,
+                                 const struct twsfwphysx_vec *v1,
+                                 const struct twsfwphysx_vec *v2,
+                                 const struct twsfwphysx_vec *v3)
+{
+    const struct vec_x4 res = { f32x4_make(v0->x, v1->x, v2->x, v3->x),
+                                f32x4_make(v0->y, v1->y, v2->y, v3->y),
+                                f32x4_make(v0->z, v1->z, v2->z, v3->z) };
+    return res;
+}
+
+static void store_vec_x4(const struct vec_x4 v,
+                         struct twsfwphysx_vec *v0,
+                         struct twsfwphysx_vec *v1,
+                         struct twsfwphysx_vec *v2,
+                         struct twsfwphysx_vec *v3)
+{
+    float x[4];
+    float y[4];
+    float z[4];
+    f32x4_store(x, v.x);
+    f32x4_store(y, v.y);
+    f32x4_store(z, v.z);
+
+    struct twsfwphysx_vec *vecs[4] = { v0, v1, v2, v3 };
+    for (int32_t i = 0; i < 4; i++) {
+        vecs[i]->x = x[i];
+        vecs[i]->y = y[i];
+        vecs[i]->z = z[i];
+    }
+}
+
+// four lanes of dot(v, w)
+static f32x4 dot_x4(const struct vec_x4 v, const struct vec_x4 w)
+{
+    return f32x4_add(f32x4_add(f32x4_mul(v.x, w.x), f32x4_mul(v.y, w.y)),
+                     f32x4_mul(v.z, w.z));
+}
+
+// four lanes of sincos_f
+static void sincos_x4(const f32x4 x, f32x4 *sin_x, f32x4 *cos_x)
+{
+    const f32x4 k = f32x4_floor(f32x4_add(
+        f32x4_mul(x, f32x4_splat(0.636619772F)), f32x4_splat(.5F)));
+    f32x4 y = f32x4_sub(x, f32x4_mul(k, f32x4_splat(1.5703125F)));
+    y = f32x4_sub(y, f32x4_mul(k, f32x4_splat(4.837512969970703e-4F)));
+    y = f32x4_sub(y, f32x4_mul(k, f32x4_splat(7.549789954891882e-8F)));
+    const f32x4 z = f32x4_mul(y, y);
+
+    f32x4 s = f32x4_splat(-1.9515295891e-4F);
+    s = f32x4_add(f32x4_mul(s, z), f32x4_splat(8.3321608736e-3F));
+    s = f32x4_sub(f32x4_mul(s, z), f32x4_splat(1.6666654611e-1F));
+    s = f32x4_add(f32x4_mul(f32x4_mul(s, z), y), y);
+
+    f32x4 c = f32x4_splat(2.443315711809948e-5F);
+    c = f32x4_sub(f32x4_mul(c, z), f32x4_splat(1.388731625493765e-3F));
+    c = f32x4_add(f32x4_mul(c, z), f32x4_splat(4.166664568298827e-2F));
+    c = f32x4_add(f32x4_sub(f32x4_mul(f32x4_mul(c, z), z),
+                            f32x4_mul(f32x4_splat(.5F), z)),
+                  f32x4_splat(1.F));
+
+    // quadrants 0 to 3 (see sincos_f): sin and cos are swapped in odd
+    // quadrants, sin is negated in quadrants 2 and 3, cos in 1 and 2
+    const i32x4 q = i32x4_and(f32x4_trunc(k), i32x4_splat(3));
+    const i32x4 one = i32x4_splat(1);
+    const i32x4 two = i32x4_splat(2);
+    const i32x4 odd = i32x4_eq(i32x4_and(q, one), one);
+    const i32x4 negate_sin = i32x4_eq(i32x4_and(q, two), two);
+    const i32x4 negate_cos = i32x4_eq(i32x4_and(i32x4_add(q, one), two), two);
+
+    const f32x4 sin_0 = f32x4_select(odd, c, s);
+    const f32x4 cos_0 = f32x4_select(odd, s, c);
+    *sin_x = f32x4_select(negate_sin, f32x4_neg(sin_0), sin_0);
+    *cos_x = f32x4_select(negate_cos, f32x4_neg(cos_0), cos_0);
+}
+
+// four lanes of propagate (with exp_f(-dt) and expm1_f(-dt) precomputed)
+static void propagate_x4(struct vec_x4 *r,
+                         const struct vec_x4 u,
+                         f32x4 *v,
+                         const f32x4 a,
+                         const float dt,
+                         const float exp_dt,
+                         const float expm1_dt)
+{
+    const f32x4 theta =
+        f32x4_sub(f32x4_mul(a, f32x4_splat(dt)),
+                  f32x4_mul(f32x4_sub(*v, a), f32x4_splat(expm1_dt)));
+    f32x4 sin_theta;
+    f32x4 cos_theta;
+    sincos_x4(theta, &sin_theta, &cos_theta);
+
+    const struct vec_x4 w = {
+        f32x4_sub(f32x4_mul(u.y, r->z), f32x4_mul(u.z, r->y)),
+        f32x4_sub(f32x4_mul(u.z, r->x), f32x4_mul(u.x, r->z)),
+        f32x4_sub(f32x4_mul(u.x, r->y), f32x4_mul(u.y, r->x))
+    };
+    r->x = f32x4_add(f32x4_mul(cos_theta, r->x), f32x4_mul(sin_theta, w.x));
+    r->y = f32x4_add(f32x4_mul(cos_theta, r->y), f32x4_mul(sin_theta, w.y));
+    r->z = f32x4_add(f32x4_mul(cos_theta, r->z), f32x4_mul(sin_theta, w.z));
+
+    *v = f32x4_sub(a, f32x4_mul(f32x4_sub(a, *v), f32x4_splat(exp_dt)));
+}
+
+#endif
+
+static float collide(struct twsfwphysx_agent *p1,
+                     struct twsfwphysx_agent *p2,
+                     const float epsilon)
+{
+    struct twsfwphysx_vec n = { p1->r.x - p2->r.x,
+                                p1->r.y - p2->r.y,
+                                p1->r.z - p2->r.z };
+
+    const float length = vec_length(n);
+    n.x /= length;
+    n.y /= length;
+    n.z /= length;
+
+    struct twsfwphysx_vec v1 = cross(p1->u, p1->r);
+    v1.x *= p1->v;
+    v1.y *= p1->v;
+    v1.z *= p1->v;
+
+    struct twsfwphysx_vec v2 = cross(p2->u, p2->r);
+    v2.x *= p2->v;
+    v2.y *= p2->v;
+    v2.z *= p2->v;
+
+    const struct twsfwphysx_vec dv = { v1.x - v2.x, v1.y - v2.y, v1.z - v2.z };
+    const float J = (1.F + epsilon) / 2.F * dot(n, dv);
+
+    v1.x = v1.x - J * n.x;
+    v1.y = v1.y - J * n.y;
+    v1.z = v1.z - J * n.z;
+
+    v2.x = v2.x + J * n.x;
+    v2.y = v2.y + J * n.y;
+    v2.z = v2.z + J * n.z;
+
+    p1->v = vec_length(v1);
+    p2->v = vec_length(v2);
+
+    if (p1->v > 1e-10F) {
+        p1->u = normalize(cross(p1->r, v1));
+    }
+
+    if (p2->v > 1e-10F) {
+        p2->u = normalize(cross(p2->r, v2));
+    }
+
+    return J;
+}
+
+// Fills the rows `first`, `first + stride`, ... of the distance buffer.
+static void fill_distance_rows(const struct twsfwphysx_agent *agents,
+                               float *buffer,
+                               const int32_t n,
+                               const int32_t first,
+                               const int32_t stride)
+{
+    for (int32_t i = first; i < n; i += stride) {
+        // row i starts after (n - 1) + (n - 2) + ... + (n - i) entries
+        int64_t k = (int64_t)i * (n - 1) - (int64_t)i * (i - 1) / 2;
+        int32_t j = i + 1;
+#ifdef TWSFWPHYSX_SIMD
+        const struct vec_x4 r = { f32x4_splat(agents[i].r.x),
+                                  f32x4_splat(agents[i].r.y),
+                                  f32x4_splat(agents[i].r.z) };
+        for (; j + 4 <= n; j += 4) {
+            const struct vec_x4 s = load_vec_x4(&agents[j].r,
+                                                &agents[j + 1].r,
+                                                &agents[j + 2].r,
+                                                &agents[j + 3].r);
+            f32x4_store(&buffer[k], dot_x4(r, s));
+            k += 4;
+        }
+#endif
+        for (; j < n; j++) {
+            buffer[k++] = dot(agents[i].r, agents[j].r);
+        }
+    }
+}
+
+static void fill_distance_buffer(const struct twsfwphysx_agent *agents,
+                                 float *buffer,
+                                 int32_t n)
+{
+    assert(agents != NULL || n < 2);
+    assert(buffer != NULL || n < 2);
+
+    fill_distance_rows(agents, buffer, n, 0, 1);
+}
+
+static float hit(struct twsfwphysx_agent *agent,
+                 struct twsfwphysx_missiles *missiles,
+                 const int32_t i)
+{
+    const struct twsfwphysx_missile missile = missiles->missiles[i];
+    const float cos_theta = dot(agent->u, missile.u);
+    const float damage = 2.F + cos_theta;
+
+    agent->hp -= damage;
+
+    missiles->size -= 1;
+    if (i < missiles->size) {
+        missiles->missiles[i] = missiles->missiles[missiles->size];
+    }
+
+    return damage;
+}
+
+static int32_t nearest_hit(const struct twsfwphysx_agents *agents,
+                           const struct twsfwphysx_missile missile,
+                           const float threshold)
+{
+    int32_t i_max = -1;
+    float s_max = -2.F; // -1 <= dot(.) <= +1
+    int32_t i = 0;
+#ifdef TWSFWPHYSX_SIMD
+    // Every lane keeps its first maximum. The first maximum of all lanes is
+    // the one with the lowest index.
+    if (agents->size >= 4) {
+        const struct vec_x4 r = { f32x4_splat(missile.r.x),
+                                  f32x4_splat(missile.r.y),
+                                  f32x4_splat(missile.r.z) };
+        const f32x4 zero = f32x4_splat(0.F);
+        const f32x4 t = f32x4_splat(threshold);
+        f32x4 s_lanes = f32x4_splat(s_max);
+        i32x4 i_lanes = i32x4_splat(i_max);
+        i32x4 idx = i32x4_make(0, 1, 2, 3);
+        for (; i + 4 <= agents->size; i += 4) {
+            const struct twsfwphysx_agent *a = &agents->agents[i];
+            const f32x4 hp = f32x4_make(a[0].hp, a[1].hp, a[2].hp, a[3].hp);
+            const f32x4 s = dot_x4(
+                load_vec_x4(&a[0].r, &a[1].r, &a[2].r, &a[3].r), r);
+            const i32x4 found = i32x4_and(
+                i32x4_and(f32x4_gt(hp, zero), f32x4_gt(s, t)),
+                f32x4_gt(s, s_lanes));
+            s_lanes = f32x4_select(found, s, s_lanes);
+            i_lanes = i32x4_select(found, idx, i_lanes);
+            idx = i32x4_add(idx, i32x4_splat(4));
+        }
+
+        float s_found[4];
+        int32_t i_found[4];
+        f32x4_store(s_found, s_lanes);
+        i32x4_store(i_found, i_lanes);
+        for (int32_t lane = 0; lane < 4; lane++) {
+            if (i_found[lane] >= 0 &&
+                (s_found[lane] > s_max ||
+                 (!(s_found[lane] < s_max) && i_found[lane] < i_max))) {
+                i_max = i_found[lane];
+                s_max = s_found[lane];
+            }
+        }
+    }
+#endif
+    for (; i < agents->size; i++) {
+        if (agents->agents[i].hp > 0.F) {
+            const float s = dot(agents->agents[i].r, missile.r);
+            if (s > threshold && s > s_max) {
+                i_max = i;
+                s_max = s;
+            }
+        }
+    }
+
+    return i_max;
+}
+
+// Copies `n` agents from `src` to `dst` and propagates them.
+static void propagate_agents(struct twsfwphysx_agent *dst,
+                             const struct twsfwphysx_agent *src,
+                             const int32_t n,
+                             const float dt)
+{
+    int32_t i = 0;
+#ifdef TWSFWPHYSX_SIMD
+    const float exp_dt = exp_f(-dt);
+    const float expm1_dt = expm1_f(-dt);
+    for (; i + 4 <= n; i += 4) {
+        struct twsfwphysx_agent *p = &dst[i];
+        p[0] = src[i];
+        p[1] = src[i + 1];
+        p[2] = src[i + 2];
+        p[3] = src[i + 3];
+
+        struct vec_x4 r = load_vec_x4(&p[0].r, &p[1].r, &p[2].r, &p[3].r);
+        const struct vec_x4 u =
+            load_vec_x4(&p[0].u, &p[1].u, &p[2].u, &p[3].u);
+        f32x4 v = f32x4_make(p[0].v, p[1].v, p[2].v, p[3].v);
+        const f32x4 a = f32x4_make(p[0].a, p[1].a, p[2].a, p[3].a);
+        propagate_x4(&r, u, &v, a, dt, exp_dt, expm1_dt);
+
+        store_vec_x4(r, &p[0].r, &p[1].r, &p[2].r, &p[3].r);
+        float vs[4];
+        f32x4_store(vs, v);
+        for (int32_t lane = 0; lane < 4; lane++) {
+            p[lane].v = vs[lane];
+        }
+    }
+#endif
+    for (; i < n; i++) {
+        dst[i] = src[i];
+        propagate(&dst[i].r, dst[i].u, &dst[i].v, dst[i].a, dt);
+    }
+}
+
+static void propagate_missiles(struct twsfwphysx_missile *m,
+                               const int32_t n,
+                               const float acceleration,
+                               const float dt)
+{
+    int32_t i = 0;
+#ifdef TWSFWPHYSX_SIMD
+    const float exp_dt = exp_f(-dt);
+    const float expm1_dt = expm1_f(-dt);
+    const f32x4 a = f32x4_splat(acceleration);
+    for (; i + 4 <= n; i += 4) {
+        struct twsfwphysx_missile *p = &m[i];
+        struct vec_x4 r = load_vec_x4(&p[0].r, &p[1].r, &p[2].r, &p[3].r);
+        const struct vec_x4 u =
+            load_vec_x4(&p[0].u, &p[1].u, &p[2].u, &p[3].u);
+        f32x4 v = f32x4_make(p[0].v, p[1].v, p[2].v, p[3].v);
+        propagate_x4(&r, u, &v, a, dt, exp_dt, expm1_dt);
+
+        store_vec_x4(r, &p[0].r, &p[1].r, &p[2].r, &p[3].r);
+        float vs[4];
+        f32x4_store(vs, v);
+        for (int32_t lane = 0; lane < 4; lane++) {
+            p[lane].v = vs[lane];
+        }
+    }
+#endif
+    for (; i < n; i++) {
+        propagate(&m[i].r, m[i].u, &m[i].v, acceleration, dt);
+    }
+}
+
+struct twsfwphysx_simulation_buffer {
+    struct twsfwphysx_agent *p;
+    float *s1;
+    float *s2;
+    int32_t capacity;
+    struct twsfwphysx_digest *digest;
+    struct twsfwphysx_events *events;
+    struct twsfwphysx_stats *stats;
+    struct twsfwphysx_trajectory *trajectory;
+#ifdef TWSFWPHYSX_ASYNC
+    struct twsfwphysx_thread_pool *pool;
+#endif
+};
+
+#ifdef TWSFWPHYSX_ASYNC
+
+// minimal number of agents (or missiles) that are worth the synchronization
+#define TWSFWPHYSX_PARALLEL_MIN_SIZE 256
+
+typedef void (*thread_pool_task)(void *context,
+                                 int32_t thread,
+                                 int32_t n_threads);
+
+// Runs `task` on all threads of the pool (including the calling thread) and
+// waits for all of them to finish.
+static void thread_pool_run(struct twsfwphysx_thread_pool *pool,
+                            thread_pool_task task,
+                            void *context);
+
+static int32_t thread_pool_size(const struct twsfwphysx_thread_pool *pool);
+
+// Splits `n` objects into contiguous parts (of multiples of 4, see
+// TWSFWPHYSX_SIMD) and returns the part of the given thread.
+static void parallel_range(const int32_t n,
+                           const int32_t thread,
+                           const int32_t n_threads,
+                           int32_t *begin,
+                           int32_t *end)
+{
+    const int32_t part = ((n + n_threads - 1) / n_threads + 3) & ~3;
+    *begin = thread * part < n ? thread * part : n;
+    *end = n - *begin > part ? *begin + part : n;
+}
+
+struct distance_task {
+    const struct twsfwphysx_agent *agents;
+    float *buffer;
+    int32_t n;
+};
+
+static void distance_task_run(void *context,
+                              const int32_t thread,
+                              const int32_t n_threads)
+{
+    // Rows get shorter, hence they are dealt out in turns.
+    const struct distance_task *task = (const struct distance_task *)context;
+    fill_distance_rows(task->agents, task->buffer, task->n, thread, n_threads);
+}
+
+struct agent_task {
+    struct twsfwphysx_agent *dst;
+    const struct twsfwphysx_agent *src;
+    int32_t n;
+    float dt;
+};
+
+static void agent_task_run(void *context,
+                           const int32_t thread,
+                           const int32_t n_threads)
+{
+    const struct agent_task *task = (const struct agent_task *)context;
+    int32_t begin;
+    int32_t end;
+    parallel_range(task->n, thread, n_threads, &begin, &end);
+    propagate_agents(
+        &task->dst[begin], &task->src[begin], end - begin, task->dt);
+}
+
+struct missile_task {
+    struct twsfwphysx_missile *missiles;
+    int32_t n;
+    float acceleration;
+    float dt;
+};
+
+static void missile_task_run(void *context,
+                             const int32_t thread,
+                             const int32_t n_threads)
+{
+    const struct missile_task *task = (const struct missile_task *)context;
+    int32_t begin;
+    int32_t end;
+    parallel_range(task->n, thread, n_threads, &begin, &end);
+    propagate_missiles(
+        &task->missiles[begin], end - begin, task->acceleration, task->dt);
+}
+
+static int use_thread_pool(const struct twsfwphysx_simulation_buffer *buffer,
+                           const int32_t n)
+{
+    return buffer->pool != NULL && thread_pool_size(buffer->pool) > 1 &&
+           n >= TWSFWPHYSX_PARALLEL_MIN_SIZE;
+}
+
+#endif
+
+// Same as fill_distance_buffer but on the thread pool of the buffer (if any).
+static void
+parallel_fill_distance_buffer(struct twsfwphysx_simulation_buffer *buffer,
+                              const struct twsfwphysx_agent *agents,
+                              float *distances,
+                              const int32_t n)
+{
+#ifdef TWSFWPHYSX_ASYNC
+    if (use_thread_pool(buffer, n)) {
+        struct distance_task task = { agents, distances, n };
+        thread_pool_run(buffer->pool, distance_task_run, &task);
+        return;
+    }
+#else
+    (void)buffer;
+#endif
+    fill_distance_buffer(agents, distances, n);
+}
+
+// Same as propagate_agents but on the thread pool of the buffer (if any).
+static void
+parallel_propagate_agents(struct twsfwphysx_simulation_buffer *buffer,
+                          struct twsfwphysx_agent *dst,
+                          const struct twsfwphysx_agent *src,
+                          const int32_t n,
+                          const float dt)
+{
+#ifdef TWSFWPHYSX_ASYNC
+    if (use_thread_pool(buffer, n)) {
+        struct agent_task task = { dst, src, n, dt };
+        thread_pool_run(buffer->pool, agent_task_run, &task);
+        return;
+    }
+#else
+    (void)buffer;
+#endif
+    propagate_agents(dst, src, n, dt);
+}
+
+// Same as propagate_missiles but on the thread pool of the buffer (if any).
+static void
+parallel_propagate_missiles(struct twsfwphysx_simulation_buffer *buffer,
+                            struct twsfwphysx_missiles *missiles,
+                            const float acceleration,
+                            const float dt)
+{
+#ifdef TWSFWPHYSX_ASYNC
+    if (use_thread_pool(buffer, missiles->size)) {
+        struct missile_task task = {
+            missiles->missiles, missiles->size, acceleration, dt
+        };
+        thread_pool_run(buffer->pool, missile_task_run, &task);
+        return;
+    }
+#else
+    (void)buffer;
+#endif
+    propagate_missiles(missiles->missiles, missiles->size, acceleration, dt);
+}
+
+struct twsfwphysx_simulation_buffer *twsfwphysx_create_simulation_buffer(void)
+{
+    struct twsfwphysx_simulation_buffer *buffer =
+        (struct twsfwphysx_simulation_buffer *)malloc(
+            sizeof(struct twsfwphysx_simulation_buffer));
+    buffer->p = NULL;
+    buffer->s1 = NULL;
+    buffer->s2 = NULL;
+    buffer->capacity = 0;
+    buffer->digest = NULL;
+    buffer->events = NULL;
+    buffer->stats = NULL;
+    buffer->trajectory = NULL;
+#ifdef TWSFWPHYSX_ASYNC
+    buffer->pool = NULL;
+#endif
+
+    return buffer;
+}
+
+void twsfwphysx_delete_simulation_buffer(
+    struct twsfwphysx_simulation_buffer *buffer)
+{
+    if (buffer != NULL) {
+        free(buffer->p);
+        free(buffer->s1);
+        free(buffer->s2);
+        free(buffer);
+    }
+}
+
+static uint64_t simulation_buffer_bytes(const int32_t capacity)
+{
+    const uint64_t n = (uint64_t)capacity;
+    const uint64_t n_pairs = n > 1 ? (n * (n - 1)) / 2 : 0;
+    return n * sizeof(struct twsfwphysx_agent) + 2 * n_pairs * sizeof(float);
+}
+
+static struct twsfwphysx_simulation_buffer
+update_simulation_buffer(struct twsfwphysx_simulation_buffer buffer,
+                         const int32_t n_agents)
+{
+    assert(buffer.capacity >= 0);
+
+    if (n_agents > buffer.capacity) {
+        buffer.capacity = n_agents;
+        if (buffer.stats != NULL) {
+            buffer.stats->n_reallocations += 1;
+        }
+
+        const uint64_t n = (uint64_t)n_agents;
+
+        buffer.p = (struct twsfwphysx_agent *)
+            // NOLINTNEXTLINE(bugprone-suspicious-realloc-usage)
+            realloc(buffer.p, n * sizeof(struct twsfwphysx_agent));
+        assert(buffer.p != NULL);
+
+        if (n_agents > 1) {
+            const uint64_t size = (n * (n - 1)) / 2 * sizeof(float);
+
+            // NOLINTNEXTLINE(bugprone-suspicious-realloc-usage)
+            buffer.s1 = (float *)realloc(buffer.s1, size);
+            assert(buffer.s1 != NULL);
+
+            // NOLINTNEXTLINE(bugprone-suspicious-realloc-usage)
+            buffer.s2 = (float *)realloc(buffer.s2, size);
+            assert(buffer.s2 != NULL);
+        }
+    }
+
+    return buffer;
+}
+
+void twsfwphysx_set_digest(struct twsfwphysx_simulation_buffer *buffer,
+                           struct twsfwphysx_digest *digest)
+{
+    assert(buffer != NULL);
+    buffer->digest = digest;
+}
+
+static uint64_t digest_hash(const void *object, const uint64_t size)
+{
+    assert(size % sizeof(uint32_t) == 0);
+
+    const unsigned char *bytes = (const unsigned char *)object;
+    uint64_t h = 0x9e3779b97f4a7c15ULL;
+    for (uint64_t i = 0; i < size; i += sizeof(uint32_t)) {
+        uint32_t word;
+        memcpy(&word, bytes + i, sizeof(uint32_t));
+        h = (h ^ word) * 0x100000001b3ULL;
+    }
+
+    // finalizer of splitmix64
+    h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+    return h ^ (h >> 31);
+}
+
+static uint64_t digest_agent(const struct twsfwphysx_agent *agent,
+                             const int32_t index)
+{
+    return digest_hash(agent, sizeof(struct twsfwphysx_agent)) ^
+           ((uint64_t)(uint32_t)index * 0xd6e8feb86659fd93ULL);
+}
+
+static uint64_t digest_missile(const struct twsfwphysx_missile *missile)
+{
+    return digest_hash(missile, sizeof(struct twsfwphysx_missile));
+}
+
+static int32_t digest_region(const struct twsfwphysx_vec r)
+{
+    return (r.x < 0.F ? 1 : 0) | (r.y < 0.F ? 2 : 0) | (r.z < 0.F ? 4 : 0);
+}
+
+static void digest_add_agent(struct twsfwphysx_digest *digest,
+                             const struct twsfwphysx_agent *agent,
+                             const int32_t index)
+{
+    const uint64_t h = digest_agent(agent, index);
+    digest->agents += h;
+    digest->regions[digest_region(agent->r)] += h;
+}
+
+static void digest_remove_agent(struct twsfwphysx_digest *digest,
+                                const struct twsfwphysx_agent *agent,
+                                const int32_t index)
+{
+    const uint64_t h = digest_agent(agent, index);
+    digest->agents -= h;
+    digest->regions[digest_region(agent->r)] -= h;
+}
+
+static void digest_add_missile(struct twsfwphysx_digest *digest,
+                               const struct twsfwphysx_missile *missile)
+{
+    const uint64_t h = digest_missile(missile);
+    digest->missiles += h;
+    digest->regions[digest_region(missile->r)] += h;
+}
+
+struct twsfwphysx_events
+twsfwphysx_make_events(struct twsfwphysx_event *storage, const int32_t capacity)
+{
+    assert(storage != NULL && capacity > 0);
+
+    const struct twsfwphysx_events events = { storage, capacity, 0, 0, 0 };
+    return events;
+}
+
+void twsfwphysx_clear_events(struct twsfwphysx_events *events)
+{
+    events->begin = 0;
+    events->size = 0;
+    events->n_dropped = 0;
+}
+
+const struct twsfwphysx_event *
+twsfwphysx_get_event(const struct twsfwphysx_events *events, const int32_t i)
+{
+    assert(i >= 0 && i < events->size);
+    return &events->events[(events->begin + i) % events->capacity];
+}
+
+void twsfwphysx_set_events(struct twsfwphysx_simulation_buffer *buffer,
+                           struct twsfwphysx_events *events)
+{
+    assert(buffer != NULL);
+    buffer->events = events;
+}
+
+void twsfwphysx_reset_stats(struct twsfwphysx_stats *stats)
+{
+    memset(stats, 0, sizeof(struct twsfwphysx_stats));
+}
+
+void twsfwphysx_set_stats(struct twsfwphysx_simulation_buffer *buffer,
+                          struct twsfwphysx_stats *stats)
+{
+    assert(buffer != NULL);
+    buffer->stats = stats;
+}
+
+void twsfwphysx_set_trajectory(struct twsfwphysx_simulation_buffer *buffer,
+                               struct twsfwphysx_trajectory *trajectory)
+{
+    assert(buffer != NULL);
+    assert(trajectory == NULL || trajectory->every > 0);
+    buffer->trajectory = trajectory;
+}
+
+static unsigned char *strided_element(const struct twsfwphysx_strided_array *a,
+                                      const int32_t i,
+                                      const int32_t j,
+                                      const int32_t k)
+{
+    return (unsigned char *)a->data + (int64_t)i * a->strides[0] +
+           (int64_t)j * a->strides[1] + (int64_t)k * a->strides[2];
+}
+
+// memcpy avoids assumptions on the alignment of the caller's arrays
+static void write_strided_vec(const struct twsfwphysx_strided_array *a,
+                              const int32_t frame,
+                              const int32_t i,
+                              const struct twsfwphysx_vec v)
+{
+    memcpy(strided_element(a, frame, i, 0), &v.x, sizeof(float));
+    memcpy(strided_element(a, frame, i, 1), &v.y, sizeof(float));
+    memcpy(strided_element(a, frame, i, 2), &v.z, sizeof(float));
+}
+
+static void record_frame(struct twsfwphysx_trajectory *trajectory,
+                         const struct twsfwphysx_agent *agents,
+                         const int32_t n_agents,
+                         const struct twsfwphysx_missiles *missiles)
+{
+    const int32_t frame = trajectory->size;
+
+    for (int32_t i = 0; i < n_agents; i++) {
+        if (trajectory->agent_r.data != NULL) {
+            write_strided_vec(&trajectory->agent_r, frame, i, agents[i].r);
+        }
+        if (trajectory->agent_v.data != NULL) {
+            memcpy(strided_element(&trajectory->agent_v, frame, i, 0),
+                   &agents[i].v,
+                   sizeof(float));
+        }
+        if (trajectory->agent_hp.data != NULL) {
+            memcpy(strided_element(&trajectory->agent_hp, frame, i, 0),
+                   &agents[i].hp,
+                   sizeof(float));
+        }
+    }
+
+    for (int32_t i = 0; i < missiles->size; i++) {
+        const struct twsfwphysx_missile *missile = &missiles->missiles[i];
+        if (trajectory->missile_r.data != NULL) {
+            write_strided_vec(&trajectory->missile_r, frame, i, missile->r);
+        }
+        if (trajectory->missile_payload.data != NULL) {
+            memcpy(strided_element(&trajectory->missile_payload, frame, i, 0),
+                   &missile->payload,
+                   sizeof(int32_t));
+        }
+    }
+
+    if (trajectory->n_missiles.data != NULL) {
+        memcpy(strided_element(&trajectory->n_missiles, frame, 0, 0),
+               &missiles->size,
+               sizeof(int32_t));
+    }
+
+    trajectory->size += 1;
+}
+
+// Monotonic, such that adjustments of the wall clock do not distort intervals
+static uint64_t clock_ns(void)
+{
+#if defined(_WIN32)
+    LARGE_INTEGER counter;
+    LARGE_INTEGER frequency;
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&frequency);
+
+    const uint64_t ticks = (uint64_t)counter.QuadPart;
+    const uint64_t hz = (uint64_t)frequency.QuadPart;
+    return ticks / hz * 1000000000ULL + ticks % hz * 1000000000ULL / hz;
+#else
+    struct timespec ts;
+#if defined(CLOCK_MONOTONIC)
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+#elif defined(TIME_MONOTONIC)
+    timespec_get(&ts, TIME_MONOTONIC);
+#else
+    // last resort if POSIX was hidden by an earlier include
+    timespec_get(&ts, TIME_UTC);
+#endif
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+static uint64_t stats_clock(const struct twsfwphysx_stats *stats)
+{
+    return stats != NULL ? clock_ns() : 0;
+}
+
+#ifdef TWSFWPHYSX_TRACE
+
+struct trace_record {
+    const char *name;
+    uint64_t ns;
+    char phase;
+};
+
+struct trace_ring {
+    struct trace_ring *next;
+    int32_t thread;
+    atomic_uint_fast64_t size;
+    struct trace_record records[TWSFWPHYSX_TRACE_CAPACITY];
+};
+
+static _Atomic(struct trace_ring *) trace_rings = NULL;
+static atomic_int trace_n_threads = 0;
+static _Thread_local struct trace_ring *trace_ring = NULL;
+
+static void trace(const char *name, const char phase)
+{
+    struct trace_ring *ring = trace_ring;
+    if (ring == NULL) {
+        ring = (struct trace_ring *)malloc(sizeof(struct trace_ring));
+        assert(ring != NULL);
+        ring->thread = atomic_fetch_add(&trace_n_threads, 1);
+        atomic_init(&ring->size, 0);
+
+        // rings are never released and thus can be pushed without ABA issues
+        ring->next = atomic_load(&trace_rings);
+        while (!atomic_compare_exchange_weak(&trace_rings, &ring->next, ring)) {
+        }
+        trace_ring = ring;
+    }
+
+    const uint_fast64_t size =
+        atomic_load_explicit(&ring->size, memory_order_relaxed);
+    struct trace_record *record =
+        &ring->records[size % TWSFWPHYSX_TRACE_CAPACITY];
+    record->name = name;
+    record->ns = clock_ns();
+    record->phase = phase;
+    atomic_store_explicit(&ring->size, size + 1, memory_order_release);
+}
+
+#define TWSFWPHYSX_TRACE_BEGIN(name) trace(name, 'B')
+#define TWSFWPHYSX_TRACE_END(name) trace(name, 'E')
+
+#else
+
+#define TWSFWPHYSX_TRACE_BEGIN(name) ((void)0)
+#define TWSFWPHYSX_TRACE_END(name) ((void)0)
+
+#endif
+
+static void record_event(struct twsfwphysx_events *events,
+                         const int32_t type,
+                         const int32_t step,
+                         const int32_t a,
+                         const int32_t b,
+                         const float value)
+{
+    const struct twsfwphysx_event event = { type, step, a, b, value };
+
+    if (events->size < events->capacity) {
+        const int32_t end = (events->begin + events->size) % events->capacity;
+        events->events[end] = event;
+        events->size += 1;
+    } else {
+        events->events[events->begin] = event;
+        events->begin = (events->begin + 1) % events->capacity;
+        events->n_dropped += 1;
+    }
+}
+
+void twsfwphysx_compute_digest(const struct twsfwphysx_agents *agents,
+                               const struct twsfwphysx_missiles *missiles,
+                               struct twsfwphysx_digest *digest)
+{
+    memset(digest, 0, sizeof(struct twsfwphysx_digest));
+
+    for (int32_t i = 0; i < agents->size; i++) {
+        digest_add_agent(digest, &agents->agents[i], i);
+    }
+
+    for (int32_t i = 0; i < missiles->size; i++) {
+        digest_add_missile(digest, &missiles->missiles[i]);
+    }
+}
+
+#if defined(__GNUC__)
+#define TWSFWPHYSX_ALWAYS_INLINE inline __attribute__((always_inline))
+#elif defined(_MSC_VER)
+#define TWSFWPHYSX_ALWAYS_INLINE __forceinline
+#else
+#define TWSFWPHYSX_ALWAYS_INLINE inline
+#endif
+
+// The steps of twsfwphysx_simulate. Every caller passes constants for the
+// flags, such that each kernel is compiled without the dead branches.
+// Uninstrumented kernels ignore events, digests, stats and trajectories.
+static TWSFWPHYSX_ALWAYS_INLINE void
+simulate_steps(struct twsfwphysx_agents *agents,
+               struct twsfwphysx_missiles *missiles,
+               const struct twsfwphysx_world *world,
+               const float t,
+               int32_t n_steps,
+               struct twsfwphysx_simulation_buffer *buffer,
+               const int has_missiles,
+               const int elastic,
+               const int check_hp,
+               const int instrumented)
+{
+    struct twsfwphysx_simulation_buffer bffr;
+    memset(&bffr, 0, sizeof(struct twsfwphysx_simulation_buffer));
+    if (buffer == NULL) {
+        buffer = &bffr;
+    }
+
+    TWSFWPHYSX_TRACE_BEGIN("simulate");
+
+    struct twsfwphysx_stats *stats = instrumented ? buffer->stats : NULL;
+    const uint64_t clock_begin = stats_clock(stats);
+
+    const int32_t n_agents = agents->size;
+    *buffer = update_simulation_buffer(*buffer, n_agents);
+    if (stats != NULL) {
+        stats->buffer_bytes = simulation_buffer_bytes(buffer->capacity);
+    }
+
+    // !!! WARNING !!!
+    // cos(.) makes small angles large and large angles small!
+    // Hence, search for distances *above* `*_threshold` when looking for
+    // *close* objects.
+    const float missile_agent_threshold = cos_f(world->agent_radius);
+    const float agent_agent_threshold = cos_f(2.F * world->agent_radius);
+    const float restitution = elastic ? 1.F : world->restitution;
+
+    struct twsfwphysx_agent *p = agents->agents;
+
+    struct twsfwphysx_digest *final_digest =
+        instrumented ? buffer->digest : NULL;
+    if (final_digest != NULL && n_steps <= 0) {
+        twsfwphysx_compute_digest(agents, missiles, final_digest);
+    }
+
+    struct twsfwphysx_events *events = instrumented ? buffer->events : NULL;
+    const int32_t n_total_steps = n_steps;
+
+    struct twsfwphysx_trajectory *trajectory =
+        instrumented ? buffer->trajectory : NULL;
+    if (trajectory != NULL) {
+        trajectory->size = 0;
+    }
+
+    const float dt = t / (float)n_steps;
+    while (n_steps-- > 0) {
+        const int32_t step = n_total_steps - n_steps - 1;
+
+        // The digest describes the final state and thus is only updated
+        // during the last step.
+        struct twsfwphysx_digest *digest = n_steps == 0 ? final_digest : NULL;
+        if (digest != NULL) {
+            memset(digest, 0, sizeof(struct twsfwphysx_digest));
+        }
+
+        int32_t n_hits = 0;
+        int32_t n_missiles_propagated = 0;
+        int32_t n_pairs_close = 0;
+        int32_t n_collisions = 0;
+        TWSFWPHYSX_TRACE_BEGIN("step");
+        const uint64_t clock_step = stats_clock(stats);
+
+        TWSFWPHYSX_TRACE_BEGIN("missiles");
+        for (int i = has_missiles ? missiles->size - 1 : -1; i >= 0; i--) {
+            const int j = nearest_hit(agents,
+                                      missiles->missiles[i],
+                                      missile_agent_threshold);
+            if (j >= 0) {
+                const int32_t payload = missiles->missiles[i].payload;
+                const float damage = hit(&p[j], missiles, i);
+                n_hits += 1;
+                if (events != NULL) {
+                    // damage = 2 + cos(angle between the rotation axes)
+                    record_event(events,
+                                 damage < 2.F ? TWSFWPHYSX_EVENT_HIT_HEAD_ON :
+                                                TWSFWPHYSX_EVENT_HIT_REAR,
+                                 step,
+                                 j,
+                                 payload,
+                                 damage);
+                }
+            }
+        }
+
+        // Missiles that did not detonate are propagated afterwards. (Hits
+        // only depend on the positions before propagation.)
+        if (has_missiles) {
+            parallel_propagate_missiles(
+                buffer, missiles, world->missile_acceleration, dt);
+            n_missiles_propagated = missiles->size;
+        }
+        for (int i = 0; digest != NULL && i < missiles->size; i++) {
+            digest_add_missile(digest, &missiles->missiles[i]);
+        }
+
+        TWSFWPHYSX_TRACE_END("missiles");
+        const uint64_t clock_missiles = stats_clock(stats);
+
+        TWSFWPHYSX_TRACE_BEGIN("distances");
+        parallel_fill_distance_buffer(buffer, p, buffer->s1, n_agents);
+        TWSFWPHYSX_TRACE_END("distances");
+        const uint64_t clock_distances = stats_clock(stats);
+
+        TWSFWPHYSX_TRACE_BEGIN("agents");
+        parallel_propagate_agents(buffer, buffer->p, p, n_agents, dt);
+        for (int i = 0; digest != NULL && i < n_agents; i++) {
+            digest_add_agent(digest, &buffer->p[i], i);
+        }
+        TWSFWPHYSX_TRACE_END("agents");
+        const uint64_t clock_agents = stats_clock(stats);
+
+        TWSFWPHYSX_TRACE_BEGIN("distances");
+        parallel_fill_distance_buffer(
+            buffer, buffer->p, buffer->s2, n_agents);
+        TWSFWPHYSX_TRACE_END("distances");
+        const uint64_t clock_pairs = stats_clock(stats);
+
+        TWSFWPHYSX_TRACE_BEGIN("collisions");
+        int32_t k = 0;
+        for (int i = 0; i < n_agents; i++) {
+            for (int j = i + 1; j < n_agents; j++) {
+                const int both_alive =
+                    !check_hp || (p[i].hp > 0.F && p[j].hp > 0.F);
+                const int too_close = buffer->s1[k] > agent_agent_threshold ||
+                                      buffer->s2[k] > agent_agent_threshold;
+                const int distance_decreases = buffer->s1[k] < buffer->s2[k];
+                n_pairs_close += too_close;
+
+                if (both_alive && too_close && distance_decreases) {
+                    if (digest != NULL) {
+                        digest_remove_agent(digest, &buffer->p[i], i);
+                        digest_remove_agent(digest, &buffer->p[j], j);
+                    }
+
+                    buffer->p[i] = p[i];
+                    buffer->p[j] = p[j];
+                    n_collisions += 1;
+                    const float impulse =
+                        collide(&buffer->p[i], &buffer->p[j], restitution);
+                    if (events != NULL) {
+                        record_event(events,
+                                     TWSFWPHYSX_EVENT_COLLISION,
+                                     step,
+                                     i,
+                                     j,
+                                     fabsf(impulse));
+                    }
+
+                    if (digest != NULL) {
+                        digest_add_agent(digest, &buffer->p[i], i);
+                        digest_add_agent(digest, &buffer->p[j], j);
+                    }
+                }
+
+                k += 1;
+            }
+        }
+
+        TWSFWPHYSX_TRACE_END("collisions");
+        TWSFWPHYSX_TRACE_END("step");
+
+        if (stats != NULL) {
+            const uint64_t clock_end = stats_clock(stats);
+            const uint64_t n = (uint64_t)n_agents;
+
+            stats->n_steps += 1;
+            stats->ns_missiles += clock_missiles - clock_step;
+            stats->ns_distances += (clock_distances - clock_missiles) +
+                                   (clock_pairs - clock_agents);
+            stats->ns_agents += clock_agents - clock_distances;
+            stats->ns_collisions += clock_end - clock_pairs;
+            stats->n_pairs_tested += n > 1 ? n * (n - 1) / 2 : 0;
+            stats->n_pairs_close += (uint64_t)n_pairs_close;
+            stats->n_collisions += (uint64_t)n_collisions;
+            stats->n_missiles_propagated += (uint64_t)n_missiles_propagated;
+            stats->n_hits += (uint64_t)n_hits;
+        }
+
+        struct twsfwphysx_agent *tmp = p;
+        p = buffer->p;
+        buffer->p = tmp;
+
+        if (trajectory != NULL && (step + 1) % trajectory->every == 0 &&
+            trajectory->size < trajectory->capacity) {
+            record_frame(trajectory, p, n_agents, missiles);
+        }
+    }
+
+    // After an odd number of steps, the result is in the simulation buffer.
+    // Agents are copied back such that the buffer keeps its own array (which
+    // matches its capacity even if twsfwphysx_restore resized the agents) and
+    // `agents->agents` can point to memory that is not owned by twsfwphysx
+    // (e.g., a mapped world file).
+    if (p != agents->agents) {
+        memcpy(agents->agents,
+               p,
+               (uint64_t)n_agents * sizeof(struct twsfwphysx_agent));
+        buffer->p = p;
+    }
+
+    if (stats != NULL) {
+        stats->n_calls += 1;
+        stats->ns_total += stats_clock(stats) - clock_begin;
+    }
+
+    free(bffr.p);
+    free(bffr.s1);
+    free(bffr.s2);
+
+    TWSFWPHYSX_TRACE_END("simulate");
+}
+
+void twsfwphysx_simulate(struct twsfwphysx_agents *agents,
+                         struct twsfwphysx_missiles *missiles,
+                         const struct twsfwphysx_world *world,
+                         const float t,
+                         const int32_t n_steps,
+                         struct twsfwphysx_simulation_buffer *buffer)
+{
+    simulate_steps(agents, missiles, world, t, n_steps, buffer, 1, 0, 1, 1);
+}
+
+static void check_kernel(const struct twsfwphysx_agents *agents,
+                         const struct twsfwphysx_missiles *missiles,
+                         const struct twsfwphysx_world *world,
+                         const uint32_t kernel)
+{
+#ifdef NDEBUG
+    (void)agents;
+    (void)missiles;
+    (void)world;
+    (void)kernel;
+#else
+    const int no_missiles = (kernel & TWSFWPHYSX_KERNEL_NO_MISSILES) != 0;
+    const int elastic = (kernel & TWSFWPHYSX_KERNEL_ELASTIC) != 0;
+    const int all_alive = (kernel & TWSFWPHYSX_KERNEL_ALL_ALIVE) != 0;
+
+    assert(!no_missiles || missiles->size == 0);
+    assert(!elastic ||
+           !(world->restitution < 1.F || world->restitution > 1.F));
+    assert(!all_alive || no_missiles);
+    for (int32_t i = 0; all_alive && i < agents->size; i++) {
+        assert(agents->agents[i].hp > 0.F);
+    }
+#endif
+}
+
+static int has_attachments(const struct twsfwphysx_simulation_buffer *buffer)
+{
+    return buffer != NULL &&
+           (buffer->digest != NULL || buffer->events != NULL ||
+            buffer->stats != NULL || buffer->trajectory != NULL);
+}
+
+// Defines the kernel `simulate_<kernel>`. Attached events, digests, stats and
+// trajectories are only recorded by twsfwphysx_simulate.
+#define TWSFWPHYSX_DEFINE_KERNEL(kernel, has_missiles, elastic, check_hp) \
+    static void simulate_##kernel(                                        \
+        struct twsfwphysx_agents *agents,                                 \
+        struct twsfwphysx_missiles *missiles,                             \
+        const struct twsfwphysx_world *world,                             \
+        const float t,                                                    \
+        const int32_t n_steps,                                            \
+        struct twsfwphysx_simulation_buffer *buffer)                      \
+    {                                                                     \
+        check_kernel(agents, missiles, world, (kernel));                  \
+        if (has_attachments(buffer)) {                                    \
+            twsfwphysx_simulate(                                          \
+                agents, missiles, world, t, n_steps, buffer);             \
+            return;                                                       \
+        }                                                                 \
+        simulate_steps(agents,                                            \
+                       missiles,                                          \
+                       world,                                             \
+                       t,                                                 \
+                       n_steps,                                           \
+                       buffer,                                            \
+                       (has_missiles),                                    \
+                       (elastic),                                         \
+                       (check_hp),                                        \
+                       0);                                                \
+    }
+
+TWSFWPHYSX_DEFINE_KERNEL(1, 0, 0, 1)
+TWSFWPHYSX_DEFINE_KERNEL(2, 1, 1, 1)
+TWSFWPHYSX_DEFINE_KERNEL(3, 0, 1, 1)
+TWSFWPHYSX_DEFINE_KERNEL(5, 0, 0, 0)
+TWSFWPHYSX_DEFINE_KERNEL(7, 0, 1, 0)
+
+#undef TWSFWPHYSX_DEFINE_KERNEL
+#undef TWSFWPHYSX_ALWAYS_INLINE
+
+twsfwphysx_simulate_function twsfwphysx_select_kernel(const uint32_t kernel)
+{
+    assert(!(kernel & TWSFWPHYSX_KERNEL_ALL_ALIVE) ||
+           (kernel & TWSFWPHYSX_KERNEL_NO_MISSILES));
+
+    switch (kernel) {
+    case TWSFWPHYSX_KERNEL_NO_MISSILES:
+        return simulate_1;
+    case TWSFWPHYSX_KERNEL_ELASTIC:
+        return simulate_2;
+    case TWSFWPHYSX_KERNEL_NO_MISSILES | TWSFWPHYSX_KERNEL_ELASTIC:
+        return simulate_3;
+    case TWSFWPHYSX_KERNEL_NO_MISSILES | TWSFWPHYSX_KERNEL_ALL_ALIVE:
+        return simulate_5;
+    case TWSFWPHYSX_KERNEL_NO_MISSILES | TWSFWPHYSX_KERNEL_ELASTIC |
+        TWSFWPHYSX_KERNEL_ALL_ALIVE:
+        return simulate_7;
+    default:
+        return twsfwphysx_simulate;
+    }
+}
+
+void twsfwphysx_simulate_kernel(struct twsfwphysx_agents *agents,
+                                struct twsfwphysx_missiles *missiles,
+                                const struct twsfwphysx_world *world,
+                                const float t,
+                                const int32_t n_steps,
+                                struct twsfwphysx_simulation_buffer *buffer,
+                                const uint32_t kernel)
+{
+    twsfwphysx_select_kernel(kernel)(
+        agents, missiles, world, t, n_steps, buffer);
+}
+
+
+void twsfwphysx_turn_agent(struct twsfwphysx_agent *agent, float angle)
+{
+    rotate(&agent->u, agent->r, angle);
+}
+
+struct twsfwphysx_missile
+twsfwphysx_launch_missile(const struct twsfwphysx_agent *agent,
+                          const struct twsfwphysx_world *world)
+{
+    struct twsfwphysx_missile missile = { agent->r, agent->u, agent->v, -1 };
+
+    const float distance = world->agent_radius + world->agent_radius * 1e-4F;
+    rotate(&missile.r, missile.u, distance);
+
+    return missile;
+}
+
+static void resize_agents(struct twsfwphysx_agents *agents, const int32_t n)
+{
+    if (agents->size != n) {
+        // NOLINTNEXTLINE(bugprone-suspicious-realloc-usage)
+        agents->agents = (struct twsfwphysx_agent *)realloc(
+            agents->agents, (uint64_t)n * sizeof(struct twsfwphysx_agent));
+        assert(agents->agents != NULL || n == 0);
+        agents->size = n;
+    }
+}
+
+static void assign_agents(struct twsfwphysx_agents *agents,
+                          const void *src,
+                          const int32_t n)
+{
+    resize_agents(agents, n);
+
+    if (n > 0) {
+        memcpy(agents->agents,
+               src,
+               (uint64_t)n * sizeof(struct twsfwphysx_agent));
+    }
+}
+
+static void assign_missiles(struct twsfwphysx_missiles *missiles,
+                            const void *src,
+                            const int32_t n)
+{
+    if (missile_capacity(missiles) < n) {
+        reserve_missiles(missiles, n);
+    }
+    missiles->size = n;
+
+    if (n > 0) {
+        memcpy(missiles->missiles,
+               src,
+               (uint64_t)n * sizeof(struct twsfwphysx_missile));
+    }
+}
+
+struct twsfwphysx_snapshot_slot {
+    unsigned char *data;
+    uint64_t capacity;
+    int32_t tick;
+    int32_t n_agents;
+    int32_t n_missiles;
+};
+
+struct twsfwphysx_snapshots {
+    struct twsfwphysx_snapshot_slot *slots;
+    int32_t n_slots;
+};
+
+static uint64_t snapshot_size(const int32_t n_agents, const int32_t n_missiles)
+{
+    return ((uint64_t)n_agents * sizeof(struct twsfwphysx_agent)) +
+           ((uint64_t)n_missiles * sizeof(struct twsfwphysx_missile));
+}
+
+struct twsfwphysx_snapshots *twsfwphysx_create_snapshots(
+    const int32_t n_slots,
+    const int32_t n_agents, // NOLINT(bugprone-easily-swappable-parameters)
+    const int32_t n_missiles)
+{
+    assert(n_slots > 0);
+    assert(n_agents >= 0 && n_missiles >= 0);
+
+    struct twsfwphysx_snapshots *snapshots =
+        (struct twsfwphysx_snapshots *)malloc(
+            sizeof(struct twsfwphysx_snapshots));
+    assert(snapshots != NULL);
+
+    snapshots->n_slots = n_slots;
+    snapshots->slots = (struct twsfwphysx_snapshot_slot *)malloc(
+        (uint64_t)n_slots * sizeof(struct twsfwphysx_snapshot_slot));
+    assert(snapshots->slots != NULL);
+
+    const uint64_t capacity = snapshot_size(n_agents, n_missiles);
+    for (int32_t i = 0; i < n_slots; i++) {
+        struct twsfwphysx_snapshot_slot *slot = &snapshots->slots[i];
+        slot->data = capacity > 0 ? (unsigned char *)malloc(capacity) : NULL;
+        slot->capacity = slot->data != NULL ? capacity : 0;
+        slot->tick = -1;
+        slot->n_agents = 0;
+        slot->n_missiles = 0;
+    }
+
+    return snapshots;
+}
+
+void twsfwphysx_delete_snapshots(struct twsfwphysx_snapshots *snapshots)
+{
+    if (snapshots != NULL) {
+        for (int32_t i = 0; i < snapshots->n_slots; i++) {
+            free(snapshots->slots[i].data);
+        }
+        free(snapshots->slots);
+        free(snapshots);
+    }
+}
+
+void twsfwphysx_snapshot(struct twsfwphysx_snapshots *snapshots,
+                         const int32_t tick,
+                         const struct twsfwphysx_agents *agents,
+                         const struct twsfwphysx_missiles *missiles)
+{
+    assert(tick >= 0);
+
+    struct twsfwphysx_snapshot_slot *slot =
+        &snapshots->slots[tick % snapshots->n_slots];
+
+    const uint64_t size = snapshot_size(agents->size, missiles->size);
+    if (size > slot->capacity) {
+        // NOLINTNEXTLINE(bugprone-suspicious-realloc-usage)
+        slot->data = (unsigned char *)realloc(slot->data, size);
+        assert(slot->data != NULL);
+        slot->capacity = size;
+    }
+
+    const uint64_t agents_size =
+        (uint64_t)agents->size * sizeof(struct twsfwphysx_agent);
+    if (agents_size > 0) {
+        memcpy(slot->data, agents->agents, agents_size);
+    }
+    if (size > agents_size) {
+        memcpy(slot->data + agents_size,
+               missiles->missiles,
+               size - agents_size);
+    }
+
+    slot->tick = tick;
+    slot->n_agents = agents->size;
+    slot->n_missiles = missiles->size;
+}
+
+int twsfwphysx_restore(const struct twsfwphysx_snapshots *snapshots,
+                       const int32_t tick,
+                       struct twsfwphysx_agents *agents,
+                       struct twsfwphysx_missiles *missiles)
+{
+    if (tick < 0) {
+        return 0;
+    }
+
+    const struct twsfwphysx_snapshot_slot *slot =
+        &snapshots->slots[tick % snapshots->n_slots];
+    if (slot->tick != tick) {
+        return 0;
+    }
+
+    const uint64_t agents_size =
+        (uint64_t)slot->n_agents * sizeof(struct twsfwphysx_agent);
+    assign_agents(agents, slot->data, slot->n_agents);
+    assign_missiles(missiles, slot->data + agents_size, slot->n_missiles);
+
+    return 1;
+}
+
+// The grid covers [-1, 1]^3 with `resolution` cells per axis. Cells are
+// ordered by x, y and then z such that columns of cells along z are
+// contiguous.
+struct twsfwphysx_spatial_index {
+    int32_t resolution;
+    int32_t size;
+    int32_t capacity;
+    int32_t n_cells;
+    int32_t *cells; // index of the first object per cell (n_cells + 1)
+    int32_t *ids;
+    float *x;
+    float *y;
+    float *z;
+    int32_t *cell_of; // cell per object (unsorted)
+};
+
+#define TWSFWPHYSX_INDEX_MAX_RESOLUTION 64
+#define TWSFWPHYSX_PI 3.14159265F
+
+struct twsfwphysx_spatial_index *twsfwphysx_create_spatial_index(void)
+{
+    struct twsfwphysx_spatial_index *index =
+        (struct twsfwphysx_spatial_index *)malloc(
+            sizeof(struct twsfwphysx_spatial_index));
+    assert(index != NULL);
+
+    index->resolution = 1;
+    index->size = 0;
+    index->capacity = 0;
+    index->n_cells = 0;
+    index->cells = NULL;
+    index->ids = NULL;
+    index->x = NULL;
+    index->y = NULL;
+    index->z = NULL;
+    index->cell_of = NULL;
+
+    return index;
+}
+
+void twsfwphysx_delete_spatial_index(struct twsfwphysx_spatial_index *index)
+{
+    if (index != NULL) {
+        free(index->cells);
+        free(index->ids);
+        free(index->x);
+        free(index->y);
+        free(index->z);
+        free(index->cell_of);
+        free(index);
+    }
+}
+
+static int32_t grid_coordinate(const float x, const int32_t resolution)
+{
+    const int32_t i = (int32_t)floorf((x + 1.F) * .5F * (float)resolution);
+    return i < 0 ? 0 : (i < resolution ? i : resolution - 1);
+}
+
+static int32_t grid_cell(const struct twsfwphysx_spatial_index *index,
+                         const int32_t ix,
+                         const int32_t iy,
+                         const int32_t iz)
+{
+    return (ix * index->resolution + iy) * index->resolution + iz;
+}
+
+static int32_t index_resolution(const int32_t n)
+{
+    // about eight objects per occupied cell (the sphere touches about
+    // pi * resolution^2 cells)
+    const int32_t resolution = (int32_t)ceilf(sqrtf((float)n / 8.F));
+    if (resolution < 1) {
+        return 1;
+    }
+    if (resolution > TWSFWPHYSX_INDEX_MAX_RESOLUTION) {
+        return TWSFWPHYSX_INDEX_MAX_RESOLUTION;
+    }
+    return resolution;
+}
+
+// Prepares the index for `n` objects that are added by add_to_index and
+// sorted by sort_index afterward.
+static void reserve_index(struct twsfwphysx_spatial_index *index,
+                          const int32_t n)
+{
+    const int32_t resolution = index_resolution(n);
+    const int32_t n_cells = resolution * resolution * resolution;
+    if (n_cells > index->n_cells) {
+        // NOLINTNEXTLINE(bugprone-suspicious-realloc-usage)
+        index->cells = (int32_t *)realloc(
+            index->cells, (uint64_t)(n_cells + 1) * sizeof(int32_t));
+        assert(index->cells != NULL);
+    }
+    index->resolution = resolution;
+    index->n_cells = n_cells;
+
+    // objects are first written to the second half of each array
+    if (2 * n > index->capacity) {
+        index->capacity = 2 * n;
+        const uint64_t capacity = (uint64_t)index->capacity;
+
+        // NOLINTBEGIN(bugprone-suspicious-realloc-usage)
+        index->ids =
+            (int32_t *)realloc(index->ids, capacity * sizeof(int32_t));
+        index->x = (float *)realloc(index->x, capacity * sizeof(float));
+        index->y = (float *)realloc(index->y, capacity * sizeof(float));
+        index->z = (float *)realloc(index->z, capacity * sizeof(float));
+        index->cell_of =
+            (int32_t *)realloc(index->cell_of, capacity * sizeof(int32_t));
+        // NOLINTEND(bugprone-suspicious-realloc-usage)
+        assert(index->ids != NULL && index->x != NULL && index->y != NULL &&
+               index->z != NULL && index->cell_of != NULL);
+    }
+    index->size = 0;
+}
+
+static void add_to_index(struct twsfwphysx_spatial_index *index,
+                         const struct twsfwphysx_vec r,
+                         const int32_t id)
+{
+    const int32_t i = index->capacity / 2 + index->size++;
+    index->ids[i] = id;
+    index->x[i] = r.x;
+    index->y[i] = r.y;
+    index->z[i] = r.z;
+    index->cell_of[i] = grid_cell(index,
+                                  grid_coordinate(r.x, index->resolution),
+                                  grid_coordinate(r.y, index->resolution),
+                                  grid_coordinate(r.z, index->resolution));
+}
+
+// counting sort from the second half of the arrays into the first half
+static void sort_index(struct twsfwphysx_spatial_index *index)
+{
+    int32_t *cells = index->cells;
+    memset(cells, 0, (uint64_t)(index->n_cells + 1) * sizeof(int32_t));
+
+    const int32_t begin = index->capacity / 2;
+    for (int32_t i = begin; i < begin + index->size; i++) {
+        cells[index->cell_of[i] + 1] += 1;
+    }
+    for (int32_t c = 0; c < index->n_cells; c++) {
+        cells[c + 1] += cells[c];
+    }
+
+    // cells[c] temporarily points to the next free slot of cell c
+    for (int32_t i = begin; i < begin + index->size; i++) {
+        const int32_t j = cells[index->cell_of[i]]++;
+        index->ids[j] = index->ids[i];
+        index->x[j] = index->x[i];
+        index->y[j] = index->y[i];
+        index->z[j] = index->z[i];
+    }
+    for (int32_t c = index->n_cells; c > 0; c--) {
+        cells[c] = cells[c - 1];
+    }
+    cells[0] = 0;
+}
+
+void twsfwphysx_index_agents(struct twsfwphysx_spatial_index *index,
+                             const struct twsfwphysx_agents *agents)
+{
+    int32_t n = 0;
+    for (int32_t i = 0; i < agents->size; i++) {
+        n += agents->agents[i].hp > 0.F;
+    }
+
+    reserve_index(index, n);
+    for (int32_t i = 0; i < agents->size; i++) {
+        if (agents->agents[i].hp > 0.F) {
+            add_to_index(index, agents->agents[i].r, i);
+        }
+    }
+    sort_index(index);
+}
+
+void twsfwphysx_index_missiles(struct twsfwphysx_spatial_index *index,
+                               const struct twsfwphysx_missiles *missiles)
+{
+    reserve_index(index, missiles->size);
+    for (int32_t i = 0; i < missiles->size; i++) {
+        add_to_index(index, missiles->missiles[i].r, i);
+    }
+    sort_index(index);
+}
+
+// range [*z_min, *z_max] of z at which the unit sphere intersects the column
+// of cells (ix, iy); returns 0 if it does not intersect
+static int column_range(const struct twsfwphysx_spatial_index *index,
+                        const int32_t ix,
+                        const int32_t iy,
+                        float *z_min,
+                        float *z_max)
+{
+    const float h = 2.F / (float)index->resolution;
+    const float x0 = -1.F + (float)ix * h;
+    const float y0 = -1.F + (float)iy * h;
+    const float x1 = x0 + h;
+    const float y1 = y0 + h;
+
+    const float x_near = x0 > 0.F ? x0 : (x1 < 0.F ? x1 : 0.F);
+    const float y_near = y0 > 0.F ? y0 : (y1 < 0.F ? y1 : 0.F);
+    const float x_far = fmaxf(fabsf(x0), fabsf(x1));
+    const float y_far = fmaxf(fabsf(y0), fabsf(y1));
+
+    // margins for positions that are not perfectly normalized
+    const float z_far2 = 1.F - (x_near * x_near + y_near * y_near) + 1e-3F;
+    const float z_near2 = 1.F - (x_far * x_far + y_far * y_far) - 1e-3F;
+    if (z_far2 < 0.F) {
+        return 0;
+    }
+
+    *z_max = sqrtf(z_far2);
+    *z_min = z_near2 > 0.F ? sqrtf(z_near2) : 0.F;
+    return 1;
+}
+
+// cells that intersect the bounding box of a ball
+struct grid_box {
+    int32_t x0;
+    int32_t x1;
+    int32_t y0;
+    int32_t y1;
+    int32_t z0;
+    int32_t z1;
+};
+
+static struct grid_box ball_box(const struct twsfwphysx_spatial_index *index,
+                                const struct twsfwphysx_vec r,
+                                const float chord)
+{
+    const int32_t res = index->resolution;
+    const struct grid_box box = {
+        grid_coordinate(r.x - chord, res), grid_coordinate(r.x + chord, res),
+        grid_coordinate(r.y - chord, res), grid_coordinate(r.y + chord, res),
+        grid_coordinate(r.z - chord, res), grid_coordinate(r.z + chord, res),
+    };
+    return box;
+}
+
+// Writes the ranges of objects in the cells (ix, iy, z0) to (ix, iy, z1) that
+// are close to the surface of the sphere to `objects` and returns the number
+// of ranges (at most two).
+static int32_t column_objects(const struct twsfwphysx_spatial_index *index,
+                              const int32_t ix,
+                              const int32_t iy,
+                              const int32_t z0,
+                              const int32_t z1,
+                              int32_t objects[2][2])
+{
+    // only cells close to the surface of the sphere are occupied
+    float z_min;
+    float z_max;
+    if (!column_range(index, ix, iy, &z_min, &z_max)) {
+        return 0;
+    }
+
+    const int32_t res = index->resolution;
+    int32_t ranges[2][2] = {
+        { grid_coordinate(-z_max, res), grid_coordinate(-z_min, res) },
+        { grid_coordinate(z_min, res), grid_coordinate(z_max, res) },
+    };
+    if (ranges[0][1] + 1 >= ranges[1][0]) {
+        ranges[0][1] = ranges[1][1];
+        ranges[1][0] = 1;
+        ranges[1][1] = 0;
+    }
+
+    int32_t n = 0;
+    for (int32_t k = 0; k < 2; k++) {
+        const int32_t begin = ranges[k][0] > z0 ? ranges[k][0] : z0;
+        const int32_t end = ranges[k][1] < z1 ? ranges[k][1] : z1;
+        if (begin <= end) {
+            // the cells of a column are contiguous
+            objects[n][0] = index->cells[grid_cell(index, ix, iy, begin)];
+            objects[n][1] = index->cells[grid_cell(index, ix, iy, end) + 1];
+            n += 1;
+        }
+    }
+
+    return n;
+}
+
+// Finds all objects in the ball of radius `chord` around `r` whose dot product
+// with `r` is at least `threshold`.
+static int32_t query_ball(const struct twsfwphysx_spatial_index *index,
+                          const struct twsfwphysx_vec r,
+                          const float chord,
+                          const float threshold,
+                          int32_t *ids,
+                          const int32_t capacity)
+{
+    const struct grid_box box = ball_box(index, r, chord);
+
+    int32_t n = 0;
+    for (int32_t ix = box.x0; ix <= box.x1; ix++) {
+        for (int32_t iy = box.y0; iy <= box.y1; iy++) {
+            int32_t objects[2][2];
+            const int32_t n_ranges =
+                column_objects(index, ix, iy, box.z0, box.z1, objects);
+
+            for (int32_t k = 0; k < n_ranges; k++) {
+                for (int32_t i = objects[k][0]; i < objects[k][1]; i++) {
+                    const float s = r.x * index->x[i] + r.y * index->y[i] +
+                                    r.z * index->z[i];
+                    if (s >= threshold) {
+                        if (n < capacity) {
+                            ids[n] = index->ids[i];
+                        }
+                        n += 1;
+                    }
+                }
+            }
+        }
+    }
+
+    return n;
+}
+
+// chord length of an angle on the unit sphere
+static float chord_of(const float angle)
+{
+    if (angle >= TWSFWPHYSX_PI) {
+        return 2.F;
+    }
+
+    float sin_x;
+    float cos_x;
+    sincos_f(.5F * angle, &sin_x, &cos_x);
+    return 2.F * sin_x;
+}
+
+int32_t twsfwphysx_query_cap(const struct twsfwphysx_spatial_index *index,
+                             const struct twsfwphysx_vec r,
+                             const float angle,
+                             int32_t *ids,
+                             const int32_t capacity)
+{
+    assert(angle >= 0.F);
+    if (index->size == 0) {
+        return 0;
+    }
+
+    // the margin covers positions that are not perfectly normalized
+    const float chord = chord_of(angle) + 1e-3F;
+    const float threshold = angle >= TWSFWPHYSX_PI ? -2.F : cos_f(angle);
+    return query_ball(index, r, chord, threshold, ids, capacity);
+}
+
+int32_t
+twsfwphysx_query_cap_batch(const struct twsfwphysx_spatial_index *index,
+                           const struct twsfwphysx_vec *r,
+                           const float *angles,
+                           const int32_t n,
+                           int32_t *offsets,
+                           int32_t *ids,
+                           const int32_t capacity)
+{
+    offsets[0] = 0;
+    for (int32_t i = 0; i < n; i++) {
+        const int32_t offset = offsets[i];
+        const int32_t remaining = offset < capacity ? capacity - offset : 0;
+        int32_t *query_ids = remaining > 0 ? ids + offset : ids;
+        offsets[i + 1] =
+            offset + twsfwphysx_query_cap(
+                         index, r[i], angles[i], query_ids, remaining);
+    }
+
+    return offsets[n];
+}
+
+// inserts an object into the list of the k nearest objects (sorted by
+// descending cosines)
+static void insert_nearest(int32_t *ids,
+                           float *cosines,
+                           int32_t *n,
+                           const int32_t k,
+                           const int32_t id,
+                           const float s)
+{
+    if (*n == k && s <= cosines[k - 1]) {
+        return;
+    }
+
+    int32_t i = *n < k ? (*n)++ : k - 1;
+    for (; i > 0 && cosines[i - 1] < s; i--) {
+        ids[i] = ids[i - 1];
+        cosines[i] = cosines[i - 1];
+    }
+    ids[i] = id;
+    cosines[i] = s;
+}
+
+static void nearest_in_cells(const struct twsfwphysx_spatial_index *index,
+                             const struct twsfwphysx_vec r,
+                             const int32_t first_cell,
+                             const int32_t last_cell,
+                             const int32_t k,
+                             int32_t *ids,
+                             float *cosines,
+                             int32_t *n)
+{
+    const int32_t i1 = index->cells[last_cell + 1];
+    for (int32_t i = index->cells[first_cell]; i < i1; i++) {
+        const float s =
+            r.x * index->x[i] + r.y * index->y[i] + r.z * index->z[i];
+        insert_nearest(ids, cosines, n, k, index->ids[i], s);
+    }
+}
+
+int32_t twsfwphysx_query_nearest(const struct twsfwphysx_spatial_index *index,
+                                 const struct twsfwphysx_vec r,
+                                 const int32_t k,
+                                 int32_t *ids,
+                                 float *cosines)
+{
+    assert(k >= 0);
+    if (k == 0 || index->size == 0) {
+        return 0;
+    }
+
+    const int32_t res = index->resolution;
+    const float h = 2.F / (float)res;
+    const int32_t cx = grid_coordinate(r.x, res);
+    const int32_t cy = grid_coordinate(r.y, res);
+    const int32_t cz = grid_coordinate(r.z, res);
+
+    // Searches shells of cells with increasing Chebyshev distance `d` to the
+    // cell of `r`. Objects outside of the shells 0 to `d` are at least `d * h`
+    // away from `r`.
+    int32_t n = 0;
+    for (int32_t d = 0; d < res; d++) {
+        const int32_t x0 = cx - d > 0 ? cx - d : 0;
+        const int32_t x1 = cx + d < res - 1 ? cx + d : res - 1;
+        const int32_t y0 = cy - d > 0 ? cy - d : 0;
+        const int32_t y1 = cy + d < res - 1 ? cy + d : res - 1;
+        const int32_t z0 = cz - d > 0 ? cz - d : 0;
+        const int32_t z1 = cz + d < res - 1 ? cz + d : res - 1;
+
+        for (int32_t ix = x0; ix <= x1; ix++) {
+            for (int32_t iy = y0; iy <= y1; iy++) {
+                const int on_shell = ix == cx - d || ix == cx + d ||
+                                     iy == cy - d || iy == cy + d;
+                if (on_shell) {
+                    nearest_in_cells(index,
+                                     r,
+                                     grid_cell(index, ix, iy, z0),
+                                     grid_cell(index, ix, iy, z1),
+                                     k,
+                                     ids,
+                                     cosines,
+                                     &n);
+                    continue;
+                }
+
+                if (cz - d >= 0) {
+                    const int32_t c = grid_cell(index, ix, iy, cz - d);
+                    nearest_in_cells(index, r, c, c, k, ids, cosines, &n);
+                }
+                if (cz + d < res) {
+                    const int32_t c = grid_cell(index, ix, iy, cz + d);
+                    nearest_in_cells(index, r, c, c, k, ids, cosines, &n);
+                }
+            }
+        }
+
+        const float chord = (float)d * h;
+        if (n == k && 2.F - 2.F * cosines[k - 1] <= chord * chord) {
+            break;
+        }
+    }
+
+    return n;
+}
+
+void twsfwphysx_query_nearest_batch(
+    const struct twsfwphysx_spatial_index *index,
+    const struct twsfwphysx_vec *r,
+    const int32_t n,
+    const int32_t k,
+    int32_t *ids,
+    float *cosines)
+{
+    for (int32_t i = 0; i < n; i++) {
+        int32_t *query_ids = ids + (int64_t)i * k;
+        float *query_cosines = cosines + (int64_t)i * k;
+
+        const int32_t n_found = twsfwphysx_query_nearest(
+            index, r[i], k, query_ids, query_cosines);
+        for (int32_t j = n_found; j < k; j++) {
+            query_ids[j] = -1;
+            query_cosines[j] = -2.F;
+        }
+    }
+}
+
+// Arc length at which the ray (r, w = u x r) first touches the cap of angular
+// radius acos(cos_rho) around c; returns -1 if it never does.
+static float first_contact(const struct twsfwphysx_vec r,
+                           const struct twsfwphysx_vec w,
+                           const struct twsfwphysx_vec c,
+                           const float cos_rho)
+{
+    // dot(c, r(phi)) = a * cos(phi) + b * sin(phi) = R * cos(phi - phi0)
+    const float a = dot(c, r);
+    const float b = dot(c, w);
+    const float R = sqrtf(a * a + b * b);
+    if (R <= cos_rho) {
+        return -1.F;
+    }
+    if (-R >= cos_rho) {
+        return 0.F;
+    }
+
+    const float delta = acos_f(cos_rho / R);
+    float phi0 = atan2_f(b, a);
+    if (fabsf(phi0) <= delta) {
+        return 0.F;
+    }
+    if (phi0 < 0.F) {
+        phi0 += 2.F * TWSFWPHYSX_PI;
+    }
+
+    return phi0 - delta;
+}
+
+static struct twsfwphysx_ray_hit
+cast_ray(const struct twsfwphysx_spatial_index *index,
+         const struct twsfwphysx_ray *ray,
+         const float rho)
+{
+    const float length =
+        ray->length < 2.F * TWSFWPHYSX_PI ? ray->length : 2.F * TWSFWPHYSX_PI;
+    const float cos_rho = cos_f(rho);
+    const struct twsfwphysx_vec w = cross(ray->u, ray->r);
+
+    // The arc is split into segments of about the size of a cell. A ball
+    // around the center of a segment covers all caps touching the segment.
+    const float cell = 2.F / (float)index->resolution;
+    int32_t n_segments = (int32_t)ceilf(length / cell);
+    if (n_segments < 1) {
+        n_segments = 1;
+    }
+    const float step = length / (float)n_segments;
+    const float chord = chord_of(.5F * step + rho) + 1e-3F;
+
+    struct twsfwphysx_ray_hit hit = { -1, length };
+    for (int32_t s = 0; s < n_segments; s++) {
+        // contacts in earlier segments are final
+        const float begin = (float)s * step;
+        if (hit.agent >= 0 && hit.angle <= begin) {
+            break;
+        }
+
+        float sin_phi;
+        float cos_phi;
+        sincos_f(begin + .5F * step, &sin_phi, &cos_phi);
+        const struct twsfwphysx_vec center = {
+            cos_phi * ray->r.x + sin_phi * w.x,
+            cos_phi * ray->r.y + sin_phi * w.y,
+            cos_phi * ray->r.z + sin_phi * w.z,
+        };
+
+        const struct grid_box box = ball_box(index, center, chord);
+        for (int32_t ix = box.x0; ix <= box.x1; ix++) {
+            for (int32_t iy = box.y0; iy <= box.y1; iy++) {
+                int32_t objects[2][2];
+                const int32_t n_ranges =
+                    column_objects(index, ix, iy, box.z0, box.z1, objects);
+
+                for (int32_t k = 0; k < n_ranges; k++) {
+                    for (int32_t i = objects[k][0]; i < objects[k][1]; i++) {
+                        if (index->ids[i] == ray->ignore) {
+                            continue;
+                        }
+
+                        const struct twsfwphysx_vec c = { index->x[i],
+                                                          index->y[i],
+                                                          index->z[i] };
+                        const float phi = first_contact(ray->r, w, c, cos_rho);
+                        if (phi >= 0.F && phi <= hit.angle &&
+                            (hit.agent < 0 || phi < hit.angle)) {
+                            hit.agent = index->ids[i];
+                            hit.angle = phi;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    return hit;
+}
+
+int32_t twsfwphysx_cast_rays(const struct twsfwphysx_spatial_index *index,
+                             const struct twsfwphysx_world *world,
+                             const struct twsfwphysx_ray *rays,
+                             const int32_t n,
+                             struct twsfwphysx_ray_hit *hits)
+{
+    int32_t n_hits = 0;
+    for (int32_t i = 0; i < n; i++) {
+        if (index->size == 0) {
+            const struct twsfwphysx_ray_hit miss = { -1, rays[i].length };
+            hits[i] = miss;
+            continue;
+        }
+
+        hits[i] = cast_ray(index, &rays[i], world->agent_radius);
+        n_hits += hits[i].agent >= 0;
+    }
+
+    return n_hits;
+}
+
+#define TWSFWPHYSX_MAX_SLABS 256
+
+// closed-form motion of an agent or missile
+struct motion {
+    struct twsfwphysx_vec r;
+    struct twsfwphysx_vec u;
+    float v;
+    float a;
+};
+
+static struct motion agent_motion(const struct twsfwphysx_agent *agent)
+{
+    const struct motion m = { agent->r, agent->u, agent->v, agent->a };
+    return m;
+}
+
+static struct motion missile_motion(const struct twsfwphysx_missile *missile,
+                                    const struct twsfwphysx_world *world)
+{
+    const struct motion m = {
+        missile->r, missile->u, missile->v, world->missile_acceleration
+    };
+    return m;
+}
+
+// same as propagate for a single step of length t
+static struct twsfwphysx_vec position_at(const struct motion *m, const float t)
+{
+    struct twsfwphysx_vec r = m->r;
+    rotate(&r, m->u, (m->a * t) - ((m->v - m->a) * expm1_f(-t)));
+    return r;
+}
+
+// the velocity relaxes monotonically from v to a
+static float max_speed(const struct motion *m)
+{
+    return fmaxf(fabsf(m->v), fabsf(m->a));
+}
+
+#define TWSFWPHYSX_MAX_ADVANCEMENTS 256
+
+// Conservative advancement: Both objects approach each other by at most
+// `speed * dt` within dt, hence, the time until the angular distance D drops
+// below `angle` is at least (D - angle) / speed. Steps are at least
+// `1e-5 / speed` long, which bounds the error of the time of contact and lets
+// objects that touch but separate escape. Returns -1 if there is no contact
+// within [t0, t1].
+static float time_of_contact(const struct motion *m1,
+                             const struct motion *m2,
+                             const float angle,
+                             const float t0,
+                             const float t1)
+{
+    const float speed = max_speed(m1) + max_speed(m2);
+
+    float t = t0;
+    for (int32_t i = 0; i < TWSFWPHYSX_MAX_ADVANCEMENTS && t <= t1; i++) {
+        // accurate (unlike acos of the dot product) for small angles
+        const struct twsfwphysx_vec p = position_at(m1, t);
+        const struct twsfwphysx_vec q = position_at(m2, t);
+        const struct twsfwphysx_vec d = { p.x - q.x, p.y - q.y, p.z - q.z };
+        const struct twsfwphysx_vec s = { p.x + q.x, p.y + q.y, p.z + q.z };
+        const float distance =
+            2.F * atan2_f(vec_length(d), vec_length(s)) - angle;
+        if (distance < 0.F) {
+            return t;
+        }
+        if (speed <= 0.F) {
+            break;
+        }
+
+        t += fmaxf(distance, 1e-5F) / speed;
+    }
+
+    return -1.F;
+}
+
+#undef TWSFWPHYSX_MAX_ADVANCEMENTS
+
+// indexes all living agents at their positions at time t
+static void index_agents_at(struct twsfwphysx_spatial_index *index,
+                            const struct twsfwphysx_agents *agents,
+                            const float t)
+{
+    int32_t n = 0;
+    for (int32_t i = 0; i < agents->size; i++) {
+        n += agents->agents[i].hp > 0.F;
+    }
+
+    reserve_index(index, n);
+    for (int32_t i = 0; i < agents->size; i++) {
+        if (agents->agents[i].hp > 0.F) {
+            const struct motion m = agent_motion(&agents->agents[i]);
+            add_to_index(index, position_at(&m, t), i);
+        }
+    }
+    sort_index(index);
+}
+
+// first contact of `m` with any agent in the index within [t0, t1]
+static struct twsfwphysx_impact
+first_contact_in_slab(const struct twsfwphysx_spatial_index *index,
+                      const struct twsfwphysx_agents *agents,
+                      const struct motion *m,
+                      const int32_t ignore,
+                      const float chord,
+                      const float angle,
+                      const float t0,
+                      const float t1)
+{
+    const struct grid_box box =
+        ball_box(index, position_at(m, .5F * (t0 + t1)), chord);
+
+    struct twsfwphysx_impact impact = { -1, t1 };
+    for (int32_t ix = box.x0; ix <= box.x1; ix++) {
+        for (int32_t iy = box.y0; iy <= box.y1; iy++) {
+            int32_t objects[2][2];
+            const int32_t n_ranges =
+                column_objects(index, ix, iy, box.z0, box.z1, objects);
+
+            for (int32_t k = 0; k < n_ranges; k++) {
+                for (int32_t i = objects[k][0]; i < objects[k][1]; i++) {
+                    const int32_t id = index->ids[i];
+                    if (id == ignore) {
+                        continue;
+                    }
+
+                    const struct motion target =
+                        agent_motion(&agents->agents[id]);
+                    const float t =
+                        time_of_contact(m, &target, angle, t0, impact.t);
+                    if (t >= 0.F && (impact.target < 0 || t < impact.t)) {
+                        impact.target = id;
+                        impact.t = t;
+                    }
+                }
+            }
+        }
+    }
+
+    return impact;
+}
+
+// Predicts the first contacts of missiles (or agents if `missiles` is NULL)
+// with agents.
+static int32_t predict_contacts(const struct twsfwphysx_agents *agents,
+                                const struct twsfwphysx_missiles *missiles,
+                                const struct twsfwphysx_world *world,
+                                const float horizon,
+                                struct twsfwphysx_spatial_index *index,
+                                struct twsfwphysx_impact *impacts)
+{
+    assert(horizon >= 0.F);
+
+    const int32_t n = missiles != NULL ? missiles->size : agents->size;
+    const float angle = missiles != NULL ? world->agent_radius :
+                                           2.F * world->agent_radius;
+
+    int32_t n_living = 0;
+    float agent_speed = 0.F;
+    for (int32_t i = 0; i < agents->size; i++) {
+        if (agents->agents[i].hp > 0.F) {
+            const struct motion m = agent_motion(&agents->agents[i]);
+            agent_speed = fmaxf(agent_speed, max_speed(&m));
+            n_living += 1;
+        }
+    }
+
+    float speed = agent_speed;
+    for (int32_t i = 0; i < n; i++) {
+        const struct motion m =
+            missiles != NULL ? missile_motion(&missiles->missiles[i], world) :
+                               agent_motion(&agents->agents[i]);
+        speed = fmaxf(speed, max_speed(&m));
+
+        const struct twsfwphysx_impact none = { -1, horizon };
+        impacts[i] = none;
+    }
+
+    // Within a slab, objects move by about one cell of the index.
+    const float cell = 2.F / (float)index_resolution(n_living);
+    int32_t n_slabs = TWSFWPHYSX_MAX_SLABS;
+    if (horizon * 2.F * speed < cell * (float)TWSFWPHYSX_MAX_SLABS) {
+        n_slabs = (int32_t)ceilf(horizon * 2.F * speed / cell);
+    }
+    if (n_slabs < 1) {
+        n_slabs = 1;
+    }
+    const float slab = horizon / (float)n_slabs;
+
+    int32_t n_impacts = 0;
+    for (int32_t s = 0; s < n_slabs && n_living > 0; s++) {
+        const float t0 = (float)s * slab;
+        const float t1 = s == n_slabs - 1 ? horizon : t0 + slab;
+        index_agents_at(index, agents, .5F * (t0 + t1));
+
+        for (int32_t i = 0; i < n; i++) {
+            // contacts in earlier slabs are final
+            if (impacts[i].target >= 0) {
+                continue;
+            }
+
+            struct motion m;
+            if (missiles != NULL) {
+                m = missile_motion(&missiles->missiles[i], world);
+            }
+            else if (agents->agents[i].hp > 0.F) {
+                m = agent_motion(&agents->agents[i]);
+            }
+            else {
+                continue;
+            }
+
+            // a ball that contains all agents that touch `m` within the slab
+            const float reach =
+                .5F * (t1 - t0) * (max_speed(&m) + agent_speed) + angle;
+            const float chord = chord_of(reach) + 1e-3F;
+
+            const struct twsfwphysx_impact impact =
+                first_contact_in_slab(index,
+                                      agents,
+                                      &m,
+                                      missiles != NULL ? -1 : i,
+                                      chord,
+                                      angle,
+                                      t0,
+                                      t1);
+            if (impact.target >= 0) {
+                impacts[i] = impact;
+                n_impacts += 1;
+            }
+        }
+    }
+
+    return n_impacts;
+}
+
+int32_t
+twsfwphysx_predict_missile_impacts(const struct twsfwphysx_agents *agents,
+                                   const struct twsfwphysx_missiles *missiles,
+                                   const struct twsfwphysx_world *world,
+                                   const float horizon,
+                                   struct twsfwphysx_spatial_index *index,
+                                   struct twsfwphysx_impact *impacts)
+{
+    return predict_contacts(agents, missiles, world, horizon, index, impacts);
+}
+
+int32_t twsfwphysx_predict_collisions(const struct twsfwphysx_agents *agents,
+                                      const struct twsfwphysx_world *world,
+                                      const float horizon,
+                                      struct twsfwphysx_spatial_index *index,
+                                      struct twsfwphysx_impact *impacts)
+{
+    return predict_contacts(agents, NULL, world, horizon, index, impacts);
+}
+
+#undef TWSFWPHYSX_MAX_SLABS
+
+#undef TWSFWPHYSX_INDEX_MAX_RESOLUTION
+#undef TWSFWPHYSX_PI
+
+#ifdef TWSFWPHYSX_ASYNC
+
+#ifdef _WIN32
+typedef CRITICAL_SECTION twsfwphysx_mutex;
+typedef CONDITION_VARIABLE twsfwphysx_cond;
+typedef HANDLE twsfwphysx_thread;
+#else
+typedef pthread_mutex_t twsfwphysx_mutex;
+typedef pthread_cond_t twsfwphysx_cond;
+typedef pthread_t twsfwphysx_thread;
+#endif
+
+struct twsfwphysx_pipeline {
+    struct twsfwphysx_pipeline_state states[3];
+    struct twsfwphysx_pipeline_state *front;
+    struct twsfwphysx_pipeline_state *back;
+    struct twsfwphysx_pipeline_state *staging;
+
+    struct twsfwphysx_world world;
+    struct twsfwphysx_simulation_buffer *buffer;
+    float t;
+    int32_t n_steps;
+
+    int busy;
+    int quit;
+    twsfwphysx_mutex mutex;
+    twsfwphysx_cond cond;
+    twsfwphysx_thread thread;
+};
+
+static void mutex_lock(twsfwphysx_mutex *mutex)
+{
+#ifdef _WIN32
+    EnterCriticalSection(mutex);
+#else
+    pthread_mutex_lock(mutex);
+#endif
+}
+
+static void mutex_unlock(twsfwphysx_mutex *mutex)
+{
+#ifdef _WIN32
+    LeaveCriticalSection(mutex);
+#else
+    pthread_mutex_unlock(mutex);
+#endif
+}
+
+static void cond_wait(twsfwphysx_cond *cond, twsfwphysx_mutex *mutex)
+{
+#ifdef _WIN32
+    SleepConditionVariableCS(cond, mutex, INFINITE);
+#else
+    pthread_cond_wait(cond, mutex);
+#endif
+}
+
+static void cond_notify(twsfwphysx_cond *cond)
+{
+#ifdef _WIN32
+    WakeAllConditionVariable(cond);
+#else
+    pthread_cond_broadcast(cond);
+#endif
+}
+
+static void pipeline_work(struct twsfwphysx_pipeline *pipeline)
+{
+    mutex_lock(&pipeline->mutex);
+    for (;;) {
+        while (pipeline->busy == 0 && pipeline->quit == 0) {
+            cond_wait(&pipeline->cond, &pipeline->mutex);
+        }
+        if (pipeline->busy == 0) {
+            break;
+        }
+        mutex_unlock(&pipeline->mutex);
+
+        twsfwphysx_simulate(&pipeline->back->agents,
+                            &pipeline->back->missiles,
+                            &pipeline->world,
+                            pipeline->t,
+                            pipeline->n_steps,
+                            pipeline->buffer);
+
+        mutex_lock(&pipeline->mutex);
+        pipeline->busy = 0;
+        cond_notify(&pipeline->cond);
+    }
+    mutex_unlock(&pipeline->mutex);
+}
+
+#ifdef _WIN32
+static DWORD WINAPI pipeline_main(LPVOID pipeline)
+{
+    pipeline_work((struct twsfwphysx_pipeline *)pipeline);
+    return 0;
+}
+#else
+static void *pipeline_main(void *pipeline)
+{
+    pipeline_work((struct twsfwphysx_pipeline *)pipeline);
+    return NULL;
+}
+#endif
+
+struct twsfwphysx_pipeline *
+twsfwphysx_create_pipeline(const struct twsfwphysx_agents *agents,
+                           const struct twsfwphysx_missiles *missiles,
+                           const struct twsfwphysx_world *world)
+{
+    struct twsfwphysx_pipeline *pipeline =
+        (struct twsfwphysx_pipeline *)malloc(
+            sizeof(struct twsfwphysx_pipeline));
+    assert(pipeline != NULL);
+
+    for (int32_t i = 0; i < 3; i++) {
+        struct twsfwphysx_pipeline_state *state = &pipeline->states[i];
+        state->agents = twsfwphysx_create_agents(0);
+        state->missiles = twsfwphysx_new_missile_batch();
+        if (i < 2) {
+            assign_agents(&state->agents, agents->agents, agents->size);
+            assign_missiles(
+                &state->missiles, missiles->missiles, missiles->size);
+        }
+    }
+    pipeline->front = &pipeline->states[0];
+    pipeline->staging = &pipeline->states[1];
+    pipeline->back = &pipeline->states[2];
+
+    pipeline->world = *world;
+    pipeline->buffer = twsfwphysx_create_simulation_buffer();
+    pipeline->t = 0.F;
+    pipeline->n_steps = 0;
+    pipeline->busy = 0;
+    pipeline->quit = 0;
+
+#ifdef _WIN32
+    InitializeCriticalSection(&pipeline->mutex);
+    InitializeConditionVariable(&pipeline->cond);
+    pipeline->thread = CreateThread(NULL, 0, pipeline_main, pipeline, 0, NULL);
+    assert(pipeline->thread != NULL);
+#else
+    pthread_mutex_init(&pipeline->mutex, NULL);
+    pthread_cond_init(&pipeline->cond, NULL);
+    const int error =
+        pthread_create(&pipeline->thread, NULL, pipeline_main, pipeline);
+    assert(error == 0);
+    (void)error;
+#endif
+
+    return pipeline;
+}
+
+void twsfwphysx_delete_pipeline(struct twsfwphysx_pipeline *pipeline)
+{
+    if (pipeline == NULL) {
+        return;
+    }
+
+    mutex_lock(&pipeline->mutex);
+    pipeline->quit = 1;
+    cond_notify(&pipeline->cond);
+    mutex_unlock(&pipeline->mutex);
+
+#ifdef _WIN32
+    WaitForSingleObject(pipeline->thread, INFINITE);
+    CloseHandle(pipeline->thread);
+    DeleteCriticalSection(&pipeline->mutex);
+#else
+    pthread_join(pipeline->thread, NULL);
+    pthread_cond_destroy(&pipeline->cond);
+    pthread_mutex_destroy(&pipeline->mutex);
+#endif
+
+    for (int32_t i = 0; i < 3; i++) {
+        twsfwphysx_delete_agents(&pipeline->states[i].agents);
+        twsfwphysx_delete_missile_batch(&pipeline->states[i].missiles);
+    }
+    twsfwphysx_delete_simulation_buffer(pipeline->buffer);
+    free(pipeline);
+}
+
+const struct twsfwphysx_pipeline_state *
+twsfwphysx_pipeline_front(const struct twsfwphysx_pipeline *pipeline)
+{
+    return pipeline->front;
+}
 
-        // NOLINTNEXTLINE(bugprone-suspicious-realloc-usage)
-        missiles->missiles = (struct twsfwphysx_missile *)realloc(
-            missiles->missiles,
-            (uint64_t)missiles->capacity * sizeof(struct twsfwphysx_missile));
-        assert(missiles->missiles != NULL);
+struct twsfwphysx_pipeline_state *
+twsfwphysx_pipeline_staging(struct twsfwphysx_pipeline *pipeline)
+{
+    return pipeline->staging;
+}
+
+struct twsfwphysx_simulation_buffer *
+twsfwphysx_pipeline_simulation_buffer(struct twsfwphysx_pipeline *pipeline)
+{
+    return pipeline->buffer;
+}
+
+void twsfwphysx_simulate_begin(struct twsfwphysx_pipeline *pipeline,
+                               const float t,
+                               const int32_t n_steps)
+{
+    mutex_lock(&pipeline->mutex);
+    assert(pipeline->busy == 0);
+
+    struct twsfwphysx_pipeline_state *tmp = pipeline->back;
+    pipeline->back = pipeline->staging;
+    pipeline->staging = tmp;
+
+    pipeline->t = t;
+    pipeline->n_steps = n_steps;
+    pipeline->busy = 1;
+    cond_notify(&pipeline->cond);
+    mutex_unlock(&pipeline->mutex);
+}
+
+void twsfwphysx_simulate_end(struct twsfwphysx_pipeline *pipeline)
+{
+    mutex_lock(&pipeline->mutex);
+    while (pipeline->busy != 0) {
+        cond_wait(&pipeline->cond, &pipeline->mutex);
     }
+    mutex_unlock(&pipeline->mutex);
 
-    missiles->missiles[missiles->size++] = missile;
+    struct twsfwphysx_pipeline_state *tmp = pipeline->front;
+    pipeline->front = pipeline->back;
+    pipeline->back = tmp;
+
+    assign_agents(&pipeline->staging->agents,
+                  pipeline->front->agents.agents,
+                  pipeline->front->agents.size);
+    assign_missiles(&pipeline->staging->missiles,
+                    pipeline->front->missiles.missiles,
+                    pipeline->front->missiles.size);
 }
 
-static float vec_length(const struct twsfwphysx_vec v)
+struct thread_pool_worker {
+    struct twsfwphysx_thread_pool *pool;
+    int32_t index;
+    twsfwphysx_thread thread;
+};
+
+struct twsfwphysx_thread_pool {
+    int32_t n_threads;
+    struct thread_pool_worker *workers; // n_threads - 1 workers
+
+    thread_pool_task task;
+    void *context;
+    uint64_t generation; // incremented for every task
+    int32_t busy; // number of workers still running the task
+    int quit;
+    twsfwphysx_mutex mutex;
+    twsfwphysx_cond cond;
+};
+
+static void thread_pool_work(struct thread_pool_worker *worker)
 {
-    return sqrtf((v.x * v.x) + (v.y * v.y) + (v.z * v.z));
+    struct twsfwphysx_thread_pool *pool = worker->pool;
+
+    uint64_t generation = 0; // i.e., the first task has not been seen yet
+    mutex_lock(&pool->mutex);
+    for (;;) {
+        while (pool->generation == generation && pool->quit == 0) {
+            cond_wait(&pool->cond, &pool->mutex);
+        }
+        if (pool->generation == generation) {
+            break;
+        }
+        generation = pool->generation;
+        mutex_unlock(&pool->mutex);
+
+        pool->task(pool->context, worker->index, pool->n_threads);
+
+        mutex_lock(&pool->mutex);
+        pool->busy -= 1;
+        if (pool->busy == 0) {
+            cond_notify(&pool->cond);
+        }
+    }
+    mutex_unlock(&pool->mutex);
+}
+
+#ifdef _WIN32
+static DWORD WINAPI thread_pool_main(LPVOID worker)
+{
+    thread_pool_work((struct thread_pool_worker *)worker);
+    return 0;
+}
+#else
+static void *thread_pool_main(void *worker)
+{
+    thread_pool_work((struct thread_pool_worker *)worker);
+    return NULL;
+}
+#endif
+
+struct twsfwphysx_thread_pool *
+twsfwphysx_create_thread_pool(const int32_t n_threads)
+{
+    assert(n_threads > 0);
+
+    struct twsfwphysx_thread_pool *pool =
+        (struct twsfwphysx_thread_pool *)malloc(
+            sizeof(struct twsfwphysx_thread_pool));
+    assert(pool != NULL);
+
+    pool->n_threads = n_threads;
+    pool->workers = NULL;
+    pool->task = NULL;
+    pool->context = NULL;
+    pool->generation = 0;
+    pool->busy = 0;
+    pool->quit = 0;
+
+#ifdef _WIN32
+    InitializeCriticalSection(&pool->mutex);
+    InitializeConditionVariable(&pool->cond);
+#else
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->cond, NULL);
+#endif
+
+    if (n_threads > 1) {
+        pool->workers = (struct thread_pool_worker *)malloc(
+            (size_t)(n_threads - 1) * sizeof(struct thread_pool_worker));
+        assert(pool->workers != NULL);
+    }
+    for (int32_t i = 0; i < n_threads - 1; i++) {
+        struct thread_pool_worker *worker = &pool->workers[i];
+        worker->pool = pool;
+        worker->index = i + 1; // the calling thread has index 0
+#ifdef _WIN32
+        worker->thread =
+            CreateThread(NULL, 0, thread_pool_main, worker, 0, NULL);
+        assert(worker->thread != NULL);
+#else
+        const int error =
+            pthread_create(&worker->thread, NULL, thread_pool_main, worker);
+        assert(error == 0);
+        (void)error;
+#endif
+    }
+
+    return pool;
+}
+
+void twsfwphysx_delete_thread_pool(struct twsfwphysx_thread_pool *pool)
+{
+    if (pool == NULL) {
+        return;
+    }
+
+    mutex_lock(&pool->mutex);
+    pool->quit = 1;
+    cond_notify(&pool->cond);
+    mutex_unlock(&pool->mutex);
+
+    for (int32_t i = 0; i < pool->n_threads - 1; i++) {
+#ifdef _WIN32
+        WaitForSingleObject(pool->workers[i].thread, INFINITE);
+        CloseHandle(pool->workers[i].thread);
+#else
+        pthread_join(pool->workers[i].thread, NULL);
+#endif
+    }
+
+#ifdef _WIN32
+    DeleteCriticalSection(&pool->mutex);
+#else
+    pthread_cond_destroy(&pool->cond);
+    pthread_mutex_destroy(&pool->mutex);
+#endif
+    free(pool->workers);
+    free(pool);
+}
+
+void twsfwphysx_set_thread_pool(struct twsfwphysx_simulation_buffer *buffer,
+                                struct twsfwphysx_thread_pool *pool)
+{
+    buffer->pool = pool;
+}
+
+static int32_t thread_pool_size(const struct twsfwphysx_thread_pool *pool)
+{
+    return pool->n_threads;
+}
+
+static void thread_pool_run(struct twsfwphysx_thread_pool *pool,
+                            const thread_pool_task task,
+                            void *context)
+{
+    mutex_lock(&pool->mutex);
+    assert(pool->busy == 0);
+    pool->task = task;
+    pool->context = context;
+    pool->generation += 1;
+    pool->busy = pool->n_threads - 1;
+    cond_notify(&pool->cond);
+    mutex_unlock(&pool->mutex);
+
+    task(context, 0, pool->n_threads);
+
+    mutex_lock(&pool->mutex);
+    while (pool->busy != 0) {
+        cond_wait(&pool->cond, &pool->mutex);
+    }
+    mutex_unlock(&pool->mutex);
+}
+
+#undef TWSFWPHYSX_PARALLEL_MIN_SIZE
+
+#endif
+
+#ifdef TWSFWPHYSX_TRACE
+
+int32_t twsfwphysx_write_trace(FILE *file)
+{
+    int32_t n_events = 0;
+    fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+
+    const struct trace_ring *ring = atomic_load(&trace_rings);
+    for (; ring != NULL; ring = ring->next) {
+        const uint_fast64_t size =
+            atomic_load_explicit(&ring->size, memory_order_acquire);
+        const uint_fast64_t begin = size > TWSFWPHYSX_TRACE_CAPACITY ?
+                                        size - TWSFWPHYSX_TRACE_CAPACITY :
+                                        0;
+
+        for (uint_fast64_t i = begin; i < size; i++) {
+            const struct trace_record *record =
+                &ring->records[i % TWSFWPHYSX_TRACE_CAPACITY];
+
+            // timestamps are given in microseconds
+            fprintf(file,
+                    "%s\n{\"name\":\"%s\",\"ph\":\"%c\",\"pid\":1,"
+                    "\"tid\":%d,\"ts\":%llu.%03llu}",
+                    n_events > 0 ? "," : "",
+                    record->name,
+                    record->phase,
+                    ring->thread,
+                    (unsigned long long)(record->ns / 1000U),
+                    (unsigned long long)(record->ns % 1000U));
+            n_events += 1;
+        }
+    }
+
+    fprintf(file, "\n]}\n");
+    return n_events;
+}
+
+void twsfwphysx_clear_trace(void)
+{
+    struct trace_ring *ring = atomic_load(&trace_rings);
+    for (; ring != NULL; ring = ring->next) {
+        atomic_store(&ring->size, 0);
+    }
+}
+
+#endif
+
+#ifdef TWSFWPHYSX_MMAP
+
+struct mapped_file {
+    unsigned char *data;
+    uint64_t size;
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#endif
+};
+
+// Sections of world files and shared regions are aligned to cache lines.
+#define TWSFWPHYSX_MMAP_ALIGNMENT 64U
+
+static uint64_t mmap_align(const uint64_t offset)
+{
+    const uint64_t alignment = TWSFWPHYSX_MMAP_ALIGNMENT;
+    return (offset + alignment - 1) / alignment * alignment;
+}
+
+enum mapped_file_mode {
+    MAPPED_FILE_READ, // read-only
+    MAPPED_FILE_COPY, // writable but private to the process (copy-on-write)
+    MAPPED_FILE_CREATE, // (re)creates a file of a given size that is writable
+};
+
+static int map_file(struct mapped_file *map,
+                    const char *path,
+                    const enum mapped_file_mode mode,
+                    const uint64_t size)
+{
+#ifdef _WIN32
+    map->file = CreateFileA(
+        path,
+        mode == MAPPED_FILE_CREATE ? GENERIC_READ | GENERIC_WRITE :
+                                     GENERIC_READ,
+        FILE_SHARE_READ | FILE_SHARE_WRITE,
+        NULL,
+        mode == MAPPED_FILE_CREATE ? CREATE_ALWAYS : OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL,
+        NULL);
+    if (map->file == INVALID_HANDLE_VALUE) {
+        return 0;
+    }
+
+    LARGE_INTEGER file_size;
+    file_size.QuadPart = (LONGLONG)size;
+    if (mode != MAPPED_FILE_CREATE &&
+        (!GetFileSizeEx(map->file, &file_size) || file_size.QuadPart <= 0)) {
+        CloseHandle(map->file);
+        return 0;
+    }
+    map->size = (uint64_t)file_size.QuadPart;
+
+    const DWORD protection[] = { PAGE_READONLY,
+                                 PAGE_WRITECOPY,
+                                 PAGE_READWRITE };
+    map->mapping = CreateFileMappingA(map->file,
+                                      NULL,
+                                      protection[mode],
+                                      (DWORD)(map->size >> 32U),
+                                      (DWORD)(map->size & 0xFFFFFFFFU),
+                                      NULL);
+    if (map->mapping == NULL) {
+        CloseHandle(map->file);
+        return 0;
+    }
+
+    const DWORD access[] = { FILE_MAP_READ, FILE_MAP_COPY, FILE_MAP_WRITE };
+    map->data = (unsigned char *)MapViewOfFile(
+        map->mapping, access[mode], 0, 0, 0);
+    if (map->data == NULL) {
+        CloseHandle(map->mapping);
+        CloseHandle(map->file);
+        return 0;
+    }
+#else
+    const int fd = mode == MAPPED_FILE_CREATE ?
+                       open(path, O_RDWR | O_CREAT | O_TRUNC, 0644) :
+                       open(path, O_RDONLY);
+    if (fd < 0) {
+        return 0;
+    }
+
+    if (mode == MAPPED_FILE_CREATE) {
+        // grows the file to `size` bytes (which read back as zeros)
+        if (size == 0 || lseek(fd, (off_t)(size - 1), SEEK_SET) < 0 ||
+            write(fd, "", 1) != 1) {
+            close(fd);
+            return 0;
+        }
+        map->size = size;
+    } else {
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+            close(fd);
+            return 0;
+        }
+        map->size = (uint64_t)st.st_size;
+    }
+
+    void *data = mmap(NULL,
+                      (size_t)map->size,
+                      mode == MAPPED_FILE_READ ? PROT_READ :
+                                                 PROT_READ | PROT_WRITE,
+                      mode == MAPPED_FILE_COPY ? MAP_PRIVATE : MAP_SHARED,
+                      fd,
+                      0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return 0;
+    }
+    map->data = (unsigned char *)data;
+#endif
+
+    return 1;
+}
+
+static void unmap_file(struct mapped_file *map)
+{
+#ifdef _WIN32
+    UnmapViewOfFile(map->data);
+    CloseHandle(map->mapping);
+    CloseHandle(map->file);
+#else
+    munmap(map->data, (size_t)map->size);
+#endif
+    map->data = NULL;
+    map->size = 0;
+}
+
+// Replay files start with a header (magic, version, keyframe interval, world
+// and four reserved bytes) that is followed by one record per tick. Tick 0 is
+// a keyframe. Every later tick is a delta which is followed by a keyframe of
+// the resulting state if the tick is a multiple of the keyframe interval:
+//
+//   keyframe: 'K', n_agents, agents, n_missiles, missiles
+//   delta:    'D', t, n_steps, n_agents, n_changed,
+//             n_changed * (index, field mask, changed fields),
+//             n_kept, n_new, n_new * missiles
+//
+// The missiles of a delta are the first n_kept missiles of the previous tick
+// followed by n_new new missiles. The file ends with the offsets of all
+// keyframes and a footer (offset of the index, n_ticks, n_keyframes, magic).
+#define TWSFWPHYSX_REPLAY_VERSION 1U
+#define TWSFWPHYSX_REPLAY_HEADER_SIZE 32U
+#define TWSFWPHYSX_REPLAY_FOOTER_SIZE 24U
+
+static const struct {
+    uint64_t offset;
+    uint64_t size;
+} replay_agent_fields[] = {
+    { offsetof(struct twsfwphysx_agent, r), sizeof(struct twsfwphysx_vec) },
+    { offsetof(struct twsfwphysx_agent, u), sizeof(struct twsfwphysx_vec) },
+    { offsetof(struct twsfwphysx_agent, v), sizeof(float) },
+    { offsetof(struct twsfwphysx_agent, a), sizeof(float) },
+    { offsetof(struct twsfwphysx_agent, hp), sizeof(float) },
+};
+
+#define TWSFWPHYSX_REPLAY_N_FIELDS \
+    (int32_t)(sizeof(replay_agent_fields) / sizeof(replay_agent_fields[0]))
+
+struct twsfwphysx_recorder {
+    FILE *file;
+    uint64_t offset;
+    int ok;
+
+    struct twsfwphysx_world world;
+    int32_t keyframe_interval;
+    int32_t n_ticks;
+
+    // state after the last recorded tick
+    struct twsfwphysx_agents agents;
+    struct twsfwphysx_missiles missiles;
+
+    uint64_t *keyframes;
+    int32_t n_keyframes;
+};
+
+static void record_bytes(struct twsfwphysx_recorder *recorder,
+                         const void *data,
+                         const uint64_t size)
+{
+    if (size > 0 && fwrite(data, 1, (size_t)size, recorder->file) != size) {
+        recorder->ok = 0;
+    }
+    recorder->offset += size;
+}
+
+static void record_i32(struct twsfwphysx_recorder *recorder,
+                       const int32_t value)
+{
+    record_bytes(recorder, &value, sizeof(value));
+}
+
+static void record_keyframe(struct twsfwphysx_recorder *recorder)
+{
+    // NOLINTNEXTLINE(bugprone-suspicious-realloc-usage)
+    recorder->keyframes = (uint64_t *)realloc(
+        recorder->keyframes,
+        (uint64_t)(recorder->n_keyframes + 1) * sizeof(uint64_t));
+    assert(recorder->keyframes != NULL);
+    recorder->keyframes[recorder->n_keyframes++] = recorder->offset;
+
+    const unsigned char tag = 'K';
+    record_bytes(recorder, &tag, 1);
+    record_i32(recorder, recorder->agents.size);
+    record_bytes(recorder,
+                 recorder->agents.agents,
+                 (uint64_t)recorder->agents.size *
+                     sizeof(struct twsfwphysx_agent));
+    record_i32(recorder, recorder->missiles.size);
+    record_bytes(recorder,
+                 recorder->missiles.missiles,
+                 (uint64_t)recorder->missiles.size *
+                     sizeof(struct twsfwphysx_missile));
+}
+
+static unsigned char changed_fields(const struct twsfwphysx_agents *previous,
+                                    const struct twsfwphysx_agents *agents,
+                                    const int32_t index)
+{
+    if (index >= previous->size) {
+        return (unsigned char)((1U << TWSFWPHYSX_REPLAY_N_FIELDS) - 1U);
+    }
+
+    const unsigned char *a = (const unsigned char *)&previous->agents[index];
+    const unsigned char *b = (const unsigned char *)&agents->agents[index];
+
+    unsigned char mask = 0;
+    for (int32_t i = 0; i < TWSFWPHYSX_REPLAY_N_FIELDS; i++) {
+        const uint64_t offset = replay_agent_fields[i].offset;
+        if (memcmp(a + offset, b + offset, replay_agent_fields[i].size) != 0) {
+            mask |= (unsigned char)(1U << i);
+        }
+    }
+
+    return mask;
+}
+
+static void record_delta(struct twsfwphysx_recorder *recorder,
+                         const struct twsfwphysx_agents *agents,
+                         const struct twsfwphysx_missiles *missiles,
+                         const float t,
+                         const int32_t n_steps)
+{
+    int32_t n_changed = 0;
+    for (int32_t i = 0; i < agents->size; i++) {
+        n_changed += changed_fields(&recorder->agents, agents, i) != 0;
+    }
+
+    const unsigned char tag = 'D';
+    record_bytes(recorder, &tag, 1);
+    record_bytes(recorder, &t, sizeof(t));
+    record_i32(recorder, n_steps);
+    record_i32(recorder, agents->size);
+    record_i32(recorder, n_changed);
+
+    for (int32_t i = 0; i < agents->size; i++) {
+        const unsigned char mask = changed_fields(&recorder->agents, agents, i);
+        if (mask == 0) {
+            continue;
+        }
+
+        record_i32(recorder, i);
+        record_bytes(recorder, &mask, 1);
+
+        const unsigned char *agent = (const unsigned char *)&agents->agents[i];
+        for (int32_t j = 0; j < TWSFWPHYSX_REPLAY_N_FIELDS; j++) {
+            if (mask & (1U << j)) {
+                record_bytes(recorder,
+                             agent + replay_agent_fields[j].offset,
+                             replay_agent_fields[j].size);
+            }
+        }
+    }
+
+    const int32_t n = recorder->missiles.size < missiles->size ?
+                          recorder->missiles.size :
+                          missiles->size;
+    int32_t n_kept = 0;
+    while (n_kept < n && memcmp(&recorder->missiles.missiles[n_kept],
+                                &missiles->missiles[n_kept],
+                                sizeof(struct twsfwphysx_missile)) == 0)
+    {
+        n_kept += 1;
+    }
+
+    record_i32(recorder, n_kept);
+    record_i32(recorder, missiles->size - n_kept);
+    if (missiles->size > n_kept) {
+        record_bytes(recorder,
+                     &missiles->missiles[n_kept],
+                     (uint64_t)(missiles->size - n_kept) *
+                         sizeof(struct twsfwphysx_missile));
+    }
+}
+
+struct twsfwphysx_recorder *
+twsfwphysx_create_recorder(const char *path,
+                           const struct twsfwphysx_world *world,
+                           const int32_t keyframe_interval,
+                           const struct twsfwphysx_agents *agents,
+                           const struct twsfwphysx_missiles *missiles)
+{
+    assert(keyframe_interval > 0);
+
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+        return NULL;
+    }
+
+    struct twsfwphysx_recorder *recorder =
+        (struct twsfwphysx_recorder *)malloc(
+            sizeof(struct twsfwphysx_recorder));
+    assert(recorder != NULL);
+
+    recorder->file = file;
+    recorder->offset = 0;
+    recorder->ok = 1;
+    recorder->world = *world;
+    recorder->keyframe_interval = keyframe_interval;
+    recorder->agents.agents = NULL;
+    recorder->agents.size = 0;
+    recorder->missiles = twsfwphysx_new_missile_batch();
+    recorder->keyframes = NULL;
+    recorder->n_keyframes = 0;
+
+    assign_agents(&recorder->agents, agents->agents, agents->size);
+    assign_missiles(&recorder->missiles, missiles->missiles, missiles->size);
+
+    const uint32_t version = TWSFWPHYSX_REPLAY_VERSION;
+    const uint32_t reserved = 0;
+    record_bytes(recorder, "TWSFWRPL", 8);
+    record_bytes(recorder, &version, sizeof(version));
+    record_i32(recorder, keyframe_interval);
+    record_bytes(recorder, world, sizeof(struct twsfwphysx_world));
+    record_bytes(recorder, &reserved, sizeof(reserved));
+    assert(recorder->offset == TWSFWPHYSX_REPLAY_HEADER_SIZE);
+
+    record_keyframe(recorder);
+    recorder->n_ticks = 1;
+
+    return recorder;
 }
 
-static struct twsfwphysx_vec normalize(struct twsfwphysx_vec v)
-{
-    const float length = vec_length(v);
-    v.x /= length;
-    v.y /= length;
-    v.z /= length;
+int twsfwphysx_delete_recorder(struct twsfwphysx_recorder *recorder)
+{
+    const uint64_t index_offset = recorder->offset;
+    record_bytes(recorder,
+                 recorder->keyframes,
+                 (uint64_t)recorder->n_keyframes * sizeof(uint64_t));
+    record_bytes(recorder, &index_offset, sizeof(index_offset));
+    record_i32(recorder, recorder->n_ticks);
+    record_i32(recorder, recorder->n_keyframes);
+    record_bytes(recorder, "TWSFWIDX", 8);
+
+    const int ok = fclose(recorder->file) == 0 && recorder->ok;
+
+    twsfwphysx_delete_agents(&recorder->agents);
+    twsfwphysx_delete_missile_batch(&recorder->missiles);
+    free(recorder->keyframes);
+    free(recorder);
+
+    return ok;
+}
+
+void twsfwphysx_record_simulate(struct twsfwphysx_recorder *recorder,
+                                struct twsfwphysx_agents *agents,
+                                struct twsfwphysx_missiles *missiles,
+                                const float t,
+                                const int32_t n_steps,
+                                struct twsfwphysx_simulation_buffer *buffer)
+{
+    record_delta(recorder, agents, missiles, t, n_steps);
+
+    twsfwphysx_simulate(agents, missiles, &recorder->world, t, n_steps, buffer);
+
+    assign_agents(&recorder->agents, agents->agents, agents->size);
+    assign_missiles(&recorder->missiles, missiles->missiles, missiles->size);
+    if (recorder->n_ticks % recorder->keyframe_interval == 0) {
+        record_keyframe(recorder);
+    }
+    recorder->n_ticks += 1;
+}
+
+struct twsfwphysx_replay {
+    struct mapped_file file;
+    struct twsfwphysx_world world;
+    int32_t keyframe_interval;
+    int32_t n_ticks;
+    uint64_t index_offset;
+};
+
+struct replay_cursor {
+    const unsigned char *data;
+    uint64_t size;
+    uint64_t offset;
+    int ok;
+};
+
+static const unsigned char *replay_skip(struct replay_cursor *cursor,
+                                        const uint64_t size)
+{
+    if (!cursor->ok || size > cursor->size - cursor->offset) {
+        cursor->ok = 0;
+        return NULL;
+    }
+
+    const unsigned char *data = cursor->data + cursor->offset;
+    cursor->offset += size;
+    return data;
+}
+
+static void replay_read(struct replay_cursor *cursor,
+                        void *dst,
+                        const uint64_t size)
+{
+    const unsigned char *src = replay_skip(cursor, size);
+    if (src != NULL) {
+        memcpy(dst, src, size);
+    } else {
+        memset(dst, 0, size);
+    }
+}
+
+static int32_t replay_read_i32(struct replay_cursor *cursor)
+{
+    int32_t value;
+    replay_read(cursor, &value, sizeof(value));
+    return value;
+}
+
+// reads a number of elements that have to fit into the rest of the file
+static int32_t replay_read_count(struct replay_cursor *cursor,
+                                 const uint64_t element_size)
+{
+    const int32_t n = replay_read_i32(cursor);
+    if (n < 0 || (uint64_t)n > (cursor->size - cursor->offset) / element_size) {
+        cursor->ok = 0;
+        return 0;
+    }
+    return n;
+}
+
+static void replay_read_keyframe(struct replay_cursor *cursor,
+                                 struct twsfwphysx_agents *agents,
+                                 struct twsfwphysx_missiles *missiles)
+{
+    unsigned char tag;
+    replay_read(cursor, &tag, 1);
+    cursor->ok = cursor->ok && tag == 'K';
+
+    const int32_t n_agents =
+        replay_read_count(cursor, sizeof(struct twsfwphysx_agent));
+    const unsigned char *src = replay_skip(
+        cursor, (uint64_t)n_agents * sizeof(struct twsfwphysx_agent));
+    if (cursor->ok) {
+        assign_agents(agents, src, n_agents);
+    }
+
+    const int32_t n_missiles =
+        replay_read_count(cursor, sizeof(struct twsfwphysx_missile));
+    src = replay_skip(cursor,
+                      (uint64_t)n_missiles * sizeof(struct twsfwphysx_missile));
+    if (cursor->ok) {
+        assign_missiles(missiles, src, n_missiles);
+    }
+}
+
+static void replay_read_delta(struct replay_cursor *cursor,
+                              struct twsfwphysx_agents *agents,
+                              struct twsfwphysx_missiles *missiles,
+                              float *t,
+                              int32_t *n_steps)
+{
+    unsigned char tag;
+    replay_read(cursor, &tag, 1);
+    cursor->ok = cursor->ok && tag == 'D';
+
+    replay_read(cursor, t, sizeof(float));
+    *n_steps = replay_read_i32(cursor);
+    const int32_t n_agents = replay_read_i32(cursor);
+    const int32_t n_changed = replay_read_count(cursor, sizeof(int32_t) + 1);
+
+    // agents that are new in this tick are always changed
+    if (!cursor->ok || n_agents < 0 || n_agents > agents->size + n_changed) {
+        cursor->ok = 0;
+        return;
+    }
+    resize_agents(agents, n_agents);
+
+    for (int32_t i = 0; i < n_changed && cursor->ok; i++) {
+        const int32_t index = replay_read_i32(cursor);
+        unsigned char mask;
+        replay_read(cursor, &mask, 1);
+        if (index < 0 || index >= n_agents) {
+            cursor->ok = 0;
+            return;
+        }
+
+        unsigned char *agent = (unsigned char *)&agents->agents[index];
+        for (int32_t j = 0; j < TWSFWPHYSX_REPLAY_N_FIELDS; j++) {
+            if (mask & (1U << j)) {
+                replay_read(cursor,
+                            agent + replay_agent_fields[j].offset,
+                            replay_agent_fields[j].size);
+            }
+        }
+    }
+
+    const int32_t n_kept = replay_read_i32(cursor);
+    const int32_t n_new =
+        replay_read_count(cursor, sizeof(struct twsfwphysx_missile));
+    if (!cursor->ok || n_kept < 0 || n_kept > missiles->size) {
+        cursor->ok = 0;
+        return;
+    }
+
+    missiles->size = n_kept;
+    for (int32_t i = 0; i < n_new; i++) {
+        struct twsfwphysx_missile missile;
+        replay_read(cursor, &missile, sizeof(missile));
+        twsfwphysx_add_missile(missiles, missile);
+    }
+}
+
+struct twsfwphysx_replay *twsfwphysx_open_replay(const char *path)
+{
+    struct twsfwphysx_replay *replay =
+        (struct twsfwphysx_replay *)malloc(sizeof(struct twsfwphysx_replay));
+    assert(replay != NULL);
+
+    if (!map_file(&replay->file, path, MAPPED_FILE_READ, 0)) {
+        free(replay);
+        return NULL;
+    }
+
+    struct replay_cursor cursor = {
+        replay->file.data, replay->file.size, 0, 1
+    };
+    char magic[8];
+    uint32_t version;
+    replay_read(&cursor, magic, sizeof(magic));
+    replay_read(&cursor, &version, sizeof(version));
+    replay->keyframe_interval = replay_read_i32(&cursor);
+    replay_read(&cursor, &replay->world, sizeof(struct twsfwphysx_world));
+
+    int ok = cursor.ok && memcmp(magic, "TWSFWRPL", 8) == 0 &&
+             version == TWSFWPHYSX_REPLAY_VERSION &&
+             replay->keyframe_interval > 0 &&
+             replay->file.size >= TWSFWPHYSX_REPLAY_HEADER_SIZE +
+                                      TWSFWPHYSX_REPLAY_FOOTER_SIZE;
+
+    if (ok) {
+        cursor.offset = replay->file.size - TWSFWPHYSX_REPLAY_FOOTER_SIZE;
+        replay_read(&cursor, &replay->index_offset, sizeof(uint64_t));
+        replay->n_ticks = replay_read_i32(&cursor);
+        const int32_t n_keyframes = replay_read_i32(&cursor);
+        replay_read(&cursor, magic, sizeof(magic));
+
+        ok = cursor.ok && memcmp(magic, "TWSFWIDX", 8) == 0 &&
+             replay->n_ticks > 0 &&
+             n_keyframes ==
+                 (replay->n_ticks - 1) / replay->keyframe_interval + 1 &&
+             replay->index_offset + (uint64_t)n_keyframes * sizeof(uint64_t) ==
+                 replay->file.size - TWSFWPHYSX_REPLAY_FOOTER_SIZE;
+    }
+
+    if (!ok) {
+        unmap_file(&replay->file);
+        free(replay);
+        return NULL;
+    }
 
-    return v;
+    return replay;
 }
 
-static float dot(const struct twsfwphysx_vec v, const struct twsfwphysx_vec w)
+void twsfwphysx_close_replay(struct twsfwphysx_replay *replay)
 {
-    return v.x * w.x + v.y * w.y + v.z * w.z;
+    unmap_file(&replay->file);
+    free(replay);
 }
 
-static struct twsfwphysx_vec cross(const struct twsfwphysx_vec v,
-                                   const struct twsfwphysx_vec w)
+int32_t twsfwphysx_replay_n_ticks(const struct twsfwphysx_replay *replay)
 {
-    const struct twsfwphysx_vec res = { v.y * w.z - v.z * w.y,
-                                        v.z * w.x - v.x * w.z,
-                                        v.x * w.y - v.y * w.x };
-    return res;
+    return replay->n_ticks;
 }
 
-static void
-rotate(struct twsfwphysx_vec *r, struct twsfwphysx_vec u, float angle)
+struct twsfwphysx_world
+twsfwphysx_replay_world(const struct twsfwphysx_replay *replay)
 {
-    const float sin_angle = sinf(angle);
-    const float cos_angle = cosf(angle);
-
-    const struct twsfwphysx_vec w = cross(u, *r);
-    r->x = cos_angle * r->x + sin_angle * w.x;
-    r->y = cos_angle * r->y + sin_angle * w.y;
-    r->z = cos_angle * r->z + sin_angle * w.z;
+    return replay->world;
 }
 
-static void
-propagate(struct twsfwphysx_vec *r,
-          const struct twsfwphysx_vec u,
-          float *v,
-          const float a, // NOLINT(bugprone-easily-swappable-parameters)
-          const float dt) // NOLINT(bugprone-easily-swappable-parameters)
+int twsfwphysx_replay_seek(const struct twsfwphysx_replay *replay,
+                           const int32_t tick,
+                           struct twsfwphysx_agents *agents,
+                           struct twsfwphysx_missiles *missiles,
+                           struct twsfwphysx_simulation_buffer *buffer)
 {
-    const float theta = (a * dt) - ((*v - a) * expm1f(-dt));
-    rotate(r, u, theta);
+    assert(tick >= 0 && tick < replay->n_ticks);
 
-    *v = a - ((a - *v) * expf(-dt));
-}
+    // keyframes are only followed by deltas up to the next keyframe
+    const int32_t keyframe = tick / replay->keyframe_interval;
+    uint64_t offset;
+    memcpy(&offset,
+           replay->file.data + replay->index_offset +
+               (uint64_t)keyframe * sizeof(uint64_t),
+           sizeof(offset));
+    struct replay_cursor cursor = { replay->file.data,
+                                    replay->index_offset,
+                                    offset,
+                                    offset < replay->index_offset };
 
-static void collide(struct twsfwphysx_agent *p1,
-                    struct twsfwphysx_agent *p2,
-                    const float epsilon)
-{
-    struct twsfwphysx_vec n = { p1->r.x - p2->r.x,
-                                p1->r.y - p2->r.y,
-                                p1->r.z - p2->r.z };
+    replay_read_keyframe(&cursor, agents, missiles);
 
-    const float length = vec_length(n);
-    n.x /= length;
-    n.y /= length;
-    n.z /= length;
+    for (int32_t i = keyframe * replay->keyframe_interval; i < tick; i++) {
+        float t;
+        int32_t n_steps;
+        replay_read_delta(&cursor, agents, missiles, &t, &n_steps);
+        if (!cursor.ok) {
+            return 0;
+        }
 
-    struct twsfwphysx_vec v1 = cross(p1->u, p1->r);
-    v1.x *= p1->v;
-    v1.y *= p1->v;
-    v1.z *= p1->v;
+        twsfwphysx_simulate(
+            agents, missiles, &replay->world, t, n_steps, buffer);
+    }
 
-    struct twsfwphysx_vec v2 = cross(p2->u, p2->r);
-    v2.x *= p2->v;
-    v2.y *= p2->v;
-    v2.z *= p2->v;
+    return cursor.ok;
+}
 
-    const struct twsfwphysx_vec dv = { v1.x - v2.x, v1.y - v2.y, v1.z - v2.z };
-    const float J = (1.F + epsilon) / 2.F * dot(n, dv);
+#undef TWSFWPHYSX_REPLAY_VERSION
+#undef TWSFWPHYSX_REPLAY_HEADER_SIZE
+#undef TWSFWPHYSX_REPLAY_FOOTER_SIZE
+#undef TWSFWPHYSX_REPLAY_N_FIELDS
 
-    v1.x = v1.x - J * n.x;
-    v1.y = v1.y - J * n.y;
-    v1.z = v1.z - J * n.z;
+#define TWSFWPHYSX_WORLD_FILE_VERSION 1U
 
-    v2.x = v2.x + J * n.x;
-    v2.y = v2.y + J * n.y;
-    v2.z = v2.z + J * n.z;
+struct world_file_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t agent_size;
+    uint32_t missile_size;
+    int32_t n_agents;
+    int32_t n_missiles;
+    struct twsfwphysx_world world;
+    uint32_t reserved;
+    uint64_t agents_offset;
+    uint64_t missiles_offset;
+};
 
-    p1->v = vec_length(v1);
-    p2->v = vec_length(v2);
+struct twsfwphysx_world_file {
+    struct mapped_file file;
+};
 
-    if (p1->v > 1e-10F) {
-        p1->u = normalize(cross(p1->r, v1));
+int twsfwphysx_save_world_file(const char *path,
+                               const struct twsfwphysx_world *world,
+                               const struct twsfwphysx_agents *agents,
+                               const struct twsfwphysx_missiles *missiles)
+{
+    assert(sizeof(struct world_file_header) <= TWSFWPHYSX_MMAP_ALIGNMENT);
+
+    const uint64_t agents_size =
+        (uint64_t)agents->size * sizeof(struct twsfwphysx_agent);
+    const uint64_t missiles_size =
+        (uint64_t)missiles->size * sizeof(struct twsfwphysx_missile);
+
+    struct world_file_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "TWSFWWLD", 8);
+    header.version = TWSFWPHYSX_WORLD_FILE_VERSION;
+    header.byte_order = 0x01020304U;
+    header.agent_size = sizeof(struct twsfwphysx_agent);
+    header.missile_size = sizeof(struct twsfwphysx_missile);
+    header.n_agents = agents->size;
+    header.n_missiles = missiles->size;
+    header.world = *world;
+    header.agents_offset = mmap_align(sizeof(header));
+    header.missiles_offset =
+        mmap_align(header.agents_offset + agents_size);
+
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+        return 0;
     }
 
-    if (p2->v > 1e-10F) {
-        p2->u = normalize(cross(p2->r, v2));
+    // padding between the sections
+    const unsigned char zeros[TWSFWPHYSX_MMAP_ALIGNMENT] = { 0 };
+    const uint64_t agents_padding = header.agents_offset - sizeof(header);
+    const uint64_t missiles_padding =
+        header.missiles_offset - header.agents_offset - agents_size;
+
+    int ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    ok = ok && fwrite(zeros, 1, agents_padding, file) == agents_padding;
+    if (agents_size > 0) {
+        ok = ok && fwrite(agents->agents, 1, agents_size, file) == agents_size;
+    }
+    ok = ok && fwrite(zeros, 1, missiles_padding, file) == missiles_padding;
+    if (missiles_size > 0) {
+        ok = ok && fwrite(missiles->missiles, 1, missiles_size, file) ==
+                       missiles_size;
     }
+
+    return fclose(file) == 0 && ok;
 }
 
-static void fill_distance_buffer(const struct twsfwphysx_agent *agents,
-                                 float *buffer,
-                                 int32_t n)
+struct twsfwphysx_world_file *
+twsfwphysx_map_world_file(const char *path,
+                          struct twsfwphysx_world *world,
+                          struct twsfwphysx_agents *agents,
+                          struct twsfwphysx_missiles *missiles)
 {
-    assert(agents != NULL || n < 2);
-    assert(buffer != NULL || n < 2);
+    struct twsfwphysx_world_file *file = (struct twsfwphysx_world_file *)malloc(
+        sizeof(struct twsfwphysx_world_file));
+    assert(file != NULL);
 
-    int32_t k = 0;
-    for (int i = 0; i < n; i++) {
-        for (int j = i + 1; j < n; j++) {
-            buffer[k++] = dot(agents[i].r, agents[j].r);
-        }
+    if (!map_file(&file->file, path, MAPPED_FILE_COPY, 0)) {
+        free(file);
+        return NULL;
     }
-}
 
-static void hit(struct twsfwphysx_agent *agent,
-                struct twsfwphysx_missiles *missiles,
-                const int32_t i)
-{
-    const struct twsfwphysx_missile missile = missiles->missiles[i];
-    const float cos_theta = dot(agent->u, missile.u);
-    const float damage = 2.F + cos_theta;
+    // mappings are aligned to pages
+    const struct world_file_header *header =
+        (const struct world_file_header *)(void *)file->file.data;
+    const uint64_t size = file->file.size;
 
-    agent->hp -= damage;
+    const int ok =
+        size >= sizeof(struct world_file_header) &&
+        memcmp(header->magic, "TWSFWWLD", 8) == 0 &&
+        header->version == TWSFWPHYSX_WORLD_FILE_VERSION &&
+        header->byte_order == 0x01020304U &&
+        header->agent_size == sizeof(struct twsfwphysx_agent) &&
+        header->missile_size == sizeof(struct twsfwphysx_missile) &&
+        header->n_agents >= 0 && header->n_missiles >= 0 &&
+        header->agents_offset % TWSFWPHYSX_MMAP_ALIGNMENT == 0 &&
+        header->missiles_offset % TWSFWPHYSX_MMAP_ALIGNMENT == 0 &&
+        header->agents_offset <= size && header->missiles_offset <= size &&
+        (uint64_t)header->n_agents <=
+            (size - header->agents_offset) / sizeof(struct twsfwphysx_agent) &&
+        (uint64_t)header->n_missiles <= (size - header->missiles_offset) /
+                                            sizeof(struct twsfwphysx_missile);
 
-    missiles->size -= 1;
-    if (i < missiles->size) {
-        missiles->missiles[i] = missiles->missiles[missiles->size];
+    if (!ok) {
+        unmap_file(&file->file);
+        free(file);
+        return NULL;
     }
+
+    *world = header->world;
+
+    unsigned char *data = file->file.data;
+    agents->agents =
+        header->n_agents > 0 ?
+            (struct twsfwphysx_agent *)(void *)(data + header->agents_offset) :
+            NULL;
+    agents->size = header->n_agents;
+
+    missiles->missiles =
+        header->n_missiles > 0 ?
+            (struct twsfwphysx_missile *)(void *)(data +
+                                                  header->missiles_offset) :
+            NULL;
+    missiles->size = header->n_missiles;
+    missiles->capacity = -header->n_missiles;
+
+    return file;
 }
 
-static int32_t nearest_hit(const struct twsfwphysx_agents *agents,
-                           const struct twsfwphysx_missile missile,
-                           const float threshold)
+void twsfwphysx_unmap_world_file(struct twsfwphysx_world_file *file)
 {
-    int32_t i_max = -1;
-    float s_max = -2.F; // -1 <= dot(.) <= +1
-    for (int32_t i = 0; i < agents->size; i++) {
-        if (agents->agents[i].hp > 0.F) {
-            const float s = dot(agents->agents[i].r, missile.r);
-            if (s > threshold && s > s_max) {
-                i_max = i;
-                s_max = s;
-            }
-        }
-    }
-
-    return i_max;
+    unmap_file(&file->file);
+    free(file);
 }
 
-struct twsfwphysx_simulation_buffer {
-    struct twsfwphysx_agent *p;
-    float *s1;
-    float *s2;
-    int32_t capacity;
-};
+#undef TWSFWPHYSX_WORLD_FILE_VERSION
 
-struct twsfwphysx_simulation_buffer *twsfwphysx_create_simulation_buffer(void)
+// Sequence numbers, the number of publications and the latest tick are
+// accessed atomically. Plain 64-bit accesses are atomic on all supported
+// platforms if aligned.
+#ifdef _MSC_VER
+static uint64_t shared_load(const uint64_t *value)
 {
-    struct twsfwphysx_simulation_buffer *buffer =
-        (struct twsfwphysx_simulation_buffer *)malloc(
-            sizeof(struct twsfwphysx_simulation_buffer));
-    buffer->p = NULL;
-    buffer->s1 = NULL;
-    buffer->s2 = NULL;
-    buffer->capacity = 0;
+    const uint64_t x = *(const volatile uint64_t *)value;
+    MemoryBarrier();
+    return x;
+}
 
-    return buffer;
+static void shared_store(uint64_t *value, const uint64_t x)
+{
+    MemoryBarrier();
+    *(volatile uint64_t *)value = x;
 }
 
-void twsfwphysx_delete_simulation_buffer(
-    struct twsfwphysx_simulation_buffer *buffer)
+static void shared_fence(void)
 {
-    if (buffer != NULL) {
-        free(buffer->p);
-        free(buffer->s1);
-        free(buffer->s2);
-        free(buffer);
-    }
+    MemoryBarrier();
+}
+#else
+static uint64_t shared_load(const uint64_t *value)
+{
+    return __atomic_load_n(value, __ATOMIC_ACQUIRE);
 }
 
-static struct twsfwphysx_simulation_buffer
-update_simulation_buffer(struct twsfwphysx_simulation_buffer buffer,
-                         const int32_t n_agents)
+static void shared_store(uint64_t *value, const uint64_t x)
 {
-    assert(buffer.capacity >= 0);
+    __atomic_store_n(value, x, __ATOMIC_RELEASE);
+}
 
-    if (n_agents > buffer.capacity) {
-        buffer.capacity = n_agents;
+static void shared_fence(void)
+{
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+#endif
 
-        const uint64_t n = (uint64_t)n_agents;
+#define TWSFWPHYSX_SHARED_VERSION 1U
+#define TWSFWPHYSX_SHARED_N_SLOTS 3U
 
-        buffer.p = (struct twsfwphysx_agent *)
-            // NOLINTNEXTLINE(bugprone-suspicious-realloc-usage)
-            realloc(buffer.p, n * sizeof(struct twsfwphysx_agent));
-        assert(buffer.p != NULL);
+struct shared_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t agent_size;
+    uint32_t missile_size;
+    int32_t max_agents;
+    int32_t max_missiles;
+    uint64_t slot_size;
+    uint64_t missiles_offset;
+    uint64_t n_published;
+    uint64_t tick;
+};
 
-        if (n_agents > 1) {
-            const uint64_t size = (n * (n - 1)) / 2 * sizeof(float);
+struct shared_slot {
+    uint64_t sequence;
+    int64_t tick;
+    int32_t n_agents;
+    int32_t n_missiles;
+};
 
-            // NOLINTNEXTLINE(bugprone-suspicious-realloc-usage)
-            buffer.s1 = (float *)realloc(buffer.s1, size);
-            assert(buffer.s1 != NULL);
+struct twsfwphysx_publisher {
+    struct mapped_file file;
+    uint64_t n_published;
+};
 
-            // NOLINTNEXTLINE(bugprone-suspicious-realloc-usage)
-            buffer.s2 = (float *)realloc(buffer.s2, size);
-            assert(buffer.s2 != NULL);
-        }
-    }
+struct twsfwphysx_subscriber {
+    struct mapped_file file;
+};
 
-    return buffer;
+// mappings are aligned to pages and slots are aligned to cache lines
+static struct shared_header *shared_header(const struct mapped_file *file)
+{
+    return (struct shared_header *)(void *)file->data;
 }
 
-void twsfwphysx_simulate(struct twsfwphysx_agents *agents,
-                         struct twsfwphysx_missiles *missiles,
-                         const struct twsfwphysx_world *world,
-                         const float t,
-                         int32_t n_steps,
-                         struct twsfwphysx_simulation_buffer *buffer)
+static struct shared_slot *shared_slot(const struct mapped_file *file,
+                                       const uint64_t i)
 {
-    struct twsfwphysx_simulation_buffer bffr = { NULL, NULL, NULL, 0 };
-    if (buffer == NULL) {
-        buffer = &bffr;
+    const struct shared_header *header = shared_header(file);
+    return (struct shared_slot *)(void *)(file->data +
+                                          TWSFWPHYSX_MMAP_ALIGNMENT +
+                                          i % TWSFWPHYSX_SHARED_N_SLOTS *
+                                              header->slot_size);
+}
+
+struct twsfwphysx_publisher *twsfwphysx_create_publisher(
+    const char *path, const int32_t max_agents, const int32_t max_missiles)
+{
+    assert(max_agents >= 0 && max_missiles >= 0);
+    assert(sizeof(struct shared_header) <= TWSFWPHYSX_MMAP_ALIGNMENT);
+
+    const uint64_t missiles_offset =
+        mmap_align(TWSFWPHYSX_MMAP_ALIGNMENT +
+                   (uint64_t)max_agents * sizeof(struct twsfwphysx_agent));
+    const uint64_t slot_size = mmap_align(
+        missiles_offset +
+        (uint64_t)max_missiles * sizeof(struct twsfwphysx_missile));
+
+    struct twsfwphysx_publisher *publisher =
+        (struct twsfwphysx_publisher *)malloc(
+            sizeof(struct twsfwphysx_publisher));
+    assert(publisher != NULL);
+
+    if (!map_file(&publisher->file,
+                  path,
+                  MAPPED_FILE_CREATE,
+                  TWSFWPHYSX_MMAP_ALIGNMENT +
+                      TWSFWPHYSX_SHARED_N_SLOTS * slot_size)) {
+        free(publisher);
+        return NULL;
     }
+    publisher->n_published = 0;
 
-    const int32_t n_agents = agents->size;
-    *buffer = update_simulation_buffer(*buffer, n_agents);
+    // The file is filled with zeros. The magic is written last such that
+    // subscribers do not see incomplete headers.
+    struct shared_header *header = shared_header(&publisher->file);
+    header->version = TWSFWPHYSX_SHARED_VERSION;
+    header->byte_order = 0x01020304U;
+    header->agent_size = sizeof(struct twsfwphysx_agent);
+    header->missile_size = sizeof(struct twsfwphysx_missile);
+    header->max_agents = max_agents;
+    header->max_missiles = max_missiles;
+    header->slot_size = slot_size;
+    header->missiles_offset = missiles_offset;
+    shared_fence();
+    memcpy(header->magic, "TWSFWSHM", 8);
 
-    // !!! WARNING !!!
-    // cos(.) makes small angles large and large angles small!
-    // Hence, search for distances *above* `*_threshold` when looking for
-    // *close* objects.
-    const float missile_agent_threshold = cosf(world->agent_radius);
-    const float agent_agent_threshold = cosf(2.F * world->agent_radius);
+    return publisher;
+}
 
-    struct twsfwphysx_agent *p = agents->agents;
+void twsfwphysx_delete_publisher(struct twsfwphysx_publisher *publisher)
+{
+    unmap_file(&publisher->file);
+    free(publisher);
+}
 
-    const float dt = t / (float)n_steps;
-    while (n_steps-- > 0) {
-        for (int i = missiles->size - 1; i >= 0; i--) {
-            const int j = nearest_hit(agents,
-                                      missiles->missiles[i],
-                                      missile_agent_threshold);
-            if (j >= 0) {
-                hit(&p[j], missiles, i);
-            } else {
-                propagate(&missiles->missiles[i].r,
-                          missiles->missiles[i].u,
-                          &missiles->missiles[i].v,
-                          world->missile_acceleration,
-                          dt);
-            }
-        }
+int twsfwphysx_publish(struct twsfwphysx_publisher *publisher,
+                       const int64_t tick,
+                       const struct twsfwphysx_agents *agents,
+                       const struct twsfwphysx_missiles *missiles)
+{
+    struct shared_header *header = shared_header(&publisher->file);
+    if (agents->size > header->max_agents ||
+        missiles->size > header->max_missiles) {
+        return 0;
+    }
 
-        fill_distance_buffer(p, buffer->s1, n_agents);
-        for (int i = 0; i < n_agents; i++) {
-            buffer->p[i] = p[i];
-            propagate(&buffer->p[i].r,
-                      buffer->p[i].u,
-                      &buffer->p[i].v,
-                      buffer->p[i].a,
-                      dt);
-        }
-        fill_distance_buffer(buffer->p, buffer->s2, n_agents);
+    const uint64_t n_published = publisher->n_published;
+    struct shared_slot *slot = shared_slot(&publisher->file, n_published);
+    unsigned char *data = (unsigned char *)slot;
 
-        int32_t k = 0;
-        for (int i = 0; i < n_agents; i++) {
-            for (int j = i + 1; j < n_agents; j++) {
-                const int both_alive = p[i].hp > 0.F && p[j].hp > 0.F;
-                const int too_close = buffer->s1[k] > agent_agent_threshold ||
-                                      buffer->s2[k] > agent_agent_threshold;
-                const int distance_decreases = buffer->s1[k] < buffer->s2[k];
+    // readers retry while the sequence number is odd
+    const uint64_t sequence = slot->sequence;
+    shared_store(&slot->sequence, sequence + 1);
+    shared_fence();
 
-                if (both_alive && too_close && distance_decreases) {
-                    buffer->p[i] = p[i];
-                    buffer->p[j] = p[j];
-                    collide(&buffer->p[i], &buffer->p[j], world->restitution);
-                }
+    slot->tick = tick;
+    slot->n_agents = agents->size;
+    slot->n_missiles = missiles->size;
+    if (agents->size > 0) {
+        memcpy(data + TWSFWPHYSX_MMAP_ALIGNMENT,
+               agents->agents,
+               (uint64_t)agents->size * sizeof(struct twsfwphysx_agent));
+    }
+    if (missiles->size > 0) {
+        memcpy(data + header->missiles_offset,
+               missiles->missiles,
+               (uint64_t)missiles->size * sizeof(struct twsfwphysx_missile));
+    }
 
-                k += 1;
-            }
-        }
+    shared_store(&slot->sequence, sequence + 2);
+    shared_store(&header->tick, (uint64_t)tick);
+    shared_store(&header->n_published, n_published + 1);
+    publisher->n_published = n_published + 1;
 
-        struct twsfwphysx_agent *tmp = p;
-        p = buffer->p;
-        buffer->p = tmp;
+    return 1;
+}
+
+struct twsfwphysx_subscriber *twsfwphysx_open_subscriber(const char *path)
+{
+    struct twsfwphysx_subscriber *subscriber =
+        (struct twsfwphysx_subscriber *)malloc(
+            sizeof(struct twsfwphysx_subscriber));
+    assert(subscriber != NULL);
+
+    if (!map_file(&subscriber->file, path, MAPPED_FILE_READ, 0)) {
+        free(subscriber);
+        return NULL;
     }
 
-    agents->agents = p;
+    const uint64_t size = subscriber->file.size;
+    const struct shared_header *header = shared_header(&subscriber->file);
+    int ok = size >= TWSFWPHYSX_MMAP_ALIGNMENT &&
+             memcmp(header->magic, "TWSFWSHM", 8) == 0;
 
-    free(bffr.p);
-    free(bffr.s1);
-    free(bffr.s2);
+    // the magic has been written last
+    shared_fence();
+    ok = ok && header->version == TWSFWPHYSX_SHARED_VERSION &&
+         header->byte_order == 0x01020304U &&
+         header->agent_size == sizeof(struct twsfwphysx_agent) &&
+         header->missile_size == sizeof(struct twsfwphysx_missile) &&
+         header->max_agents >= 0 && header->max_missiles >= 0 &&
+         header->slot_size % TWSFWPHYSX_MMAP_ALIGNMENT == 0 &&
+         header->missiles_offset >=
+             TWSFWPHYSX_MMAP_ALIGNMENT + (uint64_t)header->max_agents *
+                                             sizeof(struct twsfwphysx_agent) &&
+         header->slot_size >=
+             header->missiles_offset + (uint64_t)header->max_missiles *
+                                           sizeof(struct twsfwphysx_missile) &&
+         (size - TWSFWPHYSX_MMAP_ALIGNMENT) / TWSFWPHYSX_SHARED_N_SLOTS >=
+             header->slot_size;
+
+    if (!ok) {
+        unmap_file(&subscriber->file);
+        free(subscriber);
+        return NULL;
+    }
+
+    return subscriber;
 }
 
-void twsfwphysx_turn_agent(struct twsfwphysx_agent *agent, float angle)
+void twsfwphysx_close_subscriber(struct twsfwphysx_subscriber *subscriber)
 {
-    rotate(&agent->u, agent->r, angle);
+    unmap_file(&subscriber->file);
+    free(subscriber);
 }
 
-struct twsfwphysx_missile
-twsfwphysx_launch_missile(const struct twsfwphysx_agent *agent,
-                          const struct twsfwphysx_world *world)
+int twsfwphysx_read_shared(const struct twsfwphysx_subscriber *subscriber,
+                           struct twsfwphysx_shared_state *state)
 {
-    struct twsfwphysx_missile missile = { agent->r, agent->u, agent->v, -1 };
+    const struct shared_header *header = shared_header(&subscriber->file);
+    const uint64_t n_published = shared_load(&header->n_published);
+    if (n_published == 0) {
+        return 0;
+    }
 
-    const float distance = world->agent_radius + world->agent_radius * 1e-4F;
-    rotate(&missile.r, missile.u, distance);
+    struct shared_slot *slot = shared_slot(&subscriber->file, n_published - 1);
+    const uint64_t sequence = shared_load(&slot->sequence);
+    if (sequence % 2 != 0) {
+        return 0;
+    }
 
-    return missile;
+    const int32_t n_agents = slot->n_agents;
+    const int32_t n_missiles = slot->n_missiles;
+    if (n_agents < 0 || n_agents > header->max_agents || n_missiles < 0 ||
+        n_missiles > header->max_missiles) {
+        return 0;
+    }
+
+    unsigned char *data = (unsigned char *)slot;
+    state->tick = slot->tick;
+    state->agents.agents =
+        (struct twsfwphysx_agent *)(void *)(data + TWSFWPHYSX_MMAP_ALIGNMENT);
+    state->agents.size = n_agents;
+    state->missiles.missiles =
+        (struct twsfwphysx_missile *)(void *)(data + header->missiles_offset);
+    state->missiles.size = n_missiles;
+    state->missiles.capacity = -n_missiles;
+    state->slot = slot;
+    state->sequence = sequence;
+
+    return 1;
+}
+
+int twsfwphysx_validate_shared(const struct twsfwphysx_shared_state *state)
+{
+    const struct shared_slot *slot = (const struct shared_slot *)state->slot;
+    shared_fence();
+    return shared_load(&slot->sequence) == state->sequence;
 }
 
+#undef TWSFWPHYSX_SHARED_VERSION
+#undef TWSFWPHYSX_SHARED_N_SLOTS
+
+#undef TWSFWPHYSX_MMAP_ALIGNMENT
+
+#endif
+
+#undef TWSFWPHYSX_TRACE_BEGIN
+#undef TWSFWPHYSX_TRACE_END
+
+#ifdef TWSFWPHYSX_DETERMINISTIC
+#if defined(__clang__)
+#pragma STDC FP_CONTRACT DEFAULT
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+#endif
+
 #endif
 
 #ifdef __cplusplus
@@ -0,0 +1,368 @@
+/*!
+ * \file twsfwphysx.hpp
+ * \brief C++17 wrapper of twsfwphysx
+ *
+ * Owning containers for agents, missiles and simulation buffers as well as a
+ * \ref twsfwphysx::simulate template that selects a specialised kernel (see
+ * \ref twsfwphysx_kernel) at compile time:
+ *
+ * \code
+ * twsfwphysx::Agents agents(n_agents);
+ * twsfwphysx::Missiles missiles;
+ * twsfwphysx::SimulationBuffer buffer;
+ *
+ * for (auto &agent : agents.view()) {
+ *     agent = ...;
+ * }
+ *
+ * using Options = twsfwphysx::SimulationOptions<true, true>;
+ * twsfwphysx::simulate<Options>(agents, missiles, world, t, n_steps, buffer);
+ * \endcode
+ *
+ * This is only a wrapper: Define `TWSFWPHYSX_IMPLEMENTATION` in **one** source
+ * file before including \ref twsfwphysx.h (or this file) as usual.
+ */
+
+#ifndef TWSFWPHYSX_HPP
+#define TWSFWPHYSX_HPP
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+#if __cplusplus >= 202002L && __has_include(<span>)
+#include <span>
+#endif
+
+#include "twsfwphysx.h"
+
+namespace twsfwphysx
+{
+#if defined(__cpp_lib_span)
+template <class T>
+using span = std::span<T>;
+#else
+/**
+ * @brief Minimal replacement of `std::span` (which requires C++20).
+ */
+template <class T>
+class span {
+    T *m_data = nullptr;
+    std::size_t m_size = 0;
+
+  public:
+    constexpr span() noexcept = default;
+
+    constexpr span(T *data, const std::size_t size) noexcept
+        : m_data(data)
+        , m_size(size)
+    {
+    }
+
+    [[nodiscard]] constexpr T *data() const noexcept
+    {
+        return m_data;
+    }
+
+    [[nodiscard]] constexpr std::size_t size() const noexcept
+    {
+        return m_size;
+    }
+
+    [[nodiscard]] constexpr bool empty() const noexcept
+    {
+        return m_size == 0;
+    }
+
+    constexpr T &operator[](const std::size_t idx) const
+    {
+        assert(idx < m_size);
+        return m_data[idx];
+    }
+
+    [[nodiscard]] constexpr T *begin() const noexcept
+    {
+        return m_data;
+    }
+
+    [[nodiscard]] constexpr T *end() const noexcept
+    {
+        return m_data + m_size;
+    }
+};
+#endif
+
+/**
+ * @brief Owning batch of agents (see \ref twsfwphysx_agents).
+ *
+ * Agents are move-only. A moved-from batch is empty.
+ */
+class Agents final {
+    twsfwphysx_agents m_agents;
+
+  public:
+    /**
+     * @brief Creates a batch with `size` uninitialized agents.
+     */
+    explicit Agents(const std::size_t size = 0)
+        : m_agents(twsfwphysx_create_agents(static_cast<int32_t>(size)))
+    {
+    }
+
+    Agents(const Agents &) = delete;
+    Agents &operator=(const Agents &) = delete;
+
+    Agents(Agents &&other) noexcept
+        : m_agents(std::exchange(other.m_agents, twsfwphysx_agents{}))
+    {
+    }
+
+    Agents &operator=(Agents &&other) noexcept
+    {
+        std::swap(m_agents, other.m_agents);
+        return *this;
+    }
+
+    ~Agents()
+    {
+        twsfwphysx_delete_agents(&m_agents);
+    }
+
+    twsfwphysx_agent &operator[](const std::size_t idx)
+    {
+        assert(idx < size());
+        return m_agents.agents[idx];
+    }
+
+    const twsfwphysx_agent &operator[](const std::size_t idx) const
+    {
+        assert(idx < size());
+        return m_agents.agents[idx];
+    }
+
+    [[nodiscard]] std::size_t size() const noexcept
+    {
+        return static_cast<std::size_t>(m_agents.size);
+    }
+
+    [[nodiscard]] span<twsfwphysx_agent> view() noexcept
+    {
+        return {m_agents.agents, size()};
+    }
+
+    [[nodiscard]] span<const twsfwphysx_agent> view() const noexcept
+    {
+        return {m_agents.agents, size()};
+    }
+
+    /**
+     * @brief Returns the underlying batch for calls to the C API.
+     */
+    [[nodiscard]] twsfwphysx_agents *get() noexcept
+    {
+        return &m_agents;
+    }
+
+    [[nodiscard]] const twsfwphysx_agents *get() const noexcept
+    {
+        return &m_agents;
+    }
+};
+
+/**
+ * @brief Owning batch of missiles (see \ref twsfwphysx_missiles).
+ *
+ * Missiles are move-only. A moved-from batch is empty.
+ */
+class Missiles final {
+    twsfwphysx_missiles m_missiles;
+
+  public:
+    Missiles() noexcept
+        : m_missiles(twsfwphysx_new_missile_batch())
+    {
+    }
+
+    Missiles(const Missiles &) = delete;
+    Missiles &operator=(const Missiles &) = delete;
+
+    Missiles(Missiles &&other) noexcept
+        : m_missiles(
+              std::exchange(other.m_missiles, twsfwphysx_new_missile_batch()))
+    {
+    }
+
+    Missiles &operator=(Missiles &&other) noexcept
+    {
+        std::swap(m_missiles, other.m_missiles);
+        return *this;
+    }
+
+    ~Missiles()
+    {
+        twsfwphysx_delete_missile_batch(&m_missiles);
+    }
+
+    /**
+     * @brief Removes all missiles but keeps the allocated memory.
+     */
+    void clear() noexcept
+    {
+        twsfwphysx_clear_missile_batch(&m_missiles);
+    }
+
+    void push_back(const twsfwphysx_missile &missile)
+    {
+        twsfwphysx_add_missile(&m_missiles, missile);
+    }
+
+    const twsfwphysx_missile &operator[](const std::size_t idx) const
+    {
+        assert(idx < size());
+        return m_missiles.missiles[idx];
+    }
+
+    [[nodiscard]] std::size_t size() const noexcept
+    {
+        return static_cast<std::size_t>(m_missiles.size);
+    }
+
+    [[nodiscard]] bool empty() const noexcept
+    {
+        return m_missiles.size == 0;
+    }
+
+    /**
+     * @brief Returns a read-only view (since the simulation reorders missiles).
+     */
+    [[nodiscard]] span<const twsfwphysx_missile> view() const noexcept
+    {
+        return {m_missiles.missiles, size()};
+    }
+
+    /**
+     * @brief Returns the underlying batch for calls to the C API.
+     */
+    [[nodiscard]] twsfwphysx_missiles *get() noexcept
+    {
+        return &m_missiles;
+    }
+
+    [[nodiscard]] const twsfwphysx_missiles *get() const noexcept
+    {
+        return &m_missiles;
+    }
+};
+
+/**
+ * @brief Owning simulation buffer (see \ref twsfwphysx_simulation_buffer).
+ *
+ * Buffers are move-only. A moved-from buffer holds no buffer, which is
+ * equivalent to passing `NULL` to \ref twsfwphysx_simulate.
+ */
+class SimulationBuffer final {
+    twsfwphysx_simulation_buffer *m_buffer;
+
+  public:
+    SimulationBuffer()
+        : m_buffer(twsfwphysx_create_simulation_buffer())
+    {
+    }
+
+    SimulationBuffer(const SimulationBuffer &) = delete;
+    SimulationBuffer &operator=(const SimulationBuffer &) = delete;
+
+    SimulationBuffer(SimulationBuffer &&other) noexcept
+        : m_buffer(std::exchange(other.m_buffer, nullptr))
+    {
+    }
+
+    SimulationBuffer &operator=(SimulationBuffer &&other) noexcept
+    {
+        std::swap(m_buffer, other.m_buffer);
+        return *this;
+    }
+
+    ~SimulationBuffer()
+    {
+        twsfwphysx_delete_simulation_buffer(m_buffer);
+    }
+
+    /**
+     * @brief Returns the underlying buffer for calls to the C API.
+     */
+    [[nodiscard]] twsfwphysx_simulation_buffer *get() const noexcept
+    {
+        return m_buffer;
+    }
+};
+
+/**
+ * @brief Compile-time assumptions of \ref simulate.
+ *
+ * @tparam NoMissiles There are no missiles.
+ * @tparam Elastic \ref twsfwphysx_world.restitution is 1.
+ * @tparam AllAlive All agents have positive HPs (requires `NoMissiles`).
+ */
+template <bool NoMissiles = false, bool Elastic = false, bool AllAlive = false>
+struct SimulationOptions {
+    static_assert(!AllAlive || NoMissiles,
+                  "missiles can kill agents: AllAlive requires NoMissiles");
+
+    /**
+     * @brief Combination of \ref twsfwphysx_kernel flags.
+     */
+    static constexpr uint32_t kernel =
+        (NoMissiles ? uint32_t{TWSFWPHYSX_KERNEL_NO_MISSILES} : 0U) |
+        (Elastic ? uint32_t{TWSFWPHYSX_KERNEL_ELASTIC} : 0U) |
+        (AllAlive ? uint32_t{TWSFWPHYSX_KERNEL_ALL_ALIVE} : 0U);
+};
+
+/**
+ * @brief Returns the kernel of `Options` (see \ref twsfwphysx_select_kernel).
+ */
+template <class Options>
+twsfwphysx_simulate_function kernel()
+{
+    static const twsfwphysx_simulate_function function =
+        twsfwphysx_select_kernel(Options::kernel);
+    return function;
+}
+
+/**
+ * @brief Simulates with the kernel selected by `Options`.
+ *
+ * See \ref twsfwphysx_simulate and \ref twsfwphysx_simulate_kernel. Results
+ * are bitwise identical to \ref twsfwphysx_simulate as long as the
+ * assumptions of `Options` hold. Each instantiation calls the kernel for
+ * `Options` directly (see \ref twsfwphysx_select_kernel).
+ */
+template <class Options = SimulationOptions<>>
+void simulate(Agents &agents,
+              Missiles &missiles,
+              const twsfwphysx_world &world,
+              const float t,
+              const int32_t n_steps,
+              SimulationBuffer &buffer)
+{
+    kernel<Options>()(
+        agents.get(), missiles.get(), &world, t, n_steps, buffer.get());
+}
+
+/**
+ * @brief Simulates without keeping a simulation buffer between calls.
+ */
+template <class Options = SimulationOptions<>>
+void simulate(Agents &agents,
+              Missiles &missiles,
+              const twsfwphysx_world &world,
+              const float t,
+              const int32_t n_steps)
+{
+    kernel<Options>()(
+        agents.get(), missiles.get(), &world, t, n_steps, nullptr);
+}
+}  // namespace twsfwphysx
+
+#endif  // TWSFWPHYSX_HPP
@@ -14,7 +14,10 @@ ext_modules = [
         "binding",
         sources=[os.path.join("twsfwphysx", "binding.pyx")],
         include_dirs=[os.path.join("..", "include")],
-        extra_compile_args=["-DTWSFWPHYSX_IMPLEMENTATION"],
+        extra_compile_args=[
+            "-DTWSFWPHYSX_IMPLEMENTATION",
+            "-DTWSFWPHYSX_DETERMINISTIC",
+        ],
         language="c",
     )
 ]
@@ -34,6 +37,7 @@ setup(
     extras_require={
         "dev": [
             "GitPython",
+            "numpy",
             "pytest",
             "ruff",
             "sphinx",
@@ -1,5 +1,6 @@
 import math
 
+import numpy
 import pytest
 
 import twsfwphysx
@@ -58,3 +59,111 @@ def test_engine():
 
     assert engine.agents[0].v > 0
     assert engine.agents[1].v > 0
+
+
+def test_trajectory():
+    r1 = twsfwphysx.Vec(1.0, 0.0, 0.0)
+    r2 = twsfwphysx.Vec(0.0, 1.0, 0.0)
+    u = twsfwphysx.Vec(0.0, 0.0, 1.0)
+
+    world = twsfwphysx.World(
+        restitution=1.0, agent_radius=0.1, missile_acceleration=2.0
+    )
+    engine = twsfwphysx.Engine(
+        world,
+        [
+            twsfwphysx.Agent(r1, u, 1.0, 1.0, 5.0),
+            twsfwphysx.Agent(r2, u, 0.0, 0.0, 5.0),
+        ],
+    )
+    engine.launch_missile(agent_idx=0)
+
+    # any writable buffer works, e.g., numpy.empty((10, 2, 3), "float32")
+    def array(fmt, shape):
+        size = 4 * math.prod(shape)
+        return memoryview(bytearray(size)).cast(fmt, shape)
+
+    r = array("f", (10, 2, 3))
+    hp = array("f", (10, 2))
+    n_missiles = array("i", (10,))
+
+    n_frames = engine.simulate(
+        t=2,
+        n_steps=2_000,
+        every=200,
+        agent_r=r,
+        agent_hp=hp,
+        n_missiles=n_missiles,
+    )
+    assert n_frames == 10
+
+    for i, agent in enumerate(engine.agents):
+        assert r[9, i, 0] == pytest.approx(agent.r.x)
+        assert r[9, i, 1] == pytest.approx(agent.r.y)
+        assert r[9, i, 2] == pytest.approx(agent.r.z)
+        assert hp[9, i] == pytest.approx(agent.hp)
+
+    assert n_missiles[0] == 1
+    assert n_missiles[9] == 0
+    assert hp[0, 1] == pytest.approx(5)
+    assert hp[9, 1] == pytest.approx(2)
+
+    with pytest.raises(ValueError):
+        engine.simulate(t=1, n_steps=10, agent_r=array("f", (10, 1, 3)))
+
+    with pytest.raises(ValueError):
+        engine.simulate(t=1, n_steps=10, every=0)
+
+
+def test_trajectory_views():
+    r1 = twsfwphysx.Vec(1.0, 0.0, 0.0)
+    r2 = twsfwphysx.Vec(0.0, 1.0, 0.0)
+    u = twsfwphysx.Vec(0.0, 0.0, 1.0)
+
+    world = twsfwphysx.World(
+        restitution=1.0, agent_radius=0.1, missile_acceleration=2.0
+    )
+    engine = twsfwphysx.Engine(
+        world,
+        [
+            twsfwphysx.Agent(r1, u, 1.0, 1.0, 5.0),
+            twsfwphysx.Agent(r2, u, 0.0, 0.0, 5.0),
+        ],
+    )
+    engine.launch_missile(agent_idx=0)
+    engine.launch_missile(agent_idx=1, v=world.missile_acceleration)
+
+    # non-contiguous views are written in place
+    r = numpy.zeros((4, 4, 3), "float32")[:, ::2, :]
+    v = numpy.zeros((2, 4), "float32").T
+    missile_r = numpy.zeros((4, 2, 3), "float32")
+    payload = numpy.full((4, 2), -1, "int32")
+    n_missiles = numpy.zeros(4, "int32")
+
+    n_frames = engine.simulate(
+        t=2,
+        n_steps=2_000,
+        every=500,
+        agent_r=r,
+        agent_v=v,
+        missile_r=missile_r,
+        missile_payload=payload,
+        n_missiles=n_missiles,
+    )
+    assert n_frames == 4
+    assert not r.flags.c_contiguous
+    assert not v.flags.c_contiguous
+
+    for i, agent in enumerate(engine.agents):
+        assert r[3, i] == pytest.approx([agent.r.x, agent.r.y, agent.r.z])
+        assert v[3, i] == pytest.approx(agent.v)
+
+    assert n_missiles[3] == len(engine.missiles)
+    for i, missile in enumerate(engine.missiles):
+        assert payload[3, i] == missile.payload
+        assert missile_r[3, i] == pytest.approx([missile.r.x, missile.r.y, missile.r.z])
+
+    # only the first n_missiles[frame] entries are written
+    for frame in range(4):
+        assert sorted(payload[frame, : n_missiles[frame]]) in ([0, 1], [1], [])
+        assert all(payload[frame, n_missiles[frame] :] == -1)
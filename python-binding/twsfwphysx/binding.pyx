@@ -3,7 +3,8 @@ import collections
 from dataclasses import dataclass
 from math import pi
 
-from libc.stdint cimport int32_t
+from libc.stdint cimport int32_t, int64_t
+from libc.string cimport memset
 
 
 cdef extern from "twsfwphysx/twsfwphysx.h":
@@ -63,6 +64,24 @@ cdef extern from "twsfwphysx/twsfwphysx.h":
 
     void twsfwphysx_delete_simulation_buffer(void *buffer)
 
+    cdef struct twsfwphysx_strided_array:
+        void *data
+        int64_t strides[3]
+
+    cdef struct twsfwphysx_trajectory:
+        int32_t every
+        int32_t capacity
+        int32_t size
+        twsfwphysx_strided_array agent_r
+        twsfwphysx_strided_array agent_v
+        twsfwphysx_strided_array agent_hp
+        twsfwphysx_strided_array missile_r
+        twsfwphysx_strided_array missile_payload
+        twsfwphysx_strided_array n_missiles
+
+    void twsfwphysx_set_trajectory(void *buffer,
+                                   twsfwphysx_trajectory *trajectory)
+
     void twsfwphysx_simulate(twsfwphysx_agents *agents,
                              twsfwphysx_missiles *missiles,
                              const twsfwphysx_world *world,
@@ -73,6 +92,26 @@ cdef extern from "twsfwphysx/twsfwphysx.h":
     void twsfwphysx_turn_agent(twsfwphysx_agent *agent, float angle)
 
 
+cdef twsfwphysx_strided_array _strided_array(void *data,
+                                             Py_ssize_t stride0,
+                                             Py_ssize_t stride1=0,
+                                             Py_ssize_t stride2=0):
+    cdef twsfwphysx_strided_array array
+    array.data = data
+    array.strides[0] = stride0
+    array.strides[1] = stride1
+    array.strides[2] = stride2
+    return array
+
+
+def _check_trajectory_array(name: str, n_objects: int, required: int):
+    if n_objects < required:
+        raise ValueError(
+            f"Array '{name}' is too small (space for {n_objects} objects "
+            f"but {required} are needed)"
+        )
+
+
 def get_twsfwphysx_version() -> str:
     cdef const char* version = twsfwphysx_version()
     return version.decode("utf-8")
@@ -265,7 +304,17 @@ cdef class Engine:
                 f"Invalid index '{idx}' (total number of agents: {self._agents.size})"
             )
 
-    def simulate(self, *, t: float, n_steps: int):
+    def simulate(self,
+                 *,
+                 t: float,
+                 n_steps: int,
+                 every: int=1,
+                 float[:, :, :] agent_r=None,
+                 float[:, :] agent_v=None,
+                 float[:, :] agent_hp=None,
+                 float[:, :, :] missile_r=None,
+                 int32_t[:, :] missile_payload=None,
+                 int32_t[:] n_missiles=None) -> int:
         """Simulates the propagation and interactions of agents and missiles.
 
         Simulates the propagation and interactions of agents and missiles for
@@ -277,10 +326,124 @@ cdef class Engine:
         during one simulation steps should be smaller than
         :class:`World.agent_radius <twsfwphysx.World.agent_radius>`.
 
+        Optionally, the trajectories of agents and missiles are written into
+        the given arrays after every `every`-th internal step, e.g.,
+
+        .. code-block:: python
+
+            r = numpy.empty((10, len(engine.agents), 3), "float32")
+            n_frames = engine.simulate(t=1, n_steps=100, every=10, agent_r=r)
+
+        Any writable buffer (e.g., NumPy arrays, also non-contiguous ones) of
+        32-bit floats or integers with the given number of dimensions can be
+        passed; no data is copied. The first axis of all arrays enumerates the
+        recorded frames, the second axis agents or missiles and the third axis
+        the components of vectors. Only the first `n_missiles[frame]` entries
+        of the missile arrays are written in each frame; use `missile_payload`
+        to identify missiles.
+
         :param t: Simulation time in seconds. (Not real time!)
         :param n_steps: Number of internal simulation steps.
+        :param every: Record every `every`-th internal step.
+        :param agent_r: Positions of agents, shape `(frames, agents, 3)`.
+        :param agent_v: Velocities of agents, shape `(frames, agents)`.
+        :param agent_hp: HPs of agents, shape `(frames, agents)`.
+        :param missile_r: Positions of missiles, shape `(frames, missiles, 3)`.
+        :param missile_payload: Payloads of missiles (int32), shape `(frames, missiles)`.
+        :param n_missiles: Number of missiles (int32), shape `(frames,)`.
+        :return: Number of recorded frames.
+        :raises ValueError: if `every` is not positive or an array is too small.
         """
 
+        if every < 1:
+            raise ValueError(f"Invalid value '{every}' for every")
+
+        cdef twsfwphysx_trajectory trajectory
+        memset(&trajectory, 0, sizeof(twsfwphysx_trajectory))
+        trajectory.every = every
+        trajectory.capacity = max(n_steps, 0) // every
+
+        cdef int32_t n_agents_ = self._agents.size
+        cdef int32_t n_missiles_ = self._missiles.size
+        cdef bint record = False
+
+        if agent_r is not None:
+            _check_trajectory_array("agent_r", agent_r.shape[1], n_agents_)
+            _check_trajectory_array("agent_r", agent_r.shape[2], 3)
+            trajectory.capacity = min(trajectory.capacity, agent_r.shape[0])
+            if agent_r.shape[0] > 0 and n_agents_ > 0:
+                trajectory.agent_r = _strided_array(
+                    &agent_r[0, 0, 0],
+                    agent_r.strides[0],
+                    agent_r.strides[1],
+                    agent_r.strides[2],
+                )
+            record = True
+
+        if agent_v is not None:
+            _check_trajectory_array("agent_v", agent_v.shape[1], n_agents_)
+            trajectory.capacity = min(trajectory.capacity, agent_v.shape[0])
+            if agent_v.shape[0] > 0 and n_agents_ > 0:
+                trajectory.agent_v = _strided_array(
+                    &agent_v[0, 0],
+                    agent_v.strides[0],
+                    agent_v.strides[1],
+                )
+            record = True
+
+        if agent_hp is not None:
+            _check_trajectory_array("agent_hp", agent_hp.shape[1], n_agents_)
+            trajectory.capacity = min(trajectory.capacity, agent_hp.shape[0])
+            if agent_hp.shape[0] > 0 and n_agents_ > 0:
+                trajectory.agent_hp = _strided_array(
+                    &agent_hp[0, 0],
+                    agent_hp.strides[0],
+                    agent_hp.strides[1],
+                )
+            record = True
+
+        if missile_r is not None:
+            _check_trajectory_array(
+                "missile_r", missile_r.shape[1], n_missiles_
+            )
+            _check_trajectory_array("missile_r", missile_r.shape[2], 3)
+            trajectory.capacity = min(trajectory.capacity, missile_r.shape[0])
+            if missile_r.shape[0] > 0 and n_missiles_ > 0:
+                trajectory.missile_r = _strided_array(
+                    &missile_r[0, 0, 0],
+                    missile_r.strides[0],
+                    missile_r.strides[1],
+                    missile_r.strides[2],
+                )
+            record = True
+
+        if missile_payload is not None:
+            _check_trajectory_array(
+                "missile_payload", missile_payload.shape[1], n_missiles_
+            )
+            trajectory.capacity = min(
+                trajectory.capacity, missile_payload.shape[0]
+            )
+            if missile_payload.shape[0] > 0 and n_missiles_ > 0:
+                trajectory.missile_payload = _strided_array(
+                    &missile_payload[0, 0],
+                    missile_payload.strides[0],
+                    missile_payload.strides[1],
+                )
+            record = True
+
+        if n_missiles is not None:
+            trajectory.capacity = min(trajectory.capacity, n_missiles.shape[0])
+            if n_missiles.shape[0] > 0:
+                trajectory.n_missiles = _strided_array(
+                    &n_missiles[0],
+                    n_missiles.strides[0],
+                )
+            record = True
+
+        if record:
+            twsfwphysx_set_trajectory(self._simulation_buffer, &trajectory)
+
         twsfwphysx_simulate(
             &self._agents,
             &self._missiles,
@@ -290,6 +453,12 @@ cdef class Engine:
             self._simulation_buffer
         )
 
+        if not record:
+            return 0
+
+        twsfwphysx_set_trajectory(self._simulation_buffer, NULL)
+        return trajectory.size
+
     def launch_missile(self,
                        *,
                        agent_idx: int,
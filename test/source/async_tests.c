@@ -0,0 +1,237 @@
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+
+#include "twsfwphysx/twsfwphysx.h"
+#include "utils.h"
+
+#ifndef TWSFWPHYSX_ASYNC
+#error "This test has to be compiled with TWSFWPHYSX_ASYNC."
+#endif
+
+static const struct twsfwphysx_world WORLD = { .restitution = 1.F,
+                                               .agent_radius = .1F,
+                                               .missile_acceleration = 2.F };
+
+// some inputs that depend on the tick
+static void apply_inputs(struct twsfwphysx_agents *agents,
+                         struct twsfwphysx_missiles *missiles,
+                         const int32_t tick)
+{
+    const int32_t i = tick % agents->size;
+    twsfwphysx_turn_agent(&agents->agents[i], .1F * (float)tick);
+
+    if (tick % 4 == 0) {
+        struct twsfwphysx_missile missile =
+            twsfwphysx_launch_missile(&agents->agents[i], &WORLD);
+        missile.payload = tick;
+        twsfwphysx_add_missile(missiles, missile);
+    }
+}
+
+static void assert_state_eq(const struct twsfwphysx_agents *agents,
+                            const struct twsfwphysx_missiles *missiles,
+                            const struct twsfwphysx_pipeline_state *state)
+{
+    assert(agents->size == state->agents.size);
+    assert(memcmp(agents->agents,
+                  state->agents.agents,
+                  (size_t)agents->size * sizeof(struct twsfwphysx_agent)) ==
+           0);
+
+    assert(missiles->size == state->missiles.size);
+    if (missiles->size > 0) {
+        assert(memcmp(missiles->missiles,
+                      state->missiles.missiles,
+                      (size_t)missiles->size *
+                          sizeof(struct twsfwphysx_missile)) == 0);
+    }
+}
+
+void test_pipeline_matches_synchronous_simulation(void)
+{
+    struct twsfwphysx_agents agents = make_three_agents();
+    struct twsfwphysx_missiles missiles = twsfwphysx_new_missile_batch();
+    struct twsfwphysx_simulation_buffer *buffer =
+        twsfwphysx_create_simulation_buffer();
+
+    struct twsfwphysx_pipeline *pipeline =
+        twsfwphysx_create_pipeline(&agents, &missiles, &WORLD);
+    assert_state_eq(&agents, &missiles, twsfwphysx_pipeline_front(pipeline));
+    assert_state_eq(
+        &agents, &missiles, twsfwphysx_pipeline_staging(pipeline));
+
+    for (int32_t tick = 0; tick < 40; tick++) {
+        struct twsfwphysx_pipeline_state *inputs =
+            twsfwphysx_pipeline_staging(pipeline);
+        apply_inputs(&inputs->agents, &inputs->missiles, tick);
+        twsfwphysx_simulate_begin(pipeline, .25F, 25);
+
+        // the previous tick is still readable while simulating
+        assert_state_eq(
+            &agents, &missiles, twsfwphysx_pipeline_front(pipeline));
+
+        apply_inputs(&agents, &missiles, tick);
+        twsfwphysx_simulate(&agents, &missiles, &WORLD, .25F, 25, buffer);
+
+        twsfwphysx_simulate_end(pipeline);
+        assert_state_eq(
+            &agents, &missiles, twsfwphysx_pipeline_front(pipeline));
+        assert_state_eq(
+            &agents, &missiles, twsfwphysx_pipeline_staging(pipeline));
+    }
+
+    // something happened in the meantime
+    assert(agents.agents[0].hp < 20.F);
+
+    // deleting a pipeline waits for the running simulation
+    twsfwphysx_simulate_begin(pipeline, 1.F, 1000);
+    twsfwphysx_delete_pipeline(pipeline);
+
+    twsfwphysx_delete_simulation_buffer(buffer);
+    twsfwphysx_delete_missile_batch(&missiles);
+    twsfwphysx_delete_agents(&agents);
+}
+
+void test_pipeline_digest(void)
+{
+    struct twsfwphysx_agents agents = make_three_agents();
+    struct twsfwphysx_missiles missiles = twsfwphysx_new_missile_batch();
+
+    struct twsfwphysx_pipeline *pipeline =
+        twsfwphysx_create_pipeline(&agents, &missiles, &WORLD);
+
+    struct twsfwphysx_digest digest;
+    twsfwphysx_set_digest(twsfwphysx_pipeline_simulation_buffer(pipeline),
+                          &digest);
+
+    twsfwphysx_simulate_begin(pipeline, 1.F, 100);
+    twsfwphysx_simulate_end(pipeline);
+
+    const struct twsfwphysx_pipeline_state *front =
+        twsfwphysx_pipeline_front(pipeline);
+    struct twsfwphysx_digest expected;
+    twsfwphysx_compute_digest(&front->agents, &front->missiles, &expected);
+    assert(memcmp(&digest, &expected, sizeof(struct twsfwphysx_digest)) == 0);
+
+    twsfwphysx_delete_pipeline(pipeline);
+    twsfwphysx_delete_missile_batch(&missiles);
+    twsfwphysx_delete_agents(&agents);
+}
+
+static float uniform(uint32_t *state)
+{
+    *state = *state * 1664525U + 1013904223U;
+    return (float)(*state >> 8U) / (float)(1U << 24U) * 2.F - 1.F;
+}
+
+static struct twsfwphysx_vec normalized(const struct twsfwphysx_vec v)
+{
+    const float norm = sqrtf(v.x * v.x + v.y * v.y + v.z * v.z);
+    return make_vec(v.x / norm, v.y / norm, v.z / norm);
+}
+
+// Agents are crowded on a cap such that they collide often.
+static struct twsfwphysx_agents make_crowd(const int32_t n)
+{
+    uint32_t state = 42;
+    struct twsfwphysx_agents agents = twsfwphysx_create_agents(n);
+    for (int32_t i = 0; i < n; i++) {
+        const struct twsfwphysx_vec r = normalized(
+            make_vec(uniform(&state), uniform(&state), 2.F));
+        const struct twsfwphysx_vec t = normalized(
+            make_vec(uniform(&state), uniform(&state), uniform(&state)));
+        const struct twsfwphysx_vec u =
+            normalized(make_vec(r.y * t.z - r.z * t.y,
+                                r.z * t.x - r.x * t.z,
+                                r.x * t.y - r.y * t.x));
+        const struct twsfwphysx_agent agent = {
+            r, u, .5F * uniform(&state), uniform(&state), 3.F
+        };
+        twsfwphysx_set_agent(&agents, agent, i);
+    }
+
+    return agents;
+}
+
+static void simulate_crowd(const int32_t n_threads,
+                           const uint32_t kernel,
+                           struct twsfwphysx_agents *agents,
+                           struct twsfwphysx_missiles *missiles)
+{
+    const struct twsfwphysx_world world = { .restitution = .5F,
+                                            .agent_radius = .02F,
+                                            .missile_acceleration = 1.F };
+
+    const int32_t n_agents = 301;
+    *agents = make_crowd(n_agents);
+    *missiles = twsfwphysx_new_missile_batch();
+    for (int32_t i = 0; kernel == TWSFWPHYSX_KERNEL_GENERIC && i < n_agents;
+         i++) {
+        struct twsfwphysx_missile missile =
+            twsfwphysx_launch_missile(&agents->agents[i], &world);
+        missile.payload = i;
+        twsfwphysx_add_missile(missiles, missile);
+    }
+
+    struct twsfwphysx_simulation_buffer *buffer =
+        twsfwphysx_create_simulation_buffer();
+    struct twsfwphysx_thread_pool *pool =
+        n_threads > 0 ? twsfwphysx_create_thread_pool(n_threads) : NULL;
+    twsfwphysx_set_thread_pool(buffer, pool);
+
+    for (int32_t tick = 0; tick < 5; tick++) {
+        twsfwphysx_simulate_kernel(
+            agents, missiles, &world, .1F, 10, buffer, kernel);
+    }
+
+    twsfwphysx_set_thread_pool(buffer, NULL);
+    twsfwphysx_delete_thread_pool(pool);
+    twsfwphysx_delete_simulation_buffer(buffer);
+}
+
+void test_thread_pool_matches_serial_simulation(void)
+{
+    const uint32_t kernels[2] = { TWSFWPHYSX_KERNEL_GENERIC,
+                                  TWSFWPHYSX_KERNEL_NO_MISSILES };
+    for (int32_t k = 0; k < 2; k++) {
+        struct twsfwphysx_agents agents;
+        struct twsfwphysx_missiles missiles;
+        simulate_crowd(0, kernels[k], &agents, &missiles);
+
+        // missiles have hit (some of) the agents
+        assert(kernels[k] != TWSFWPHYSX_KERNEL_GENERIC ||
+               (missiles.size > 0 && missiles.size < agents.size));
+
+        const int32_t n_threads[4] = { 1, 2, 3, 8 };
+        for (int32_t i = 0; i < 4; i++) {
+            struct twsfwphysx_agents parallel_agents;
+            struct twsfwphysx_missiles parallel_missiles;
+            simulate_crowd(
+                n_threads[i], kernels[k], &parallel_agents, &parallel_missiles);
+
+            const struct twsfwphysx_pipeline_state state = {
+                parallel_agents, parallel_missiles
+            };
+            assert_state_eq(&agents, &missiles, &state);
+
+            twsfwphysx_delete_missile_batch(&parallel_missiles);
+            twsfwphysx_delete_agents(&parallel_agents);
+        }
+
+        twsfwphysx_delete_missile_batch(&missiles);
+        twsfwphysx_delete_agents(&agents);
+    }
+}
+
+int main(const int argc, const char *argv[])
+{
+    (void)argc;
+    (void)argv;
+
+    test_pipeline_matches_synchronous_simulation();
+    test_pipeline_digest();
+    test_thread_pool_matches_serial_simulation();
+
+    return 0;
+}
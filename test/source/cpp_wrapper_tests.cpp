@@ -0,0 +1,176 @@
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+#include "twsfwphysx/twsfwphysx.hpp"
+
+namespace
+{
+constexpr std::size_t N_AGENTS = 64;
+constexpr std::size_t N_MISSILES = 32;
+constexpr float T = 2.F;
+constexpr int32_t N_STEPS = 101;
+
+uint32_t STATE = 1337;
+
+float uniform()
+{
+    STATE = STATE * 1664525U + 1013904223U;
+    return static_cast<float>(STATE >> 8U) / static_cast<float>(1U << 24U) *
+               2.F -
+           1.F;
+}
+
+twsfwphysx_vec normalized(const float x, const float y, const float z)
+{
+    const float norm = std::sqrt(x * x + y * y + z * z);
+    return {x / norm, y / norm, z / norm};
+}
+
+twsfwphysx_vec perpendicular(const twsfwphysx_vec &r)
+{
+    const auto t = normalized(uniform(), uniform(), uniform());
+    return normalized(r.y * t.z - r.z * t.y,
+                      r.z * t.x - r.x * t.z,
+                      r.x * t.y - r.y * t.x);
+}
+
+// Agents are crowded in a small region such that they collide often.
+twsfwphysx::Agents make_agents(const bool with_dead)
+{
+    twsfwphysx::Agents agents(N_AGENTS);
+    for (std::size_t i = 0; i < agents.size(); i++) {
+        const auto r = normalized(uniform(), uniform(), 4.F);
+        const float hp = with_dead && i % 5 == 0 ? 0.F : 3.F;
+        agents[i] = {r, perpendicular(r), .5F * uniform(), uniform(), hp};
+    }
+
+    return agents;
+}
+
+twsfwphysx::Missiles make_missiles(const twsfwphysx::Agents &agents,
+                                   const twsfwphysx_world &world)
+{
+    twsfwphysx::Missiles missiles;
+    for (std::size_t i = 0; i < N_MISSILES; i++) {
+        auto missile = twsfwphysx_launch_missile(&agents[i], &world);
+        missile.payload = static_cast<int32_t>(i);
+        missiles.push_back(missile);
+    }
+
+    return missiles;
+}
+
+bool equal(const twsfwphysx::Agents &a, const twsfwphysx::Agents &b)
+{
+    return a.size() == b.size() &&
+           std::memcmp(a.view().data(),
+                       b.view().data(),
+                       a.size() * sizeof(twsfwphysx_agent)) == 0;
+}
+
+bool equal(const twsfwphysx::Missiles &a, const twsfwphysx::Missiles &b)
+{
+    return a.size() == b.size() &&
+           (a.empty() ||
+            std::memcmp(a.view().data(),
+                        b.view().data(),
+                        a.size() * sizeof(twsfwphysx_missile)) == 0);
+}
+
+// Compares the specialised kernel against the generic C path.
+template <class Options>
+void test_kernel(const twsfwphysx_world &world,
+                 const bool with_missiles,
+                 const bool with_dead)
+{
+    const uint32_t state = STATE;
+    auto agents = make_agents(with_dead);
+    auto missiles = with_missiles ? make_missiles(agents, world) :
+                                    twsfwphysx::Missiles();
+
+    STATE = state;
+    auto expected_agents = make_agents(with_dead);
+    auto expected_missiles = with_missiles ?
+                                 make_missiles(expected_agents, world) :
+                                 twsfwphysx::Missiles();
+    assert(equal(agents, expected_agents));
+
+    twsfwphysx::SimulationBuffer buffer;
+    twsfwphysx::SimulationBuffer expected_buffer;
+    for (int32_t i = 0; i < 3; i++) {
+        twsfwphysx::simulate<Options>(
+            agents, missiles, world, T, N_STEPS + i, buffer);
+        twsfwphysx_simulate(expected_agents.get(),
+                            expected_missiles.get(),
+                            &world,
+                            T,
+                            N_STEPS + i,
+                            expected_buffer.get());
+
+        assert(equal(agents, expected_agents));
+        assert(equal(missiles, expected_missiles));
+    }
+    assert(!with_missiles || missiles.size() < N_MISSILES);
+
+    // without buffer
+    twsfwphysx::simulate<Options>(agents, missiles, world, T, N_STEPS);
+    twsfwphysx_simulate(expected_agents.get(),
+                        expected_missiles.get(),
+                        &world,
+                        T,
+                        N_STEPS,
+                        nullptr);
+    assert(equal(agents, expected_agents));
+    assert(equal(missiles, expected_missiles));
+}
+
+void test_kernels()
+{
+    const twsfwphysx_world elastic{1.F, .02F, 5.F};
+    const twsfwphysx_world inelastic{.5F, .02F, 5.F};
+
+    using twsfwphysx::SimulationOptions;
+    test_kernel<SimulationOptions<>>(inelastic, true, true);
+    test_kernel<SimulationOptions<false, true>>(elastic, true, true);
+    test_kernel<SimulationOptions<true>>(inelastic, false, true);
+    test_kernel<SimulationOptions<true, true>>(elastic, false, true);
+    test_kernel<SimulationOptions<true, false, true>>(inelastic, false, false);
+    test_kernel<SimulationOptions<true, true, true>>(elastic, false, false);
+}
+
+void test_move()
+{
+    auto agents = make_agents(false);
+    const auto *data = agents.view().data();
+
+    twsfwphysx::Agents other(std::move(agents));
+    assert(other.view().data() == data);
+    assert(other.size() == N_AGENTS);
+    assert(agents.size() == 0);  // NOLINT(bugprone-use-after-move)
+
+    agents = std::move(other);
+    assert(agents.view().data() == data);
+
+    const twsfwphysx_world world{1.F, .02F, 5.F};
+    auto missiles = make_missiles(agents, world);
+    twsfwphysx::Missiles other_missiles;
+    other_missiles = std::move(missiles);
+    assert(other_missiles.size() == N_MISSILES);
+
+    twsfwphysx::SimulationBuffer buffer;
+    twsfwphysx::SimulationBuffer other_buffer(std::move(buffer));
+    assert(buffer.get() == nullptr);  // NOLINT(bugprone-use-after-move)
+    assert(other_buffer.get() != nullptr);
+}
+}  // namespace
+
+int main(int /*argc*/, char ** /*argv*/)
+{
+    test_kernels();
+    test_move();
+
+    return 0;
+}
@@ -0,0 +1,146 @@
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "twsfwphysx/twsfwphysx.h"
+#include "utils.h"
+
+#ifndef TWSFWPHYSX_DETERMINISTIC
+#error "This test has to be compiled with TWSFWPHYSX_DETERMINISTIC."
+#endif
+
+static uint64_t fnv1a(const void *data, const size_t size, uint64_t hash)
+{
+    const unsigned char *bytes = (const unsigned char *)data;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+void test_turn_agent(void)
+{
+    const float pi = 3.14159265F;
+
+    struct twsfwphysx_agent agent = {
+        make_vec(1.F, 0.F, 0.F), make_vec(0.F, 0.F, 1.F), 1.F, 1.F, 1.F
+    };
+
+    twsfwphysx_turn_agent(&agent, pi / 2.F);
+    assert_vec_eq(agent.u, 0.F, -1.F, 0.F);
+
+    twsfwphysx_turn_agent(&agent, -pi / 4.F);
+    assert_vec_eq(agent.u, 0.F, -sqrtf(.5F), sqrtf(.5F));
+
+    twsfwphysx_turn_agent(&agent, 100.F * pi - pi / 4.F);
+    assert_vec_eq_with_tolerance(agent.u, 0.F, 0.F, 1.F, 1e-4F);
+}
+
+void test_propagation(void)
+{
+    const struct twsfwphysx_world world = { .restitution = 1.F,
+                                            .agent_radius = .1F,
+                                            .missile_acceleration = 1.F };
+
+    // v == a, hence the agent travels half a great circle within t = pi
+    struct twsfwphysx_agents agents = twsfwphysx_create_agents(1);
+    const struct twsfwphysx_agent agent = {
+        make_vec(1.F, 0.F, 0.F), make_vec(0.F, 0.F, 1.F), 1.F, 1.F, 1.F
+    };
+    twsfwphysx_set_agent(&agents, agent, 0);
+    struct twsfwphysx_missiles missiles = twsfwphysx_new_missile_batch();
+
+    twsfwphysx_simulate(&agents, &missiles, &world, 3.14159265F, 100, NULL);
+    assert_vec_eq_with_tolerance(agents.agents[0].r, -1.F, 0.F, 0.F, 1e-4F);
+    assert(fabsf(agents.agents[0].v - 1.F) < 1e-6F);
+
+    // decelerate: v(t) = exp(-t)
+    agents.agents[0].a = 0.F;
+    twsfwphysx_simulate(&agents, &missiles, &world, 1.F, 100, NULL);
+    assert(fabsf(agents.agents[0].v - expf(-1.F)) < 1e-6F);
+
+    twsfwphysx_delete_missile_batch(&missiles);
+    twsfwphysx_delete_agents(&agents);
+}
+
+void test_bitwise_reproducible(void)
+{
+    const struct twsfwphysx_world world = { .restitution = .9F,
+                                            .agent_radius = .1F,
+                                            .missile_acceleration = 2.F };
+
+    struct twsfwphysx_agents agents = twsfwphysx_create_agents(16);
+    for (int32_t i = 0; i < agents.size; i++) {
+        const float phi = (float)i * .39269908F;
+        const struct twsfwphysx_agent agent = {
+            make_vec(cosf(phi), sinf(phi), 0.F),
+            make_vec(0.F, 0.F, i % 2 == 0 ? 1.F : -1.F),
+            .1F * (float)(i % 5),
+            .3F + .1F * (float)(i % 3),
+            5.F
+        };
+        twsfwphysx_set_agent(&agents, agent, i);
+        twsfwphysx_turn_agent(&agents.agents[i], .05F * (float)i);
+    }
+
+    // make sure that all floats of the initial state are identical on all
+    // platforms (the libm functions above might differ)
+    for (int32_t i = 0; i < agents.size; i++) {
+        struct twsfwphysx_agent *agent = &agents.agents[i];
+        agent->r.x = roundf(agent->r.x * 4096.F) / 4096.F;
+        agent->r.y = roundf(agent->r.y * 4096.F) / 4096.F;
+        agent->u.x = roundf(agent->u.x * 4096.F) / 4096.F;
+        agent->u.y = roundf(agent->u.y * 4096.F) / 4096.F;
+        agent->u.z = roundf(agent->u.z * 4096.F) / 4096.F;
+    }
+
+    struct twsfwphysx_missiles missiles = twsfwphysx_new_missile_batch();
+    for (int32_t i = 0; i < agents.size; i += 3) {
+        struct twsfwphysx_missile missile =
+            twsfwphysx_launch_missile(&agents.agents[i], &world);
+        missile.payload = i;
+        twsfwphysx_add_missile(&missiles, missile);
+    }
+
+    struct twsfwphysx_simulation_buffer *buffer =
+        twsfwphysx_create_simulation_buffer();
+    for (int32_t tick = 0; tick < 60; tick++) {
+        twsfwphysx_simulate(&agents, &missiles, &world, 1.F / 6.F, 8, buffer);
+    }
+
+    uint64_t hash = 14695981039346656037ULL;
+    hash = fnv1a(agents.agents,
+                 (size_t)agents.size * sizeof(struct twsfwphysx_agent),
+                 hash);
+    hash = fnv1a(missiles.missiles,
+                 (size_t)missiles.size * sizeof(struct twsfwphysx_missile),
+                 hash);
+
+    const uint64_t expected = 0xcb1e458fe6716566ULL;
+    if (hash != expected) {
+        fprintf(stderr,
+                "state hash: %016llx (%d missiles)\n",
+                (unsigned long long)hash,
+                missiles.size);
+    }
+    assert(hash == expected);
+
+    twsfwphysx_delete_simulation_buffer(buffer);
+    twsfwphysx_delete_missile_batch(&missiles);
+    twsfwphysx_delete_agents(&agents);
+}
+
+int main(const int argc, const char *argv[])
+{
+    (void)argc;
+    (void)argv;
+
+    test_turn_agent();
+    test_propagation();
+    test_bitwise_reproducible();
+
+    return 0;
+}
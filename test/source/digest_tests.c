@@ -0,0 +1,174 @@
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "twsfwphysx/twsfwphysx.h"
+#include "utils.h"
+
+static const struct twsfwphysx_world WORLD = { .restitution = 1.F,
+                                               .agent_radius = .1F,
+                                               .missile_acceleration = 2.F };
+
+static void assert_digest_eq(const struct twsfwphysx_digest *d1,
+                             const struct twsfwphysx_digest *d2)
+{
+    assert(memcmp(d1, d2, sizeof(struct twsfwphysx_digest)) == 0);
+}
+
+static void assert_regions_consistent(const struct twsfwphysx_digest *digest)
+{
+    uint64_t sum = 0;
+    for (int32_t i = 0; i < TWSFWPHYSX_DIGEST_REGIONS; i++) {
+        sum += digest->regions[i];
+    }
+    assert(sum == digest->agents + digest->missiles);
+}
+
+static struct twsfwphysx_agents make_agents(void)
+{
+    struct twsfwphysx_agents agents = twsfwphysx_create_agents(3);
+    const struct twsfwphysx_agent agent1 = { make_vec(0.F, 1.F, 0.F),
+                                             make_vec(0.F, 0.F, 1.F),
+                                             0.F,
+                                             0.F,
+                                             20.F };
+    const struct twsfwphysx_agent agent2 = { make_vec(1.F, 0.F, 0.F),
+                                             make_vec(0.F, 0.F, 1.F),
+                                             1.F,
+                                             1.F,
+                                             5.F };
+    const struct twsfwphysx_agent agent3 = { make_vec(0.F, 0.F, -1.F),
+                                             make_vec(1.F, 0.F, 0.F),
+                                             .5F,
+                                             .5F,
+                                             5.F };
+    twsfwphysx_set_agent(&agents, agent1, 0);
+    twsfwphysx_set_agent(&agents, agent2, 1);
+    twsfwphysx_set_agent(&agents, agent3, 2);
+
+    return agents;
+}
+
+void test_incremental_digest_matches_full_digest(void)
+{
+    struct twsfwphysx_agents agents = make_agents();
+    struct twsfwphysx_missiles missiles = twsfwphysx_new_missile_batch();
+    for (int32_t i = 0; i < agents.size; i++) {
+        struct twsfwphysx_missile missile =
+            twsfwphysx_launch_missile(&agents.agents[i], &WORLD);
+        missile.payload = i;
+        twsfwphysx_add_missile(&missiles, missile);
+    }
+
+    struct twsfwphysx_simulation_buffer *buffer =
+        twsfwphysx_create_simulation_buffer();
+    struct twsfwphysx_digest digest;
+    twsfwphysx_set_digest(buffer, &digest);
+
+    struct twsfwphysx_digest expected;
+    for (int32_t tick = 0; tick < 20; tick++) {
+        twsfwphysx_simulate(&agents, &missiles, &WORLD, .25F, 25, buffer);
+
+        twsfwphysx_compute_digest(&agents, &missiles, &expected);
+        assert_digest_eq(&digest, &expected);
+        assert_regions_consistent(&digest);
+    }
+
+    // agents collided and missiles detonated in the meantime
+    assert(agents.agents[0].v > 0.F);
+    assert(missiles.size < agents.size);
+
+    // no simulation steps
+    twsfwphysx_turn_agent(&agents.agents[0], 1.F);
+    twsfwphysx_simulate(&agents, &missiles, &WORLD, 0.F, 0, buffer);
+    twsfwphysx_compute_digest(&agents, &missiles, &expected);
+    assert_digest_eq(&digest, &expected);
+
+    // detach
+    twsfwphysx_set_digest(buffer, NULL);
+    twsfwphysx_simulate(&agents, &missiles, &WORLD, 1.F, 10, buffer);
+    assert_digest_eq(&digest, &expected);
+
+    twsfwphysx_delete_simulation_buffer(buffer);
+    twsfwphysx_delete_missile_batch(&missiles);
+    twsfwphysx_delete_agents(&agents);
+}
+
+void test_digest_is_order_independent(void)
+{
+    struct twsfwphysx_agents agents = twsfwphysx_create_agents(0);
+
+    const struct twsfwphysx_missile m1 = {
+        make_vec(1.F, 0.F, 0.F), make_vec(0.F, 0.F, 1.F), 1.F, 1
+    };
+    const struct twsfwphysx_missile m2 = {
+        make_vec(0.F, -1.F, 0.F), make_vec(0.F, 0.F, 1.F), 1.F, 2
+    };
+
+    struct twsfwphysx_missiles missiles1 = twsfwphysx_new_missile_batch();
+    twsfwphysx_add_missile(&missiles1, m1);
+    twsfwphysx_add_missile(&missiles1, m2);
+
+    struct twsfwphysx_missiles missiles2 = twsfwphysx_new_missile_batch();
+    twsfwphysx_add_missile(&missiles2, m2);
+    twsfwphysx_add_missile(&missiles2, m1);
+
+    struct twsfwphysx_digest d1;
+    struct twsfwphysx_digest d2;
+    twsfwphysx_compute_digest(&agents, &missiles1, &d1);
+    twsfwphysx_compute_digest(&agents, &missiles2, &d2);
+    assert_digest_eq(&d1, &d2);
+    assert(d1.agents == 0);
+    assert(d1.missiles != 0);
+    assert(d1.regions[0] != 0);
+    assert(d1.regions[2] != 0);
+
+    twsfwphysx_delete_missile_batch(&missiles2);
+    twsfwphysx_delete_missile_batch(&missiles1);
+    twsfwphysx_delete_agents(&agents);
+}
+
+void test_digest_localizes_divergence(void)
+{
+    struct twsfwphysx_agents agents = make_agents();
+    struct twsfwphysx_missiles missiles = twsfwphysx_new_missile_batch();
+
+    struct twsfwphysx_digest d1;
+    twsfwphysx_compute_digest(&agents, &missiles, &d1);
+
+    // smallest possible change of agent 2 (which is in the southern
+    // hemisphere, i.e., in region 4)
+    agents.agents[2].hp = nextafterf(agents.agents[2].hp, 0.F);
+
+    struct twsfwphysx_digest d2;
+    twsfwphysx_compute_digest(&agents, &missiles, &d2);
+    assert(d1.agents != d2.agents);
+    assert(d1.missiles == d2.missiles);
+    for (int32_t i = 0; i < TWSFWPHYSX_DIGEST_REGIONS; i++) {
+        assert((d1.regions[i] == d2.regions[i]) == (i != 4));
+    }
+
+    // swapping agents changes the digest as well
+    agents.agents[2].hp = agents.agents[1].hp;
+    struct twsfwphysx_agent tmp = agents.agents[0];
+    agents.agents[0] = agents.agents[1];
+    agents.agents[1] = tmp;
+    twsfwphysx_compute_digest(&agents, &missiles, &d2);
+    assert(d1.agents != d2.agents);
+
+    twsfwphysx_delete_missile_batch(&missiles);
+    twsfwphysx_delete_agents(&agents);
+}
+
+int main(const int argc, const char *argv[])
+{
+    (void)argc;
+    (void)argv;
+
+    test_incremental_digest_matches_full_digest();
+    test_digest_is_order_independent();
+    test_digest_localizes_divergence();
+
+    return 0;
+}
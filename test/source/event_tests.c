@@ -0,0 +1,189 @@
+#include <assert.h>
+#include <math.h>
+#include <stddef.h>
+
+#include "twsfwphysx/twsfwphysx.h"
+#include "utils.h"
+
+void test_collision_events(void)
+{
+    const struct twsfwphysx_world world = { .restitution = 1.F,
+                                            .agent_radius = .1F,
+                                            .missile_acceleration = 1.F };
+
+    const struct twsfwphysx_agent agent1 = { make_vec(0.F, 1.F, 0.F),
+                                             make_vec(0.F, 0.F, 1.F),
+                                             0.F,
+                                             0.F,
+                                             5 };
+    const struct twsfwphysx_agent agent2 = { make_vec(1.F, 0.F, 0.F),
+                                             make_vec(0.F, 0.F, 1.F),
+                                             1.F,
+                                             1.F,
+                                             5 };
+    struct twsfwphysx_agents agents = twsfwphysx_create_agents(2);
+    twsfwphysx_set_agent(&agents, agent1, 0);
+    twsfwphysx_set_agent(&agents, agent2, 1);
+    struct twsfwphysx_missiles missiles = twsfwphysx_new_missile_batch();
+
+    struct twsfwphysx_event storage[16];
+    struct twsfwphysx_events events = twsfwphysx_make_events(storage, 16);
+    struct twsfwphysx_simulation_buffer *buffer =
+        twsfwphysx_create_simulation_buffer();
+    twsfwphysx_set_events(buffer, &events);
+
+    twsfwphysx_simulate(&agents, &missiles, &world, 2.F, 100, buffer);
+
+    assert(events.size >= 1);
+    assert(events.n_dropped == 0);
+
+    const struct twsfwphysx_event *event = twsfwphysx_get_event(&events, 0);
+    assert(event->type == TWSFWPHYSX_EVENT_COLLISION);
+    assert(event->a == 0);
+    assert(event->b == 1);
+    assert(event->step > 0 && event->step < 100);
+    assert(event->value > 0.F);
+
+    // the resting agent has been pushed away
+    assert(agents.agents[0].v > 0.F);
+
+    twsfwphysx_clear_events(&events);
+    assert(events.size == 0);
+
+    twsfwphysx_delete_simulation_buffer(buffer);
+    twsfwphysx_delete_missile_batch(&missiles);
+    twsfwphysx_delete_agents(&agents);
+}
+
+void test_hit_events(void)
+{
+    const struct twsfwphysx_world world = { .restitution = 1.F,
+                                            .agent_radius = .1F,
+                                            .missile_acceleration = 1.F };
+
+    const struct twsfwphysx_agent agent1 = { make_vec(1.F, 0.F, 0.F),
+                                             make_vec(0.F, 0.F, 1.F),
+                                             0.F,
+                                             0.F,
+                                             5 };
+    const struct twsfwphysx_agent agent2 = { make_vec(0.F, 0.F, 1.F),
+                                             make_vec(-1.F, 0.F, 0.F),
+                                             0.F,
+                                             0.F,
+                                             5 };
+    struct twsfwphysx_agents agents = twsfwphysx_create_agents(2);
+    twsfwphysx_set_agent(&agents, agent1, 0);
+    twsfwphysx_set_agent(&agents, agent2, 1);
+
+    // m1 hits agent1 from behind, m2 hits agent2 head-on
+    const struct twsfwphysx_missile m1 = { make_vec(-1.F, 0.F, 0.F),
+                                           make_vec(0.F, 0.F, 1.F),
+                                           1.F,
+                                           42 };
+    const struct twsfwphysx_missile m2 = { make_vec(0.F, 1.F, 0.F),
+                                           make_vec(1.F, 0.F, 0.F),
+                                           1.F,
+                                           1337 };
+    struct twsfwphysx_missiles missiles = twsfwphysx_new_missile_batch();
+    twsfwphysx_add_missile(&missiles, m1);
+    twsfwphysx_add_missile(&missiles, m2);
+
+    struct twsfwphysx_event storage[4];
+    struct twsfwphysx_events events = twsfwphysx_make_events(storage, 4);
+    struct twsfwphysx_simulation_buffer *buffer =
+        twsfwphysx_create_simulation_buffer();
+    twsfwphysx_set_events(buffer, &events);
+
+    twsfwphysx_simulate(&agents, &missiles, &world, 4.F, 200, buffer);
+    assert(missiles.size == 0);
+    assert(events.size == 2);
+
+    const struct twsfwphysx_event *e1 = twsfwphysx_get_event(&events, 0);
+    assert(e1->type == TWSFWPHYSX_EVENT_HIT_HEAD_ON);
+    assert(e1->a == 1);
+    assert(e1->b == 1337);
+    assert(fabsf(e1->value - 1.F) < 1e-6F);
+
+    const struct twsfwphysx_event *e2 = twsfwphysx_get_event(&events, 1);
+    assert(e2->type == TWSFWPHYSX_EVENT_HIT_REAR);
+    assert(e2->a == 0);
+    assert(e2->b == 42);
+    assert(fabsf(e2->value - 3.F) < 1e-6F);
+    assert(e1->step < e2->step);
+
+    assert(fabsf(agents.agents[0].hp - (5.F - e2->value)) < 1e-6F);
+    assert(fabsf(agents.agents[1].hp - (5.F - e1->value)) < 1e-6F);
+
+    twsfwphysx_delete_simulation_buffer(buffer);
+    twsfwphysx_delete_missile_batch(&missiles);
+    twsfwphysx_delete_agents(&agents);
+}
+
+void test_ring_overrides_oldest_events(void)
+{
+    const struct twsfwphysx_world world = { .restitution = 1.F,
+                                            .agent_radius = .1F,
+                                            .missile_acceleration = 1.F };
+
+    const struct twsfwphysx_agent agent = { make_vec(0.F, 0.F, 1.F),
+                                            make_vec(1.F, 0.F, 0.F),
+                                            0.F,
+                                            0.F,
+                                            100 };
+    struct twsfwphysx_agents agents = twsfwphysx_create_agents(1);
+    twsfwphysx_set_agent(&agents, agent, 0);
+
+    // five missiles right next to the agent detonate in the first step
+    struct twsfwphysx_missiles missiles = twsfwphysx_new_missile_batch();
+    for (int32_t i = 0; i < 5; i++) {
+        const struct twsfwphysx_missile missile = {
+            make_vec(0.F, 0.F, 1.F), make_vec(1.F, 0.F, 0.F), 0.F, i
+        };
+        twsfwphysx_add_missile(&missiles, missile);
+    }
+
+    struct twsfwphysx_event storage[3];
+    struct twsfwphysx_events events = twsfwphysx_make_events(storage, 3);
+    struct twsfwphysx_simulation_buffer *buffer =
+        twsfwphysx_create_simulation_buffer();
+    twsfwphysx_set_events(buffer, &events);
+
+    twsfwphysx_simulate(&agents, &missiles, &world, 1.F, 10, buffer);
+    assert(events.size == 3);
+    assert(events.n_dropped == 2);
+
+    // missiles are processed in reverse order
+    for (int32_t i = 0; i < events.size; i++) {
+        const struct twsfwphysx_event *event = twsfwphysx_get_event(&events, i);
+        assert(event->type == TWSFWPHYSX_EVENT_HIT_REAR);
+        assert(event->step == 0);
+        assert(event->b == 2 - i);
+    }
+
+    // detached rings are not touched
+    twsfwphysx_clear_events(&events);
+    twsfwphysx_set_events(buffer, NULL);
+    const struct twsfwphysx_missile missile = {
+        make_vec(0.F, 0.F, 1.F), make_vec(1.F, 0.F, 0.F), 0.F, 5
+    };
+    twsfwphysx_add_missile(&missiles, missile);
+    twsfwphysx_simulate(&agents, &missiles, &world, 1.F, 10, buffer);
+    assert(missiles.size == 0);
+    assert(events.size == 0);
+
+    twsfwphysx_delete_simulation_buffer(buffer);
+    twsfwphysx_delete_missile_batch(&missiles);
+    twsfwphysx_delete_agents(&agents);
+}
+
+int main(const int argc, const char *argv[])
+{
+    (void)argc;
+    (void)argv;
+
+    test_collision_events();
+    test_hit_events();
+    test_ring_overrides_oldest_events();
+
+    return 0;
+}
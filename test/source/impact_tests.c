@@ -0,0 +1,224 @@
+#include <assert.h>
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "twsfwphysx/twsfwphysx.h"
+#include "utils.h"
+
+enum { N_AGENTS = 40, N_STEPS = 4000, N_EVENTS = 1024 };
+
+static const struct twsfwphysx_world WORLD = { .restitution = 1.F,
+                                               .agent_radius = .015F,
+                                               .missile_acceleration = 5.F };
+
+static uint32_t STATE = 1337;
+
+static float uniform(void)
+{
+    STATE = STATE * 1664525U + 1013904223U;
+    return (float)(STATE >> 8U) / (float)(1U << 24U) * 2.F - 1.F;
+}
+
+static struct twsfwphysx_vec random_unit(void)
+{
+    for (;;) {
+        const float x = uniform();
+        const float y = uniform();
+        const float z = uniform();
+        const float norm = sqrtf(x * x + y * y + z * z);
+        if (norm > .1F && norm < 1.F) {
+            return make_vec(x / norm, y / norm, z / norm);
+        }
+    }
+}
+
+static struct twsfwphysx_vec perpendicular(const struct twsfwphysx_vec r)
+{
+    const struct twsfwphysx_vec t = random_unit();
+    const float x = r.y * t.z - r.z * t.y;
+    const float y = r.z * t.x - r.x * t.z;
+    const float z = r.x * t.y - r.y * t.x;
+    const float norm = sqrtf(x * x + y * y + z * z);
+    return make_vec(x / norm, y / norm, z / norm);
+}
+
+void test_head_on_impact(void)
+{
+    struct twsfwphysx_agents agents = twsfwphysx_create_agents(2);
+    const struct twsfwphysx_agent agent = {
+        make_vec(1.F, 0.F, 0.F), make_vec(0.F, 0.F, 1.F), 0.F, 0.F, 1.F
+    };
+    twsfwphysx_set_agent(&agents, agent, 0);
+
+    // a dead agent right in front of the missile is ignored
+    const struct twsfwphysx_agent dead = { make_vec(cosf(.5F), sinf(.5F), 0.F),
+                                           make_vec(0.F, 0.F, 1.F),
+                                           0.F,
+                                           0.F,
+                                           0.F };
+    twsfwphysx_set_agent(&agents, dead, 1);
+
+    // the missile flies at terminal velocity towards the agent
+    struct twsfwphysx_missiles missiles = twsfwphysx_new_missile_batch();
+    const struct twsfwphysx_missile missile = {
+        make_vec(cosf(.6F), sinf(.6F), 0.F), make_vec(0.F, 0.F, -1.F), 5.F, 0
+    };
+    twsfwphysx_add_missile(&missiles, missile);
+
+    struct twsfwphysx_spatial_index *index = twsfwphysx_create_spatial_index();
+    struct twsfwphysx_impact impact;
+
+    assert(twsfwphysx_predict_missile_impacts(
+               &agents, &missiles, &WORLD, 1.F, index, &impact) == 1);
+    assert(impact.target == 0);
+    assert(fabsf(impact.t - (.6F - WORLD.agent_radius) / 5.F) < 1e-4F);
+
+    // the horizon is too short
+    assert(twsfwphysx_predict_missile_impacts(
+               &agents, &missiles, &WORLD, .1F, index, &impact) == 0);
+    assert(impact.target == -1);
+    assert(fabsf(impact.t - .1F) < 1e-6F);
+
+    // the missile flies away from the agent (and around the sphere)
+    missiles.missiles[0].u = make_vec(0.F, 0.F, 1.F);
+    assert(twsfwphysx_predict_missile_impacts(
+               &agents, &missiles, &WORLD, 1.F, index, &impact) == 0);
+    assert(twsfwphysx_predict_missile_impacts(
+               &agents, &missiles, &WORLD, 2.F, index, &impact) == 1);
+    const float around = 2.F * 3.14159265F - .6F - WORLD.agent_radius;
+    assert(fabsf(impact.t - around / 5.F) < 1e-4F);
+
+    twsfwphysx_delete_spatial_index(index);
+    twsfwphysx_delete_missile_batch(&missiles);
+    twsfwphysx_delete_agents(&agents);
+}
+
+static struct twsfwphysx_vec ahead_of(const struct twsfwphysx_agent *agent,
+                                      const float angle)
+{
+    const struct twsfwphysx_vec r = agent->r;
+    const struct twsfwphysx_vec u = agent->u;
+    const float c = cosf(angle);
+    const float s = sinf(angle);
+    return make_vec(c * r.x + s * (u.y * r.z - u.z * r.y),
+                    c * r.y + s * (u.z * r.x - u.x * r.z),
+                    c * r.z + s * (u.x * r.y - u.y * r.x));
+}
+
+static int32_t first_event(const struct twsfwphysx_events *events,
+                           const int32_t type,
+                           const int32_t b)
+{
+    for (int32_t i = 0; i < events->size; i++) {
+        const struct twsfwphysx_event *event = twsfwphysx_get_event(events, i);
+        const int32_t is_hit = event->type != TWSFWPHYSX_EVENT_COLLISION;
+        const int32_t is_type = type == TWSFWPHYSX_EVENT_COLLISION ?
+                                    !is_hit :
+                                    is_hit && event->b == b;
+        if (is_type) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+void test_predictions_match_simulation(void)
+{
+    struct twsfwphysx_agents agents = twsfwphysx_create_agents(N_AGENTS);
+    for (int32_t i = 0; i < N_AGENTS; i++) {
+        const struct twsfwphysx_vec r = random_unit();
+        const struct twsfwphysx_agent agent = {
+            r, perpendicular(r), .1F * (uniform() + 1.F), .1F, 1e6F
+        };
+        twsfwphysx_set_agent(&agents, agent, i);
+    }
+
+    struct twsfwphysx_missiles missiles = twsfwphysx_new_missile_batch();
+    for (int32_t i = 0; i < N_AGENTS; i++) {
+        // launched missiles touch the shooter within the precision of floats
+        const struct twsfwphysx_agent *shooter = &agents.agents[i];
+        const struct twsfwphysx_missile missile = {
+            ahead_of(shooter, 2.F * WORLD.agent_radius),
+            shooter->u,
+            WORLD.missile_acceleration,
+            i
+        };
+        twsfwphysx_add_missile(&missiles, missile);
+    }
+
+    struct twsfwphysx_spatial_index *index = twsfwphysx_create_spatial_index();
+
+    // predictions are only valid until the first collision
+    struct twsfwphysx_impact collisions[N_AGENTS];
+    const float max_horizon = 6.F;
+    const int32_t n_collisions = twsfwphysx_predict_collisions(
+        &agents, &WORLD, max_horizon, index, collisions);
+    assert(n_collisions > 0);
+    float horizon = max_horizon;
+    for (int32_t i = 0; i < N_AGENTS; i++) {
+        assert((collisions[i].target >= 0) ==
+               (collisions[i].t < max_horizon));
+        horizon = fminf(horizon, collisions[i].t);
+    }
+    assert(horizon > .5F);
+
+    struct twsfwphysx_impact impacts[N_AGENTS];
+    const int32_t n_impacts = twsfwphysx_predict_missile_impacts(
+        &agents, &missiles, &WORLD, horizon, index, impacts);
+    assert(n_impacts > 0);
+
+    struct twsfwphysx_event storage[N_EVENTS];
+    struct twsfwphysx_events events =
+        twsfwphysx_make_events(storage, N_EVENTS);
+    struct twsfwphysx_simulation_buffer *buffer =
+        twsfwphysx_create_simulation_buffer();
+    twsfwphysx_set_events(buffer, &events);
+
+    const float dt = max_horizon / (float)N_STEPS;
+    twsfwphysx_simulate(
+        &agents, &missiles, &WORLD, max_horizon, N_STEPS, buffer);
+    assert(events.n_dropped == 0);
+
+    // the first collision
+    const int32_t c = first_event(&events, TWSFWPHYSX_EVENT_COLLISION, 0);
+    assert(c >= 0);
+    const float t_collision =
+        (float)(twsfwphysx_get_event(&events, c)->step + 1) * dt;
+    assert(fabsf(t_collision - horizon) <= dt);
+
+    // all hits until the first collision
+    for (int32_t i = 0; i < N_AGENTS; i++) {
+        const int32_t k = first_event(&events, TWSFWPHYSX_EVENT_HIT_REAR, i);
+        const struct twsfwphysx_event *hit =
+            k >= 0 ? twsfwphysx_get_event(&events, k) : NULL;
+        const float t_hit = hit != NULL ? (float)hit->step * dt : 1e9F;
+
+        if (impacts[i].target < 0) {
+            assert(t_hit > horizon - dt);
+            continue;
+        }
+
+        assert(hit != NULL);
+        assert(hit->a == impacts[i].target);
+        assert(t_hit >= impacts[i].t);
+        assert(t_hit - impacts[i].t <= 2.F * dt);
+    }
+
+    twsfwphysx_delete_simulation_buffer(buffer);
+    twsfwphysx_delete_spatial_index(index);
+    twsfwphysx_delete_missile_batch(&missiles);
+    twsfwphysx_delete_agents(&agents);
+}
+
+int main(const int argc, const char *argv[])
+{
+    (void)argc;
+    (void)argv;
+
+    test_head_on_impact();
+    test_predictions_match_simulation();
+
+    return 0;
+}
@@ -0,0 +1,187 @@
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "twsfwphysx/twsfwphysx.h"
+#include "utils.h"
+
+#ifndef TWSFWPHYSX_MMAP
+#error "This test has to be compiled with TWSFWPHYSX_MMAP."
+#endif
+
+static const char *PATH = "replay_tests.replay";
+
+static const struct twsfwphysx_world WORLD = { .restitution = 1.F,
+                                               .agent_radius = .1F,
+                                               .missile_acceleration = 2.F };
+
+// some inputs that depend on the tick
+static void apply_inputs(struct twsfwphysx_agents *agents,
+                         struct twsfwphysx_missiles *missiles,
+                         const int32_t tick)
+{
+    const int32_t i = tick % agents->size;
+    twsfwphysx_turn_agent(&agents->agents[i], .1F * (float)tick);
+
+    if (tick % 3 == 0) {
+        struct twsfwphysx_missile missile =
+            twsfwphysx_launch_missile(&agents->agents[i], &WORLD);
+        missile.payload = tick;
+        twsfwphysx_add_missile(missiles, missile);
+    }
+
+    if (tick % 7 == 0) {
+        agents->agents[(i + 1) % agents->size].a += .25F;
+    }
+
+    // a late joiner
+    if (tick == 13) {
+        const struct twsfwphysx_agent agent = { make_vec(0.F, -1.F, 0.F),
+                                                make_vec(1.F, 0.F, 0.F),
+                                                0.F,
+                                                .75F,
+                                                10.F };
+        struct twsfwphysx_agents more = twsfwphysx_create_agents(4);
+        memcpy(more.agents,
+               agents->agents,
+               (size_t)agents->size * sizeof(struct twsfwphysx_agent));
+        twsfwphysx_set_agent(&more, agent, 3);
+        twsfwphysx_delete_agents(agents);
+        *agents = more;
+    }
+}
+
+static void assert_state_eq(const struct twsfwphysx_agents *agents1,
+                            const struct twsfwphysx_missiles *missiles1,
+                            const struct twsfwphysx_agents *agents2,
+                            const struct twsfwphysx_missiles *missiles2)
+{
+    assert(agents1->size == agents2->size);
+    assert(memcmp(agents1->agents,
+                  agents2->agents,
+                  (size_t)agents1->size * sizeof(struct twsfwphysx_agent)) ==
+           0);
+
+    assert(missiles1->size == missiles2->size);
+    if (missiles1->size > 0) {
+        assert(memcmp(missiles1->missiles,
+                      missiles2->missiles,
+                      (size_t)missiles1->size *
+                          sizeof(struct twsfwphysx_missile)) == 0);
+    }
+}
+
+void test_seek_reproduces_recording(void)
+{
+    const int32_t n_ticks = 40;
+
+    struct twsfwphysx_agents agents = make_three_agents();
+    struct twsfwphysx_missiles missiles = twsfwphysx_new_missile_batch();
+    struct twsfwphysx_simulation_buffer *buffer =
+        twsfwphysx_create_simulation_buffer();
+    struct twsfwphysx_snapshots *expected =
+        twsfwphysx_create_snapshots(n_ticks + 1, 4, 16);
+
+    struct twsfwphysx_recorder *recorder =
+        twsfwphysx_create_recorder(PATH, &WORLD, 8, &agents, &missiles);
+    assert(recorder != NULL);
+    twsfwphysx_snapshot(expected, 0, &agents, &missiles);
+
+    for (int32_t tick = 1; tick <= n_ticks; tick++) {
+        apply_inputs(&agents, &missiles, tick);
+        twsfwphysx_record_simulate(
+            recorder, &agents, &missiles, .25F, 25, buffer);
+        twsfwphysx_snapshot(expected, tick, &agents, &missiles);
+    }
+    assert(twsfwphysx_delete_recorder(recorder) == 1);
+
+    // something happened in the meantime
+    assert(agents.size == 4);
+    assert(agents.agents[0].hp < 20.F);
+
+    struct twsfwphysx_replay *replay = twsfwphysx_open_replay(PATH);
+    assert(replay != NULL);
+    assert(twsfwphysx_replay_n_ticks(replay) == n_ticks + 1);
+
+    const struct twsfwphysx_world world = twsfwphysx_replay_world(replay);
+    assert(memcmp(&world, &WORLD, sizeof(struct twsfwphysx_world)) == 0);
+
+    struct twsfwphysx_agents replayed_agents = twsfwphysx_create_agents(0);
+    struct twsfwphysx_missiles replayed_missiles =
+        twsfwphysx_new_missile_batch();
+
+    // seek backwards to reconstruct every tick from scratch
+    for (int32_t tick = n_ticks; tick >= 0; tick--) {
+        assert(twsfwphysx_replay_seek(replay,
+                                      tick,
+                                      &replayed_agents,
+                                      &replayed_missiles,
+                                      buffer) == 1);
+        assert(twsfwphysx_restore(expected, tick, &agents, &missiles) == 1);
+        assert_state_eq(
+            &agents, &missiles, &replayed_agents, &replayed_missiles);
+    }
+
+    twsfwphysx_close_replay(replay);
+    assert(remove(PATH) == 0);
+
+    twsfwphysx_delete_missile_batch(&replayed_missiles);
+    twsfwphysx_delete_agents(&replayed_agents);
+    twsfwphysx_delete_snapshots(expected);
+    twsfwphysx_delete_simulation_buffer(buffer);
+    twsfwphysx_delete_missile_batch(&missiles);
+    twsfwphysx_delete_agents(&agents);
+}
+
+void test_deltas_are_compact(void)
+{
+    struct twsfwphysx_agents agents = make_three_agents();
+    struct twsfwphysx_missiles missiles = twsfwphysx_new_missile_batch();
+
+    struct twsfwphysx_recorder *recorder =
+        twsfwphysx_create_recorder(PATH, &WORLD, 1000, &agents, &missiles);
+    for (int32_t tick = 1; tick <= 100; tick++) {
+        twsfwphysx_record_simulate(
+            recorder, &agents, &missiles, .1F, 10, NULL);
+    }
+    assert(twsfwphysx_delete_recorder(recorder) == 1);
+
+    // without inputs, a tick only costs 25 bytes
+    FILE *file = fopen(PATH, "rb");
+    assert(file != NULL);
+    assert(fseek(file, 0, SEEK_END) == 0);
+    const long size = ftell(file);
+    assert(fclose(file) == 0);
+    assert(size == 32 + (1 + 4 + 3 * 36 + 4) + 100 * 25 + 8 + 24);
+
+    assert(remove(PATH) == 0);
+    twsfwphysx_delete_missile_batch(&missiles);
+    twsfwphysx_delete_agents(&agents);
+}
+
+void test_invalid_files(void)
+{
+    assert(twsfwphysx_open_replay("does_not_exist.replay") == NULL);
+
+    FILE *file = fopen(PATH, "wb");
+    assert(file != NULL);
+    char garbage[128];
+    memset(garbage, 42, sizeof(garbage));
+    assert(fwrite(garbage, 1, sizeof(garbage), file) == sizeof(garbage));
+    assert(fclose(file) == 0);
+    assert(twsfwphysx_open_replay(PATH) == NULL);
+
+    assert(remove(PATH) == 0);
+}
+
+int main(const int argc, const char *argv[])
+{
+    (void)argc;
+    (void)argv;
+
+    test_seek_reproduces_recording();
+    test_deltas_are_compact();
+    test_invalid_files();
+
+    return 0;
+}
@@ -0,0 +1,124 @@
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "twsfwphysx/twsfwphysx.h"
+#include "utils.h"
+
+#ifndef TWSFWPHYSX_MMAP
+#error "This test has to be compiled with TWSFWPHYSX_MMAP."
+#endif
+
+static const char *PATH = "shared_tests.shm";
+
+static const struct twsfwphysx_world WORLD = { .restitution = 1.F,
+                                               .agent_radius = .1F,
+                                               .missile_acceleration = 2.F };
+
+static void assert_state_eq(const struct twsfwphysx_agents *agents,
+                            const struct twsfwphysx_missiles *missiles,
+                            const struct twsfwphysx_shared_state *state)
+{
+    assert(agents->size == state->agents.size);
+    assert(memcmp(agents->agents,
+                  state->agents.agents,
+                  (size_t)agents->size * sizeof(struct twsfwphysx_agent)) ==
+           0);
+
+    assert(missiles->size == state->missiles.size);
+    if (missiles->size > 0) {
+        assert(memcmp(missiles->missiles,
+                      state->missiles.missiles,
+                      (size_t)missiles->size *
+                          sizeof(struct twsfwphysx_missile)) == 0);
+    }
+}
+
+void test_subscriber_reads_latest_publication(void)
+{
+    struct twsfwphysx_agents agents = make_three_agents();
+    struct twsfwphysx_missiles missiles = twsfwphysx_new_missile_batch();
+
+    struct twsfwphysx_publisher *publisher =
+        twsfwphysx_create_publisher(PATH, 4, 8);
+    assert(publisher != NULL);
+
+    struct twsfwphysx_subscriber *subscriber =
+        twsfwphysx_open_subscriber(PATH);
+    assert(subscriber != NULL);
+
+    // nothing has been published yet
+    struct twsfwphysx_shared_state state;
+    assert(twsfwphysx_read_shared(subscriber, &state) == 0);
+
+    for (int64_t tick = 0; tick < 10; tick++) {
+        const struct twsfwphysx_missile missile =
+            twsfwphysx_launch_missile(&agents.agents[tick % 3], &WORLD);
+        twsfwphysx_add_missile(&missiles, missile);
+        twsfwphysx_simulate(&agents, &missiles, &WORLD, .25F, 25, NULL);
+        assert(twsfwphysx_publish(publisher, tick, &agents, &missiles) == 1);
+
+        assert(twsfwphysx_read_shared(subscriber, &state) == 1);
+        assert(state.tick == tick);
+        assert_state_eq(&agents, &missiles, &state);
+        assert(twsfwphysx_validate_shared(&state) == 1);
+    }
+
+    // a publication stays intact during the next two publications
+    assert(twsfwphysx_read_shared(subscriber, &state) == 1);
+    assert(twsfwphysx_publish(publisher, 10, &agents, &missiles) == 1);
+    assert(twsfwphysx_publish(publisher, 11, &agents, &missiles) == 1);
+    assert(state.tick == 9);
+    assert(twsfwphysx_validate_shared(&state) == 1);
+
+    // ... but not during the third one
+    assert(twsfwphysx_publish(publisher, 12, &agents, &missiles) == 1);
+    assert(twsfwphysx_validate_shared(&state) == 0);
+
+    // too many missiles
+    while (missiles.size <= 8) {
+        const struct twsfwphysx_missile missile =
+            twsfwphysx_launch_missile(&agents.agents[0], &WORLD);
+        twsfwphysx_add_missile(&missiles, missile);
+    }
+    assert(twsfwphysx_publish(publisher, 13, &agents, &missiles) == 0);
+    assert(twsfwphysx_read_shared(subscriber, &state) == 1);
+    assert(state.tick == 12);
+
+    // the latest publication outlives the publisher
+    twsfwphysx_delete_publisher(publisher);
+    assert(twsfwphysx_read_shared(subscriber, &state) == 1);
+    assert(state.tick == 12);
+    assert(twsfwphysx_validate_shared(&state) == 1);
+    twsfwphysx_close_subscriber(subscriber);
+
+    assert(remove(PATH) == 0);
+    twsfwphysx_delete_missile_batch(&missiles);
+    twsfwphysx_delete_agents(&agents);
+}
+
+void test_invalid_regions(void)
+{
+    assert(twsfwphysx_open_subscriber("does_not_exist.shm") == NULL);
+
+    FILE *file = fopen(PATH, "wb");
+    assert(file != NULL);
+    char garbage[256];
+    memset(garbage, 42, sizeof(garbage));
+    assert(fwrite(garbage, 1, sizeof(garbage), file) == sizeof(garbage));
+    assert(fclose(file) == 0);
+    assert(twsfwphysx_open_subscriber(PATH) == NULL);
+
+    assert(remove(PATH) == 0);
+}
+
+int main(const int argc, const char *argv[])
+{
+    (void)argc;
+    (void)argv;
+
+    test_subscriber_reads_latest_publication();
+    test_invalid_regions();
+
+    return 0;
+}
@@ -0,0 +1,184 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "twsfwphysx/twsfwphysx.h"
+#include "utils.h"
+
+static const struct twsfwphysx_world WORLD = { .restitution = 1.F,
+                                               .agent_radius = .1F,
+                                               .missile_acceleration = 2.F };
+
+static struct twsfwphysx_agents make_agents(void)
+{
+    struct twsfwphysx_agents agents = twsfwphysx_create_agents(3);
+    const struct twsfwphysx_agent agent1 = { make_vec(1.F, 0.F, 0.F),
+                                             make_vec(0.F, 0.F, 1.F),
+                                             .5F,
+                                             1.F,
+                                             5.F };
+    const struct twsfwphysx_agent agent2 = { make_vec(0.F, 1.F, 0.F),
+                                             make_vec(0.F, 0.F, 1.F),
+                                             0.F,
+                                             0.F,
+                                             5.F };
+    const struct twsfwphysx_agent agent3 = { make_vec(0.F, 0.F, 1.F),
+                                             make_vec(-1.F, 0.F, 0.F),
+                                             .1F,
+                                             .2F,
+                                             5.F };
+    twsfwphysx_set_agent(&agents, agent1, 0);
+    twsfwphysx_set_agent(&agents, agent2, 1);
+    twsfwphysx_set_agent(&agents, agent3, 2);
+
+    return agents;
+}
+
+static void launch(const struct twsfwphysx_agents *agents,
+                   struct twsfwphysx_missiles *missiles,
+                   const int32_t i)
+{
+    struct twsfwphysx_missile missile =
+        twsfwphysx_launch_missile(&agents->agents[i], &WORLD);
+    missile.payload = i;
+    twsfwphysx_add_missile(missiles, missile);
+}
+
+void test_restore_continues_bit_identically(void)
+{
+    struct twsfwphysx_agents agents = make_agents();
+    struct twsfwphysx_missiles missiles = twsfwphysx_new_missile_batch();
+    struct twsfwphysx_simulation_buffer *buffer =
+        twsfwphysx_create_simulation_buffer();
+    struct twsfwphysx_snapshots *snapshots =
+        twsfwphysx_create_snapshots(4, agents.size, 2);
+
+    launch(&agents, &missiles, 0);
+    launch(&agents, &missiles, 2);
+
+    int32_t n_missiles_at_tick_6 = -1;
+    for (int32_t tick = 0; tick < 10; tick++) {
+        if (tick == 6) {
+            n_missiles_at_tick_6 = missiles.size;
+        }
+        twsfwphysx_snapshot(snapshots, tick, &agents, &missiles);
+        twsfwphysx_simulate(&agents, &missiles, &WORLD, .5F, 51, buffer);
+    }
+
+    struct twsfwphysx_agent expected_agents[3];
+    memcpy(expected_agents, agents.agents, sizeof(expected_agents));
+    const int32_t expected_n_missiles = missiles.size;
+    struct twsfwphysx_missile expected_missiles[2];
+    memcpy(expected_missiles,
+           missiles.missiles,
+           (size_t)missiles.size * sizeof(struct twsfwphysx_missile));
+
+    // slots of ticks < 6 have been overridden already
+    assert(twsfwphysx_restore(snapshots, 5, &agents, &missiles) == 0);
+    assert(twsfwphysx_restore(snapshots, 10, &agents, &missiles) == 0);
+
+    assert(twsfwphysx_restore(snapshots, 6, &agents, &missiles) == 1);
+    assert(agents.size == 3);
+    assert(missiles.size == n_missiles_at_tick_6);
+
+    for (int32_t tick = 6; tick < 10; tick++) {
+        twsfwphysx_simulate(&agents, &missiles, &WORLD, .5F, 51, buffer);
+    }
+
+    assert(memcmp(expected_agents, agents.agents, sizeof(expected_agents)) ==
+           0);
+    assert(missiles.size == expected_n_missiles);
+    assert(memcmp(expected_missiles,
+                  missiles.missiles,
+                  (size_t)missiles.size * sizeof(struct twsfwphysx_missile)) ==
+           0);
+
+    twsfwphysx_delete_snapshots(snapshots);
+    twsfwphysx_delete_simulation_buffer(buffer);
+    twsfwphysx_delete_missile_batch(&missiles);
+    twsfwphysx_delete_agents(&agents);
+}
+
+void test_restore_resizes(void)
+{
+    struct twsfwphysx_agents agents = make_agents();
+    struct twsfwphysx_missiles missiles = twsfwphysx_new_missile_batch();
+    struct twsfwphysx_snapshots *snapshots =
+        twsfwphysx_create_snapshots(2, 0, 0);
+
+    launch(&agents, &missiles, 0);
+    launch(&agents, &missiles, 1);
+    launch(&agents, &missiles, 2);
+    twsfwphysx_snapshot(snapshots, 0, &agents, &missiles);
+
+    struct twsfwphysx_agents other_agents = twsfwphysx_create_agents(1);
+    twsfwphysx_set_agent(&other_agents, agents.agents[1], 0);
+    struct twsfwphysx_missiles other_missiles = twsfwphysx_new_missile_batch();
+
+    assert(twsfwphysx_restore(snapshots, 0, &other_agents, &other_missiles) ==
+           1);
+    assert(other_agents.size == 3);
+    assert(other_missiles.size == 3);
+    assert(other_missiles.capacity >= 3);
+    assert(memcmp(agents.agents,
+                  other_agents.agents,
+                  3 * sizeof(struct twsfwphysx_agent)) == 0);
+    assert(memcmp(missiles.missiles,
+                  other_missiles.missiles,
+                  3 * sizeof(struct twsfwphysx_missile)) == 0);
+
+    twsfwphysx_delete_snapshots(snapshots);
+    twsfwphysx_delete_missile_batch(&other_missiles);
+    twsfwphysx_delete_agents(&other_agents);
+    twsfwphysx_delete_missile_batch(&missiles);
+    twsfwphysx_delete_agents(&agents);
+}
+
+void test_restore_after_odd_steps(void)
+{
+    struct twsfwphysx_agents agents = make_agents();
+    struct twsfwphysx_missiles missiles = twsfwphysx_new_missile_batch();
+    struct twsfwphysx_simulation_buffer *buffer =
+        twsfwphysx_create_simulation_buffer();
+    struct twsfwphysx_snapshots *snapshots =
+        twsfwphysx_create_snapshots(2, agents.size, 0);
+
+    twsfwphysx_snapshot(snapshots, 0, &agents, &missiles);
+    twsfwphysx_simulate(&agents, &missiles, &WORLD, .1F, 1, buffer);
+
+    struct twsfwphysx_agents one_agent = twsfwphysx_create_agents(1);
+    twsfwphysx_set_agent(&one_agent, agents.agents[0], 0);
+    twsfwphysx_snapshot(snapshots, 1, &one_agent, &missiles);
+    twsfwphysx_delete_agents(&one_agent);
+
+    // The buffer must not adopt the (smaller) array of the agents.
+    assert(twsfwphysx_restore(snapshots, 1, &agents, &missiles) == 1);
+    twsfwphysx_simulate(&agents, &missiles, &WORLD, .1F, 1, buffer);
+    assert(twsfwphysx_restore(snapshots, 0, &agents, &missiles) == 1);
+    twsfwphysx_simulate(&agents, &missiles, &WORLD, .1F, 1, buffer);
+
+    struct twsfwphysx_agents expected = make_agents();
+    twsfwphysx_simulate(&expected, &missiles, &WORLD, .1F, 1, NULL);
+    assert(agents.size == 3);
+    assert(memcmp(expected.agents,
+                  agents.agents,
+                  3 * sizeof(struct twsfwphysx_agent)) == 0);
+
+    twsfwphysx_delete_agents(&expected);
+    twsfwphysx_delete_snapshots(snapshots);
+    twsfwphysx_delete_simulation_buffer(buffer);
+    twsfwphysx_delete_missile_batch(&missiles);
+    twsfwphysx_delete_agents(&agents);
+}
+
+int main(const int argc, const char *argv[])
+{
+    (void)argc;
+    (void)argv;
+
+    test_restore_continues_bit_identically();
+    test_restore_resizes();
+    test_restore_after_odd_steps();
+
+    return 0;
+}
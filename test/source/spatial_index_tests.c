@@ -0,0 +1,483 @@
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "twsfwphysx/twsfwphysx.h"
+#include "utils.h"
+
+enum { N_AGENTS = 2000, N_QUERIES = 50, K = 8 };
+
+static uint32_t STATE = 42;
+
+static float uniform(void)
+{
+    STATE = STATE * 1664525U + 1013904223U;
+    return (float)(STATE >> 8U) / (float)(1U << 24U) * 2.F - 1.F;
+}
+
+static struct twsfwphysx_vec random_position(void)
+{
+    for (;;) {
+        const float x = uniform();
+        const float y = uniform();
+        const float z = uniform();
+        const float norm = sqrtf(x * x + y * y + z * z);
+        if (norm > .1F && norm < 1.F) {
+            return make_vec(x / norm, y / norm, z / norm);
+        }
+    }
+}
+
+static struct twsfwphysx_agents make_agents(void)
+{
+    struct twsfwphysx_agents agents = twsfwphysx_create_agents(N_AGENTS);
+    for (int32_t i = 0; i < N_AGENTS; i++) {
+        const struct twsfwphysx_agent agent = {
+            random_position(), make_vec(0.F, 0.F, 1.F), 0.F, 0.F, 1.F
+        };
+        twsfwphysx_set_agent(&agents, agent, i);
+    }
+
+    // every tenth agent is dead
+    for (int32_t i = 0; i < N_AGENTS; i += 10) {
+        agents.agents[i].hp = 0.F;
+    }
+
+    return agents;
+}
+
+static float dot(const struct twsfwphysx_vec v, const struct twsfwphysx_vec w)
+{
+    return v.x * w.x + v.y * w.y + v.z * w.z;
+}
+
+static void assert_cap_eq(const struct twsfwphysx_agents *agents,
+                          const struct twsfwphysx_vec r,
+                          const float angle,
+                          const int32_t *ids,
+                          const int32_t n)
+{
+    // objects on the boundary may or may not be found
+    const float eps = 1e-5F;
+    const float threshold = cosf(angle);
+
+    char found[N_AGENTS] = { 0 };
+    for (int32_t i = 0; i < n; i++) {
+        assert(ids[i] >= 0 && ids[i] < N_AGENTS);
+        assert(!found[ids[i]]);
+        found[ids[i]] = 1;
+
+        assert(agents->agents[ids[i]].hp > 0.F);
+        assert(dot(r, agents->agents[ids[i]].r) >= threshold - eps);
+    }
+
+    for (int32_t i = 0; i < N_AGENTS; i++) {
+        const float s = dot(r, agents->agents[i].r);
+        if (agents->agents[i].hp > 0.F && s >= threshold + eps) {
+            assert(found[i]);
+        }
+    }
+}
+
+static void assert_nearest_eq(const struct twsfwphysx_agents *agents,
+                              const struct twsfwphysx_vec r,
+                              const int32_t *ids,
+                              const float *cosines)
+{
+    float expected[K];
+    for (int32_t j = 0; j < K; j++) {
+        expected[j] = -2.F;
+    }
+
+    for (int32_t i = 0; i < N_AGENTS; i++) {
+        if (agents->agents[i].hp <= 0.F) {
+            continue;
+        }
+
+        float s = dot(r, agents->agents[i].r);
+        for (int32_t j = 0; j < K; j++) {
+            if (s > expected[j]) {
+                const float tmp = expected[j];
+                expected[j] = s;
+                s = tmp;
+            }
+        }
+    }
+
+    for (int32_t j = 0; j < K; j++) {
+        assert(agents->agents[ids[j]].hp > 0.F);
+        assert(fabsf(cosines[j] - dot(r, agents->agents[ids[j]].r)) < 1e-6F);
+        assert(fabsf(cosines[j] - expected[j]) < 1e-6F);
+        assert(j == 0 || cosines[j - 1] >= cosines[j]);
+    }
+}
+
+void test_cap_queries(void)
+{
+    struct twsfwphysx_agents agents = make_agents();
+    struct twsfwphysx_spatial_index *index = twsfwphysx_create_spatial_index();
+    twsfwphysx_index_agents(index, &agents);
+
+    int32_t ids[N_AGENTS];
+    const float angles[] = { 0.F, .01F, .1F, .5F, 1.F, 2.F, 3.F };
+    for (size_t a = 0; a < sizeof(angles) / sizeof(float); a++) {
+        for (int32_t q = 0; q < N_QUERIES; q++) {
+            const struct twsfwphysx_vec r = random_position();
+            const int32_t n =
+                twsfwphysx_query_cap(index, r, angles[a], ids, N_AGENTS);
+            assert(n <= N_AGENTS);
+            assert_cap_eq(&agents, r, angles[a], ids, n);
+        }
+    }
+
+    // the whole sphere contains all living agents
+    const struct twsfwphysx_vec r = random_position();
+    assert(twsfwphysx_query_cap(index, r, 4.F, ids, N_AGENTS) ==
+           N_AGENTS - N_AGENTS / 10);
+
+    // results are truncated but counted
+    assert(twsfwphysx_query_cap(index, r, 4.F, ids, 3) ==
+           N_AGENTS - N_AGENTS / 10);
+
+    twsfwphysx_delete_spatial_index(index);
+    twsfwphysx_delete_agents(&agents);
+}
+
+void test_cap_batch_query(void)
+{
+    struct twsfwphysx_agents agents = make_agents();
+    struct twsfwphysx_spatial_index *index = twsfwphysx_create_spatial_index();
+    twsfwphysx_index_agents(index, &agents);
+
+    struct twsfwphysx_vec r[N_QUERIES];
+    float angles[N_QUERIES];
+    for (int32_t q = 0; q < N_QUERIES; q++) {
+        r[q] = random_position();
+        angles[q] = .01F * (float)q;
+    }
+
+    int32_t offsets[N_QUERIES + 1];
+    const int32_t capacity = 64 * N_AGENTS;
+    int32_t *ids = (int32_t *)malloc((size_t)capacity * sizeof(int32_t));
+
+    // too small output arrays are reported
+    const int32_t total = twsfwphysx_query_cap_batch(
+        index, r, angles, N_QUERIES, offsets, ids, 10);
+    assert(total > 10);
+    assert(total <= capacity);
+
+    assert(twsfwphysx_query_cap_batch(
+               index, r, angles, N_QUERIES, offsets, ids, capacity) == total);
+    assert(offsets[0] == 0);
+    assert(offsets[N_QUERIES] == total);
+    for (int32_t q = 0; q < N_QUERIES; q++) {
+        assert(offsets[q] <= offsets[q + 1]);
+        assert_cap_eq(&agents,
+                      r[q],
+                      angles[q],
+                      ids + offsets[q],
+                      offsets[q + 1] - offsets[q]);
+    }
+
+    free(ids);
+    twsfwphysx_delete_spatial_index(index);
+    twsfwphysx_delete_agents(&agents);
+}
+
+void test_nearest_queries(void)
+{
+    struct twsfwphysx_agents agents = make_agents();
+    struct twsfwphysx_spatial_index *index = twsfwphysx_create_spatial_index();
+    twsfwphysx_index_agents(index, &agents);
+
+    int32_t ids[K];
+    float cosines[K];
+    for (int32_t q = 0; q < N_QUERIES; q++) {
+        const struct twsfwphysx_vec r = random_position();
+        assert(twsfwphysx_query_nearest(index, r, K, ids, cosines) == K);
+        assert_nearest_eq(&agents, r, ids, cosines);
+    }
+
+    // a living agent is its own nearest neighbour
+    assert(twsfwphysx_query_nearest(
+               index, agents.agents[1].r, K, ids, cosines) == K);
+    assert(ids[0] == 1);
+
+    struct twsfwphysx_vec r[N_QUERIES];
+    for (int32_t q = 0; q < N_QUERIES; q++) {
+        r[q] = random_position();
+    }
+    int32_t batch_ids[N_QUERIES * K];
+    float batch_cosines[N_QUERIES * K];
+    twsfwphysx_query_nearest_batch(
+        index, r, N_QUERIES, K, batch_ids, batch_cosines);
+    for (int32_t q = 0; q < N_QUERIES; q++) {
+        assert_nearest_eq(
+            &agents, r[q], batch_ids + q * K, batch_cosines + q * K);
+    }
+
+    twsfwphysx_delete_spatial_index(index);
+    twsfwphysx_delete_agents(&agents);
+}
+
+void test_small_indices(void)
+{
+    struct twsfwphysx_agents agents = make_agents();
+    struct twsfwphysx_spatial_index *index = twsfwphysx_create_spatial_index();
+
+    int32_t ids[K];
+    float cosines[K];
+    const struct twsfwphysx_vec r = make_vec(1.F, 0.F, 0.F);
+
+    // never filled
+    assert(twsfwphysx_query_cap(index, r, 4.F, ids, K) == 0);
+    assert(twsfwphysx_query_nearest(index, r, K, ids, cosines) == 0);
+
+    // rebuilding shrinks the index
+    twsfwphysx_index_agents(index, &agents);
+    agents.size = 3;
+    twsfwphysx_index_agents(index, &agents);
+    assert(twsfwphysx_query_cap(index, r, 4.F, ids, K) == 2);
+    assert(twsfwphysx_query_nearest(index, r, K, ids, cosines) == 2);
+
+    twsfwphysx_query_nearest_batch(index, &r, 1, K, ids, cosines);
+    assert(ids[0] == 1 || ids[0] == 2);
+    assert(ids[1] == 1 || ids[1] == 2);
+    assert(ids[0] != ids[1]);
+    for (int32_t j = 2; j < K; j++) {
+        assert(ids[j] == -1);
+        assert(cosines[j] < -1.F);
+    }
+
+    // missiles are indexed regardless of their velocity
+    struct twsfwphysx_missiles missiles = twsfwphysx_new_missile_batch();
+    const struct twsfwphysx_missile missile = {
+        make_vec(0.F, 1.F, 0.F), make_vec(1.F, 0.F, 0.F), 0.F, 0
+    };
+    twsfwphysx_add_missile(&missiles, missile);
+    twsfwphysx_index_missiles(index, &missiles);
+    assert(twsfwphysx_query_cap(index, r, 1.5F, ids, K) == 0);
+    assert(twsfwphysx_query_cap(index, r, 1.6F, ids, K) == 1);
+    assert(ids[0] == 0);
+
+    twsfwphysx_delete_missile_batch(&missiles);
+    twsfwphysx_delete_spatial_index(index);
+    twsfwphysx_delete_agents(&agents);
+}
+
+static void to_double(const struct twsfwphysx_vec v, double d[3])
+{
+    d[0] = (double)v.x;
+    d[1] = (double)v.y;
+    d[2] = (double)v.z;
+}
+
+static double dot_double(const double v[3], const double w[3])
+{
+    return v[0] * w[0] + v[1] * w[1] + v[2] * w[2];
+}
+
+// first contact of the ray with the cap around c in double precision (or -1)
+static double contact_brute_force(const struct twsfwphysx_ray *ray,
+                                  const struct twsfwphysx_vec c,
+                                  const float radius)
+{
+    double r[3];
+    double u[3];
+    double p[3];
+    to_double(ray->r, r);
+    to_double(ray->u, u);
+    to_double(c, p);
+    const double w[3] = { u[1] * r[2] - u[2] * r[1],
+                          u[2] * r[0] - u[0] * r[2],
+                          u[0] * r[1] - u[1] * r[0] };
+    const double pi = 3.14159265358979323846;
+    const double cos_rho = cos((double)radius);
+
+    const double a = dot_double(p, r);
+    const double b = dot_double(p, w);
+    const double R = sqrt(a * a + b * b);
+    if (R <= cos_rho) {
+        return -1.;
+    }
+
+    const double delta = acos(cos_rho / R);
+    const double phi0 = atan2(b, a);
+    if (fabs(phi0) <= delta) {
+        return 0.;
+    }
+
+    return (phi0 < 0. ? phi0 + 2. * pi : phi0) - delta;
+}
+
+static struct twsfwphysx_ray_hit
+cast_ray_brute_force(const struct twsfwphysx_agents *agents,
+                     const struct twsfwphysx_ray *ray,
+                     const float radius)
+{
+    struct twsfwphysx_ray_hit hit = { -1, ray->length };
+    double best = (double)ray->length;
+    for (int32_t i = 0; i < agents->size; i++) {
+        if (i == ray->ignore || agents->agents[i].hp <= 0.F) {
+            continue;
+        }
+
+        const double phi =
+            contact_brute_force(ray, agents->agents[i].r, radius);
+        if (phi >= 0. && phi <= best && (hit.agent < 0 || phi < best)) {
+            hit.agent = i;
+            best = phi;
+        }
+    }
+    hit.angle = (float)best;
+
+    return hit;
+}
+
+static struct twsfwphysx_ray random_ray(const struct twsfwphysx_agents *agents)
+{
+    const int32_t i = (int32_t)(STATE % (uint32_t)agents->size);
+    const struct twsfwphysx_vec r = agents->agents[i].r;
+    const struct twsfwphysx_vec t = random_position();
+    const float x = r.y * t.z - r.z * t.y;
+    const float y = r.z * t.x - r.x * t.z;
+    const float z = r.x * t.y - r.y * t.x;
+    const float norm = sqrtf(x * x + y * y + z * z);
+
+    const struct twsfwphysx_ray ray = {
+        r, make_vec(x / norm, y / norm, z / norm), 3.F * (uniform() + 1.F), i
+    };
+    return ray;
+}
+
+void test_ray_casts(void)
+{
+    const struct twsfwphysx_world world = { .restitution = 1.F,
+                                            .agent_radius = .01F,
+                                            .missile_acceleration = 1.F };
+
+    struct twsfwphysx_agents agents = make_agents();
+    struct twsfwphysx_spatial_index *index = twsfwphysx_create_spatial_index();
+    twsfwphysx_index_agents(index, &agents);
+
+    struct twsfwphysx_ray rays[N_QUERIES];
+    for (int32_t q = 0; q < N_QUERIES; q++) {
+        rays[q] = random_ray(&agents);
+    }
+
+    // a ray through the center of a living agent
+    rays[0].r = agents.agents[1].r;
+    rays[0].u = agents.agents[1].u;
+    rays[0].ignore = -1;
+
+    struct twsfwphysx_ray_hit hits[N_QUERIES];
+    const int32_t n_hits =
+        twsfwphysx_cast_rays(index, &world, rays, N_QUERIES, hits);
+    assert(n_hits > 0);
+    assert(n_hits < N_QUERIES);
+    assert(hits[0].agent == 1);
+    assert(hits[0].angle < 1e-6F);
+
+    int32_t n_expected = 0;
+    for (int32_t q = 0; q < N_QUERIES; q++) {
+        const struct twsfwphysx_ray_hit expected =
+            cast_ray_brute_force(&agents, &rays[q], world.agent_radius);
+        n_expected += expected.agent >= 0;
+
+        assert(hits[q].agent == expected.agent);
+        assert(fabsf(hits[q].angle - expected.angle) < 1e-4F);
+    }
+    assert(n_hits == n_expected);
+
+    twsfwphysx_delete_spatial_index(index);
+    twsfwphysx_delete_agents(&agents);
+}
+
+void test_ray_casts_predict_missile_hits(void)
+{
+    const struct twsfwphysx_world world = { .restitution = 1.F,
+                                            .agent_radius = .02F,
+                                            .missile_acceleration = 1.F };
+
+    // standing agents
+    struct twsfwphysx_agents agents = make_agents();
+    agents.size = 100;
+    for (int32_t i = 0; i < agents.size; i++) {
+        agents.agents[i].hp = agents.agents[i].hp > 0.F ? 100.F : 0.F;
+    }
+
+    struct twsfwphysx_spatial_index *index = twsfwphysx_create_spatial_index();
+    twsfwphysx_index_agents(index, &agents);
+    struct twsfwphysx_simulation_buffer *buffer =
+        twsfwphysx_create_simulation_buffer();
+
+    int32_t n_hits = 0;
+    for (int32_t q = 0; q < 10; q++) {
+        const struct twsfwphysx_ray ray = random_ray(&agents);
+        const struct twsfwphysx_agent *shooter = &agents.agents[ray.ignore];
+        if (shooter->hp <= 0.F) {
+            continue;
+        }
+
+        struct twsfwphysx_ray_hit hit;
+        twsfwphysx_cast_rays(index, &world, &ray, 1, &hit);
+
+        // a missile at terminal velocity flies along the ray
+        struct twsfwphysx_agent aiming = *shooter;
+        aiming.u = ray.u;
+        aiming.v = world.missile_acceleration;
+        struct twsfwphysx_missiles missiles = twsfwphysx_new_missile_batch();
+        twsfwphysx_add_missile(&missiles,
+                               twsfwphysx_launch_missile(&aiming, &world));
+
+        float hp[100];
+        for (int32_t i = 0; i < agents.size; i++) {
+            hp[i] = agents.agents[i].hp;
+        }
+        // the missile starts slightly ahead of the origin of the ray
+        const float t = ray.length - 1.0001F * world.agent_radius;
+        twsfwphysx_simulate(&agents, &missiles, &world, t, 2000, buffer);
+
+        int32_t target = -1;
+        for (int32_t i = 0; i < agents.size; i++) {
+            if (agents.agents[i].hp < hp[i]) {
+                assert(target == -1);
+                target = i;
+                agents.agents[i].hp = hp[i];
+            }
+        }
+
+        // Simulated missiles hit the nearest agent once they are inside of
+        // any cap, i.e., overlapping agents are ambiguous within a step.
+        if (target != hit.agent) {
+            assert(target >= 0 && hit.agent >= 0);
+            const double phi = contact_brute_force(
+                &ray, agents.agents[target].r, world.agent_radius);
+            assert(phi - (double)hit.angle < (double)(t / 2000.F));
+        }
+        n_hits += target >= 0;
+        twsfwphysx_delete_missile_batch(&missiles);
+    }
+    assert(n_hits > 0);
+
+    twsfwphysx_delete_simulation_buffer(buffer);
+    twsfwphysx_delete_spatial_index(index);
+    agents.size = N_AGENTS;
+    twsfwphysx_delete_agents(&agents);
+}
+
+int main(const int argc, const char *argv[])
+{
+    (void)argc;
+    (void)argv;
+
+    test_cap_queries();
+    test_cap_batch_query();
+    test_nearest_queries();
+    test_small_indices();
+    test_ray_casts();
+    test_ray_casts_predict_missile_hits();
+
+    return 0;
+}
@@ -0,0 +1,98 @@
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "twsfwphysx/twsfwphysx.h"
+#include "utils.h"
+
+static const struct twsfwphysx_world WORLD = { .restitution = 1.F,
+                                               .agent_radius = .1F,
+                                               .missile_acceleration = 1.F };
+
+void test_counters(void)
+{
+    // agent2 runs into agent1 and missile hits agent3 head-on
+    const struct twsfwphysx_agent agent1 = { make_vec(0.F, 1.F, 0.F),
+                                             make_vec(0.F, 0.F, 1.F),
+                                             0.F,
+                                             0.F,
+                                             5 };
+    const struct twsfwphysx_agent agent2 = { make_vec(1.F, 0.F, 0.F),
+                                             make_vec(0.F, 0.F, 1.F),
+                                             1.F,
+                                             1.F,
+                                             5 };
+    const struct twsfwphysx_agent agent3 = { make_vec(0.F, 0.F, 1.F),
+                                             make_vec(-1.F, 0.F, 0.F),
+                                             0.F,
+                                             0.F,
+                                             5 };
+    struct twsfwphysx_agents agents = twsfwphysx_create_agents(3);
+    twsfwphysx_set_agent(&agents, agent1, 0);
+    twsfwphysx_set_agent(&agents, agent2, 1);
+    twsfwphysx_set_agent(&agents, agent3, 2);
+
+    const struct twsfwphysx_missile missile = {
+        make_vec(0.F, .6F, .8F), make_vec(1.F, 0.F, 0.F), 1.F, 0
+    };
+    struct twsfwphysx_missiles missiles = twsfwphysx_new_missile_batch();
+    twsfwphysx_add_missile(&missiles, missile);
+
+    struct twsfwphysx_stats stats;
+    twsfwphysx_reset_stats(&stats);
+    struct twsfwphysx_simulation_buffer *buffer =
+        twsfwphysx_create_simulation_buffer();
+    twsfwphysx_set_stats(buffer, &stats);
+
+    twsfwphysx_simulate(&agents, &missiles, &WORLD, 1.F, 50, buffer);
+    twsfwphysx_simulate(&agents, &missiles, &WORLD, 1.F, 50, buffer);
+    assert(missiles.size == 0);
+
+    assert(stats.n_calls == 2);
+    assert(stats.n_steps == 100);
+    assert(stats.n_reallocations == 1);
+    assert(stats.buffer_bytes ==
+           3 * sizeof(struct twsfwphysx_agent) + 2 * 3 * sizeof(float));
+    assert(stats.n_pairs_tested == 300);
+    assert(stats.n_pairs_close >= stats.n_collisions);
+    assert(stats.n_collisions >= 1);
+    assert(stats.n_hits == 1);
+    assert(stats.n_missiles_propagated > 0);
+    assert(stats.n_missiles_propagated < 100);
+    assert(stats.ns_total >= stats.ns_missiles + stats.ns_distances +
+                                 stats.ns_agents + stats.ns_collisions);
+
+    // more agents require a larger buffer
+    struct twsfwphysx_agents more_agents = twsfwphysx_create_agents(4);
+    for (int32_t i = 0; i < more_agents.size; i++) {
+        twsfwphysx_set_agent(&more_agents, agents.agents[i % agents.size], i);
+    }
+    twsfwphysx_reset_stats(&stats);
+    twsfwphysx_simulate(&more_agents, &missiles, &WORLD, 1.F, 10, buffer);
+    assert(stats.n_calls == 1);
+    assert(stats.n_reallocations == 1);
+    assert(stats.n_pairs_tested == 60);
+    assert(stats.buffer_bytes ==
+           4 * sizeof(struct twsfwphysx_agent) + 2 * 6 * sizeof(float));
+    assert(stats.n_hits == 0);
+
+    // detached counters are not touched
+    twsfwphysx_set_stats(buffer, NULL);
+    twsfwphysx_simulate(&agents, &missiles, &WORLD, 1.F, 10, buffer);
+    assert(stats.n_calls == 1);
+
+    twsfwphysx_delete_agents(&more_agents);
+    twsfwphysx_delete_simulation_buffer(buffer);
+    twsfwphysx_delete_missile_batch(&missiles);
+    twsfwphysx_delete_agents(&agents);
+}
+
+int main(const int argc, const char *argv[])
+{
+    (void)argc;
+    (void)argv;
+
+    test_counters();
+
+    return 0;
+}
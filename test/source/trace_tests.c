@@ -0,0 +1,123 @@
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "twsfwphysx/twsfwphysx.h"
+#include "utils.h"
+
+#ifndef TWSFWPHYSX_TRACE
+#error "This test has to be compiled with TWSFWPHYSX_TRACE."
+#endif
+
+static const struct twsfwphysx_world WORLD = { .restitution = 1.F,
+                                               .agent_radius = .1F,
+                                               .missile_acceleration = 1.F };
+
+static int32_t count(const char *haystack, const char *needle)
+{
+    int32_t n = 0;
+    for (const char *s = strstr(haystack, needle); s != NULL;
+         s = strstr(s + 1, needle)) {
+        n += 1;
+    }
+    return n;
+}
+
+// returns the trace as null-terminated string that has to be freed
+static char *write_trace(int32_t *n_events)
+{
+    FILE *file = tmpfile();
+    assert(file != NULL);
+    *n_events = twsfwphysx_write_trace(file);
+
+    const long size = ftell(file);
+    assert(size > 0);
+    char *json = (char *)malloc((size_t)size + 1);
+    assert(json != NULL);
+
+    rewind(file);
+    assert(fread(json, 1, (size_t)size, file) == (size_t)size);
+    json[size] = '\0';
+    fclose(file);
+
+    return json;
+}
+
+static void simulate(const int32_t n_calls, const int32_t n_steps)
+{
+    struct twsfwphysx_agents agents = twsfwphysx_create_agents(2);
+    const struct twsfwphysx_agent agent = {
+        make_vec(1.F, 0.F, 0.F), make_vec(0.F, 0.F, 1.F), 1.F, 1.F, 1.F
+    };
+    twsfwphysx_set_agent(&agents, agent, 0);
+    twsfwphysx_set_agent(&agents, agent, 1);
+    struct twsfwphysx_missiles missiles = twsfwphysx_new_missile_batch();
+
+    for (int32_t i = 0; i < n_calls; i++) {
+        twsfwphysx_simulate(&agents, &missiles, &WORLD, 1.F, n_steps, NULL);
+    }
+
+    twsfwphysx_delete_missile_batch(&missiles);
+    twsfwphysx_delete_agents(&agents);
+}
+
+void test_trace(void)
+{
+    twsfwphysx_clear_trace();
+    simulate(2, 3);
+
+    int32_t n_events = 0;
+    char *json = write_trace(&n_events);
+
+    // per call: simulate + 3 * (step + missiles + 2 distances + agents +
+    // collisions), each with begin and end
+    assert(n_events == 2 * 2 * (1 + 3 * 6));
+    assert(strncmp(json, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", 39) ==
+           0);
+    assert(strcmp(json + strlen(json) - 4, "\n]}\n") == 0);
+
+    assert(count(json, "\"ph\":\"B\"") == n_events / 2);
+    assert(count(json, "\"ph\":\"E\"") == n_events / 2);
+    assert(count(json, "\"name\":\"simulate\"") == 4);
+    assert(count(json, "\"name\":\"step\"") == 12);
+    assert(count(json, "\"name\":\"missiles\"") == 12);
+    assert(count(json, "\"name\":\"distances\"") == 24);
+    assert(count(json, "\"name\":\"agents\"") == 12);
+    assert(count(json, "\"name\":\"collisions\"") == 12);
+    free(json);
+
+    twsfwphysx_clear_trace();
+    json = write_trace(&n_events);
+    assert(n_events == 0);
+    assert(strcmp(json, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n]}\n") ==
+           0);
+    free(json);
+}
+
+void test_trace_keeps_latest_events(void)
+{
+    twsfwphysx_clear_trace();
+    simulate(100, 10);
+
+    int32_t n_events = 0;
+    char *json = write_trace(&n_events);
+    assert(n_events == TWSFWPHYSX_TRACE_CAPACITY);
+
+    // the last event ends the last call
+    const char *last = strrchr(json, '{');
+    assert(strncmp(last, "{\"name\":\"simulate\",\"ph\":\"E\"", 27) == 0);
+    free(json);
+}
+
+int main(const int argc, const char *argv[])
+{
+    (void)argc;
+    (void)argv;
+
+    test_trace();
+    test_trace_keeps_latest_events();
+
+    return 0;
+}
@@ -0,0 +1,175 @@
+#include <assert.h>
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "twsfwphysx/twsfwphysx.h"
+#include "utils.h"
+
+static const struct twsfwphysx_world WORLD = { .restitution = 1.F,
+                                               .agent_radius = .1F,
+                                               .missile_acceleration = 1.F };
+
+enum { N_AGENTS = 2, N_FRAMES = 10, EVERY = 10 };
+
+static struct twsfwphysx_agents make_agents(void)
+{
+    struct twsfwphysx_agents agents = twsfwphysx_create_agents(N_AGENTS);
+    const struct twsfwphysx_agent agent1 = { make_vec(1.F, 0.F, 0.F),
+                                             make_vec(0.F, 0.F, 1.F),
+                                             .5F,
+                                             1.F,
+                                             5.F };
+    const struct twsfwphysx_agent agent2 = { make_vec(0.F, 0.F, 1.F),
+                                             make_vec(-1.F, 0.F, 0.F),
+                                             0.F,
+                                             0.F,
+                                             5.F };
+    twsfwphysx_set_agent(&agents, agent1, 0);
+    twsfwphysx_set_agent(&agents, agent2, 1);
+
+    return agents;
+}
+
+static struct twsfwphysx_missiles make_missiles(void)
+{
+    // m1 hits agent2 after roughly half of the simulation
+    const struct twsfwphysx_missile m1 = {
+        make_vec(0.F, 1.F, 0.F), make_vec(1.F, 0.F, 0.F), 1.F, 42
+    };
+    const struct twsfwphysx_missile m2 = {
+        make_vec(0.F, -1.F, 0.F), make_vec(0.F, 0.F, 1.F), 1.F, 1337
+    };
+    struct twsfwphysx_missiles missiles = twsfwphysx_new_missile_batch();
+    twsfwphysx_add_missile(&missiles, m1);
+    twsfwphysx_add_missile(&missiles, m2);
+
+    return missiles;
+}
+
+void test_trajectory_matches_stepwise_simulation(void)
+{
+    float r[N_FRAMES][N_AGENTS][3];
+    float v[N_FRAMES][N_AGENTS];
+    float missile_r[N_FRAMES][2][3];
+    int32_t payload[N_FRAMES][2];
+    int32_t n_missiles[N_FRAMES];
+    memset(payload, 0, sizeof(payload));
+
+    struct twsfwphysx_trajectory trajectory = {
+        .every = EVERY,
+        .capacity = N_FRAMES,
+        .agent_r = { r, { sizeof(r[0]), sizeof(r[0][0]), sizeof(float) } },
+        .agent_v = { v, { sizeof(v[0]), sizeof(float), 0 } },
+        .missile_r = { missile_r,
+                       { sizeof(missile_r[0]),
+                         sizeof(missile_r[0][0]),
+                         sizeof(float) } },
+        .missile_payload = { payload,
+                             { sizeof(payload[0]), sizeof(int32_t), 0 } },
+        .n_missiles = { n_missiles, { sizeof(int32_t), 0, 0 } }
+    };
+
+    struct twsfwphysx_agents agents = make_agents();
+    struct twsfwphysx_missiles missiles = make_missiles();
+    struct twsfwphysx_simulation_buffer *buffer =
+        twsfwphysx_create_simulation_buffer();
+    twsfwphysx_set_trajectory(buffer, &trajectory);
+    twsfwphysx_simulate(
+        &agents, &missiles, &WORLD, 10.F, N_FRAMES * EVERY, buffer);
+    assert(trajectory.size == N_FRAMES);
+
+    // the same time step (dt = .1) but one call per frame
+    struct twsfwphysx_agents expected_agents = make_agents();
+    struct twsfwphysx_missiles expected_missiles = make_missiles();
+    int hit = 0;
+    for (int32_t frame = 0; frame < N_FRAMES; frame++) {
+        twsfwphysx_simulate(
+            &expected_agents, &expected_missiles, &WORLD, 1.F, EVERY, NULL);
+
+        for (int32_t i = 0; i < N_AGENTS; i++) {
+            const struct twsfwphysx_agent *agent = &expected_agents.agents[i];
+            assert(memcmp(r[frame][i], &agent->r, 3 * sizeof(float)) == 0);
+            assert(memcmp(&v[frame][i], &agent->v, sizeof(float)) == 0);
+        }
+
+        assert(n_missiles[frame] == expected_missiles.size);
+        for (int32_t i = 0; i < expected_missiles.size; i++) {
+            const struct twsfwphysx_missile *missile =
+                &expected_missiles.missiles[i];
+            assert(memcmp(missile_r[frame][i],
+                          &missile->r,
+                          3 * sizeof(float)) == 0);
+            assert(payload[frame][i] == missile->payload);
+        }
+        hit |= n_missiles[frame] < 2;
+    }
+    assert(hit);
+    assert(n_missiles[0] == 2);
+
+    // a new call starts with the first frame again
+    trajectory.capacity = 1;
+    twsfwphysx_simulate(&agents, &missiles, &WORLD, 1.F, 10, buffer);
+    assert(trajectory.size == 1);
+
+    // detached trajectories are not touched
+    twsfwphysx_set_trajectory(buffer, NULL);
+    twsfwphysx_simulate(&agents, &missiles, &WORLD, 1.F, 10, buffer);
+    assert(trajectory.size == 1);
+
+    twsfwphysx_delete_simulation_buffer(buffer);
+    twsfwphysx_delete_missile_batch(&expected_missiles);
+    twsfwphysx_delete_agents(&expected_agents);
+    twsfwphysx_delete_missile_batch(&missiles);
+    twsfwphysx_delete_agents(&agents);
+}
+
+void test_interleaved_layout(void)
+{
+    // x, y, z and hp of each agent are stored next to each other
+    float state[3][N_AGENTS][4];
+    memset(state, 0, sizeof(state));
+
+    struct twsfwphysx_trajectory trajectory = {
+        .every = 1,
+        .capacity = 3,
+        .agent_r = { &state[0][0][0],
+                     { sizeof(state[0]), sizeof(state[0][0]), sizeof(float) } },
+        .agent_hp = { &state[0][0][3],
+                      { sizeof(state[0]), sizeof(state[0][0]), 0 } }
+    };
+
+    struct twsfwphysx_agents agents = make_agents();
+    struct twsfwphysx_missiles missiles = make_missiles();
+    struct twsfwphysx_simulation_buffer *buffer =
+        twsfwphysx_create_simulation_buffer();
+    twsfwphysx_set_trajectory(buffer, &trajectory);
+
+    // more steps than frames
+    twsfwphysx_simulate(&agents, &missiles, &WORLD, .5F, 5, buffer);
+    assert(trajectory.size == 3);
+
+    for (int32_t frame = 0; frame < 3; frame++) {
+        for (int32_t i = 0; i < N_AGENTS; i++) {
+            const float *x = state[frame][i];
+            assert(x[0] * x[0] + x[1] * x[1] + x[2] * x[2] > .99F);
+            assert(fabsf(x[3] - 5.F) < 1e-6F);
+        }
+    }
+
+    twsfwphysx_delete_simulation_buffer(buffer);
+    twsfwphysx_delete_missile_batch(&missiles);
+    twsfwphysx_delete_agents(&agents);
+}
+
+int main(const int argc, const char *argv[])
+{
+    (void)argc;
+    (void)argv;
+
+    test_trajectory_matches_stepwise_simulation();
+    test_interleaved_layout();
+
+    return 0;
+}
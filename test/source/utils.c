@@ -10,6 +10,31 @@ struct twsfwphysx_vec make_vec(const float x, const float y, const float z)
     return v;
 }
 
+struct twsfwphysx_agents make_three_agents(void)
+{
+    struct twsfwphysx_agents agents = twsfwphysx_create_agents(3);
+    const struct twsfwphysx_agent agent1 = { make_vec(0.F, 1.F, 0.F),
+                                             make_vec(0.F, 0.F, 1.F),
+                                             0.F,
+                                             .5F,
+                                             20.F };
+    const struct twsfwphysx_agent agent2 = { make_vec(1.F, 0.F, 0.F),
+                                             make_vec(0.F, 0.F, 1.F),
+                                             1.F,
+                                             1.F,
+                                             5.F };
+    const struct twsfwphysx_agent agent3 = { make_vec(0.F, 0.F, -1.F),
+                                             make_vec(1.F, 0.F, 0.F),
+                                             .5F,
+                                             .5F,
+                                             5.F };
+    twsfwphysx_set_agent(&agents, agent1, 0);
+    twsfwphysx_set_agent(&agents, agent2, 1);
+    twsfwphysx_set_agent(&agents, agent3, 2);
+
+    return agents;
+}
+
 void assert_vec_eq_with_tolerance(
     const struct twsfwphysx_vec v,
     const float x, // NOLINT(bugprone-easily-swappable-parameters)
@@ -4,6 +4,9 @@
 
 struct twsfwphysx_vec make_vec(float x, float y, float z);
 
+// three agents on crossing great circles
+struct twsfwphysx_agents make_three_agents(void);
+
 void assert_vec_eq(struct twsfwphysx_vec v, float x, float y, float z);
 
 void assert_vec_eq_with_tolerance(struct twsfwphysx_vec v,
@@ -0,0 +1,182 @@
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "twsfwphysx/twsfwphysx.h"
+#include "utils.h"
+
+#ifndef TWSFWPHYSX_MMAP
+#error "This test has to be compiled with TWSFWPHYSX_MMAP."
+#endif
+
+static const char *PATH = "world_file_tests.world";
+
+static const struct twsfwphysx_world WORLD = { .restitution = .5F,
+                                               .agent_radius = .1F,
+                                               .missile_acceleration = 2.F };
+
+static struct twsfwphysx_missiles make_missiles(void)
+{
+    struct twsfwphysx_missiles missiles = twsfwphysx_new_missile_batch();
+    for (int32_t i = 0; i < 3; i++) {
+        const struct twsfwphysx_missile missile = {
+            make_vec(0.F, -1.F, 0.F), make_vec((float)i, 0.F, 1.F), 0.F, i
+        };
+        twsfwphysx_add_missile(&missiles, missile);
+    }
+
+    return missiles;
+}
+
+static void assert_state_eq(const struct twsfwphysx_agents *agents1,
+                            const struct twsfwphysx_missiles *missiles1,
+                            const struct twsfwphysx_agents *agents2,
+                            const struct twsfwphysx_missiles *missiles2)
+{
+    assert(agents1->size == agents2->size);
+    assert(memcmp(agents1->agents,
+                  agents2->agents,
+                  (size_t)agents1->size * sizeof(struct twsfwphysx_agent)) ==
+           0);
+
+    assert(missiles1->size == missiles2->size);
+    if (missiles1->size > 0) {
+        assert(memcmp(missiles1->missiles,
+                      missiles2->missiles,
+                      (size_t)missiles1->size *
+                          sizeof(struct twsfwphysx_missile)) == 0);
+    }
+}
+
+void test_mapped_world_is_simulated_in_place(void)
+{
+    struct twsfwphysx_agents agents = make_three_agents();
+    struct twsfwphysx_missiles missiles = make_missiles();
+    assert(twsfwphysx_save_world_file(PATH, &WORLD, &agents, &missiles) == 1);
+
+    struct twsfwphysx_world world;
+    struct twsfwphysx_agents mapped_agents;
+    struct twsfwphysx_missiles mapped_missiles;
+    struct twsfwphysx_world_file *file = twsfwphysx_map_world_file(
+        PATH, &world, &mapped_agents, &mapped_missiles);
+    assert(file != NULL);
+
+    assert(memcmp(&world, &WORLD, sizeof(struct twsfwphysx_world)) == 0);
+    assert_state_eq(&agents, &missiles, &mapped_agents, &mapped_missiles);
+    assert((uintptr_t)mapped_agents.agents % 64 == 0);
+    assert((uintptr_t)mapped_missiles.missiles % 64 == 0);
+
+    // an odd number of steps does not move the mapped agents
+    struct twsfwphysx_agent *p = mapped_agents.agents;
+    struct twsfwphysx_simulation_buffer *buffer =
+        twsfwphysx_create_simulation_buffer();
+    twsfwphysx_simulate(&agents, &missiles, &WORLD, 1.F, 25, buffer);
+    twsfwphysx_simulate(
+        &mapped_agents, &mapped_missiles, &world, 1.F, 25, buffer);
+    assert(mapped_agents.agents == p);
+    assert_state_eq(&agents, &missiles, &mapped_agents, &mapped_missiles);
+
+    // new missiles outgrow the mapping
+    for (int32_t i = 0; i < 4; i++) {
+        const struct twsfwphysx_missile missile =
+            twsfwphysx_launch_missile(&agents.agents[i % agents.size], &WORLD);
+        twsfwphysx_add_missile(&missiles, missile);
+        twsfwphysx_add_missile(&mapped_missiles, missile);
+    }
+    twsfwphysx_simulate(&agents, &missiles, &WORLD, 1.F, 25, NULL);
+    twsfwphysx_simulate(
+        &mapped_agents, &mapped_missiles, &world, 1.F, 25, NULL);
+    assert(mapped_agents.agents == p);
+    assert_state_eq(&agents, &missiles, &mapped_agents, &mapped_missiles);
+
+    twsfwphysx_delete_missile_batch(&mapped_missiles);
+    twsfwphysx_unmap_world_file(file);
+
+    // the file has not been modified
+    struct twsfwphysx_agents initial_agents = make_three_agents();
+    struct twsfwphysx_missiles initial_missiles = make_missiles();
+    file = twsfwphysx_map_world_file(
+        PATH, &world, &mapped_agents, &mapped_missiles);
+    assert(file != NULL);
+    assert_state_eq(
+        &initial_agents, &initial_missiles, &mapped_agents, &mapped_missiles);
+    twsfwphysx_delete_missile_batch(&mapped_missiles);
+    twsfwphysx_unmap_world_file(file);
+
+    assert(remove(PATH) == 0);
+
+    twsfwphysx_delete_missile_batch(&initial_missiles);
+    twsfwphysx_delete_agents(&initial_agents);
+    twsfwphysx_delete_simulation_buffer(buffer);
+    twsfwphysx_delete_missile_batch(&missiles);
+    twsfwphysx_delete_agents(&agents);
+}
+
+void test_empty_world(void)
+{
+    const struct twsfwphysx_agents agents = twsfwphysx_create_agents(0);
+    struct twsfwphysx_missiles missiles = twsfwphysx_new_missile_batch();
+    assert(twsfwphysx_save_world_file(PATH, &WORLD, &agents, &missiles) == 1);
+
+    struct twsfwphysx_world world;
+    struct twsfwphysx_agents mapped_agents;
+    struct twsfwphysx_world_file *file =
+        twsfwphysx_map_world_file(PATH, &world, &mapped_agents, &missiles);
+    assert(file != NULL);
+    assert(mapped_agents.size == 0);
+    assert(missiles.size == 0);
+
+    const struct twsfwphysx_missile missile = {
+        make_vec(0.F, 0.F, 1.F), make_vec(1.F, 0.F, 0.F), 0.F, 1
+    };
+    twsfwphysx_add_missile(&missiles, missile);
+    assert(missiles.size == 1);
+
+    twsfwphysx_delete_missile_batch(&missiles);
+    twsfwphysx_unmap_world_file(file);
+    assert(remove(PATH) == 0);
+}
+
+void test_invalid_files(void)
+{
+    struct twsfwphysx_world world;
+    struct twsfwphysx_agents agents;
+    struct twsfwphysx_missiles missiles;
+    assert(twsfwphysx_map_world_file(
+               "does_not_exist.world", &world, &agents, &missiles) == NULL);
+
+    // a truncated file
+    agents = make_three_agents();
+    missiles = make_missiles();
+    assert(twsfwphysx_save_world_file(PATH, &WORLD, &agents, &missiles) == 1);
+    twsfwphysx_delete_missile_batch(&missiles);
+    twsfwphysx_delete_agents(&agents);
+
+    FILE *file = fopen(PATH, "rb");
+    assert(file != NULL);
+    unsigned char data[128];
+    assert(fread(data, 1, sizeof(data), file) == sizeof(data));
+    assert(fclose(file) == 0);
+
+    file = fopen(PATH, "wb");
+    assert(file != NULL);
+    assert(fwrite(data, 1, sizeof(data), file) == sizeof(data));
+    assert(fclose(file) == 0);
+    assert(twsfwphysx_map_world_file(PATH, &world, &agents, &missiles) ==
+           NULL);
+
+    assert(remove(PATH) == 0);
+}
+
+int main(const int argc, const char *argv[])
+{
+    (void)argc;
+    (void)argv;
+
+    test_mapped_world_is_simulated_in_place();
+    test_empty_world();
+    test_invalid_files();
+
+    return 0;
+}
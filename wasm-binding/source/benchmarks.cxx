@@ -0,0 +1,185 @@
+// The binding is included (instead of linked) to time its internal decode and
+// encode steps separately from the physics.
+#include "binding.cpp"  // NOLINT(bugprone-suspicious-include)
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <utility>
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+constexpr float T = .1F;
+constexpr int32_t N_STEPS = 10;
+constexpr auto MIN_DURATION = std::chrono::milliseconds(200);
+constexpr int32_t MIN_ITERATIONS = 3;
+
+struct Timings
+{
+    double decode_ns = 0.;
+    double physics_ns = 0.;
+    double encode_ns = 0.;
+    double round_trip_ns = 0.;
+};
+
+twsfwphysx::Vec normalized(const float x, const float y, const float z)
+{
+    const float norm = std::sqrt(x * x + y * y + z * z);
+    return {x / norm, y / norm, z / norm};
+}
+
+twsfwphysx::Vec random_position(std::mt19937 &rng)
+{
+    std::normal_distribution<float> normal;
+    return normalized(normal(rng), normal(rng), normal(rng));
+}
+
+// random rotation axis perpendicular to r
+twsfwphysx::Vec random_axis(std::mt19937 &rng, const twsfwphysx::Vec &r)
+{
+    const auto t = random_position(rng);
+    return normalized(r.y() * t.z() - r.z() * t.y(),
+                      r.z() * t.x() - r.x() * t.z(),
+                      r.x() * t.y() - r.y() * t.x());
+}
+
+std::vector<uint8_t> make_state(const std::size_t n_agents,
+                                const std::size_t n_missiles,
+                                std::mt19937 &rng)
+{
+    std::uniform_real_distribution<float> uniform(0.F, 1.F);
+    flatbuffers::FlatBufferBuilder builder(1024);
+
+    std::vector<twsfwphysx::PackedAgent> packed_agents;
+    for (std::size_t i = 0; i < n_agents; i++) {
+        const auto r = random_position(rng);
+        const auto u = random_axis(rng, r);
+        packed_agents.emplace_back(r, u, uniform(rng), uniform(rng), 1e9F);
+    }
+    const auto agents = builder.CreateVectorOfStructs(packed_agents);
+
+    std::vector<twsfwphysx::PackedMissile> packed_missiles;
+    for (std::size_t i = 0; i < n_missiles; i++) {
+        const auto r = random_position(rng);
+        const auto u = random_axis(rng, r);
+        packed_missiles.emplace_back(r, u, 1.F, static_cast<int32_t>(i));
+    }
+    const auto missiles = builder.CreateVectorOfStructs(packed_missiles);
+
+    twsfwphysx::WorldStateBuilder state(builder);
+    state.add_packed_agents(agents);
+    state.add_packed_missiles(missiles);
+    builder.Finish(state.Finish());
+
+    const auto *data = builder.GetBufferPointer();
+    return std::vector<uint8_t>(data, data + builder.GetSize());
+}
+
+double elapsed_ns(const Clock::time_point begin, const Clock::time_point end)
+{
+    return std::chrono::duration<double, std::nano>(end - begin).count();
+}
+
+Timings run(const std::vector<uint8_t> &state)
+{
+    auto *state_buffer = new_state_buffer(static_cast<int32_t>(state.size()));
+
+    // Every iteration starts with the same input. The first iteration warms up
+    // all buffers and is not measured.
+    Timings timings;
+    int32_t n_iterations = 0;
+    const auto begin = Clock::now();
+    for (int32_t i = -1;
+         i < MIN_ITERATIONS || Clock::now() - begin < MIN_DURATION;
+         i++)
+    {
+        std::memcpy(state_buffer, state.data(), state.size());
+
+        const auto t0 = Clock::now();
+        deserialize(state_buffer);
+        const auto t1 = Clock::now();
+        twsfwphysx_simulate(AGENTS.data(),
+                            MISSILES.data(),
+                            &WORLD_CFG,
+                            T,
+                            N_STEPS,
+                            SIMULATION_BUFFER);
+        const auto t2 = Clock::now();
+        serialize();
+        const auto t3 = Clock::now();
+
+        std::memcpy(state_buffer, state.data(), state.size());
+
+        const auto t4 = Clock::now();
+        simulate(T, N_STEPS, state_buffer);
+        const auto t5 = Clock::now();
+
+        if (i >= 0) {
+            timings.decode_ns += elapsed_ns(t0, t1);
+            timings.physics_ns += elapsed_ns(t1, t2);
+            timings.encode_ns += elapsed_ns(t2, t3);
+            timings.round_trip_ns += elapsed_ns(t4, t5);
+            n_iterations += 1;
+        }
+    }
+
+    timings.decode_ns /= n_iterations;
+    timings.physics_ns /= n_iterations;
+    timings.encode_ns /= n_iterations;
+    timings.round_trip_ns /= n_iterations;
+
+    return timings;
+}
+}  // namespace
+
+int main(int /*argc*/, char ** /*argv*/)
+{
+    init_world(1.F, .01F, 1.F);
+
+    const std::vector<std::pair<std::size_t, std::size_t>> sizes = {
+        {10, 0},
+        {10, 10},
+        {100, 100},
+        {1'000, 0},
+        {1'000, 1'000},
+        {1'000, 10'000},
+        {5'000, 5'000},
+    };
+
+    std::printf("%8s %9s %10s %12s %12s %12s %12s %7s %7s\n",
+                "agents",
+                "missiles",
+                "bytes",
+                "decode [us]",
+                "physics [us]",
+                "encode [us]",
+                "total [us]",
+                "decode",
+                "encode");
+
+    std::mt19937 rng(42);
+    for (const auto &[n_agents, n_missiles] : sizes) {
+        const auto state = make_state(n_agents, n_missiles, rng);
+        const auto timings = run(state);
+
+        const auto sum =
+            timings.decode_ns + timings.physics_ns + timings.encode_ns;
+        std::printf("%8zu %9zu %10zu %12.2f %12.2f %12.2f %12.2f "
+                    "%6.1f%% %6.1f%%\n",
+                    n_agents,
+                    n_missiles,
+                    state.size(),
+                    timings.decode_ns / 1e3,
+                    timings.physics_ns / 1e3,
+                    timings.encode_ns / 1e3,
+                    timings.round_trip_ns / 1e3,
+                    100. * timings.decode_ns / sum,
+                    100. * timings.encode_ns / sum);
+    }
+
+    return 0;
+}
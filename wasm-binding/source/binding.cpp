@@ -1,8 +1,12 @@
+#include <algorithm>
 #include <array>
 #include <cassert>
 #include <cstddef>
 #include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <memory>
+#include <span>
 #include <vector>
 
 #ifdef __EMSCRIPTEN__
@@ -13,9 +17,12 @@
 
 // clang-format off
 #define TWSFWPHYSX_IMPLEMENTATION
+#define TWSFWPHYSX_DETERMINISTIC
 #include "twsfwphysx/twsfwphysx.h"
 // clang-format on
 
+#include "compact.hpp"
+#include "delta.hpp"
 #include "twsfwphysx_world_state_generated.h"
 
 namespace
@@ -23,6 +30,7 @@ namespace
 class Agents final
 {
     twsfwphysx_agents m_agents;
+    std::size_t m_capacity = 0;
 
   public:
     Agents()
@@ -40,18 +48,38 @@ class Agents final
         twsfwphysx_delete_agents(&m_agents);
     }
 
-    twsfwphysx_agent &operator[](const std::size_t idx)
+    // Memory is only reallocated if `size` exceeds all previous sizes. Hence,
+    // worlds of constant size do not allocate after the first call.
+    void resize(const std::size_t size)
     {
-        if (const auto i = static_cast<int32_t>(idx); i >= m_agents.size) {
-            const auto agents = twsfwphysx_create_agents(i + 1);
+        if (size > m_capacity) {
+            const auto agents =
+                twsfwphysx_create_agents(static_cast<int32_t>(size));
             for (int32_t j = 0; j < m_agents.size; j++) {
                 twsfwphysx_set_agent(&agents, m_agents.agents[j], j);
             }
             twsfwphysx_delete_agents(&m_agents);
 
             m_agents = agents;
+            m_capacity = size;
         }
 
+        m_agents.size = static_cast<int32_t>(size);
+    }
+
+    // Replaces all agents by `n` agents that are stored with the memory layout
+    // of twsfwphysx_agent at `data`.
+    void assign(const void *data, const std::size_t n)
+    {
+        resize(n);
+        if (n > 0) {
+            std::memcpy(m_agents.agents, data, n * sizeof(twsfwphysx_agent));
+        }
+    }
+
+    twsfwphysx_agent &operator[](const std::size_t idx)
+    {
+        assert(idx < size());
         return m_agents.agents[idx];
     }
 
@@ -96,6 +124,28 @@ class Missiles final
         twsfwphysx_add_missile(&m_missiles, missile);
     }
 
+    // Replaces all missiles by `n` missiles that are stored with the memory
+    // layout of twsfwphysx_missile at `data`.
+    // The batch is always owned (never borrowed), so its capacity is the
+    // size of the heap block that twsfwphysx_add_missile reallocates, too.
+    void assign(const void *data, const std::size_t n)
+    {
+        const auto size = static_cast<int32_t>(n);
+        if (size > m_missiles.capacity) {
+            auto *missiles = static_cast<twsfwphysx_missile *>(std::realloc(
+                m_missiles.missiles, n * sizeof(twsfwphysx_missile)));
+            assert(missiles != nullptr);
+            m_missiles.missiles = missiles;
+            m_missiles.capacity = size;
+        }
+
+        m_missiles.size = size;
+        if (n > 0) {
+            std::memcpy(
+                m_missiles.missiles, data, n * sizeof(twsfwphysx_missile));
+        }
+    }
+
     const twsfwphysx_missile &operator[](const std::size_t idx) const
     {
         const auto i = static_cast<int32_t>(idx);
@@ -108,12 +158,31 @@ class Missiles final
         return static_cast<std::size_t>(m_missiles.size);
     }
 
+    [[nodiscard]] const twsfwphysx_missile *missiles() const
+    {
+        return m_missiles.missiles;
+    }
+
     [[nodiscard]] twsfwphysx_missiles *data()
     {
         return &m_missiles;
     }
 };
 
+// Packed agents and missiles are copied bytewise between FlatBuffers and the
+// engine (which both store floats in little-endian byte order on WASM).
+static_assert(FLATBUFFERS_LITTLEENDIAN,
+              "packed vectors require a little-endian target");
+static_assert(sizeof(twsfwphysx::PackedAgent) == sizeof(twsfwphysx_agent));
+static_assert(offsetof(twsfwphysx_agent, u) == sizeof(twsfwphysx::Vec));
+static_assert(offsetof(twsfwphysx_agent, hp) == 2 * sizeof(twsfwphysx::Vec) +
+                                                   2 * sizeof(float));
+static_assert(sizeof(twsfwphysx::PackedMissile) == sizeof(twsfwphysx_missile));
+static_assert(offsetof(twsfwphysx_missile, payload) ==
+              2 * sizeof(twsfwphysx::Vec) + sizeof(float));
+static_assert(sizeof(twsfwphysx::CompactAgent) == 14);
+static_assert(sizeof(twsfwphysx::CompactMissile) == 16);
+
 twsfwphysx_world WORLD_CFG{
     .restitution = 1.F, .agent_radius = .1F, .missile_acceleration = 2.F};
 
@@ -129,6 +198,52 @@ twsfwphysx_simulation_buffer *SIMULATION_BUFFER =
 flatbuffers::FlatBufferBuilder FB_BUILDER(1024);
 std::vector<uint8_t> STATE_BUFFER;
 
+// Byte sizes and offsets of the engine's agents and missiles in linear memory.
+// Exposed via `layout()` such that hosts can access the arrays of
+// `agents_pointer()` and `missiles_pointer()` through typed-array views.
+enum Layout : uint8_t
+{
+    AGENT_SIZE,
+    AGENT_R,
+    AGENT_U,
+    AGENT_V,
+    AGENT_A,
+    AGENT_HP,
+    MISSILE_SIZE,
+    MISSILE_R,
+    MISSILE_U,
+    MISSILE_V,
+    MISSILE_PAYLOAD,
+    LAYOUT_SIZE
+};
+
+const std::array<int32_t, LAYOUT_SIZE> LAYOUT = {
+    sizeof(twsfwphysx_agent),
+    offsetof(twsfwphysx_agent, r),
+    offsetof(twsfwphysx_agent, u),
+    offsetof(twsfwphysx_agent, v),
+    offsetof(twsfwphysx_agent, a),
+    offsetof(twsfwphysx_agent, hp),
+    sizeof(twsfwphysx_missile),
+    offsetof(twsfwphysx_missile, r),
+    offsetof(twsfwphysx_missile, u),
+    offsetof(twsfwphysx_missile, v),
+    offsetof(twsfwphysx_missile, payload),
+};
+
+// The result of the last call to `serialize()`.
+std::span<const uint8_t> RESULT;
+
+// Format of the last input. Results are serialized in the same format.
+enum class Format : uint8_t
+{
+    PACKED,
+    LEGACY,  // deprecated tables instead of packed vectors
+    COMPACT  // quantised vectors (see compact.hpp)
+};
+
+Format FORMAT = Format::PACKED;
+
 const std::array<int32_t, 3> VERSION = [](std::string version)
 {
     assert(version.size() >= 5);
@@ -149,11 +264,34 @@ const std::array<int32_t, 3> VERSION = [](std::string version)
     return std::array{major, minor, patch};
 }(twsfwphysx_version());
 
-void deserialize(const uint8_t *state_buffer)
+// Vectors of packed structs are copied straight into engine memory. Hence,
+// they must lie within a buffer that is handed out by this module.
+bool is_readable(const void *data, const std::size_t n_bytes)
 {
-    const auto *state = twsfwphysx::GetWorldState(state_buffer);
+    const auto contains = [=](const std::span<const uint8_t> buffer)
+    {
+        const auto begin = reinterpret_cast<std::uintptr_t>(buffer.data());
+        const auto ptr = reinterpret_cast<std::uintptr_t>(data);
+        return ptr >= begin && ptr - begin <= buffer.size() &&
+               n_bytes <= buffer.size() - (ptr - begin);
+    };
+
+    return contains(STATE_BUFFER) || contains(RESULT);
+}
 
-    const auto n_agents = state->agents()->size();
+template <class T>
+void assign_packed(auto &target, const flatbuffers::Vector<const T *> *vector)
+{
+    const std::size_t n = vector->size();
+    assert(is_readable(vector->Data(), n * sizeof(T)));
+    target.assign(vector->Data(), n);
+}
+
+void deserialize_legacy(const twsfwphysx::WorldState *state)
+{
+    const auto n_agents = state->agents() != nullptr ? state->agents()->size() :
+                                                       0U;
+    AGENTS.resize(n_agents);
     for (auto i = 0U; i < n_agents; i++) {
         const auto *agent = state->agents()->Get(i);
         AGENTS[i] = twsfwphysx_agent{.r = {.x = agent->r()->x(),
@@ -168,7 +306,8 @@ void deserialize(const uint8_t *state_buffer)
     }
 
     MISSILES.clear();
-    const auto n_missiles = state->missiles()->size();
+    const auto n_missiles =
+        state->missiles() != nullptr ? state->missiles()->size() : 0U;
     for (auto i = 0U; i < n_missiles; i++) {
         const auto *missile = state->missiles()->Get(i);
         MISSILES.push_back({.r = {.x = missile->r()->x(),
@@ -182,7 +321,65 @@ void deserialize(const uint8_t *state_buffer)
     }
 }
 
-uint8_t *serialize()
+void deserialize_compact(const twsfwphysx::WorldState *state)
+{
+    const compact::Steps steps{.speed = state->speed_step(),
+                               .hp = state->hp_step()};
+
+    const auto n_agents = state->compact_agents() != nullptr ?
+                              state->compact_agents()->size() :
+                              0U;
+    AGENTS.resize(n_agents);
+    for (auto i = 0U; i < n_agents; i++) {
+        AGENTS[i] = compact::decode(*state->compact_agents()->Get(i), steps);
+    }
+
+    MISSILES.clear();
+    const auto n_missiles = state->compact_missiles() != nullptr ?
+                                state->compact_missiles()->size() :
+                                0U;
+    for (auto i = 0U; i < n_missiles; i++) {
+        MISSILES.push_back(
+            compact::decode(*state->compact_missiles()->Get(i), steps));
+    }
+}
+
+void deserialize(const uint8_t *state_buffer)
+{
+    const auto *state = twsfwphysx::GetWorldState(state_buffer);
+
+    if (state->compact_agents() != nullptr ||
+        state->compact_missiles() != nullptr)
+    {
+        FORMAT = Format::COMPACT;
+        deserialize_compact(state);
+        return;
+    }
+
+    // Buffers with tables of agents and missiles are accepted for one more
+    // release.
+    const bool legacy = state->packed_agents() == nullptr &&
+                        state->packed_missiles() == nullptr;
+    FORMAT = legacy ? Format::LEGACY : Format::PACKED;
+    if (FORMAT == Format::LEGACY) {
+        deserialize_legacy(state);
+        return;
+    }
+
+    if (state->packed_agents() != nullptr) {
+        assign_packed(AGENTS, state->packed_agents());
+    } else {
+        AGENTS.resize(0);
+    }
+
+    if (state->packed_missiles() != nullptr) {
+        assign_packed(MISSILES, state->packed_missiles());
+    } else {
+        MISSILES.clear();
+    }
+}
+
+flatbuffers::Offset<twsfwphysx::WorldState> serialize_legacy()
 {
     AGENTS_OFFSETS.clear();
     AGENTS_OFFSETS.reserve(AGENTS.size());
@@ -206,12 +403,224 @@ uint8_t *serialize()
     }
     const auto missiles = FB_BUILDER.CreateVector(MISSILES_OFFSETS);
 
-    const auto state =
-        twsfwphysx::CreateWorldState(FB_BUILDER, agents, missiles);
-    FB_BUILDER.Finish(state);
+    return twsfwphysx::CreateWorldState(FB_BUILDER, agents, missiles);
+}
+
+template <class T>
+flatbuffers::Offset<flatbuffers::Vector<const T *>>
+create_packed_vector(const void *data, const std::size_t n)
+{
+    T *buffer = nullptr;
+    const auto vector =
+        FB_BUILDER.CreateUninitializedVectorOfStructs<T>(n, &buffer);
+    if (n > 0) {
+        std::memcpy(buffer, data, n * sizeof(T));
+    }
+
+    return vector;
+}
+
+flatbuffers::Offset<twsfwphysx::WorldState> serialize_compact()
+{
+    const std::span<const twsfwphysx_agent> agents(AGENTS.data()->agents,
+                                                   AGENTS.size());
+    const std::span<const twsfwphysx_missile> missiles(MISSILES.missiles(),
+                                                       MISSILES.size());
+    const auto steps = compact::steps(agents, missiles);
+
+    twsfwphysx::CompactAgent *compact_agents = nullptr;
+    const auto agents_vector =
+        FB_BUILDER.CreateUninitializedVectorOfStructs<twsfwphysx::CompactAgent>(
+            agents.size(), &compact_agents);
+    for (std::size_t i = 0; i < agents.size(); i++) {
+        compact_agents[i] = compact::encode(agents[i], steps);
+    }
+
+    twsfwphysx::CompactMissile *compact_missiles = nullptr;
+    const auto missiles_vector = FB_BUILDER.CreateUninitializedVectorOfStructs<
+        twsfwphysx::CompactMissile>(missiles.size(), &compact_missiles);
+    for (std::size_t i = 0; i < missiles.size(); i++) {
+        compact_missiles[i] = compact::encode(missiles[i], steps);
+    }
+
+    twsfwphysx::WorldStateBuilder state(FB_BUILDER);
+    state.add_compact_agents(agents_vector);
+    state.add_compact_missiles(missiles_vector);
+    state.add_speed_step(steps.speed);
+    state.add_hp_step(steps.hp);
+    return state.Finish();
+}
+
+uint8_t *serialize()
+{
+    // Clearing keeps the memory of the builder, i.e., the previous result is
+    // overwritten. (It may still be the input of `deserialize()` though.)
+    FB_BUILDER.Clear();
+
+    if (FORMAT == Format::LEGACY) {
+        FB_BUILDER.Finish(serialize_legacy());
+    } else if (FORMAT == Format::COMPACT) {
+        FB_BUILDER.Finish(serialize_compact());
+    } else {
+        const auto agents = create_packed_vector<twsfwphysx::PackedAgent>(
+            AGENTS.data()->agents, AGENTS.size());
+        const auto missiles = create_packed_vector<twsfwphysx::PackedMissile>(
+            MISSILES.missiles(), MISSILES.size());
+        twsfwphysx::WorldStateBuilder state(FB_BUILDER);
+        state.add_packed_agents(agents);
+        state.add_packed_missiles(missiles);
+        FB_BUILDER.Finish(state.Finish());
+    }
 
+    RESULT = {FB_BUILDER.GetBufferPointer(), FB_BUILDER.GetSize()};
     return FB_BUILDER.GetBufferPointer();
 }
+
+// Commands are sequences of little-endian 32-bit words: the opcode followed
+// by its arguments (see README). Agents are referred to by their index.
+enum Command : int32_t
+{
+    SET_ACCELERATION = 1,  // agent, a
+    TURN_AGENT = 2,  // agent, angle
+    LAUNCH_MISSILE = 3,  // agent, payload
+    SET_HP = 4,  // agent, hp
+    SPAWN_AGENT = 5,  // r.x, r.y, r.z, u.x, u.y, u.z, v, a, hp
+    REMOVE_AGENT = 6,  // agent (the last agent takes over its index)
+};
+
+constexpr int32_t MAX_EVENTS = 1024;
+
+// Output of `tick()`. The host reads it as little-endian 32-bit words.
+struct TickOutput
+{
+    int32_t n_bytes;  // size of the used part of this struct
+    int32_t tick;  // number of ticks so far (including this one)
+    int32_t n_applied;  // number of applied commands
+    int32_t n_agents;
+    int32_t n_missiles;
+    int32_t n_events;
+    int32_t n_dropped;  // number of events that did not fit
+    std::array<twsfwphysx_event, MAX_EVENTS> events;
+};
+
+std::vector<uint8_t> COMMAND_BUFFER;
+std::array<twsfwphysx_event, MAX_EVENTS> EVENT_STORAGE;
+twsfwphysx_events EVENTS =
+    twsfwphysx_make_events(EVENT_STORAGE.data(), MAX_EVENTS);
+TickOutput TICK_OUTPUT{};
+
+delta::Encoder DELTA_ENCODER;
+
+// Reads commands word by word and stops at the first malformed one.
+class CommandReader final
+{
+    const uint8_t *m_data;
+    std::size_t m_n_words;
+    std::size_t m_pos = 0;
+
+  public:
+    CommandReader(const uint8_t *data, const std::size_t n_bytes)
+        : m_data(data)
+        , m_n_words(n_bytes / sizeof(int32_t))
+    {
+    }
+
+    [[nodiscard]] bool done() const
+    {
+        return m_pos == m_n_words;
+    }
+
+    [[nodiscard]] bool has(const std::size_t n_words) const
+    {
+        return m_n_words - m_pos >= n_words;
+    }
+
+    template <class T>
+    T read()
+    {
+        static_assert(sizeof(T) == sizeof(int32_t));
+        assert(has(1));
+
+        T value;
+        std::memcpy(&value, m_data + m_pos * sizeof(int32_t), sizeof(T));
+        m_pos += 1;
+        return value;
+    }
+
+    // Reads an agent index and checks it.
+    bool read_agent(std::size_t &agent)
+    {
+        const auto i = read<int32_t>();
+        agent = static_cast<std::size_t>(i);
+        return i >= 0 && agent < AGENTS.size();
+    }
+};
+
+bool apply_command(CommandReader &reader)
+{
+    const auto command = reader.read<int32_t>();
+    std::size_t agent = 0;
+
+    switch (command) {
+    case SET_ACCELERATION:
+        if (!reader.has(2) || !reader.read_agent(agent)) {
+            return false;
+        }
+        AGENTS[agent].a = reader.read<float>();
+        return true;
+    case TURN_AGENT:
+        if (!reader.has(2) || !reader.read_agent(agent)) {
+            return false;
+        }
+        twsfwphysx_turn_agent(&AGENTS[agent], reader.read<float>());
+        return true;
+    case LAUNCH_MISSILE: {
+        if (!reader.has(2) || !reader.read_agent(agent)) {
+            return false;
+        }
+        auto missile = twsfwphysx_launch_missile(&AGENTS[agent], &WORLD_CFG);
+        missile.payload = reader.read<int32_t>();
+        MISSILES.push_back(missile);
+        return true;
+    }
+    case SET_HP:
+        if (!reader.has(2) || !reader.read_agent(agent)) {
+            return false;
+        }
+        AGENTS[agent].hp = reader.read<float>();
+        return true;
+    case SPAWN_AGENT: {
+        if (!reader.has(9)) {
+            return false;
+        }
+        std::array<float, 9> fields{};
+        for (auto &field : fields) {
+            field = reader.read<float>();
+        }
+        agent = AGENTS.size();
+        AGENTS.resize(agent + 1);
+        AGENTS[agent] =
+            twsfwphysx_agent{.r = {fields[0], fields[1], fields[2]},
+                             .u = {fields[3], fields[4], fields[5]},
+                             .v = fields[6],
+                             .a = fields[7],
+                             .hp = fields[8]};
+        return true;
+    }
+    case REMOVE_AGENT: {
+        if (!reader.has(1) || !reader.read_agent(agent)) {
+            return false;
+        }
+        const auto last = AGENTS.size() - 1;
+        AGENTS[agent] = AGENTS[last];
+        AGENTS.resize(last);
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
 }  // namespace
 
 extern "C"
@@ -248,7 +657,14 @@ EMSCRIPTEN_KEEPALIVE
 uint8_t *new_state_buffer(const int32_t n_bytes)
 {
     assert(n_bytes > 0);
-    ::STATE_BUFFER.resize(static_cast<std::size_t>(n_bytes));
+
+    // Grow geometrically such that slightly growing worlds do not reallocate
+    // on every tick. Shrinking never releases memory.
+    const auto size = static_cast<std::size_t>(n_bytes);
+    if (size > ::STATE_BUFFER.capacity()) {
+        ::STATE_BUFFER.reserve(std::max(size, 2 * ::STATE_BUFFER.capacity()));
+    }
+    ::STATE_BUFFER.resize(size);
 
     return ::STATE_BUFFER.data();
 }
@@ -270,4 +686,159 @@ uint8_t *simulate(const float t,
     return ::serialize();
 }
 
+EMSCRIPTEN_KEEPALIVE
+const int32_t *layout()
+{
+    return ::LAYOUT.data();
+}
+
+EMSCRIPTEN_KEEPALIVE
+twsfwphysx_agent *set_agent_count(const int32_t n_agents)
+{
+    assert(n_agents >= 0);
+
+    const auto size = ::AGENTS.size();
+    const auto new_size = static_cast<std::size_t>(n_agents);
+    ::AGENTS.resize(new_size);
+    for (auto i = size; i < new_size; i++) {
+        ::AGENTS[i] = twsfwphysx_agent{};
+    }
+
+    return ::AGENTS.data()->agents;
+}
+
+EMSCRIPTEN_KEEPALIVE
+twsfwphysx_agent *agents_pointer()
+{
+    return ::AGENTS.data()->agents;
+}
+
+EMSCRIPTEN_KEEPALIVE
+int32_t agents_count()
+{
+    return static_cast<int32_t>(::AGENTS.size());
+}
+
+EMSCRIPTEN_KEEPALIVE
+const twsfwphysx_missile *missiles_pointer()
+{
+    return ::MISSILES.missiles();
+}
+
+EMSCRIPTEN_KEEPALIVE
+int32_t missiles_count()
+{
+    return static_cast<int32_t>(::MISSILES.size());
+}
+
+EMSCRIPTEN_KEEPALIVE
+void clear_missiles()
+{
+    ::MISSILES.clear();
+}
+
+EMSCRIPTEN_KEEPALIVE
+int32_t launch_missile(const int32_t agent, const int32_t payload)
+{
+    assert(agent >= 0);
+
+    auto missile = twsfwphysx_launch_missile(
+        &::AGENTS[static_cast<std::size_t>(agent)], &::WORLD_CFG);
+    missile.payload = payload;
+    ::MISSILES.push_back(missile);
+
+    return static_cast<int32_t>(::MISSILES.size());
+}
+
+EMSCRIPTEN_KEEPALIVE
+void turn_agent(const int32_t agent, const float angle)
+{
+    assert(agent >= 0);
+    twsfwphysx_turn_agent(&::AGENTS[static_cast<std::size_t>(agent)], angle);
+}
+
+EMSCRIPTEN_KEEPALIVE
+void simulate_in_place(const float t, const int32_t n_steps)
+{
+    twsfwphysx_simulate(AGENTS.data(),
+                        MISSILES.data(),
+                        &WORLD_CFG,
+                        t,
+                        n_steps,
+                        SIMULATION_BUFFER);
+}
+
+EMSCRIPTEN_KEEPALIVE
+uint8_t *new_command_buffer(const int32_t n_bytes)
+{
+    assert(n_bytes > 0);
+
+    const auto size = static_cast<std::size_t>(n_bytes);
+    if (size > ::COMMAND_BUFFER.capacity()) {
+        ::COMMAND_BUFFER.reserve(
+            std::max(size, 2 * ::COMMAND_BUFFER.capacity()));
+    }
+    ::COMMAND_BUFFER.resize(size);
+
+    return ::COMMAND_BUFFER.data();
+}
+
+EMSCRIPTEN_KEEPALIVE
+const uint8_t *tick(const float t,
+                    const int32_t n_steps,
+                    const uint8_t *commands,
+                    const int32_t n_bytes)
+{
+    assert(n_bytes >= 0);
+
+    int32_t n_applied = 0;
+    CommandReader reader(commands, static_cast<std::size_t>(n_bytes));
+    while (!reader.done() && ::apply_command(reader)) {
+        n_applied += 1;
+    }
+
+    twsfwphysx_clear_events(&::EVENTS);
+    twsfwphysx_set_events(SIMULATION_BUFFER, &::EVENTS);
+    twsfwphysx_simulate(AGENTS.data(),
+                        MISSILES.data(),
+                        &WORLD_CFG,
+                        t,
+                        n_steps,
+                        SIMULATION_BUFFER);
+    twsfwphysx_set_events(SIMULATION_BUFFER, nullptr);
+
+    auto &output = ::TICK_OUTPUT;
+    output.tick += 1;
+    output.n_applied = n_applied;
+    output.n_agents = static_cast<int32_t>(AGENTS.size());
+    output.n_missiles = static_cast<int32_t>(MISSILES.size());
+    output.n_events = ::EVENTS.size;
+    output.n_dropped = ::EVENTS.n_dropped;
+    for (int32_t i = 0; i < ::EVENTS.size; i++) {
+        output.events[static_cast<std::size_t>(i)] =
+            *twsfwphysx_get_event(&::EVENTS, i);
+    }
+    output.n_bytes = static_cast<int32_t>(
+        offsetof(TickOutput, events) +
+        static_cast<std::size_t>(::EVENTS.size) * sizeof(twsfwphysx_event));
+
+    return reinterpret_cast<const uint8_t *>(&output);
+}
+
+EMSCRIPTEN_KEEPALIVE
+const uint8_t *serialize_delta()
+{
+    const auto output = ::DELTA_ENCODER.encode(
+        {AGENTS.data()->agents, AGENTS.size()},
+        {MISSILES.missiles(), MISSILES.size()});
+
+    return output.data();
+}
+
+EMSCRIPTEN_KEEPALIVE
+void acknowledge(const int32_t tick)
+{
+    ::DELTA_ENCODER.acknowledge(tick);
+}
+
 }  // extern "C"
@@ -0,0 +1,181 @@
+// Quantisation of the compact world state (see CompactAgent and CompactMissile
+// in twsfwphysx_world_state.fbs).
+//
+// Unit vectors are octahedral-encoded with two signed 16-bit integers. On
+// decode, they are normalized again and `u` is made perpendicular to `r`.
+// Velocities and accelerations are fixed-point numbers with the unit
+// `speed_step`, HPs with the unit `hp_step`. If all HPs are small integers,
+// `hp_step` is 1 and HPs are exact. Positive HPs are at least one `hp_step`
+// such that living agents stay alive.
+
+#ifndef TWSFWPHYSX_COMPACT_HPP
+#define TWSFWPHYSX_COMPACT_HPP
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <span>
+
+#include "twsfwphysx/twsfwphysx.h"
+#include "twsfwphysx_world_state_generated.h"
+
+namespace compact
+{
+constexpr float SNORM_MAX = std::numeric_limits<int16_t>::max();
+
+struct Steps
+{
+    float speed;
+    float hp;
+};
+
+inline int16_t to_snorm(const float value)
+{
+    return static_cast<int16_t>(
+        std::lround(std::clamp(value, -1.F, 1.F) * SNORM_MAX));
+}
+
+inline float sign(const float value)
+{
+    return value < 0.F ? -1.F : 1.F;
+}
+
+inline std::array<int16_t, 2> encode_unit(const twsfwphysx_vec &vec)
+{
+    const float norm = std::abs(vec.x) + std::abs(vec.y) + std::abs(vec.z);
+    float x = vec.x / norm;
+    float y = vec.y / norm;
+    if (vec.z < 0.F) {
+        const float folded_x = (1.F - std::abs(y)) * sign(x);
+        y = (1.F - std::abs(x)) * sign(y);
+        x = folded_x;
+    }
+
+    return {to_snorm(x), to_snorm(y)};
+}
+
+inline twsfwphysx_vec normalized(const twsfwphysx_vec &vec)
+{
+    const float norm = std::sqrt(vec.x * vec.x + vec.y * vec.y + vec.z * vec.z);
+    return {vec.x / norm, vec.y / norm, vec.z / norm};
+}
+
+inline twsfwphysx_vec decode_unit(const int16_t qx, const int16_t qy)
+{
+    float x = static_cast<float>(qx) / SNORM_MAX;
+    float y = static_cast<float>(qy) / SNORM_MAX;
+    const float z = 1.F - std::abs(x) - std::abs(y);
+    if (z < 0.F) {
+        const float unfolded_x = (1.F - std::abs(y)) * sign(x);
+        y = (1.F - std::abs(x)) * sign(y);
+        x = unfolded_x;
+    }
+
+    return normalized({x, y, z});
+}
+
+// Decodes the rotation axis `u` such that it is perpendicular to `r`.
+inline twsfwphysx_vec
+decode_axis(const int16_t qx, const int16_t qy, const twsfwphysx_vec &r)
+{
+    const auto u = decode_unit(qx, qy);
+    const float d = u.x * r.x + u.y * r.y + u.z * r.z;
+    return normalized({u.x - d * r.x, u.y - d * r.y, u.z - d * r.z});
+}
+
+inline int16_t to_fixed(const float value, const float step)
+{
+    return static_cast<int16_t>(
+        std::lround(std::clamp(value / step, -SNORM_MAX, SNORM_MAX)));
+}
+
+// Rounds positive HPs up to one step (instead of down to 0, which would kill
+// the agent).
+inline int16_t to_hp(const float hp, const float step)
+{
+    const int16_t value = to_fixed(hp, step);
+    return hp > 0.F ? std::max<int16_t>(value, 1) : value;
+}
+
+inline float from_fixed(const int16_t value, const float step)
+{
+    return static_cast<float>(value) * step;
+}
+
+// Chooses the units such that no value is clipped.
+inline Steps steps(const std::span<const twsfwphysx_agent> agents,
+                   const std::span<const twsfwphysx_missile> missiles)
+{
+    float max_speed = 0.F;
+    float max_hp = 0.F;
+    bool small_integers = true;
+    for (const auto &agent : agents) {
+        max_speed = std::max({max_speed, std::abs(agent.v), std::abs(agent.a)});
+        max_hp = std::max(max_hp, std::abs(agent.hp));
+        small_integers = small_integers && std::trunc(agent.hp) == agent.hp;
+    }
+    for (const auto &missile : missiles) {
+        max_speed = std::max(max_speed, std::abs(missile.v));
+    }
+
+    const auto step = [](const float max)
+    {
+        return max > 0.F ? max / SNORM_MAX : 1.F;
+    };
+
+    return {.speed = step(max_speed),
+            .hp = small_integers && max_hp <= SNORM_MAX ? 1.F : step(max_hp)};
+}
+
+inline twsfwphysx::CompactAgent encode(const twsfwphysx_agent &agent,
+                                       const Steps &steps)
+{
+    const auto r = encode_unit(agent.r);
+    const auto u = encode_unit(agent.u);
+    return {r[0],
+            r[1],
+            u[0],
+            u[1],
+            to_fixed(agent.v, steps.speed),
+            to_fixed(agent.a, steps.speed),
+            to_hp(agent.hp, steps.hp)};
+}
+
+inline twsfwphysx::CompactMissile encode(const twsfwphysx_missile &missile,
+                                         const Steps &steps)
+{
+    const auto r = encode_unit(missile.r);
+    const auto u = encode_unit(missile.u);
+    return {missile.payload,
+            r[0],
+            r[1],
+            u[0],
+            u[1],
+            to_fixed(missile.v, steps.speed)};
+}
+
+inline twsfwphysx_agent decode(const twsfwphysx::CompactAgent &agent,
+                               const Steps &steps)
+{
+    const auto r = decode_unit(agent.r_x(), agent.r_y());
+    return {.r = r,
+            .u = decode_axis(agent.u_x(), agent.u_y(), r),
+            .v = from_fixed(agent.v(), steps.speed),
+            .a = from_fixed(agent.a(), steps.speed),
+            .hp = from_fixed(agent.hp(), steps.hp)};
+}
+
+inline twsfwphysx_missile decode(const twsfwphysx::CompactMissile &missile,
+                                 const Steps &steps)
+{
+    const auto r = decode_unit(missile.r_x(), missile.r_y());
+    return {.r = r,
+            .u = decode_axis(missile.u_x(), missile.u_y(), r),
+            .v = from_fixed(missile.v(), steps.speed),
+            .payload = missile.payload()};
+}
+}  // namespace compact
+
+#endif  // TWSFWPHYSX_COMPACT_HPP
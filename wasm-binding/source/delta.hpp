@@ -0,0 +1,510 @@
+// Delta encoding of the world relative to a state that the host acknowledged.
+//
+// Outputs are sequences of little-endian 32-bit words (`int32` or `float32`):
+//
+//   header   n_bytes, tick, baseline, n_agents, n_agent_records, n_removed,
+//            n_moved, n_spawned
+//   agents   n_agent_records x (index << 8 | fields, changed fields...)
+//   removed  n_removed x baseline index of a detonated missile (ascending)
+//   moved    n_moved x (angle, v) of the remaining baseline missiles
+//   spawned  n_spawned x (r.x, r.y, r.z, u.x, u.y, u.z, v, payload)
+//
+// The changed fields of an agent follow in the order r, u, v, a, hp. Agents
+// that are not part of the baseline are sent with all fields.
+//
+// Missiles keep their rotation axis `u` and payload and move along the great
+// circle around `u`. Hence, only the angle by which they advanced on that
+// circle and their new velocity are sent. Decoded missiles are ordered as the
+// remaining baseline missiles followed by the spawned ones, which is not the
+// order of the engine (see `twsfwphysx_simulate`).
+//
+// Outputs without baseline (`baseline == NO_BASELINE`) contain the full world
+// and are sent for the first tick, periodically (see `RESYNC_INTERVAL`) and if
+// the acknowledged state is too old.
+
+#ifndef TWSFWPHYSX_DELTA_HPP
+#define TWSFWPHYSX_DELTA_HPP
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <vector>
+
+#include "twsfwphysx/twsfwphysx.h"
+
+namespace delta
+{
+enum Field : uint32_t
+{
+    FIELD_R = 1U << 0U,
+    FIELD_U = 1U << 1U,
+    FIELD_V = 1U << 2U,
+    FIELD_A = 1U << 3U,
+    FIELD_HP = 1U << 4U,
+    ALL_FIELDS = (1U << 5U) - 1U
+};
+
+constexpr uint32_t INDEX_SHIFT = 8;
+constexpr int32_t NO_BASELINE = -1;
+
+// Number of past states that are kept by the encoder and the decoder. Deltas
+// are only sent relative to one of them.
+constexpr int32_t HISTORY_SIZE = 32;
+
+// Maximum number of ticks between two outputs without baseline. Rounding
+// errors of the missiles' positions do not accumulate beyond that.
+constexpr int32_t RESYNC_INTERVAL = 64;
+
+struct Header
+{
+    int32_t n_bytes;
+    int32_t tick;
+    int32_t baseline;
+    int32_t n_agents;
+    int32_t n_agent_records;
+    int32_t n_removed;
+    int32_t n_moved;
+    int32_t n_spawned;
+};
+
+constexpr std::size_t HEADER_WORDS = sizeof(Header) / sizeof(uint32_t);
+constexpr std::size_t SPAWN_WORDS = 8;
+
+struct State
+{
+    int32_t tick = NO_BASELINE;
+    std::vector<twsfwphysx_agent> agents;
+    std::vector<twsfwphysx_missile> missiles;
+};
+
+// Ring of the last `HISTORY_SIZE` states indexed by their tick.
+class History final
+{
+    std::array<State, HISTORY_SIZE> m_states;
+
+  public:
+    [[nodiscard]] const State *find(const int32_t tick) const
+    {
+        if (tick < 0) {
+            return nullptr;
+        }
+
+        const auto &state =
+            m_states[static_cast<std::size_t>(tick % HISTORY_SIZE)];
+        return state.tick == tick ? &state : nullptr;
+    }
+
+    State &slot(const int32_t tick)
+    {
+        return m_states[static_cast<std::size_t>(tick % HISTORY_SIZE)];
+    }
+};
+
+// Rotates `r` around `u` (see `rotate()` of the engine).
+inline twsfwphysx_vec
+rotate(const twsfwphysx_vec &r, const twsfwphysx_vec &u, const float angle)
+{
+    const float c = std::cos(angle);
+    const float s = std::sin(angle);
+    const twsfwphysx_vec w = {u.y * r.z - u.z * r.y,
+                              u.z * r.x - u.x * r.z,
+                              u.x * r.y - u.y * r.x};
+    return {c * r.x + s * w.x, c * r.y + s * w.y, c * r.z + s * w.z};
+}
+
+// Angle by which `to` is rotated around `u` relative to `from`.
+inline float angle(const twsfwphysx_vec &from,
+                   const twsfwphysx_vec &to,
+                   const twsfwphysx_vec &u)
+{
+    const twsfwphysx_vec w = {u.y * from.z - u.z * from.y,
+                              u.z * from.x - u.x * from.z,
+                              u.x * from.y - u.y * from.x};
+    return std::atan2(w.x * to.x + w.y * to.y + w.z * to.z,
+                      from.x * to.x + from.y * to.y + from.z * to.z);
+}
+
+// Reads words and checks that they are available.
+class Reader final
+{
+    std::span<const uint8_t> m_data;
+    std::size_t m_pos = 0;
+
+  public:
+    explicit Reader(const std::span<const uint8_t> data)
+        : m_data(data)
+    {
+    }
+
+    [[nodiscard]] bool has(const std::size_t n_words) const
+    {
+        return (m_data.size() - m_pos) / sizeof(uint32_t) >= n_words;
+    }
+
+    template <class T>
+    T read()
+    {
+        static_assert(sizeof(T) == sizeof(uint32_t));
+        T value;
+        std::memcpy(&value, m_data.data() + m_pos, sizeof(T));
+        m_pos += sizeof(T);
+        return value;
+    }
+
+    twsfwphysx_vec read_vec()
+    {
+        const auto x = read<float>();
+        const auto y = read<float>();
+        const auto z = read<float>();
+        return {x, y, z};
+    }
+};
+
+// Decodes `data` and stores the result in `history`. Returns false if the
+// output is malformed or its baseline is not part of `history`.
+inline bool decode(const std::span<const uint8_t> data, History &history)
+{
+    Reader reader(data);
+    if (!reader.has(HEADER_WORDS)) {
+        return false;
+    }
+
+    Header header{};
+    std::memcpy(&header, data.data(), sizeof(Header));
+    for (std::size_t i = 0; i < HEADER_WORDS; i++) {
+        reader.read<int32_t>();
+    }
+
+    if (header.n_bytes < 0 ||
+        static_cast<std::size_t>(header.n_bytes) != data.size() ||
+        header.tick < 0 || header.n_agents < 0 || header.n_agent_records < 0 ||
+        header.n_removed < 0 || header.n_moved < 0 || header.n_spawned < 0)
+    {
+        return false;
+    }
+
+    static const State EMPTY;
+    const State *baseline = &EMPTY;
+    if (header.baseline != NO_BASELINE) {
+        // The slot of the baseline must not be overwritten by the result.
+        baseline = history.find(header.baseline);
+        if (baseline == nullptr || header.baseline >= header.tick ||
+            header.tick - header.baseline >= HISTORY_SIZE)
+        {
+            return false;
+        }
+    }
+
+    auto &state = history.slot(header.tick);
+    state.tick = NO_BASELINE;
+
+    const auto n_agents = static_cast<std::size_t>(header.n_agents);
+    const auto n_kept = std::min(n_agents, baseline->agents.size());
+    state.agents.resize(n_agents);
+    std::copy_n(baseline->agents.begin(), n_kept, state.agents.begin());
+    std::fill(state.agents.begin() + static_cast<std::ptrdiff_t>(n_kept),
+              state.agents.end(),
+              twsfwphysx_agent{});
+
+    for (int32_t i = 0; i < header.n_agent_records; i++) {
+        if (!reader.has(1)) {
+            return false;
+        }
+        const auto record = reader.read<uint32_t>();
+        const auto index = static_cast<std::size_t>(record >> INDEX_SHIFT);
+        const auto fields = record & ALL_FIELDS;
+        if (index >= n_agents ||
+            !reader.has(static_cast<std::size_t>(std::popcount(fields)) +
+                        2 * static_cast<std::size_t>((fields & FIELD_R) != 0) +
+                        2 * static_cast<std::size_t>((fields & FIELD_U) != 0)))
+        {
+            return false;
+        }
+
+        auto &agent = state.agents[index];
+        if ((fields & FIELD_R) != 0) {
+            agent.r = reader.read_vec();
+        }
+        if ((fields & FIELD_U) != 0) {
+            agent.u = reader.read_vec();
+        }
+        if ((fields & FIELD_V) != 0) {
+            agent.v = reader.read<float>();
+        }
+        if ((fields & FIELD_A) != 0) {
+            agent.a = reader.read<float>();
+        }
+        if ((fields & FIELD_HP) != 0) {
+            agent.hp = reader.read<float>();
+        }
+    }
+
+    // remaining baseline missiles (in the order of the baseline)
+    const auto n_missiles = baseline->missiles.size();
+    state.missiles.clear();
+    std::size_t next = 0;
+    for (int32_t i = 0; i <= header.n_removed; i++) {
+        auto removed = n_missiles;
+        if (i < header.n_removed) {
+            if (!reader.has(1)) {
+                return false;
+            }
+            removed = static_cast<std::size_t>(reader.read<uint32_t>());
+            if (removed < next || removed >= n_missiles) {
+                return false;
+            }
+        }
+
+        state.missiles.insert(
+            state.missiles.end(),
+            baseline->missiles.begin() + static_cast<std::ptrdiff_t>(next),
+            baseline->missiles.begin() + static_cast<std::ptrdiff_t>(removed));
+        next = removed + 1;
+    }
+
+    if (static_cast<std::size_t>(header.n_moved) != state.missiles.size() ||
+        !reader.has(2 * state.missiles.size()))
+    {
+        return false;
+    }
+    for (auto &missile : state.missiles) {
+        missile.r = rotate(missile.r, missile.u, reader.read<float>());
+        missile.v = reader.read<float>();
+    }
+
+    if (!reader.has(SPAWN_WORDS * static_cast<std::size_t>(header.n_spawned))) {
+        return false;
+    }
+    for (int32_t i = 0; i < header.n_spawned; i++) {
+        twsfwphysx_missile missile{};
+        missile.r = reader.read_vec();
+        missile.u = reader.read_vec();
+        missile.v = reader.read<float>();
+        missile.payload = reader.read<int32_t>();
+        state.missiles.push_back(missile);
+    }
+
+    if (reader.has(1)) {
+        return false;
+    }
+
+    state.tick = header.tick;
+    return true;
+}
+
+// Encodes the world relative to the last acknowledged state. The encoder
+// decodes its own outputs to know the exact state of the host.
+class Encoder final
+{
+    // Missiles are identified by their (constant) rotation axis and payload.
+    // Missiles with the same key share a great circle, which is why they can
+    // be matched arbitrarily.
+    using Key = std::array<uint32_t, 4>;
+
+    struct Entry
+    {
+        Key key;
+        std::size_t index;
+
+        bool operator<(const Entry &other) const
+        {
+            return key < other.key || (key == other.key && index < other.index);
+        }
+    };
+
+    History m_history;
+    int32_t m_tick = 0;
+    int32_t m_acknowledged = NO_BASELINE;
+    int32_t m_resync = NO_BASELINE;
+
+    std::vector<uint32_t> m_words;
+    std::vector<Entry> m_baseline_entries;
+    std::vector<Entry> m_entries;
+    std::vector<std::size_t> m_matches;
+
+    static Key key(const twsfwphysx_missile &missile)
+    {
+        return {std::bit_cast<uint32_t>(missile.u.x),
+                std::bit_cast<uint32_t>(missile.u.y),
+                std::bit_cast<uint32_t>(missile.u.z),
+                std::bit_cast<uint32_t>(missile.payload)};
+    }
+
+    void add(const float value)
+    {
+        m_words.push_back(std::bit_cast<uint32_t>(value));
+    }
+
+    void add(const twsfwphysx_vec &vec)
+    {
+        add(vec.x);
+        add(vec.y);
+        add(vec.z);
+    }
+
+    static uint32_t changed_fields(const twsfwphysx_agent &from,
+                                   const twsfwphysx_agent &to)
+    {
+        const auto differs = [](const auto &a, const auto &b)
+        {
+            return std::memcmp(&a, &b, sizeof(a)) != 0;
+        };
+
+        return (differs(from.r, to.r) ? FIELD_R : 0U) |
+               (differs(from.u, to.u) ? FIELD_U : 0U) |
+               (differs(from.v, to.v) ? FIELD_V : 0U) |
+               (differs(from.a, to.a) ? FIELD_A : 0U) |
+               (differs(from.hp, to.hp) ? FIELD_HP : 0U);
+    }
+
+    // Sets m_matches[i] to the index of the missile that continues the i-th
+    // baseline missile (or to `missiles.size()` if it detonated) and marks
+    // matched missiles in m_entries by setting their index to `SIZE_MAX`.
+    void match(const std::vector<twsfwphysx_missile> &baseline,
+               const std::span<const twsfwphysx_missile> missiles)
+    {
+        m_baseline_entries.clear();
+        for (std::size_t i = 0; i < baseline.size(); i++) {
+            m_baseline_entries.push_back({key(baseline[i]), i});
+        }
+        std::sort(m_baseline_entries.begin(), m_baseline_entries.end());
+
+        m_entries.clear();
+        for (std::size_t j = 0; j < missiles.size(); j++) {
+            m_entries.push_back({key(missiles[j]), j});
+        }
+        std::sort(m_entries.begin(), m_entries.end());
+
+        m_matches.assign(baseline.size(), missiles.size());
+        auto entry = m_entries.begin();
+        for (const auto &baseline_entry : m_baseline_entries) {
+            while (entry != m_entries.end() && entry->key < baseline_entry.key)
+            {
+                ++entry;
+            }
+            if (entry != m_entries.end() && entry->key == baseline_entry.key) {
+                m_matches[baseline_entry.index] = entry->index;
+                entry->index = SIZE_MAX;
+                ++entry;
+            }
+        }
+    }
+
+  public:
+    // Deltas of the following outputs are relative to the state of `tick`
+    // (if it is still known).
+    void acknowledge(const int32_t tick)
+    {
+        if (tick > m_acknowledged && tick < m_tick) {
+            m_acknowledged = tick;
+        }
+    }
+
+    std::span<const uint8_t>
+    encode(const std::span<const twsfwphysx_agent> agents,
+           const std::span<const twsfwphysx_missile> missiles)
+    {
+        assert(agents.size() < (std::size_t{1} << (32U - INDEX_SHIFT)));
+        const int32_t tick = m_tick++;
+
+        const State *baseline = m_history.find(m_acknowledged);
+        if (tick - m_acknowledged >= HISTORY_SIZE ||
+            tick - m_resync >= RESYNC_INTERVAL)
+        {
+            baseline = nullptr;
+        }
+        if (baseline == nullptr) {
+            m_resync = tick;
+        }
+
+        static const State EMPTY;
+        const State &base = baseline != nullptr ? *baseline : EMPTY;
+
+        m_words.assign(HEADER_WORDS, 0U);
+        Header header{.n_bytes = 0,
+                      .tick = tick,
+                      .baseline = baseline != nullptr ? baseline->tick :
+                                                        NO_BASELINE,
+                      .n_agents = static_cast<int32_t>(agents.size()),
+                      .n_agent_records = 0,
+                      .n_removed = 0,
+                      .n_moved = 0,
+                      .n_spawned = 0};
+
+        for (std::size_t i = 0; i < agents.size(); i++) {
+            const auto &agent = agents[i];
+            const auto fields = i < base.agents.size() ?
+                                    changed_fields(base.agents[i], agent) :
+                                    uint32_t{ALL_FIELDS};
+            if (fields == 0) {
+                continue;
+            }
+
+            m_words.push_back(static_cast<uint32_t>(i) << INDEX_SHIFT | fields);
+            if ((fields & FIELD_R) != 0) {
+                add(agent.r);
+            }
+            if ((fields & FIELD_U) != 0) {
+                add(agent.u);
+            }
+            if ((fields & FIELD_V) != 0) {
+                add(agent.v);
+            }
+            if ((fields & FIELD_A) != 0) {
+                add(agent.a);
+            }
+            if ((fields & FIELD_HP) != 0) {
+                add(agent.hp);
+            }
+            header.n_agent_records += 1;
+        }
+
+        match(base.missiles, missiles);
+        for (std::size_t i = 0; i < base.missiles.size(); i++) {
+            if (m_matches[i] == missiles.size()) {
+                m_words.push_back(static_cast<uint32_t>(i));
+                header.n_removed += 1;
+            }
+        }
+        for (std::size_t i = 0; i < base.missiles.size(); i++) {
+            if (m_matches[i] != missiles.size()) {
+                const auto &from = base.missiles[i];
+                const auto &to = missiles[m_matches[i]];
+                add(angle(from.r, to.r, from.u));
+                add(to.v);
+                header.n_moved += 1;
+            }
+        }
+        for (const auto &entry : m_entries) {
+            if (entry.index != SIZE_MAX) {
+                const auto &missile = missiles[entry.index];
+                add(missile.r);
+                add(missile.u);
+                add(missile.v);
+                m_words.push_back(static_cast<uint32_t>(missile.payload));
+                header.n_spawned += 1;
+            }
+        }
+
+        header.n_bytes =
+            static_cast<int32_t>(m_words.size() * sizeof(uint32_t));
+        std::memcpy(m_words.data(), &header, sizeof(Header));
+
+        const std::span<const uint8_t> output(
+            reinterpret_cast<const uint8_t *>(m_words.data()),
+            m_words.size() * sizeof(uint32_t));
+        [[maybe_unused]] const bool decoded = decode(output, m_history);
+        assert(decoded);
+
+        return output;
+    }
+};
+}  // namespace delta
+
+#endif  // TWSFWPHYSX_DELTA_HPP
@@ -1,8 +1,18 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
 #include <cassert>
+#include <cmath>
+#include <cstdlib>
 #include <cstring>
+#include <new>
+#include <random>
 #include <string>
 #include <vector>
 
+#include "compact.hpp"
+#include "delta.hpp"
 #include "twsfwphysx/twsfwphysx.h"
 #include "twsfwphysx_world_state_generated.h"
 
@@ -10,6 +20,26 @@
 #    error "Assertions must be enabled. Compile without defining NDEBUG."
 #endif
 
+#if defined(__SANITIZE_ADDRESS__)
+#    define ASAN_ENABLED
+#elif defined(__has_feature)
+#    if __has_feature(address_sanitizer)
+#        define ASAN_ENABLED
+#    endif
+#endif
+
+#ifdef ASAN_ENABLED
+// from <sanitizer/allocator_interface.h> (which not all compilers ship)
+extern "C"
+{
+int __sanitizer_install_malloc_and_free_hooks(
+    void (*malloc_hook)(const volatile void *, std::size_t),
+    void (*free_hook)(const volatile void *));
+
+std::size_t __sanitizer_get_current_allocated_bytes();
+}  // extern "C"
+#endif
+
 extern "C"
 {
 extern int32_t version_major();
@@ -23,8 +53,65 @@ extern void init_world(float restitution,
 extern uint8_t *new_state_buffer(int32_t n_bytes);
 
 extern uint8_t *simulate(float t, int32_t n_steps, const uint8_t *state_buffer);
+
+extern const int32_t *layout();
+extern twsfwphysx_agent *set_agent_count(int32_t n_agents);
+extern twsfwphysx_agent *agents_pointer();
+extern int32_t agents_count();
+extern const twsfwphysx_missile *missiles_pointer();
+extern int32_t missiles_count();
+extern void clear_missiles();
+extern int32_t launch_missile(int32_t agent, int32_t payload);
+extern void turn_agent(int32_t agent, float angle);
+extern void simulate_in_place(float t, int32_t n_steps);
+
+extern uint8_t *new_command_buffer(int32_t n_bytes);
+extern const uint8_t *
+tick(float t, int32_t n_steps, const uint8_t *commands, int32_t n_bytes);
+
+extern const uint8_t *serialize_delta();
+extern void acknowledge(int32_t tick);
 }  // extern "C"
 
+namespace
+{
+std::atomic<int64_t> N_ALLOCATIONS{0};
+}  // namespace
+
+// Counts heap allocations. With AddressSanitizer (see Makefile), every
+// allocation is counted via its hooks, including the ones of the C engine.
+// Otherwise, only allocations via `operator new` are seen.
+#ifdef ASAN_ENABLED
+namespace
+{
+void count_malloc(const volatile void * /*ptr*/, std::size_t /*size*/)
+{
+    N_ALLOCATIONS++;
+}
+
+void ignore_free(const volatile void * /*ptr*/) {}
+}  // namespace
+#else
+void *operator new(const std::size_t size)
+{
+    N_ALLOCATIONS++;
+    if (void *ptr = std::malloc(size == 0 ? 1 : size)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t /*size*/) noexcept
+{
+    std::free(ptr);
+}
+#endif
+
 namespace
 {
 void test_version()
@@ -40,6 +127,909 @@ void test_version()
     assert(version == twsfwphysx_version());
 }
 
+// agents on a Fibonacci sphere, each launching one missile
+void make_crowded_world(const twsfwphysx_world &world,
+                        const int32_t n_agents,
+                        std::vector<twsfwphysx_agent> &agents,
+                        std::vector<twsfwphysx_missile> &missiles)
+{
+    for (int32_t i = 0; i < n_agents; i++) {
+        const float z = 1.F - 2.F * (static_cast<float>(i) + .5F) /
+                                  static_cast<float>(n_agents);
+        const float rho = std::sqrt(1.F - z * z);
+        const float phi = 2.39996323F * static_cast<float>(i);
+        const twsfwphysx_agent agent{
+            .r = {rho * std::cos(phi), rho * std::sin(phi), z},
+            .u = {-std::sin(phi), std::cos(phi), 0.F},
+            .v = .1F,
+            .a = .2F,
+            .hp = 1e3F};
+        agents.push_back(agent);
+
+        auto missile = twsfwphysx_launch_missile(&agent, &world);
+        missile.payload = i;
+        missiles.push_back(missile);
+    }
+}
+
+twsfwphysx::Vec to_vec(const twsfwphysx_vec &v)
+{
+    return {v.x, v.y, v.z};
+}
+
+std::vector<uint8_t> serialize(const std::vector<twsfwphysx_agent> &agents,
+                               const std::vector<twsfwphysx_missile> &missiles,
+                               const bool legacy)
+{
+    flatbuffers::FlatBufferBuilder builder(1024);
+
+    if (legacy) {
+        std::vector<flatbuffers::Offset<twsfwphysx::Agent>> agents_offsets;
+        for (const auto &agent : agents) {
+            const auto r = to_vec(agent.r);
+            const auto u = to_vec(agent.u);
+            agents_offsets.emplace_back(twsfwphysx::CreateAgent(
+                builder, &r, &u, agent.v, agent.a, agent.hp));
+        }
+        const auto agents_vector = builder.CreateVector(agents_offsets);
+
+        std::vector<flatbuffers::Offset<twsfwphysx::Missile>> missiles_offsets;
+        for (const auto &missile : missiles) {
+            const auto r = to_vec(missile.r);
+            const auto u = to_vec(missile.u);
+            missiles_offsets.emplace_back(twsfwphysx::CreateMissile(
+                builder, &r, &u, missile.v, missile.payload));
+        }
+        const auto missiles_vector = builder.CreateVector(missiles_offsets);
+
+        builder.Finish(twsfwphysx::CreateWorldState(
+            builder, agents_vector, missiles_vector));
+    } else {
+        std::vector<twsfwphysx::PackedAgent> packed_agents;
+        for (const auto &agent : agents) {
+            packed_agents.emplace_back(to_vec(agent.r),
+                                       to_vec(agent.u),
+                                       agent.v,
+                                       agent.a,
+                                       agent.hp);
+        }
+        const auto agents_vector = builder.CreateVectorOfStructs(packed_agents);
+
+        std::vector<twsfwphysx::PackedMissile> packed_missiles;
+        for (const auto &missile : missiles) {
+            packed_missiles.emplace_back(to_vec(missile.r),
+                                         to_vec(missile.u),
+                                         missile.v,
+                                         missile.payload);
+        }
+        const auto missiles_vector =
+            builder.CreateVectorOfStructs(packed_missiles);
+
+        twsfwphysx::WorldStateBuilder state(builder);
+        state.add_packed_agents(agents_vector);
+        state.add_packed_missiles(missiles_vector);
+        builder.Finish(state.Finish());
+    }
+
+    const auto *data = builder.GetBufferPointer();
+    return {data, data + builder.GetSize()};
+}
+
+bool same(const float a, const float b)
+{
+    return std::bit_cast<uint32_t>(a) == std::bit_cast<uint32_t>(b);
+}
+
+bool same(const twsfwphysx::Vec &a, const twsfwphysx::Vec &b)
+{
+    return same(a.x(), b.x()) && same(a.y(), b.y()) && same(a.z(), b.z());
+}
+
+template <class T>
+std::vector<T> copy_structs(const flatbuffers::Vector<const T *> *vector)
+{
+    std::vector<T> copy;
+    for (auto i = 0U; i < vector->size(); i++) {
+        copy.push_back(*vector->Get(i));
+    }
+
+    return copy;
+}
+
+uint8_t *simulate_state(const std::vector<uint8_t> &state,
+                        const float t,
+                        const int32_t n_steps)
+{
+    auto *state_buffer = new_state_buffer(static_cast<int32_t>(state.size()));
+    std::memcpy(state_buffer, state.data(), state.size());
+    return simulate(t, n_steps, state_buffer);
+}
+
+// Results are serialized in the format of the input. Both formats yield
+// bitwise identical results.
+void test_packed_and_legacy_format()
+{
+    constexpr int32_t N_AGENTS = 50;
+
+    const twsfwphysx_world world{
+        .restitution = .8F, .agent_radius = .05F, .missile_acceleration = 1.F};
+    init_world(
+        world.restitution, world.agent_radius, world.missile_acceleration);
+
+    std::vector<twsfwphysx_agent> agents;
+    std::vector<twsfwphysx_missile> missiles;
+    make_crowded_world(world, N_AGENTS, agents, missiles);
+
+    const auto *packed = twsfwphysx::GetWorldState(
+        simulate_state(serialize(agents, missiles, false), 2.F, 200));
+    assert(packed->agents() == nullptr);
+    assert(packed->missiles() == nullptr);
+    assert(packed->packed_agents()->size() == static_cast<uint32_t>(N_AGENTS));
+    assert(packed->packed_missiles()->size() <
+           static_cast<uint32_t>(N_AGENTS));
+
+    // copy the result since simulate() overwrites it
+    const auto packed_agents = copy_structs(packed->packed_agents());
+    const auto packed_missiles = copy_structs(packed->packed_missiles());
+
+    const auto *legacy = twsfwphysx::GetWorldState(
+        simulate_state(serialize(agents, missiles, true), 2.F, 200));
+    assert(legacy->packed_agents() == nullptr);
+    assert(legacy->packed_missiles() == nullptr);
+    assert(legacy->agents()->size() == packed_agents.size());
+    assert(legacy->missiles()->size() == packed_missiles.size());
+
+    for (auto i = 0U; i < packed_agents.size(); i++) {
+        const auto &expected = packed_agents[i];
+        const auto *agent = legacy->agents()->Get(i);
+        assert(same(expected.r(), *agent->r()));
+        assert(same(expected.u(), *agent->u()));
+        assert(same(expected.v(), agent->v()));
+        assert(same(expected.a(), agent->a()));
+        assert(same(expected.hp(), agent->hp()));
+    }
+
+    for (auto i = 0U; i < packed_missiles.size(); i++) {
+        const auto &expected = packed_missiles[i];
+        const auto *missile = legacy->missiles()->Get(i);
+        assert(same(expected.r(), *missile->r()));
+        assert(same(expected.u(), *missile->u()));
+        assert(same(expected.v(), missile->v()));
+        assert(expected.payload() == missile->payload());
+    }
+}
+
+// Repeated calls to simulate() with worlds of constant (or shrinking) size
+// must neither allocate nor grow memory after the first tick.
+void test_steady_state()
+{
+    constexpr int32_t N_AGENTS = 100;
+    constexpr int32_t N_TICKS = 10'000;
+    constexpr int32_t RESTART_EVERY = 100;
+
+    const twsfwphysx_world world{
+        .restitution = .8F, .agent_radius = .01F, .missile_acceleration = 1.F};
+    init_world(
+        world.restitution, world.agent_radius, world.missile_acceleration);
+
+    std::vector<twsfwphysx_agent> agents;
+    std::vector<twsfwphysx_missile> missiles;
+    make_crowded_world(world, N_AGENTS, agents, missiles);
+    const auto state = serialize(agents, missiles, false);
+
+#ifdef ASAN_ENABLED
+    const auto installed =
+        __sanitizer_install_malloc_and_free_hooks(count_malloc, ignore_free);
+    assert(installed != 0);
+#endif
+
+    // Missiles hit agents such that the world shrinks until it is restarted
+    // via new_state_buffer(). Otherwise, results are fed back into simulate().
+    const auto run = [&state](const int32_t n_ticks)
+    {
+        const uint8_t *state_buffer = nullptr;
+        for (int32_t i = 0; i < n_ticks; i++) {
+            if (i % RESTART_EVERY == 0) {
+                auto *buffer =
+                    new_state_buffer(static_cast<int32_t>(state.size()));
+                std::memcpy(buffer, state.data(), state.size());
+                state_buffer = buffer;
+            }
+            state_buffer = simulate(.01F, 1, state_buffer);
+        }
+
+        const auto *result = twsfwphysx::GetWorldState(state_buffer);
+        assert(result->packed_agents()->size() ==
+               static_cast<uint32_t>(N_AGENTS));
+    };
+
+    // warm-up
+    run(RESTART_EVERY);
+
+#ifdef ASAN_ENABLED
+    const auto bytes = __sanitizer_get_current_allocated_bytes();
+#endif
+    N_ALLOCATIONS = 0;
+
+    run(N_TICKS);
+
+    assert(N_ALLOCATIONS == 0);
+#ifdef ASAN_ENABLED
+    assert(__sanitizer_get_current_allocated_bytes() == bytes);
+#endif
+}
+
+// Accesses the engine's memory like a host would do with typed-array views,
+// i.e., only via the exported pointers and layout constants.
+void test_linear_memory()
+{
+    constexpr int32_t N_AGENTS = 50;
+
+    const twsfwphysx_world world{
+        .restitution = .8F, .agent_radius = .05F, .missile_acceleration = 1.F};
+    init_world(
+        world.restitution, world.agent_radius, world.missile_acceleration);
+
+    std::vector<twsfwphysx_agent> agents;
+    std::vector<twsfwphysx_missile> missiles;
+    make_crowded_world(world, N_AGENTS, agents, missiles);
+
+    const int32_t *constants = layout();
+    const auto agent_size = static_cast<std::size_t>(constants[0]);
+    const auto missile_size = static_cast<std::size_t>(constants[6]);
+    assert(agent_size == sizeof(twsfwphysx_agent));
+    assert(missile_size == sizeof(twsfwphysx_missile));
+
+    auto *memory = reinterpret_cast<uint8_t *>(set_agent_count(N_AGENTS));
+    assert(agents_count() == N_AGENTS);
+    for (std::size_t i = 0; i < agents.size(); i++) {
+        const auto &agent = agents[i];
+        const std::array<float, 6> fields = {agent.r.x,
+                                             agent.r.y,
+                                             agent.r.z,
+                                             agent.u.x,
+                                             agent.u.y,
+                                             agent.u.z};
+        auto *slot = memory + i * agent_size;
+        std::memcpy(slot + constants[1], fields.data(), 3 * sizeof(float));
+        std::memcpy(slot + constants[2], fields.data() + 3, 3 * sizeof(float));
+        std::memcpy(slot + constants[3], &agent.v, sizeof(float));
+        std::memcpy(slot + constants[4], &agent.a, sizeof(float));
+        std::memcpy(slot + constants[5], &agent.hp, sizeof(float));
+    }
+
+    clear_missiles();
+    for (int32_t i = 0; i < N_AGENTS; i += 2) {
+        assert(launch_missile(i, i) == i / 2 + 1);
+    }
+    turn_agent(1, .5F);
+
+    // the same world via the C API
+    twsfwphysx_agents expected_agents = twsfwphysx_create_agents(N_AGENTS);
+    std::memcpy(expected_agents.agents,
+                agents.data(),
+                agents.size() * sizeof(twsfwphysx_agent));
+    twsfwphysx_missiles expected_missiles = twsfwphysx_new_missile_batch();
+    for (int32_t i = 0; i < N_AGENTS; i += 2) {
+        auto missile =
+            twsfwphysx_launch_missile(&expected_agents.agents[i], &world);
+        missile.payload = i;
+        twsfwphysx_add_missile(&expected_missiles, missile);
+    }
+    twsfwphysx_turn_agent(&expected_agents.agents[1], .5F);
+
+    for (int32_t tick = 0; tick < 10; tick++) {
+        simulate_in_place(.2F, 20);
+        twsfwphysx_simulate(&expected_agents,
+                            &expected_missiles,
+                            &world,
+                            .2F,
+                            20,
+                            nullptr);
+
+        assert(agents_pointer() == reinterpret_cast<void *>(memory));
+        assert(std::memcmp(agents_pointer(),
+                           expected_agents.agents,
+                           N_AGENTS * agent_size) == 0);
+        assert(missiles_count() == expected_missiles.size);
+        assert(std::memcmp(missiles_pointer(),
+                           expected_missiles.missiles,
+                           static_cast<std::size_t>(expected_missiles.size) *
+                               missile_size) == 0);
+    }
+    assert(missiles_count() < N_AGENTS / 2);
+
+    // growing keeps the existing agents and zeroes new ones
+    set_agent_count(N_AGENTS + 1);
+    assert(std::memcmp(agents_pointer(),
+                       expected_agents.agents,
+                       N_AGENTS * agent_size) == 0);
+    assert(agents_pointer()[N_AGENTS].hp == 0.F);
+
+    twsfwphysx_delete_missile_batch(&expected_missiles);
+    twsfwphysx_delete_agents(&expected_agents);
+}
+
+// Builds command buffers for tick() word by word.
+class Commands final
+{
+    std::vector<uint32_t> m_words;
+
+  public:
+    Commands &add(const int32_t word)
+    {
+        m_words.push_back(static_cast<uint32_t>(word));
+        return *this;
+    }
+
+    Commands &add(const float word)
+    {
+        m_words.push_back(std::bit_cast<uint32_t>(word));
+        return *this;
+    }
+
+    const uint8_t *send(const float t, const int32_t n_steps)
+    {
+        const auto n_bytes =
+            static_cast<int32_t>(m_words.size() * sizeof(uint32_t));
+        auto *buffer = new_command_buffer(std::max(n_bytes, 1));
+        std::memcpy(buffer, m_words.data(), m_words.size() * sizeof(uint32_t));
+        m_words.clear();
+
+        return tick(t, n_steps, buffer, n_bytes);
+    }
+};
+
+struct TickHeader
+{
+    int32_t n_bytes;
+    int32_t tick;
+    int32_t n_applied;
+    int32_t n_agents;
+    int32_t n_missiles;
+    int32_t n_events;
+    int32_t n_dropped;
+};
+
+TickHeader read_header(const uint8_t *output)
+{
+    TickHeader header{};
+    std::memcpy(&header, output, sizeof(TickHeader));
+    assert(header.n_bytes ==
+           static_cast<int32_t>(sizeof(TickHeader) +
+                                static_cast<std::size_t>(header.n_events) *
+                                    sizeof(twsfwphysx_event)));
+    return header;
+}
+
+// Commands are applied to the world that lives in the module. The same
+// changes are applied to a second world via the C API.
+void test_commands()
+{
+    constexpr int32_t N_AGENTS = 50;
+    constexpr int32_t MAX_EVENTS = 1024;
+
+    const twsfwphysx_world world{
+        .restitution = .8F, .agent_radius = .05F, .missile_acceleration = 1.F};
+    init_world(
+        world.restitution, world.agent_radius, world.missile_acceleration);
+    set_agent_count(0);
+    clear_missiles();
+
+    std::vector<twsfwphysx_agent> agents;
+    std::vector<twsfwphysx_missile> missiles;
+    make_crowded_world(world, N_AGENTS, agents, missiles);
+
+    twsfwphysx_agents expected_agents = twsfwphysx_create_agents(N_AGENTS);
+    twsfwphysx_missiles expected_missiles = twsfwphysx_new_missile_batch();
+    std::vector<twsfwphysx_event> storage(MAX_EVENTS);
+    twsfwphysx_events events =
+        twsfwphysx_make_events(storage.data(), MAX_EVENTS);
+    twsfwphysx_simulation_buffer *buffer =
+        twsfwphysx_create_simulation_buffer();
+    twsfwphysx_set_events(buffer, &events);
+
+    const auto check = [&](const uint8_t *output)
+    {
+        const auto header = read_header(output);
+        assert(header.n_agents == expected_agents.size);
+        assert(header.n_missiles == expected_missiles.size);
+        assert(header.n_events == events.size);
+        assert(header.n_dropped == 0);
+
+        for (int32_t i = 0; i < events.size; i++) {
+            assert(std::memcmp(output + sizeof(TickHeader) +
+                                   static_cast<std::size_t>(i) *
+                                       sizeof(twsfwphysx_event),
+                               twsfwphysx_get_event(&events, i),
+                               sizeof(twsfwphysx_event)) == 0);
+        }
+
+        assert(std::memcmp(agents_pointer(),
+                           expected_agents.agents,
+                           static_cast<std::size_t>(expected_agents.size) *
+                               sizeof(twsfwphysx_agent)) == 0);
+        assert(std::memcmp(missiles_pointer(),
+                           expected_missiles.missiles,
+                           static_cast<std::size_t>(expected_missiles.size) *
+                               sizeof(twsfwphysx_missile)) == 0);
+
+        twsfwphysx_clear_events(&events);
+        return header;
+    };
+
+    // spawn all agents and launch missiles from every other agent
+    Commands commands;
+    for (int32_t i = 0; i < N_AGENTS; i++) {
+        const auto &agent = agents[static_cast<std::size_t>(i)];
+        commands.add(5)
+            .add(agent.r.x)
+            .add(agent.r.y)
+            .add(agent.r.z)
+            .add(agent.u.x)
+            .add(agent.u.y)
+            .add(agent.u.z)
+            .add(agent.v)
+            .add(agent.a)
+            .add(agent.hp);
+        expected_agents.agents[i] = agent;
+    }
+    for (int32_t i = 0; i < N_AGENTS; i += 2) {
+        commands.add(3).add(i).add(i);
+        auto missile =
+            twsfwphysx_launch_missile(&expected_agents.agents[i], &world);
+        missile.payload = i;
+        twsfwphysx_add_missile(&expected_missiles, missile);
+    }
+
+    const auto *output = commands.send(.1F, 10);
+    twsfwphysx_simulate(
+        &expected_agents, &expected_missiles, &world, .1F, 10, buffer);
+    auto header = check(output);
+    assert(header.n_applied == N_AGENTS + N_AGENTS / 2);
+    const int32_t first_tick = header.tick;
+
+    // steer some agents, then remove agent 3 (agent 49 takes over its index)
+    int32_t n_events = 0;
+    for (int32_t i = 0; i < 20; i++) {
+        const auto agent = (7 * i) % (N_AGENTS - 2);
+        commands.add(1).add(agent).add(.05F * static_cast<float>(i % 5));
+        commands.add(2).add(agent).add(.3F);
+        commands.add(4).add(agent + 1).add(2.F);
+        expected_agents.agents[agent].a = .05F * static_cast<float>(i % 5);
+        twsfwphysx_turn_agent(&expected_agents.agents[agent], .3F);
+        expected_agents.agents[agent + 1].hp = 2.F;
+
+        if (i == 10) {
+            commands.add(6).add(3);
+            expected_agents.agents[3] = expected_agents.agents[N_AGENTS - 1];
+            expected_agents.size -= 1;
+        }
+
+        output = commands.send(.1F, 10);
+        twsfwphysx_simulate(
+            &expected_agents, &expected_missiles, &world, .1F, 10, buffer);
+        header = check(output);
+        assert(header.n_applied == (i == 10 ? 4 : 3));
+        assert(header.tick == first_tick + i + 1);
+        n_events += header.n_events;
+    }
+    assert(n_events > 0);
+    assert(agents_count() == N_AGENTS - 1);
+
+    // malformed commands (unknown opcode, invalid agent, truncated) stop
+    // processing
+    header = read_header(commands.add(1).add(0).add(.1F).add(42).add(1).send(
+        0.F, 0));
+    assert(header.n_applied == 1);
+    header = read_header(commands.add(2).add(N_AGENTS).add(.1F).send(0.F, 0));
+    assert(header.n_applied == 0);
+    header = read_header(commands.add(5).add(0.F).add(1.F).send(0.F, 0));
+    assert(header.n_applied == 0);
+
+    twsfwphysx_delete_simulation_buffer(buffer);
+    twsfwphysx_delete_missile_batch(&expected_missiles);
+    twsfwphysx_delete_agents(&expected_agents);
+}
+
+// Missiles of decoded states are not in the order of the engine. They are
+// compared after sorting by payload.
+std::vector<twsfwphysx_missile>
+sorted_missiles(std::vector<twsfwphysx_missile> missiles)
+{
+    std::sort(missiles.begin(),
+              missiles.end(),
+              [](const auto &a, const auto &b)
+              {
+                  return a.payload < b.payload;
+              });
+    return missiles;
+}
+
+// Checks a decoded state against the full state. Agents are exact, missiles
+// only deviate by rounding errors of their positions.
+void check_decoded(const delta::State &state,
+                   const std::vector<twsfwphysx_agent> &agents,
+                   const std::vector<twsfwphysx_missile> &missiles,
+                   const bool exact)
+{
+    assert(state.agents.size() == agents.size());
+    assert(agents.empty() ||
+           std::memcmp(state.agents.data(),
+                       agents.data(),
+                       agents.size() * sizeof(twsfwphysx_agent)) == 0);
+
+    assert(state.missiles.size() == missiles.size());
+    const auto decoded = sorted_missiles(state.missiles);
+    const auto expected = sorted_missiles(missiles);
+    for (std::size_t i = 0; i < expected.size(); i++) {
+        const auto &a = decoded[i];
+        const auto &b = expected[i];
+        assert(a.payload == b.payload);
+        assert(same(to_vec(a.u), to_vec(b.u)));
+        assert(same(a.v, b.v));
+        if (exact) {
+            assert(same(to_vec(a.r), to_vec(b.r)));
+        } else {
+            assert(std::abs(a.r.x - b.r.x) < 1e-5F);
+            assert(std::abs(a.r.y - b.r.y) < 1e-5F);
+            assert(std::abs(a.r.z - b.r.z) < 1e-5F);
+        }
+    }
+}
+
+// Decodes the outputs of serialize_delta() like a host would do and compares
+// them to the full state in linear memory.
+void test_delta_encoding()
+{
+    constexpr int32_t N_AGENTS = 50;
+    constexpr int32_t N_TICKS = 300;
+    constexpr int32_t LAG = 2;
+
+    const twsfwphysx_world world{
+        .restitution = .8F, .agent_radius = .05F, .missile_acceleration = 1.F};
+    init_world(
+        world.restitution, world.agent_radius, world.missile_acceleration);
+
+    std::vector<twsfwphysx_agent> agents;
+    std::vector<twsfwphysx_missile> missiles;
+    make_crowded_world(world, N_AGENTS, agents, missiles);
+
+    std::memcpy(set_agent_count(N_AGENTS),
+                agents.data(),
+                agents.size() * sizeof(twsfwphysx_agent));
+    clear_missiles();
+
+    delta::History history;
+    std::size_t delta_bytes = 0;
+    std::size_t full_bytes = 0;
+    int32_t last_resync = -1;
+    int32_t n_deltas = 0;
+    int32_t n_resyncs = 0;
+    for (int32_t i = 0; i < N_TICKS; i++) {
+        // missiles are launched, agents are steered, removed and added
+        if (i % 3 == 0) {
+            launch_missile((5 * i) % agents_count(), i);
+        }
+        if (i % 7 == 0) {
+            turn_agent(i % agents_count(), .2F);
+            agents_pointer()[i % agents_count()].a =
+                .01F * static_cast<float>(i);
+        }
+        if (i % 50 == 25) {
+            set_agent_count(agents_count() - 1);
+        }
+        if (i % 50 == 45) {
+            auto agent = agents[static_cast<std::size_t>(i) % agents.size()];
+            agent.hp = 1.F;
+            set_agent_count(agents_count() + 1)[agents_count() - 1] = agent;
+        }
+
+        simulate_in_place(.05F, 5);
+
+        const auto *output = serialize_delta();
+        delta::Header header{};
+        std::memcpy(&header, output, sizeof(delta::Header));
+        assert(header.tick >= 0);
+        assert(header.n_agents == agents_count());
+        assert(header.n_removed + header.n_moved + header.n_spawned >=
+               missiles_count());
+
+        const auto n_bytes = static_cast<std::size_t>(header.n_bytes);
+        assert(delta::decode({output, n_bytes}, history));
+        const auto *state = history.find(header.tick);
+        assert(state != nullptr);
+
+        const auto *agents_begin = agents_pointer();
+        const auto *missiles_begin = missiles_pointer();
+        check_decoded(
+            *state,
+            {agents_begin, agents_begin + agents_count()},
+            {missiles_begin, missiles_begin + missiles_count()},
+            header.baseline == delta::NO_BASELINE);
+
+        if (header.baseline == delta::NO_BASELINE) {
+            assert(header.n_agent_records == header.n_agents);
+            assert(header.n_spawned == missiles_count());
+            assert(last_resync < 0 ||
+                   header.tick - last_resync <= delta::RESYNC_INTERVAL);
+            last_resync = header.tick;
+            n_resyncs += 1;
+        } else {
+            assert(header.tick - header.baseline < delta::HISTORY_SIZE);
+            assert(header.tick - header.baseline == LAG + 1 ||
+                   (i > 150 && i <= 200));
+            n_deltas += 1;
+        }
+
+        // The host acknowledges with a delay and stops acknowledging for a
+        // while (which forces a resync).
+        if (i < 150 || i >= 200) {
+            acknowledge(header.tick - LAG);
+        }
+
+        delta_bytes += n_bytes;
+        // size of an output without baseline
+        full_bytes += sizeof(delta::Header) +
+                      static_cast<std::size_t>(agents_count()) *
+                          (sizeof(uint32_t) + sizeof(twsfwphysx_agent)) +
+                      static_cast<std::size_t>(missiles_count()) *
+                          sizeof(twsfwphysx_missile);
+    }
+
+    // deltas also follow worlds that are replaced via simulate()
+    const auto *result = twsfwphysx::GetWorldState(
+        simulate_state(serialize(agents, missiles, false), .05F, 5));
+    std::vector<twsfwphysx_agent> result_agents(
+        result->packed_agents()->size());
+    std::memcpy(result_agents.data(),
+                result->packed_agents()->Data(),
+                result_agents.size() * sizeof(twsfwphysx_agent));
+    std::vector<twsfwphysx_missile> result_missiles(
+        result->packed_missiles()->size());
+    std::memcpy(result_missiles.data(),
+                result->packed_missiles()->Data(),
+                result_missiles.size() * sizeof(twsfwphysx_missile));
+
+    const auto *output = serialize_delta();
+    delta::Header header{};
+    std::memcpy(&header, output, sizeof(delta::Header));
+    assert(header.baseline != delta::NO_BASELINE);
+    assert(delta::decode(
+        {output, static_cast<std::size_t>(header.n_bytes)}, history));
+    check_decoded(
+        *history.find(header.tick), result_agents, result_missiles, false);
+
+    assert(n_deltas > N_TICKS / 2);
+    assert(n_resyncs > N_TICKS / delta::RESYNC_INTERVAL);
+    assert(missiles_count() > 0);
+    assert(4 * delta_bytes < 3 * full_bytes);
+}
+
+double dot(const twsfwphysx_vec &a, const twsfwphysx_vec &b)
+{
+    return double{a.x} * b.x + double{a.y} * b.y + double{a.z} * b.z;
+}
+
+// angle between two vectors (accurate for small angles as well)
+double angle_between(const twsfwphysx_vec &a, const twsfwphysx_vec &b)
+{
+    const double x = double{a.y} * b.z - double{a.z} * b.y;
+    const double y = double{a.z} * b.x - double{a.x} * b.z;
+    const double z = double{a.x} * b.y - double{a.y} * b.x;
+    return std::atan2(std::sqrt(x * x + y * y + z * z), dot(a, b));
+}
+
+// Quantised agents and missiles stay within these errors.
+constexpr double MAX_ANGLE_ERROR = 1e-4;
+constexpr double MAX_NORM_ERROR = 1e-6;
+
+// Fixed-point numbers deviate by half a step (plus rounding errors).
+bool within_step(const float expected, const float value, const float step)
+{
+    return std::abs(expected - value) <=
+           .5F * step + 1e-6F * std::abs(expected);
+}
+
+void check_quantised(const twsfwphysx_agent &expected,
+                     const twsfwphysx_agent &agent,
+                     const compact::Steps &steps)
+{
+    assert(angle_between(expected.r, agent.r) < MAX_ANGLE_ERROR);
+    assert(angle_between(expected.u, agent.u) < MAX_ANGLE_ERROR);
+    assert(std::abs(dot(agent.r, agent.r) - 1.) < MAX_NORM_ERROR);
+    assert(std::abs(dot(agent.u, agent.u) - 1.) < MAX_NORM_ERROR);
+    assert(std::abs(dot(agent.r, agent.u)) < MAX_NORM_ERROR);
+    assert(within_step(expected.v, agent.v, steps.speed));
+    assert(within_step(expected.a, agent.a, steps.speed));
+    assert(within_step(expected.hp, agent.hp, steps.hp));
+}
+
+void check_quantised(const twsfwphysx_missile &expected,
+                     const twsfwphysx_missile &missile,
+                     const compact::Steps &steps)
+{
+    assert(angle_between(expected.r, missile.r) < MAX_ANGLE_ERROR);
+    assert(angle_between(expected.u, missile.u) < MAX_ANGLE_ERROR);
+    assert(std::abs(dot(missile.r, missile.u)) < MAX_NORM_ERROR);
+    assert(within_step(expected.v, missile.v, steps.speed));
+    assert(expected.payload == missile.payload);
+}
+
+// Random agents (with arbitrary orientations) are encoded and decoded.
+void test_quantisation_error()
+{
+    constexpr int32_t N_AGENTS = 100'000;
+
+    std::mt19937 rng(42);
+    std::normal_distribution<float> normal;
+    std::uniform_real_distribution<float> uniform(-1.F, 1.F);
+
+    const auto random_unit = [&]()
+    {
+        return compact::normalized({normal(rng), normal(rng), normal(rng)});
+    };
+
+    std::vector<twsfwphysx_agent> agents;
+    std::vector<twsfwphysx_missile> missiles;
+    for (int32_t i = 0; i < N_AGENTS; i++) {
+        const auto r = random_unit();
+        const auto t = random_unit();
+        const auto u = compact::normalized({r.y * t.z - r.z * t.y,
+                                            r.z * t.x - r.x * t.z,
+                                            r.x * t.y - r.y * t.x});
+        agents.push_back({.r = r,
+                          .u = u,
+                          .v = 3.F * uniform(rng),
+                          .a = uniform(rng),
+                          .hp = std::round(100.F * uniform(rng))});
+        missiles.push_back({.r = r, .u = u, .v = 5.F, .payload = i});
+    }
+
+    // unit vectors along the axes and the edges of the octahedron
+    for (const auto &r : {twsfwphysx_vec{0.F, 0.F, 1.F},
+                          twsfwphysx_vec{0.F, 0.F, -1.F},
+                          twsfwphysx_vec{1.F, 0.F, 0.F},
+                          twsfwphysx_vec{0.F, -1.F, 0.F},
+                          compact::normalized({1.F, -1.F, 0.F})})
+    {
+        const auto u = compact::normalized({-r.y - r.z, r.x, r.x});
+        agents.push_back({.r = r, .u = u, .v = 0.F, .a = 0.F, .hp = 0.F});
+    }
+
+    // HPs are small integers and thus exact
+    auto steps = compact::steps(agents, missiles);
+    assert(steps.hp == 1.F);
+    assert(steps.speed == 5.F / compact::SNORM_MAX);
+    for (std::size_t i = 0; i < agents.size(); i++) {
+        const auto agent =
+            compact::decode(compact::encode(agents[i], steps), steps);
+        check_quantised(agents[i], agent, steps);
+        assert(agent.hp == agents[i].hp);
+    }
+    for (const auto &missile : missiles) {
+        check_quantised(missile,
+                        compact::decode(compact::encode(missile, steps), steps),
+                        steps);
+    }
+
+    // otherwise, HPs are fixed-point numbers as well
+    agents[0].hp = 1e4F + .5F;
+    steps = compact::steps(agents, {});
+    assert(steps.hp == agents[0].hp / compact::SNORM_MAX);
+    for (const auto &agent : agents) {
+        check_quantised(agent,
+                        compact::decode(compact::encode(agent, steps), steps),
+                        steps);
+    }
+
+    // positive HPs below half a step are rounded up such that agents survive
+    agents[0].hp = 1e3F + .5F;
+    agents[1].hp = .01F;
+    steps = compact::steps({agents.data(), 2}, {});
+    assert(agents[1].hp < .5F * steps.hp);
+    const auto agent =
+        compact::decode(compact::encode(agents[1], steps), steps);
+    assert(agent.hp > 0.F);
+    assert(agent.hp == steps.hp);
+}
+
+std::vector<uint8_t>
+serialize_compact(const std::vector<twsfwphysx_agent> &agents,
+                  const std::vector<twsfwphysx_missile> &missiles)
+{
+    flatbuffers::FlatBufferBuilder builder(1024);
+
+    const auto steps = compact::steps(agents, missiles);
+    std::vector<twsfwphysx::CompactAgent> compact_agents;
+    for (const auto &agent : agents) {
+        compact_agents.push_back(compact::encode(agent, steps));
+    }
+    const auto agents_vector = builder.CreateVectorOfStructs(compact_agents);
+
+    std::vector<twsfwphysx::CompactMissile> compact_missiles;
+    for (const auto &missile : missiles) {
+        compact_missiles.push_back(compact::encode(missile, steps));
+    }
+    const auto missiles_vector =
+        builder.CreateVectorOfStructs(compact_missiles);
+
+    twsfwphysx::WorldStateBuilder state(builder);
+    state.add_compact_agents(agents_vector);
+    state.add_compact_missiles(missiles_vector);
+    state.add_speed_step(steps.speed);
+    state.add_hp_step(steps.hp);
+    builder.Finish(state.Finish());
+
+    const auto *data = builder.GetBufferPointer();
+    return {data, data + builder.GetSize()};
+}
+
+// Results of compact inputs are compact as well. They match the results of
+// the (decoded) input in the packed format up to quantisation errors.
+void test_compact_format()
+{
+    constexpr int32_t N_AGENTS = 50;
+
+    const twsfwphysx_world world{
+        .restitution = .8F, .agent_radius = .05F, .missile_acceleration = 1.F};
+    init_world(
+        world.restitution, world.agent_radius, world.missile_acceleration);
+
+    std::vector<twsfwphysx_agent> agents;
+    std::vector<twsfwphysx_missile> missiles;
+    make_crowded_world(world, N_AGENTS, agents, missiles);
+
+    const auto compact_state = serialize_compact(agents, missiles);
+    const auto packed_state = serialize(agents, missiles, false);
+    assert(2 * compact_state.size() < packed_state.size());
+
+    // the decoded input
+    const auto *input = twsfwphysx::GetWorldState(compact_state.data());
+    const compact::Steps input_steps{.speed = input->speed_step(),
+                                     .hp = input->hp_step()};
+    for (auto i = 0U; i < agents.size(); i++) {
+        agents[i] =
+            compact::decode(*input->compact_agents()->Get(i), input_steps);
+    }
+    for (auto i = 0U; i < missiles.size(); i++) {
+        missiles[i] =
+            compact::decode(*input->compact_missiles()->Get(i), input_steps);
+    }
+
+    const auto *packed = twsfwphysx::GetWorldState(
+        simulate_state(serialize(agents, missiles, false), 2.F, 200));
+    const auto expected_agents = copy_structs(packed->packed_agents());
+    const auto expected_missiles = copy_structs(packed->packed_missiles());
+
+    const auto *result =
+        twsfwphysx::GetWorldState(simulate_state(compact_state, 2.F, 200));
+    assert(result->packed_agents() == nullptr);
+    assert(result->packed_missiles() == nullptr);
+    assert(result->compact_agents()->size() == expected_agents.size());
+    assert(result->compact_missiles()->size() == expected_missiles.size());
+    assert(expected_missiles.size() < missiles.size());
+
+    const compact::Steps steps{.speed = result->speed_step(),
+                               .hp = result->hp_step()};
+    for (auto i = 0U; i < expected_agents.size(); i++) {
+        twsfwphysx_agent expected{};
+        std::memcpy(&expected, &expected_agents[i], sizeof(expected));
+        check_quantised(
+            expected,
+            compact::decode(*result->compact_agents()->Get(i), steps),
+            steps);
+    }
+    for (auto i = 0U; i < expected_missiles.size(); i++) {
+        twsfwphysx_missile expected{};
+        std::memcpy(&expected, &expected_missiles[i], sizeof(expected));
+        check_quantised(
+            expected,
+            compact::decode(*result->compact_missiles()->Get(i), steps),
+            steps);
+    }
+}
+
 int asserts_enabled()
 {
     int32_t ret = -1;
@@ -110,5 +1100,13 @@ int main(int /*argc*/, char ** /*argv*/)
 
     assert(state->missiles()->Get(0)->payload() == 2);
 
+    test_packed_and_legacy_format();
+    test_linear_memory();
+    test_commands();
+    test_delta_encoding();
+    test_quantisation_error();
+    test_compact_format();
+    test_steady_state();
+
     return asserts_enabled();
 }